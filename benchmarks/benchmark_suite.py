@@ -0,0 +1,550 @@
+#!/usr/bin/env python3
+"""Per-primitive benchmark suite for the simulator.
+
+Runs the RSA primitives (modload, montmul, modexp, modexp_blinded) at 768,
+1024 and 2048 bits, the P-256 primitives of sim_ecc_tests and the _cops
+micro-ops in-process. Simulator kernels are timed around run_machine() only,
+so DMEM setup, result checks, interpreter startup and assembly stay out of
+the numbers; they report instructions/s and simulated cycles/s. Micro-ops
+report ns/op; the int.* kernels run the batches of the *_many calls on
+Python ints, as their baseline. rsa1024.modexp_lanes* runs a group of
+modexps through run_lanes(), rsa1024.modexp_x* the same group one by one.
+
+Simulator kernels also record the machines' perf_counters() summed over
+one sample, so --json carries the native/Python split, superinstruction
+hit rate, DMEM traffic and phase times next to each timing.
+
+--json writes the results, --compare diffs against such a file and exits
+non-zero when a kernel got slower than --threshold.
+"""
+
+from __future__ import annotations
+
+import argparse
+import contextlib
+import importlib.util
+import io
+import json
+import os
+import platform
+import re
+import statistics
+import sys
+import time
+from pathlib import Path
+
+REPO_ROOT = Path(__file__).resolve().parents[1]
+
+RSA_BITS = (768, 1024, 2048)
+
+# operand counts of the batched _cops calls
+MANY_COUNT = 256
+
+# machines per lockstep group of the lane kernels
+LANE_COUNT = 16
+
+
+def _summary(values):
+    return {
+        "mean": statistics.fmean(values),
+        "min": min(values),
+        "max": max(values),
+        "stdev": statistics.stdev(values) if len(values) > 1 else 0.0,
+    }
+
+
+# ---------------------------------------------------------------------------
+# drivers
+# ---------------------------------------------------------------------------
+
+
+class _RunTimer:
+    """Stands in for a driver's run_machine() and accounts the time spent in it
+
+    perf sums the perf_counters() of the machines run, taken right after
+    their run so the driver's result readback stays out of them.
+    """
+
+    def __init__(self, run_machine):
+        self._run_machine = run_machine
+        self.reset()
+
+    def reset(self):
+        from ot_dsim.bignum_lib.machine import PERF_COUNTER_FIELDS
+
+        self.seconds = 0.0
+        self.perf = [0] * len(PERF_COUNTER_FIELDS)
+
+    def perf_dict(self):
+        from ot_dsim.bignum_lib.machine import perf_counters_dict
+
+        return perf_counters_dict(self.perf)
+
+    def __call__(self, machine, *args, **kwargs):
+        start = time.perf_counter()
+        try:
+            return self._run_machine(machine, *args, **kwargs)
+        finally:
+            self.seconds += time.perf_counter() - start
+            self.perf = [a + b for a, b in zip(self.perf, machine.perf_counters())]
+
+
+def _load_driver(name, alias):
+    """Private copy of the driver module name, with run_machine() timed"""
+    spec = importlib.util.spec_from_file_location(alias, REPO_ROOT / (name + ".py"))
+    mod = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(mod)
+    mod.ENABLE_TRACE_DUMP = False
+    mod.timer = _RunTimer(mod.run_machine)
+    mod.run_machine = mod.timer
+    return mod
+
+
+def _rsa_otbn_driver():
+    t = _load_driver("sim_rsa_tests", "_bench_rsa_otbn")
+    t.init_dmem()
+    t.load_program_otbn_asm()
+    t.breakpoints = {}
+    return t
+
+
+def _rsa_dcrypto_driver():
+    # modexp_blinded only exists in the dcrypto library, which addresses
+    # DMEM in 256 bit words rather than bytes
+    t = _load_driver("sim_rsa_tests", "_bench_rsa_dcrypto")
+    t.DMEM_BYTE_ADDRESSING = False
+    for name in dir(t):
+        if name.startswith("DMEMP_"):
+            setattr(t, name, getattr(t, name) // t.dmem_mult)
+    t.dmem_mult = 1
+    t.init_dmem()
+    with contextlib.redirect_stdout(io.StringIO()):
+        t.load_program_hex()
+    t.breakpoints = {}
+    return t
+
+
+def _ecc_driver():
+    t = _load_driver("sim_ecc_tests", "_bench_ecc")
+    t.init_dmem()
+    with contextlib.redirect_stdout(io.StringIO()):
+        t.load_program_hex()
+    t.breakpoints = {}
+    return t
+
+
+# ---------------------------------------------------------------------------
+# kernels
+# ---------------------------------------------------------------------------
+
+
+class SimKernel:
+    """Simulator primitive, one sample is one call of fn on the driver
+
+    Every sample starts from the DMEM that prepare left behind, so samples
+    repeat the same work, and with fresh statistics, which otherwise grow
+    by an entry per flag access and wide memory op.
+    """
+
+    unit = "inst"
+
+    def __init__(self, name, driver, prepare, fn):
+        self.name = name
+        self._driver = driver
+        self._prepare = prepare
+        self._fn = fn
+        self._t = None
+        self._dmem = None
+
+    def setup(self, drivers):
+        if self._driver not in drivers:
+            drivers[self._driver] = globals()[self._driver]()
+        self._t = drivers[self._driver]
+        if self._prepare is not None:
+            self._prepare(self._t)
+        self._dmem = list(self._t.dmem)
+
+    def sample(self):
+        t = self._t
+        t.dmem = list(self._dmem)
+        t.stats = t.init_stats()
+        inst, cycles = t.inst_cnt, t.cycle_cnt
+        t.timer.reset()
+        self._fn(t)
+        self.perf = t.timer.perf_dict()
+        return t.timer.seconds, t.inst_cnt - inst, t.cycle_cnt - cycles
+
+
+class OpKernel:
+    """_cops micro-op, one sample is loops calls of fn"""
+
+    unit = "op"
+
+    def __init__(self, name, fn, loops, ops_per_call=1):
+        self.name = name
+        self._fn = fn
+        self._loops = loops
+        self._ops = ops_per_call
+
+    def setup(self, drivers):
+        pass
+
+    def sample(self):
+        fn = self._fn
+        start = time.perf_counter()
+        for _ in range(self._loops):
+            fn()
+        return time.perf_counter() - start, self._loops * self._ops, 0
+
+
+class LaneKernel:
+    """Group of modexp runs on different messages, one sample runs all of them
+
+    With lanes the group goes through run_lanes() in lockstep, otherwise
+    each machine is run on its own, as the baseline.
+    """
+
+    unit = "inst"
+
+    def __init__(self, name, bits, count, lanes):
+        self.name = name
+        self._bits = bits
+        self._count = count
+        self._lanes = lanes
+        self._t = None
+        self._machines = None
+
+    def setup(self, drivers):
+        if "_rsa_otbn_driver" not in drivers:
+            drivers["_rsa_otbn_driver"] = _rsa_otbn_driver()
+        t = drivers["_rsa_otbn_driver"]
+        _rsa_prepare(self._bits)(t)
+        dmem = list(t.dmem)
+        machines = []
+        # Only the machines run_modexp() builds are wanted, not their runs
+        t.run_machine = lambda machine, *args: machines.append(machine) or (0, 0)
+        try:
+            for i in range(self._count):
+                t.dmem = list(dmem)
+                t.load_full_bn_val(t.DMEMP_IN, _MSG + i)
+                t.run_modexp(self._bits // 256, t.RSA_D[self._bits])
+        finally:
+            t.run_machine = t.timer
+            t.dmem = dmem
+        self._machines = machines
+        self._t = t
+
+    def sample(self):
+        from ot_dsim.bignum_lib.machine import PERF_COUNTER_FIELDS, perf_counters_dict, run_lanes
+
+        jobs = [m.fork() for m in self._machines]
+        start = time.perf_counter()
+        if self._lanes:
+            runs = run_lanes(jobs)
+        else:
+            runs = [m.run() for m in jobs]
+        seconds = time.perf_counter() - start
+        t = self._t
+        for i, m in enumerate(jobs):
+            msg = _MSG + i
+            if t.get_full_bn_val(t.DMEMP_OUT, m, self._bits // 256) != pow(
+                msg, t.RSA_D[self._bits], t.RSA_N[self._bits]
+            ):
+                raise RuntimeError("%s returned a wrong result" % self.name)
+        perf = [0] * len(PERF_COUNTER_FIELDS)
+        for m in jobs:
+            perf = [a + b for a, b in zip(perf, m.perf_counters())]
+        self.perf = perf_counters_dict(perf)
+        return seconds, sum(r[0] for r in runs), sum(r[1] for r in runs)
+
+
+# fixed inputs so that runs are comparable
+_MSG = 0x6F745F6473696D2062656E63686D61726B
+
+
+def _rsa_prepare(bits):
+    def prepare(t):
+        t.init_dmem()
+        t.load_mod(t.RSA_N[bits])
+        t.run_modload(bits // 256)
+
+    return prepare
+
+
+def _rsa_modload(bits):
+    def fn(t):
+        t.init_dmem()
+        t.load_mod(t.RSA_N[bits])
+        t.run_modload(bits // 256)
+
+    return fn
+
+
+# a single montmul is only a few thousand instructions
+MONTMUL_CALLS = 32
+
+
+def _rsa_montmul(bits):
+    def fn(t):
+        t.load_full_bn_val(t.DMEMP_IN, _MSG)
+        for _ in range(MONTMUL_CALLS):
+            t.run_montmul(bits // 256, t.DMEMP_IN, t.DMEMP_RR, t.DMEMP_OUT)
+
+    return fn
+
+
+def _rsa_modexp(bits):
+    def fn(t):
+        t.load_full_bn_val(t.DMEMP_IN, _MSG)
+        res = t.run_modexp(bits // 256, t.RSA_D[bits])
+        if res != pow(_MSG, t.RSA_D[bits], t.RSA_N[bits]):
+            raise RuntimeError("modexp-%d returned a wrong result" % bits)
+
+    return fn
+
+
+def _rsa_modexp_blinded(bits):
+    def fn(t):
+        t.load_full_bn_val(t.DMEMP_IN, _MSG)
+        t.run_modexp_blinded(bits // 256, t.RSA_D[bits])
+
+    return fn
+
+
+def _p256(fn):
+    def run(t):
+        t.init_dmem()
+        fn(t)
+
+    return run
+
+
+def _p256_isoncurve(t):
+    if not t.run_isoncurve(t.xexp, t.yexp):
+        raise RuntimeError("p256 isoncurve rejected the test point")
+
+
+def _p256_scalarmult(t):
+    t.run_scalarmult(t.xexp, t.yexp, t.kexp)
+
+
+def _p256_sign(t):
+    t.run_sign(t.d, t.kexp, t.msg_digest_int)
+
+
+def _p256_verify(t):
+    if not t.run_verify(t.xexp, t.yexp, t.rexp, t.sexp, t.msg_digest_int):
+        raise RuntimeError("p256 verify rejected the test signature")
+
+
+def _op_kernels():
+    from ot_dsim.bignum_lib import c_backend as cb
+
+    a = 0xB0DBED46D932F07CD42023D2355A8617DB247236333BC2648BA4496E74FEFAD2
+    b = 0x820CC4123A4867E115CC94DF441B4EC018BA461B512CE20FC03277ED5F8BE5A3
+    lhs = cb.pack_u256_many((a + i) & cb.XLEN_MASK for i in range(MANY_COUNT))
+    rhs = cb.pack_u256_many((b ^ i) for i in range(MANY_COUNT))
+    # the same operands as Python ints, the baseline of the *_many calls
+    lhs_ints = cb.unpack_u256_many(lhs)
+    rhs_ints = cb.unpack_u256_many(rhs)
+    hex_words = b"".join(b"%08x\n" % (0x9E3779B9 * i & 0xFFFFFFFF) for i in range(4096))
+    dmem_hex = b"".join(
+        b"%04d: " % i + b" ".join(b"%08x" % ((a ^ i) >> (32 * k) & cb.LIMB_MASK) for k in range(7, -1, -1)) + b"\n"
+        for i in range(1024)
+    )
+    loops = 20000
+    many_loops = 200
+    return [
+        OpKernel("cops.add_u256", lambda: cb.add_u256(a, b, True), loops),
+        OpKernel("cops.sub_u256", lambda: cb.sub_u256(a, b, True), loops),
+        OpKernel("cops.cmp_u256", lambda: cb.cmp_u256(a, b), loops),
+        OpKernel("cops.xor_u256", lambda: cb.xor_u256(a, b), loops),
+        OpKernel("cops.shl_u256", lambda: cb.shl_u256(a, 77), loops),
+        OpKernel("cops.get_limb", lambda: cb.get_limb(a, 5), loops),
+        OpKernel("cops.set_limb", lambda: cb.set_limb(a, 5, 0x12345678), loops),
+        OpKernel("cops.mulqacc", lambda: cb.mulqacc(a >> 16, a, b, 1, 2, 64), loops),
+        OpKernel("cops.mulh", lambda: cb.mulh(a, b, True, False), loops),
+        OpKernel("cops.add_u256_many", lambda: cb.add_u256_many(lhs, rhs), many_loops, MANY_COUNT),
+        OpKernel("cops.cmp_u256_many", lambda: cb.cmp_u256_many(lhs, rhs), many_loops, MANY_COUNT),
+        OpKernel("cops.xor_u256_many", lambda: cb.xor_u256_many(lhs, rhs), many_loops, MANY_COUNT),
+        OpKernel("cops.mul_u256_many", lambda: cb.mul_u256_many(lhs, rhs), many_loops, MANY_COUNT),
+        OpKernel(
+            "int.xor_many", lambda: [x ^ y for x, y in zip(lhs_ints, rhs_ints)], many_loops, MANY_COUNT
+        ),
+        OpKernel(
+            "int.mul_many", lambda: [x * y for x, y in zip(lhs_ints, rhs_ints)], many_loops, MANY_COUNT
+        ),
+        OpKernel("cops.parse_hex_words", lambda: cb.parse_hex_words(hex_words), many_loops, 4096),
+        OpKernel("cops.parse_dmem_hex", lambda: cb.parse_dmem_hex(dmem_hex), many_loops, 1024),
+    ]
+
+
+def kernels():
+    ks = []
+    for bits in RSA_BITS:
+        prep = _rsa_prepare(bits)
+        ks += [
+            SimKernel("rsa%d.modload" % bits, "_rsa_otbn_driver", None, _rsa_modload(bits)),
+            SimKernel("rsa%d.montmul" % bits, "_rsa_otbn_driver", prep, _rsa_montmul(bits)),
+            SimKernel("rsa%d.modexp" % bits, "_rsa_otbn_driver", prep, _rsa_modexp(bits)),
+            SimKernel(
+                "rsa%d.modexp_blinded" % bits, "_rsa_dcrypto_driver", prep, _rsa_modexp_blinded(bits)
+            ),
+        ]
+    ks += [
+        SimKernel("p256.isoncurve", "_ecc_driver", None, _p256(_p256_isoncurve)),
+        SimKernel("p256.scalarmult", "_ecc_driver", None, _p256(_p256_scalarmult)),
+        SimKernel("p256.sign", "_ecc_driver", None, _p256(_p256_sign)),
+        SimKernel("p256.verify", "_ecc_driver", None, _p256(_p256_verify)),
+        LaneKernel("rsa1024.modexp_x%d" % LANE_COUNT, 1024, LANE_COUNT, False),
+        LaneKernel("rsa1024.modexp_lanes%d" % LANE_COUNT, 1024, LANE_COUNT, True),
+    ]
+    return ks + _op_kernels()
+
+
+# ---------------------------------------------------------------------------
+# running and reporting
+# ---------------------------------------------------------------------------
+
+
+def run_kernel(kernel, drivers, warmup, repeat):
+    kernel.setup(drivers)
+    for _ in range(warmup):
+        kernel.sample()
+    seconds, counts, cycles = [], set(), set()
+    for _ in range(repeat):
+        secs, n, cyc = kernel.sample()
+        seconds.append(secs)
+        counts.add(n)
+        cycles.add(cyc)
+    if len(counts) != 1 or len(cycles) != 1:
+        raise RuntimeError("%s is not deterministic: %r %r" % (kernel.name, counts, cycles))
+    n, cyc = counts.pop(), cycles.pop()
+    best = min(seconds)
+    result = {
+        "unit": kernel.unit,
+        "count": n,
+        "seconds": _summary(seconds),
+        "ns_per_%s" % kernel.unit: best / n * 1e9,
+    }
+    if kernel.unit == "inst":
+        result["cycles"] = cyc
+        result["inst_per_s"] = n / best
+        result["cycles_per_s"] = cyc / best
+        result["perf"] = kernel.perf
+    return result
+
+
+def _ns(result):
+    return result["ns_per_%s" % result["unit"]]
+
+
+def _format(name, result):
+    if result["unit"] == "inst":
+        return "%-26s %10d inst %10d cyc  %7.2f Minst/s %7.2f Mcyc/s  %7.1f ns/inst" % (
+            name,
+            result["count"],
+            result["cycles"],
+            result["inst_per_s"] / 1e6,
+            result["cycles_per_s"] / 1e6,
+            _ns(result),
+        )
+    return "%-26s %10d op   %44s  %7.1f ns/op" % (name, result["count"], "", _ns(result))
+
+
+def _backend():
+    from ot_dsim.bignum_lib import c_backend, machine
+
+    return {
+        "machine": "c%d" % machine._C_MACHINE_ABI_VERSION if machine._USE_C_MACHINE else "py",
+        "cops": "c" if c_backend.is_available() else "py",
+    }
+
+
+def compare(results, baseline, threshold):
+    """Print the change against baseline, returns the names that regressed"""
+    regressed = []
+    print()
+    print("Against baseline (threshold %+.0f%%):" % (threshold * 100))
+    for name, result in results.items():
+        base = baseline.get(name)
+        if base is None or base.get("unit") != result["unit"]:
+            print("  %-26s new" % name)
+            continue
+        if base["count"] != result["count"]:
+            # a different instruction count means a different workload
+            print("  %-26s count changed %d -> %d" % (name, base["count"], result["count"]))
+        change = _ns(result) / _ns(base) - 1.0
+        mark = ""
+        if change > threshold:
+            mark = "  REGRESSION"
+            regressed.append(name)
+        print("  %-26s %8.1f -> %8.1f ns/%s %+7.1f%%%s"
+              % (name, _ns(base), _ns(result), result["unit"], change * 100, mark))
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--warmup", type=int, default=1, help="untimed samples per kernel")
+    parser.add_argument("--repeat", type=int, default=5, help="timed samples per kernel")
+    parser.add_argument("--filter", default=None, help="regular expression selecting kernels by name")
+    parser.add_argument("--list", action="store_true", help="list the kernels and exit")
+    parser.add_argument("--json", metavar="FILE", default=None, help="write the results to FILE")
+    parser.add_argument("--compare", metavar="BASELINE", default=None, help="diff against a --json file")
+    parser.add_argument(
+        "--threshold", type=float, default=0.10, help="slowdown fraction counted as a regression"
+    )
+    args = parser.parse_args()
+    if args.repeat < 1:
+        parser.error("--repeat must be at least 1")
+    json_path = os.path.abspath(args.json) if args.json else None
+    compare_path = os.path.abspath(args.compare) if args.compare else None
+
+    # the drivers open their programs relative to the repository root
+    os.chdir(REPO_ROOT)
+    sys.path.insert(0, str(REPO_ROOT))
+
+    selected = kernels()
+    if args.filter:
+        pattern = re.compile(args.filter)
+        selected = [k for k in selected if pattern.search(k.name)]
+    if args.list:
+        for k in selected:
+            print(k.name)
+        return 0
+
+    backend = _backend()
+    print("backend: machine=%s cops=%s  warmup=%d repeat=%d"
+          % (backend["machine"], backend["cops"], args.warmup, args.repeat))
+    drivers = {}
+    results = {}
+    for k in selected:
+        results[k.name] = run_kernel(k, drivers, args.warmup, args.repeat)
+        print(_format(k.name, results[k.name]), flush=True)
+
+    if json_path:
+        doc = {
+            "backend": backend,
+            "python": platform.python_version(),
+            "machine": platform.machine(),
+            "warmup": args.warmup,
+            "repeat": args.repeat,
+            "results": results,
+        }
+        with open(json_path, "w") as f:
+            json.dump(doc, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if compare_path:
+        with open(compare_path) as f:
+            baseline = json.load(f)
+        if baseline.get("backend") != backend:
+            print("warning: baseline backend %r differs from %r" % (baseline.get("backend"), backend))
+        if compare(results, baseline["results"], args.threshold):
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
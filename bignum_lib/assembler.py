@@ -14,6 +14,7 @@ class Assembler:
 
     def __init__(self, lines, dmem_byte_addressing=False, otbn_only=False):
         self.otbn_only = otbn_only
+        self.dmem_byte_addressing = dmem_byte_addressing
         self.funclose =  [] # List of addresses where functions are closed
         self.instr = [] # the program (mnem, (param_string, line))
         self.ins_objects = []
@@ -165,24 +166,87 @@ class Assembler:
                 self.ctx.functions[key] = (value, funlen)
                 print('Warning: No length parameter for function \'' + key + '\' ')
 
+    def __create_instr(self, address):
+        item = self.instr[address]
+        line = item[1][1]
+        mnem = item[0]
+        params = item[1][0]
+        asm_str = mnem + ' ' + params
+        try:
+            if self.ins_fac.is_valid_mnem(mnem) and (not self.otbn_only):
+                return self.ins_fac.factory_asm(address, asm_str, self.ctx)
+            return self.ins_fac_ot.factory_asm(address, asm_str, self.ctx)
+        except Exception:
+            print('Error at instruction address: ' + str(address) + ', assembly line: ' + str(line+1))
+            raise
+
     def assemble(self):
-        for i, item in enumerate(self.instr):
-            address = i
-            line = item[1][1]
-            mnem = item[0]
-            params = item[1][0]
-            asm_str = mnem + ' ' + params
-            try:
-                if self.ins_fac.is_valid_mnem(mnem) and (not self.otbn_only):
-                    ins_obj = self.ins_fac.factory_asm(address, asm_str, self.ctx)
-                else:
-                    ins_obj = self.ins_fac_ot.factory_asm(address, asm_str, self.ctx)
-                if ins_obj != 0:
-                    self.ins_objects.append(ins_obj)
+        for i in range(len(self.instr)):
+            ins_obj = self.__create_instr(i)
+            if ins_obj != 0:
+                self.ins_objects.append(ins_obj)
+
+    def __layout(self):
+        return (len(self.instr), self.ctx.functions, self.ctx.loopclose, self.ctx.labels,
+                self.funclose, self.breakpoints)
+
+    def __take_over(self, new):
+        """Assemble new in full and become it, keeping the identity of the
+        object list; a failing assembly leaves self and the list alone"""
+        new.assemble()
+        ins_objects = self.ins_objects
+        ins_objects[:] = new.ins_objects
+        self.__dict__.update(new.__dict__)
+        self.ins_objects = ins_objects
+        return None
+
+    def reassemble(self, lines, program=None):
+        """Assemble an edited version of the source, re-creating only what changed
 
-            except Exception:
-                print('Error at instruction address: ' + str(address) + ', assembly line: ' + str(line+1))
-                raise
+        When the edit keeps the layout (instruction count, function, loop
+        and label addresses, breakpoints), only the instructions whose text
+        changed are created again. They replace the old ones in place in
+        get_instruction_objects(), so machines running that list pick them
+        up, and program, a Program of the old objects, is patched to match.
+        Returns the (start, end) address ranges re-created. Otherwise the
+        source is assembled afresh (the object list is still updated in
+        place) and None is returned: program no longer matches and has to
+        be rebuilt. An edit that fails to assemble raises and changes
+        neither the assembler nor the object list.
+        """
+        new = Assembler(lines, dmem_byte_addressing=self.dmem_byte_addressing,
+                        otbn_only=self.otbn_only)
+        if (new.__layout() != self.__layout() or len(self.ins_objects) != len(self.instr)):
+            return self.__take_over(new)
+
+        ranges = []
+        for address, (old, item) in enumerate(zip(self.instr, new.instr)):
+            if (old[0], old[1][0]) == (item[0], item[1][0]):
+                continue
+            if ranges and ranges[-1][1] == address:
+                ranges[-1] = (ranges[-1][0], address + 1)
+            else:
+                ranges.append((address, address + 1))
+        old_instr = self.instr
+        self.instr = new.instr
+        created = {}
+        try:
+            for start, end in ranges:
+                for address in range(start, end):
+                    created[address] = self.__create_instr(address)
+        except Exception:
+            self.instr = old_instr
+            raise
+        if 0 in created.values():
+            # an edit that drops an instruction object shifts the program
+            self.instr = old_instr
+            return self.__take_over(new)
+        self.lines = lines
+        for start, end in ranges:
+            self.ins_objects[start:end] = [created[a] for a in range(start, end)]
+            if program is not None:
+                program.patch(start, self.ins_objects[start:end])
+        return ranges
 
     def get_instruction_words(self):
         return [item.ins for item in self.ins_objects]
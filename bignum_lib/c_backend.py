@@ -2,7 +2,7 @@
 
 from __future__ import annotations
 
-from typing import Tuple
+from typing import Iterable, List, Tuple
 
 try:
     from ot_dsim import _cops as _native
@@ -16,11 +16,16 @@ LIMB_BITS = 32
 LIMBS = XLEN_BITS // LIMB_BITS
 HALF_LIMB_BITS = LIMB_BITS // 2
 HALF_WORD_BITS = XLEN_BITS // 2
+QUARTER_WORD_BITS = XLEN_BITS // 4
+# Width of the native multiply-accumulate accumulator
+ACC_BITS = 2 * XLEN_BITS
+ACC_BYTES = ACC_BITS // 8
 
 XLEN_MASK = (1 << XLEN_BITS) - 1
 LIMB_MASK = (1 << LIMB_BITS) - 1
 HALF_LIMB_MASK = (1 << HALF_LIMB_BITS) - 1
 HALF_WORD_MASK = (1 << HALF_WORD_BITS) - 1
+QUARTER_WORD_MASK = (1 << QUARTER_WORD_BITS) - 1
 
 
 def is_available() -> bool:
@@ -310,3 +315,253 @@ def set_half_word(
     shift = idx * half_word_bits
     clear_mask = ~(half_word_mask << shift) & value_mask
     return (value & clear_mask) | (half_word_value << shift)
+
+
+def _check_qw_sel(name: str, qw_sel: int) -> None:
+    _require_int(name, qw_sel)
+    if qw_sel < 0 or qw_sel >= 4:
+        raise IndexError(f"{name} quarter-word index out of range")
+
+
+def _native_acc_fits(acc: int, shift: int) -> bool:
+    # The native accumulator is ACC_BITS wide; anything that could carry
+    # out of it takes the Python path.
+    return 0 <= acc < 1 << (ACC_BITS - 1) and shift < ACC_BITS - 2 * QUARTER_WORD_BITS
+
+
+def mulqacc(acc: int, lhs: int, rhs: int, lhs_qw: int, rhs_qw: int, shift: int) -> int:
+    """acc + (lhs.qw[lhs_qw] * rhs.qw[rhs_qw] << shift), as BN.MULQACC"""
+    _check_u256("lhs", lhs)
+    _check_u256("rhs", rhs)
+    _check_qw_sel("lhs_qw", lhs_qw)
+    _check_qw_sel("rhs_qw", rhs_qw)
+    _require_int("acc", acc)
+    _require_int("shift", shift)
+    if shift < 0:
+        raise ValueError("shift must be non-negative")
+
+    if _native is None or not _native_acc_fits(acc, shift):
+        op1 = (lhs >> (lhs_qw * QUARTER_WORD_BITS)) & QUARTER_WORD_MASK
+        op2 = (rhs >> (rhs_qw * QUARTER_WORD_BITS)) & QUARTER_WORD_MASK
+        return acc + ((op1 * op2) << shift)
+
+    return int.from_bytes(
+        _native.u256_mulqacc(
+            acc.to_bytes(ACC_BYTES, byteorder="little"),
+            _to_u256_bytes("lhs", lhs),
+            _to_u256_bytes("rhs", rhs),
+            lhs_qw,
+            rhs_qw,
+            shift,
+        ),
+        byteorder="little",
+    )
+
+
+def mulqacc_so(
+    acc: int, lhs: int, rhs: int, lhs_qw: int, rhs_qw: int, shift: int
+) -> Tuple[int, int]:
+    """Multiply-accumulate as mulqacc(), then shift the lower half-word out:
+    returns (acc >> HALF_WORD_BITS, acc & HALF_WORD_MASK)."""
+    _check_u256("lhs", lhs)
+    _check_u256("rhs", rhs)
+    _check_qw_sel("lhs_qw", lhs_qw)
+    _check_qw_sel("rhs_qw", rhs_qw)
+    _require_int("acc", acc)
+    _require_int("shift", shift)
+    if shift < 0:
+        raise ValueError("shift must be non-negative")
+
+    if _native is None or not _native_acc_fits(acc, shift):
+        acc = mulqacc(acc, lhs, rhs, lhs_qw, rhs_qw, shift)
+        return acc >> HALF_WORD_BITS, acc & HALF_WORD_MASK
+
+    acc_raw, shift_out = _native.u256_mulqacc_so(
+        acc.to_bytes(ACC_BYTES, byteorder="little"),
+        _to_u256_bytes("lhs", lhs),
+        _to_u256_bytes("rhs", rhs),
+        lhs_qw,
+        rhs_qw,
+        shift,
+    )
+    return (
+        int.from_bytes(acc_raw, byteorder="little"),
+        int.from_bytes(shift_out, byteorder="little"),
+    )
+
+
+def mulh(lhs: int, rhs: int, lhs_upper: bool = False, rhs_upper: bool = False) -> int:
+    """Product of one 128-bit half-word of each operand, as BN.MULH"""
+    _check_u256("lhs", lhs)
+    _check_u256("rhs", rhs)
+
+    if _native is None:
+        op1 = (lhs >> (HALF_WORD_BITS if lhs_upper else 0)) & HALF_WORD_MASK
+        op2 = (rhs >> (HALF_WORD_BITS if rhs_upper else 0)) & HALF_WORD_MASK
+        return op1 * op2
+
+    return _from_u256_bytes(
+        _native.u256_mulh(
+            _to_u256_bytes("lhs", lhs),
+            _to_u256_bytes("rhs", rhs),
+            bool(lhs_upper),
+            bool(rhs_upper),
+        )
+    )
+
+
+# Batched operations on contiguous buffers of N little-endian 256-bit
+# values. rhs may also be a single value, which pairs with every lhs value.
+
+
+def pack_u256_many(values: Iterable[int]) -> bytes:
+    """Pack 256-bit values into one buffer for the *_many functions"""
+    return b"".join(_to_u256_bytes("value", value) for value in values)
+
+
+def unpack_u256_many(raw: bytes, width: int = XLEN_BYTES) -> List[int]:
+    """Split a *_many result buffer into ints of width bytes each"""
+    view = memoryview(raw).cast("B")
+    if len(view) % width:
+        raise ValueError(f"buffer must be a multiple of {width} bytes")
+    return [_from_u256_bytes(view[i : i + width]) for i in range(0, len(view), width)]
+
+
+def _many_operands(lhs: bytes, rhs: bytes) -> Tuple[List[int], List[int]]:
+    lhs_vals = unpack_u256_many(lhs)
+    rhs_vals = unpack_u256_many(rhs)
+    if len(rhs_vals) == 1:
+        rhs_vals = rhs_vals * len(lhs_vals)
+    elif len(rhs_vals) != len(lhs_vals):
+        raise ValueError("rhs must match lhs or be a single value")
+    return lhs_vals, rhs_vals
+
+
+def add_u256_many(lhs: bytes, rhs: bytes, carry: bool = False) -> Tuple[bytes, bytes]:
+    """Element-wise add; returns (sums, one carry byte per element)"""
+    if _native is None:
+        sums = []
+        carries = bytearray()
+        for a, b in zip(*_many_operands(lhs, rhs)):
+            out, carry_out = add_u256(a, b, carry)
+            sums.append(out)
+            carries.append(carry_out)
+        return pack_u256_many(sums), bytes(carries)
+
+    return _native.u256_add_many(lhs, rhs, bool(carry))
+
+
+def sub_u256_many(lhs: bytes, rhs: bytes, borrow: bool = False) -> Tuple[bytes, bytes]:
+    """Element-wise subtract; returns (differences, one borrow byte per element)"""
+    if _native is None:
+        diffs = []
+        borrows = bytearray()
+        for a, b in zip(*_many_operands(lhs, rhs)):
+            out, borrow_out = sub_u256(a, b, borrow)
+            diffs.append(out)
+            borrows.append(borrow_out)
+        return pack_u256_many(diffs), bytes(borrows)
+
+    return _native.u256_sub_many(lhs, rhs, bool(borrow))
+
+
+def cmp_u256_many(lhs: bytes, rhs: bytes) -> List[int]:
+    """Element-wise compare; -1, 0 or 1 per element"""
+    if _native is None:
+        return [cmp_u256(a, b) for a, b in zip(*_many_operands(lhs, rhs))]
+
+    return memoryview(_native.u256_cmp_many(lhs, rhs)).cast("b").tolist()
+
+
+def and_u256_many(lhs: bytes, rhs: bytes) -> bytes:
+    if _native is None:
+        return pack_u256_many(a & b for a, b in zip(*_many_operands(lhs, rhs)))
+
+    return _native.u256_and_many(lhs, rhs)
+
+
+def or_u256_many(lhs: bytes, rhs: bytes) -> bytes:
+    if _native is None:
+        return pack_u256_many(a | b for a, b in zip(*_many_operands(lhs, rhs)))
+
+    return _native.u256_or_many(lhs, rhs)
+
+
+def xor_u256_many(lhs: bytes, rhs: bytes) -> bytes:
+    if _native is None:
+        return pack_u256_many(a ^ b for a, b in zip(*_many_operands(lhs, rhs)))
+
+    return _native.u256_xor_many(lhs, rhs)
+
+
+def mul_u256_many(lhs: bytes, rhs: bytes) -> bytes:
+    """Element-wise full products, ACC_BYTES per element"""
+    if _native is None:
+        return b"".join(
+            (a * b).to_bytes(ACC_BYTES, byteorder="little", signed=False)
+            for a, b in zip(*_many_operands(lhs, rhs))
+        )
+
+    return _native.u256_mul_many(lhs, rhs)
+
+
+# Text image parsers. Both consume bytes and return packed buffers, so a
+# large image costs no Python object per line.
+
+
+def _parse_dmem_line(line: str, line_no: int) -> bytes:
+    if ":" in line:
+        addr = line.split(":")[0].strip()
+        if not addr.isdigit() or int(addr) != line_no:
+            raise ValueError(
+                f"Error in Dmem file line {line_no + 1} "
+                "(non continues mem files currently not supported)"
+            )
+        line = line.split(":", 1)[1]
+    words = line.split()
+    if len(words) != 8:
+        raise ValueError(f"Error in Dmem file line {line_no + 1} 8 32-bit words expected per line")
+    digits = "".join(words)
+    if len(digits) != 2 * XLEN_BYTES or any(c not in "0123456789abcdefABCDEF" for c in digits):
+        raise ValueError(f"Error in Dmem file line {line_no + 1}. Expecting data 32 bytes per line")
+    return int(digits, 16).to_bytes(XLEN_BYTES, byteorder="little", signed=False)
+
+
+def parse_dmem_hex(data: bytes, first_line: int = 0, final: bool = True) -> Tuple[bytes, int, int]:
+    """Pack DMEM init file lines into 32-byte little-endian cells
+
+    Returns (image, lines, consumed). Lines may carry their address as an
+    "addr:" prefix, counted from first_line. A trailing line without its
+    newline is left unconsumed unless final is set.
+    """
+    if _native is not None:
+        return _native.parse_dmem_hex(data, first_line, bool(final))
+
+    text = bytes(data)
+    end = len(text) if final else text.rfind(b"\n") + 1
+    lines = text[:end].decode("ascii", "replace").split("\n")
+    if lines and lines[-1] == "":
+        lines.pop()
+    image = b"".join(_parse_dmem_line(line, first_line + i) for i, line in enumerate(lines))
+    return image, len(lines), end
+
+
+def parse_hex_words(data: bytes) -> bytes:
+    """Pack the "[addr:] 0xXXXXXXXX" instruction words of a .hex program
+
+    Returns little-endian 32-bit words; lines without a word are skipped.
+    """
+    if _native is not None:
+        return _native.parse_hex_words(data)
+
+    words = bytearray()
+    for line_no, line in enumerate(bytes(data).decode("ascii", "replace").split("\n")):
+        line = line.strip().lower()
+        if ":" in line:
+            line = line.split(":", 1)[1].strip()
+        if line.startswith("0x"):
+            digits = line[2:10]
+            if len(digits) != 8 or any(c not in "0123456789abcdef" for c in digits):
+                raise ValueError(f"line {line_no + 1}: instruction word must be 8 hex digits")
+            words += int(digits, 16).to_bytes(4, byteorder="little")
+    return bytes(words)
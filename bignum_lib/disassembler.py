@@ -2,6 +2,9 @@
 # Licensed under the Apache License, Version 2.0, see LICENSE for details.
 # SPDX-License-Identifier: Apache-2.0
 
+import struct
+from collections import namedtuple
+
 from . instructions import *
 
 
@@ -171,3 +174,67 @@ class Disassembler:
 
     def get_instruction_objects(self):
         return self.ins_objects
+
+
+# Binary traces written by the C machine (CMachine.enable_trace()); the
+# format is described with the "Binary trace" section of
+# csrc/ot_dsim_machine.c.
+TRACE_MAGIC = b'OTDTRACE'
+TRACE_NONE = 0xFF
+
+TraceRecord = namedtuple('TraceRecord', ['pc', 'opcode', 'flags', 'wdr', 'wdr_value', 'gpr', 'gpr_value'])
+
+
+def read_binary_trace(data):
+    """Parse a binary trace into (opcode_names, records).
+
+    wdr/gpr are None when the instruction changed no register of that kind;
+    opcode_names[record.opcode] is None for instructions that ran through
+    execute()."""
+    if data[:8] != TRACE_MAGIC:
+        raise ValueError('not a binary trace')
+    version, rec_size, n_names = struct.unpack_from('<HHH', data, 8)
+    if version != 1:
+        raise ValueError('unsupported binary trace version ' + str(version))
+    pos = 14
+    names = []
+    for _ in range(n_names):
+        end = data.index(b'\0', pos)
+        names.append(data[pos:end].decode() or None)
+        pos = end + 1
+    n_limbs = (rec_size - 16) // 4
+    rec_fmt = struct.Struct('<IHBBB3xI' + str(n_limbs) + 'I')
+    records = []
+    for off in range(pos, len(data) - rec_size + 1, rec_size):
+        fields = rec_fmt.unpack_from(data, off)
+        pc, opcode, flags, wdr, gpr, gpr_value = fields[:6]
+        wdr_value = sum(limb << (32 * i) for i, limb in enumerate(fields[6:]))
+        if wdr == TRACE_NONE:
+            wdr = wdr_value = None
+        if gpr == TRACE_NONE:
+            gpr = gpr_value = None
+        records.append(TraceRecord(pc, opcode, flags, wdr, wdr_value, gpr, gpr_value))
+    return names, records
+
+
+def render_binary_trace(data, ins_objects=None):
+    """Render a binary trace as text, one line per executed instruction.
+
+    With the program's instruction objects the lines show the assembly
+    text; otherwise the native kernel names."""
+    names, records = read_binary_trace(data)
+    lines = []
+    for rec in records:
+        if ins_objects is not None and rec.pc < len(ins_objects):
+            asm = ins_objects[rec.pc].get_asm_str()[1]
+        else:
+            asm = names[rec.opcode] if rec.opcode < len(names) and names[rec.opcode] else '<execute>'
+        flags = ''.join(f if rec.flags >> i & 1 else '-' for i, f in enumerate('CLMZ'))
+        flags += ' ' + ''.join(f if rec.flags >> (i + 4) & 1 else '-' for i, f in enumerate('CLMZ'))
+        line = '{:4d}: {:<40} flags {}'.format(rec.pc, asm, flags)
+        if rec.wdr is not None:
+            line += ', w{} = {:#066x}'.format(rec.wdr, rec.wdr_value)
+        if rec.gpr is not None:
+            line += ', x{} = {:#010x}'.format(rec.gpr, rec.gpr_value)
+        lines.append(line)
+    return lines
@@ -623,6 +623,12 @@ class Ins(object):
     def get_cycles(self):
         return self.CYCLES
 
+    def get_native_op(self):
+        """Operands for the C machine's decoded instruction table:
+        (mnemonic, rd, rs1, rs2, shift, imm, flag_group, aux), or None if the
+        instruction only runs through execute()"""
+        return None
+
     def convert_otbn(self, addr):
         return None
 
@@ -707,6 +713,11 @@ class GIStdShift(GIStd):
         if self.shift_bytes > self.MAX_SHIFT:
             self.malformed = True
 
+    def native_shift(self):
+        """Input shift in bits, negative for a right shift"""
+        shift_bits = self.shift_bytes * 8
+        return -shift_bits if self.shift_right else shift_bits
+
     def get_asm_str(self):
         asm_str = (
             self.MNEM.get(self.fun)
@@ -996,6 +1007,14 @@ class IAdd(GIStdShift):
             return [IBnAddi(self.rd, self.rs1, self.imm, "extension", self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None:
+            return None
+        if mnem == "addi":
+            return mnem, self.rd, self.rs1, 0, 0, self.imm, 0, 0
+        return mnem, self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         if self.MNEM.get(self.fun) != "addi":
             rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
@@ -1050,6 +1069,9 @@ class IAddm(GIStdShift):
     def convert_otbn(self, addr):
         return [IBnAddm(self.rd, self.rs1, self.rs2, self.ctx)]
 
+    def get_native_op(self):
+        return self.MNEM[0], self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         sum_low, carry_out = c_backend.add_u256(m.get_reg(self.rs1), rs2op)
@@ -1184,6 +1206,15 @@ class ISub(GIStdShift):
             return [IBnSubi(self.rd, self.rs1, self.imm, "extension", self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None:
+            return None
+        if mnem == "subi":
+            # the carry is still computed from the (overlapping) rs2 field
+            return mnem, self.rd, self.rs1, self.rs2, 0, self.imm, 0, 0
+        return mnem, self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         if self.MNEM.get(self.fun) != "subi":
             rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
@@ -1237,6 +1268,9 @@ class ISubm(GIStdShift):
     def convert_otbn(self, addr):
         return [IBnSubm(self.rd, self.rs1, self.rs2, self.ctx)]
 
+    def get_native_op(self):
+        return self.MNEM[0], self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         diff_low, borrow_out = c_backend.sub_u256(m.get_reg(self.rs1), rs2op)
@@ -1312,6 +1346,10 @@ class IMul128(GIStd):
         rs2_hw_sel = "upper" if self.r2_upper else "lower"
         return [IBnMulh(self.rd, self.rs1, rs1_hw_sel, self.rs2, rs2_hw_sel, self.ctx)]
 
+    def get_native_op(self):
+        aux = int(self.r1_upper) | int(self.r2_upper) << 1
+        return self.MNEM, self.rd, self.rs1, self.rs2, 0, 0, 0, aux
+
     def execute(self, m):
         op1_shift = (m.XLEN // 2) if self.r1_upper else 0
         op2_shift = (m.XLEN // 2) if self.r2_upper else 0
@@ -1358,6 +1396,9 @@ class IAnd(GIStdShift):
             )
         ]
 
+    def get_native_op(self):
+        return "and", self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         res = c_backend.and_u256(m.get_reg(self.rs1), rs2op)
@@ -1393,6 +1434,9 @@ class IOr(GIStdShift):
             )
         ]
 
+    def get_native_op(self):
+        return "or", self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         res = c_backend.or_u256(m.get_reg(self.rs1), rs2op)
@@ -1446,6 +1490,10 @@ class INot(GIStdShift):
             ins.flag_group = "extended"
         return [ins]
 
+    def get_native_op(self):
+        # single input in rs2; notx (fun=4) sets the extended flags
+        return "not", self.rd, self.rs2, 0, self.native_shift(), 0, int(self.fun == 4), 0
+
     def execute(self, m):
         rsop = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         res = c_backend.not_u256(rsop)
@@ -1485,6 +1533,9 @@ class IXor(GIStdShift):
             )
         ]
 
+    def get_native_op(self):
+        return "xor", self.rd, self.rs1, self.rs2, self.native_shift(), 0, 0, 0
+
     def execute(self, m):
         rs2op = _shift_u256(m.get_reg(self.rs2), self.shift_right, self.shift_bytes)
         res = c_backend.xor_u256(m.get_reg(self.rs1), rs2op)
@@ -1565,6 +1616,14 @@ class ISel(GIStd):
             return [IBnSel(self.rd, self.rs1, self.rs2, "extension", "z", self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get((self.fun, self.imm))
+        if mnem is None:
+            return None
+        # flag bit in get_flags_as_bin() layout: C, L, M, Z, then the X flags
+        bit = "clmz".index(mnem[3]) + (4 if mnem.endswith("x") else 0)
+        return "sel", self.rd, self.rs1, self.rs2, 0, 0, 0, bit
+
     def execute(self, m):
         if self.MNEM.get((self.fun, self.imm)) == "sell":
             sel = m.get_flag("L")
@@ -1643,6 +1702,9 @@ class IRshi(GIStd):
     def convert_otbn(self, addr):
         return [IBnRshi(self.rd, self.rs1, self.rs2, self.imm, self.ctx)]
 
+    def get_native_op(self):
+        return "rshi", self.rd, self.rs1, self.rs2, self.imm, 0, 0, 0
+
     def execute(self, m):
         upper = c_backend.shl_u256(m.get_reg(self.rs2), m.XLEN - self.imm)
         lower = c_backend.shr_u256(m.get_reg(self.rs1), self.imm)
@@ -1694,6 +1756,12 @@ class ICmp(GIStd):
             return [IBnCmpb(self.rs1, self.rs2, "extension", "left", 0, self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None:
+            return None
+        return mnem, 0, self.rs1, self.rs2, 0, 0, 0, 0
+
     def execute(self, m):
         cmp_res = c_backend.cmp_u256(m.get_reg(self.rs1), m.get_reg(self.rs2))
         if self.MNEM.get(self.fun) == "cmp":
@@ -1777,6 +1845,12 @@ class ILdSt1(GIStd):
         ret += cls.enc_fun(cls.get_bin_for_mnem(mnem))
         return cls(ret, ctx.ins_ctx)
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None or mnem == "lddrp":
+            return None  # the machine has no drp register
+        return mnem, self.rd, self.rs1, 0, 0, 0, 0, 0
+
     def execute(self, m):
         if self.MNEM.get(self.fun) == "ldrfp":
             m.set_reg("rfp", m.get_reg(self.rs1))
@@ -1852,6 +1926,12 @@ class ILdSt2(GIStd):
             return [IBnWsrrw(self.rd, 1, self.rd, self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None:
+            return None
+        return mnem, self.rd, self.rs1, 0, 0, 0, 0, 0
+
     def execute(self, m):
         if self.MNEM.get(self.fun) == "ldmod":
             m.set_reg("mod", m.get_reg(self.rs1))
@@ -1927,6 +2007,9 @@ class ILdi(GIWideImm):
             IBnLid(3, 0, 0, 0, self.idx * dmem_mult, self.ctx),
         ]
 
+    def get_native_op(self):
+        return self.MNEM, self.rd, 0, 0, 0, self.idx, 0, 0
+
     def execute(self, m):
         m.set_reg(self.rd, m.get_dmem(self.idx))
         trace_str = self.get_asm_str()[1]
@@ -1986,6 +2069,9 @@ class ISti(GIWideImm):
         ret += cls.enc_idx(idx)
         return cls(ret, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.rd, 0, 0, 0, self.idx, 0, 0
+
     def execute(self, m):
         m.set_dmem(self.idx, m.get_reg(self.rd))
         trace_str = self.get_asm_str()[1]
@@ -2091,6 +2177,13 @@ class IMovLdr(GIStd):
             return [IBnMovr(xd, self.rd_inc, xs, self.rs_inc, self.ctx)]
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.fun)
+        if mnem is None:
+            return None
+        # ldr passes the raw limb pointer fields
+        return mnem, self.rd, self.rs1, 0, 0, 0, 0, 0
+
     def execute(self, m):
         if self.MNEM.get(self.fun) == "mov":
             m.set_reg(self.rd, m.get_reg(self.rs))
@@ -2170,6 +2263,9 @@ class IMovi(GIWideImm):
         lui_ins = IOtLui(self.rd, upper_20b, self.ctx)
         return [addi_ins, lui_ins]
 
+    def get_native_op(self):
+        return self.MNEM, self.rd, 0, 0, 0, self.imm, 0, self.fun | self.slice << 3
+
     def execute(self, m):
         m.stat_record_movi(self.imm.bit_length())
         m.set_reg_half_limb(self.rd, self.fun, self.imm, self.slice)
@@ -2258,6 +2354,9 @@ class ISt(GIStd):
         else:
             return [IBnSid(xs, self.inc_src, xd, self.inc_dst, offset, self.ctx)]
 
+    def get_native_op(self):
+        return "st", self.rd, self.rs1, 0, 0, 0, 0, 0
+
     def execute(self, m):
         sptr = m.get_reg_limb("rfp", self.limb_src) & m.reg_idx_mask
         dptr = m.get_reg_limb("dmp", self.limb_dst) & m.dmem_idx_mask
@@ -2364,6 +2463,11 @@ class ILd(GIStd):
                 return [IBnLid(xd, self.inc_dst, xs, self.inc_src, offset, self.ctx)]
         return None
 
+    def get_native_op(self):
+        if self.MNEM.get(self.dmem_src) != "ld":
+            return None
+        return "ld", self.rd, self.rs1, 0, 0, 0, 0, 0
+
     def execute(self, m):
         sptr = m.get_reg_limb("dmp", self.limb_src) & m.dmem_idx_mask
         dptr = m.get_reg_limb("rfp", self.limb_dst) & m.reg_idx_mask
@@ -2408,6 +2512,9 @@ class INop(GIStdNoParm):
         ret = cls.enc_op(cls.OP)
         return cls(ret, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return "nop", 0, 0, 0, 0, 0, 0, 0
+
     def execute(self, m):
         trace_str = self.get_asm_str()[1]
         return trace_str, None
@@ -2498,6 +2605,9 @@ class IRet(GIStdNoParm):
     def convert_otbn(self, addr):
         return [IOtJalr(0, 1, 0, self.ctx)]
 
+    def get_native_op(self):
+        return "ret", 0, 0, 0, 0, 0, 0, 0
+
     def execute(self, m):
         try:
             ret_addr = m.pop_call_stack()
@@ -2547,6 +2657,9 @@ class ICall(GIMidImm):
         jal_imm = self.imm - addr
         return [IOtJal(1, jal_imm, addr, self.ctx, label=self.label)]
 
+    def get_native_op(self):
+        return "call", 0, 0, 0, 0, self.imm, 0, 0
+
     def execute(self, m):
         m.stat_record_func_call(call_site=m.pc, callee_func=self.imm)
 
@@ -2567,6 +2680,16 @@ class IBranch(GIMidImm):
     }
     OP = 0b000100
 
+    # native branch condition: (flag bit, taken when clear), None: always
+    NATIVE_CONDITIONS = {
+        "bl": (1, 0),
+        "bm": (2, 0),
+        "bnc": (0, 1),
+        "b": None,
+        "bnz": (3, 1),
+        "bz": (3, 0),
+    }
+
     zero_ranges = [Ins.FUN_RANGE]
 
     def __init__(self, ins, ctx, label=None):
@@ -2644,6 +2767,14 @@ class IBranch(GIMidImm):
         )
         return None
 
+    def get_native_op(self):
+        mnem = self.MNEM.get(self.funb)
+        if mnem not in self.NATIVE_CONDITIONS:
+            return None
+        cond = self.NATIVE_CONDITIONS[mnem]
+        aux = -1 if cond is None else cond[0] | cond[1] << 3
+        return "b", 0, 0, 0, 0, self.imm, 0, aux
+
     def execute(self, m):
         trace_str = self.get_asm_str()[1]
         if self.MNEM.get(self.funb) == "bl":
@@ -2778,6 +2909,11 @@ class ILoop(GIMidImm):
         else:
             return [IOtLoopi(self.cnt, self.len, self.ctx)]
 
+    def get_native_op(self):
+        if self.fun == self.FUN_INDIRECT:
+            return self.MNEM, 0, self.limb, 1, 0, 0, 0, self.len
+        return self.MNEM, 0, 0, 0, 0, self.cnt, 0, self.len
+
     def execute(self, m):
         if self.fun == self.FUN_INDIRECT:  # star/indirect case
             self.cnt = m.get_reg_limb("lc", self.limb)
@@ -627,6 +627,12 @@ class GIns(object):
     def get_cycles(self):
         return self.CYCLES
 
+    def get_native_op(self):
+        """Operands for the C machine's decoded instruction table:
+        (mnemonic, rd, rs1, rs2, shift, imm, flag_group, aux), or None if the
+        instruction only runs through execute()"""
+        return None
+
 
 class GInsBn(GIns):
     """Standard Bignum format BN.<ins> <wrd>, <wrs1>, <wrs2>, FG<flag_group>"""
@@ -668,6 +674,11 @@ class GInsBn(GIns):
         else:
             return m.get_flag("XC")
 
+    def native_flag_group(self):
+        # anything but "standard" (including FG0 -> "default") selects the
+        # extension flags in the exec_* helpers above
+        return 0 if self.flag_group == "standard" else 1
+
 
 class GInsBnShift(GInsBn):
     """Standard Bignum format with immediate shift
@@ -716,6 +727,19 @@ class GInsBnShift(GInsBn):
             rs2op = c_backend.shl_u256(m.get_reg(self.rs2), shift_bits)
         return rs2op
 
+    def native_shift(self):
+        """Input shift in bits, negative for a right shift"""
+        shift_bits = self.shift_bytes * 8
+        return -shift_bits if self.shift_type == "right" else shift_bits
+
+    def get_native_op(self):
+        if self.shift_bytes < 0:
+            return None
+        return (
+            self.MNEM, self.rd, self.rs1, self.rs2, self.native_shift(), 0,
+            self.native_flag_group(), 0,
+        )
+
 
 class GInsBnCmpShift(GInsBn):
     """Bignum compare format with immediate shift
@@ -754,6 +778,19 @@ class GInsBnCmpShift(GInsBn):
             rs2op = c_backend.shl_u256(m.get_reg(self.rs2), shift_bits)
         return rs2op
 
+    def native_shift(self):
+        """Input shift in bits, negative for a right shift"""
+        shift_bits = self.shift_bytes * 8
+        return -shift_bits if self.shift_type == "right" else shift_bits
+
+    def get_native_op(self):
+        if self.shift_bytes < 0:
+            return None
+        return (
+            self.MNEM, 0, self.rs1, self.rs2, self.native_shift(), 0,
+            self.native_flag_group(), 0,
+        )
+
 
 class GInsBnImm(GInsBn):
     """Standard Bignum format with one source register and immediate
@@ -782,6 +819,14 @@ class GInsBnImm(GInsBn):
         rd, rs, imm, flag_group = _get_two_wdr_and_imm_with_flag_group(params)
         return cls(rd, rs, imm, flag_group, ctx.ins_ctx)
 
+    def get_native_op(self):
+        if self.imm < 0:
+            return None
+        return (
+            self.MNEM, self.rd, self.rs1, 0, 0, self.imm,
+            self.native_flag_group(), 0,
+        )
+
 
 class GInsBnMod(GInsBn):
     """Standard Bignum format for pseudo modulo operations
@@ -811,6 +856,9 @@ class GInsBnMod(GInsBn):
         ) = _get_three_wdr(params)
         return cls(rd, rs1, rs2, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.rd, self.rs1, self.rs2, 0, 0, 0, 0
+
 
 class GInsIndReg(GIns):
     """Standard Bignum format for indirect move: BN.<ins> x<GPR>[++], x<GPR>[++]"""
@@ -838,6 +886,10 @@ class GInsIndReg(GIns):
         xd, inc_xd, xs, inc_xs = _get_two_gprs_with_inc(params)
         return cls(xd, inc_xd, xs, inc_xs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        aux = int(bool(self.inc_xd)) | int(bool(self.inc_xs)) << 1
+        return self.MNEM, self.xd, self.xs, 0, 0, 0, 0, aux
+
 
 class GInsIndLs(GIns):
     """Standard Bignum format for indirect load, store : BN.<ins> <gpr>[<inc>], <offset>(<gpr>[<gpr_inc>])"""
@@ -867,6 +919,14 @@ class GInsIndLs(GIns):
         x1, inc_x1, x2, inc_x2, offset = _get_two_gprs_with_inc_and_offset(params)
         return cls(x1, inc_x1, x2, inc_x2, offset, ctx.ins_ctx)
 
+    def get_native_op(self):
+        aux = (
+            int(bool(self.inc_x1))
+            | int(bool(self.inc_x2)) << 1
+            | int(bool(self.ctx.dmem_byte_addressing)) << 2
+        )
+        return self.MNEM, self.x1, self.x2, 0, 0, self.offset, 0, aux
+
 
 class GInsWsr(GIns):
     """WSR type"""
@@ -897,6 +957,9 @@ class GInsWsr(GIns):
         # todo: check bounds of immediate
         return cls(wrd, imm, wrs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.wrd, self.wrs, 0, 0, self.wsr, 0, 0
+
 
 #############################################
 #              Arithmetic                   #
@@ -1159,6 +1222,9 @@ class IBnSubm(GInsBnMod):
 class GInsBnMulqacc(GInsBn):
     """Quarter-word Multiply and Accumulate base instruction"""
 
+    # accumulator shift per unit of the immediate
+    ACC_SHIFT_SCALE = 1
+
     def __init__(
         self, wrd, wrd_hw_sel, wrs1, wrs1_qw_sel, wrs2, wrs2_qw_sel, acc_shift_imm, ctx
     ):
@@ -1181,6 +1247,21 @@ class GInsBnMulqacc(GInsBn):
         asm_str += ", " + str(self.imm)
         return self.hex_str, asm_str, self.malformed
 
+    def get_native_op(self):
+        if self.rd is None:
+            rd, upper = 0, 0
+        elif self.wrd_hw_sel in ("lower", "upper"):
+            rd, upper = self.rd, int(self.wrd_hw_sel == "upper")
+        else:
+            return None
+        if self.wrs1_qw_sel not in range(4) or self.wrs2_qw_sel not in range(4):
+            return None
+        if self.imm < 0:
+            return None
+        aux = self.wrs1_qw_sel | self.wrs2_qw_sel << 2 | upper << 4
+        shift = self.imm * self.ACC_SHIFT_SCALE
+        return self.MNEM, rd, self.rs1, self.rs2, shift, 0, 0, aux
+
 
 class IBnMulqacc(GInsBnMulqacc):
     """Quarter-word Multiply and Accumulate
@@ -1211,6 +1292,7 @@ class IBnMulqaccZ(GInsBnMulqacc):
     BN.MULQACC <wrs1>.<wrs1_qwsel>, <wrs2>.<wrs2_qwsel>, <acc_shift_imm>"""
 
     MNEM = "BN.MULQACC.Z"
+    ACC_SHIFT_SCALE = 64
 
     def execute(self, m):
         m.set_acc(0)
@@ -1303,6 +1385,10 @@ class IBnMulh(GInsBn):
         )
         return cls(rd, rs1, rs1_hw_sel, rs2, rs2_hw_sel, ctx.ins_ctx)
 
+    def get_native_op(self):
+        aux = int(self.rs1_hw_sel == "upper") | int(self.rs2_hw_sel == "upper") << 1
+        return self.MNEM, self.rd, self.rs1, self.rs2, 0, 0, 0, aux
+
     def execute(self, m):
         op1_shift = (m.XLEN // 2) if self.rs1_hw_sel == "upper" else 0
         op2_shift = (m.XLEN // 2) if self.rs2_hw_sel == "upper" else 0
@@ -1424,6 +1510,14 @@ class IBnNot(GIns):
             raise SyntaxError("Input shift immediate not byte aligned")
         return cls(rd, rs, shift_type, int(shift_bits / 8), ctx.ins_ctx)
 
+    def get_native_op(self):
+        if self.shift_bytes < 0:
+            return None
+        shift_bits = self.shift_bytes * 8
+        if self.shift_type == "right":
+            shift_bits = -shift_bits
+        return self.MNEM, self.rd, self.rs, 0, shift_bits, 0, 0, 0
+
     def exec_set_zml_flags(self, res, m):
         if self.flag_group == "standard":
             m.set_z_m_l(res)
@@ -1476,6 +1570,11 @@ class IBnRshi(GInsBn):
             raise SyntaxError("Only standard flag group possible with this instruction")
         return cls(rd, rs1, rs2, shift_bits, ctx.ins_ctx)
 
+    def get_native_op(self):
+        if self.shift_bits < 0:
+            return None
+        return self.MNEM, self.rd, self.rs1, self.rs2, self.shift_bits, 0, 0, 0
+
     def execute(self, m):
         if self.shift_bits < m.XLEN:
             upper = c_backend.shl_u256(m.get_reg(self.rs2), m.XLEN - self.shift_bits)
@@ -1519,6 +1618,14 @@ class IBnSel(GInsBn):
         rd, rs1, rs2, flag_group, flag = _get_three_wdr_with_flag_group_and_flag(params)
         return cls(rd, rs1, rs2, flag_group, flag, ctx.ins_ctx)
 
+    def get_native_op(self):
+        # flag bit in get_flags_as_bin() order: C, L, M, Z, XC, XL, XM, XZ
+        flag = self.flag.lower()
+        if flag not in ("c", "l", "m", "z"):
+            return None
+        aux = "clmz".index(flag) + (4 if self.flag_group == "extension" else 0)
+        return self.MNEM, self.rd, self.rs1, self.rs2, 0, 0, 0, aux
+
     def execute(self, m):
         flag_id = self.flag.upper()
         if self.flag_group == "extension":
@@ -1554,6 +1661,9 @@ class IBnMov(GIns):
         rd, rs = _get_two_wdr(params)
         return cls(rd, rs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.rd, self.rs, 0, 0, 0, 0, 0
+
     def execute(self, m):
         m.set_reg(self.rd, m.get_reg(self.rs))
         trace_str = self.get_asm_str()[1]
@@ -1682,6 +1792,9 @@ class IOtLoopi(GIns):
         iter, size = _get_two_imm(params)
         return cls(iter, size, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, 0, 0, 0, 0, self.iter, 0, self.len
+
     def execute(self, m):
         m.push_loop_stack(self.iter - 1, self.len + m.get_pc(), m.get_pc() + 1)
         trace_str = self.get_asm_str()[1]
@@ -1722,6 +1835,9 @@ class IOtLoop(GIns):
             len = len_from_pseudo
         return cls(gpr, len, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, 0, self.xiter, 0, 0, 0, 0, self.len
+
     def execute(self, m):
         iter = m.get_gpr(self.xiter)
         m.push_loop_stack(iter - 1, self.len + m.get_pc(), m.get_pc() + 1)
@@ -1763,6 +1879,9 @@ class IOtGpr(GIns):
         check_bounds_gpr_ref(xs2)
         return cls(xd, xs1, xs2, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.xd, self.xs1, self.xs2, 0, 0, 0, 0
+
     def execute(self, m):
         res = m.get_gpr(self.xs1) + m.get_gpr(self.xs2)
         m.set_gpr(self.xd, res & m.gpr_mask)
@@ -1799,6 +1918,9 @@ class IOtImm(GIns):
         check_bounds_i_type_imm(imm)
         return cls(xd, xs, imm, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.xd, self.xs, 0, 0, self.imm, 0, 0
+
 
 class IOtBranch(GIns):
     """Branch type"""
@@ -1832,6 +1954,9 @@ class IOtBranch(GIns):
         check_bounds_gpr_ref(gpr2)
         return cls(gpr1, gpr2, offset, addr, ctx.ins_ctx, label=func_label)
 
+    def get_native_op(self):
+        return self.MNEM, 0, self.grs1, self.grs2, 0, self.offset, 0, 0
+
 
 class IOtCsr(GIns):
     """CSR type"""
@@ -1862,6 +1987,9 @@ class IOtCsr(GIns):
         # todo: check bounds of immediate
         return cls(grd, imm, grs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.grd, self.grs, 0, 0, self.csr, 0, 0
+
 
 class IOtAdd(IOtGpr):
     """Base add"""
@@ -1912,6 +2040,9 @@ class IOtAddi(GIns):
         check_bounds_i_type_imm(imm)
         return cls(xd, xs, imm, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.xd, self.xs, 0, 0, self.imm, 0, 0
+
 
 class IOtSub(IOtGpr):
     """Base subtract"""
@@ -2035,6 +2166,9 @@ class IOtJal(GIns):
         check_bounds_gpr_ref(gpr)
         return cls(gpr, imm, addr, ctx.ins_ctx, label=func_label)
 
+    def get_native_op(self):
+        return self.MNEM, self.xd, 0, 0, 0, self.imm, 0, 0
+
     def execute(self, m):
         m.set_gpr(self.xd, m.get_pc() + 1)
         jump_target = m.get_pc() + self.imm
@@ -2080,6 +2214,9 @@ class IOtEcall(GIns):
     def enc(cls, addr, mnem, params, ctx):
         return cls(addr, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, 0, 0, 0, 0, 0, 0, 0
+
     def execute(self, m):
         m.finish(breakpoint=False)
         trace_str = self.get_asm_str()[1]
@@ -2160,6 +2297,9 @@ class IOtLui(GIns):
         grd, imm = _get_gpr_and_imm(params)
         return cls(grd, imm, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.grd, 0, 0, 0, self.imm, 0, 0
+
     def execute(self, m):
         new_val = self.imm << 12
         m.set_gpr(self.grd, new_val)
@@ -2196,6 +2336,9 @@ class IOtLw(GIns):
         grd, offset, grs = _get_two_gprs_with_offset(params)
         return cls(grd, offset, grs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.grd, self.grs, 0, 0, self.offset, 0, 0
+
     def execute(self, m):
         m.set_gpr(self.grd, m.get_dmem_otbn(m.get_gpr(self.grs) + self.offset))
         trace_str = self.get_asm_str()[1]
@@ -2231,6 +2374,10 @@ class IOtSw(GIns):
         grs, offset, grd = _get_two_gprs_with_offset(params)
         return cls(grd, offset, grs, ctx.ins_ctx)
 
+    def get_native_op(self):
+        # rs1: base address register, rs2: value register
+        return self.MNEM, 0, self.grd, self.grs, 0, self.offset, 0, 0
+
     def execute(self, m):
         addr = m.get_gpr(self.grd) + self.offset
         m.set_dmem_otbn(addr, m.get_gpr(self.grs))
@@ -2263,6 +2410,9 @@ class IOtPseudoLi(GIns):
         grd, imm = _get_gpr_and_imm(params)
         return cls(grd, imm, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, self.grd, 0, 0, 0, self.imm, 0, 0
+
     def execute(self, m):
         m.set_gpr(self.grd, self.imm)
         trace_str = self.get_asm_str()[1]
@@ -2287,6 +2437,9 @@ class IOtPseudoRet(GIns):
     def enc(cls, addr, mnem, params, ctx):
         return cls(addr, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, 0, 0, 0, 0, 0, 0, 0
+
     def execute(self, m):
         try:
             jump_target = m.get_gpr(1)
@@ -2319,6 +2472,9 @@ class IOtPseudoNop(GIns):
     def enc(cls, addr, mnem, params, ctx):
         return cls(addr, ctx.ins_ctx)
 
+    def get_native_op(self):
+        return self.MNEM, 0, 0, 0, 0, 0, 0, 0
+
     def execute(self, m):
         trace_str = self.get_asm_str()[1]
         return trace_str, None
@@ -2,12 +2,23 @@
 # Licensed under the Apache License, Version 2.0, see LICENSE for details.
 # SPDX-License-Identifier: Apache-2.0
 
+import asyncio
+import copy
+import hashlib
 import math
 import os
-from collections import Counter
+import threading
+import time
+import types
+from collections import Counter, namedtuple
+from concurrent.futures import CancelledError, Future, ThreadPoolExecutor
 
 # C extension ABI version expected by this Python wrapper.
-_C_MACHINE_ABI_VERSION = 1
+_C_MACHINE_ABI_VERSION = 16
+
+# (DMEM_DEPTH, IMEM_DEPTH) of the specialised builds next to the default
+# (128, 1024) _machine; must match _machine_variants in setup.py.
+_C_MACHINE_VARIANTS = ((1024, 4096),)
 
 
 def _env_truthy(name):
@@ -45,6 +56,20 @@ else:
         _CCallStackUnderrun = None
         _USE_C_MACHINE = False
 
+# Variant modules are optional: a geometry that did not build is simply
+# not offered by machine_class().
+_c_machine_variant_mods = {}
+if _USE_C_MACHINE:
+    import importlib
+
+    for _geometry in _C_MACHINE_VARIANTS:
+        try:
+            _mod = importlib.import_module("ot_dsim._machine_d%d_i%d" % _geometry)
+        except ImportError:
+            continue
+        if getattr(_mod, "ABI_VERSION", None) == _C_MACHINE_ABI_VERSION:
+            _c_machine_variant_mods[_geometry] = _mod
+
 
 # Use the C module's exception when available so that except clauses catch
 # both C-raised and Python-raised underruns with a single type.
@@ -56,6 +81,84 @@ else:
         pass
 
 
+class _PyProgram(object):
+    """Program image: the instructions with their context
+
+    Build once and pass as imem to any number of machines; the C machine
+    shares a single decode of it between them. patch() replaces
+    instructions for all of them at once.
+    """
+
+    def __init__(self, instructions, ctx=None):
+        # machines index this list, so patch() reaches them
+        self._slots = list(instructions)
+        self._ctx = ctx
+
+    instructions = property(lambda self: tuple(self._slots))
+    ctx = property(lambda self: self._ctx)
+
+    def __len__(self):
+        return len(self._slots)
+
+    def patch(self, address, instructions):
+        """Replace the instructions from address on, keeping the length"""
+        instructions = list(instructions)
+        if address < 0 or len(instructions) > len(self._slots) - address:
+            raise IndexError("patch() outside the program")
+        self._slots[address:address + len(instructions)] = instructions
+
+    def __table(self, name):
+        return types.MappingProxyType(dict(getattr(self._ctx, name, None) or {}))
+
+    @property
+    def labels(self):
+        return self.__table("labels")
+
+    @property
+    def functions(self):
+        return self.__table("functions")
+
+    @property
+    def cycles(self):
+        return tuple(instr.get_cycles() for instr in self._slots)
+
+
+if _USE_C_MACHINE:
+    Program = _machine_mod.Program
+else:
+    Program = _PyProgram
+
+
+# Fields of perf_counters(), in order; new counters are only ever appended
+PERF_COUNTER_FIELDS = (
+    "native_ops", "python_ops", "superinstructions", "fused_ops", "blocks", "block_ops",
+    "breakpoint_checks", "trace_bytes", "dmem_op_bytes", "dmem_host_bytes", "pylongs",
+    "decode_ns", "run_ns", "readback_ns", "routines", "lane_ops",
+)
+
+if _USE_C_MACHINE:
+    PerfCounters = _machine_mod.PerfCounters
+else:
+    PerfCounters = namedtuple("PerfCounters", PERF_COUNTER_FIELDS)
+
+
+def perf_counters_dict(counters):
+    """perf_counters() as a plain dict for json.dump(), with derived rates
+
+    native_rate is the share of instructions run by native kernels,
+    superinstruction_rate the share of those run inside superinstructions.
+    """
+    d = dict(zip(PERF_COUNTER_FIELDS, counters))
+    executed = d["native_ops"] + d["python_ops"]
+    d["native_rate"] = d["native_ops"] / executed if executed else 0.0
+    d["superinstruction_rate"] = d["fused_ops"] / d["native_ops"] if d["native_ops"] else 0.0
+    return d
+
+
+_PERF_PYTHON_OPS = PERF_COUNTER_FIELDS.index("python_ops")
+_PERF_RUN_NS = PERF_COUNTER_FIELDS.index("run_ns")
+
+
 class _PyMachine(object):
     """Pure-Python Machine implementation (original code, used as fallback)."""
 
@@ -153,8 +256,22 @@ class _PyMachine(object):
             }
         )
 
+    def __new__(cls, *args, dmem_depth=None, imem_depth=None, **kwargs):
+        target = _geometry_class(cls, dmem_depth, imem_depth)
+        if not issubclass(target, cls):
+            return target(*args, **kwargs)
+        return super().__new__(target)
+
     def __init__(
-        self, dmem, imem, s_addr=0, stop_addr=None, ctx=None, breakpoints=None
+        self,
+        dmem,
+        imem,
+        s_addr=0,
+        stop_addr=None,
+        ctx=None,
+        breakpoints=None,
+        dmem_depth=None,
+        imem_depth=None,
     ):
         self.finishFlag = False
         if self.XLEN % (self.LIMBS * 2):
@@ -174,14 +291,29 @@ class _PyMachine(object):
         self.dmem_idx_width = int(math.ceil(math.log2(self.DMEM_DEPTH)))
         self.dmem_idx_mask = 2**self.dmem_idx_width - 1
         self.gpr_mask = 2**self.GPR_WIDTH - 1
+        if ctx is None and isinstance(imem, (Program, _PyProgram)):
+            ctx = imem.ctx
         self.ctx = ctx
         self.reset(dmem, imem, s_addr, stop_addr, clear_regs=True)
 
+        self.breakpoints = {}
         if breakpoints:
             for item in breakpoints:
                 self.set_breakpoint(item)
 
         self.stats = {}
+        self.reset_perf_counters()
+
+    def perf_counters(self):
+        """PerfCounters since creation or reset_perf_counters()
+
+        Everything runs through execute() here, so only python_ops and
+        run_ns count.
+        """
+        return PerfCounters(*self._perf)
+
+    def reset_perf_counters(self):
+        self._perf = [0] * len(PERF_COUNTER_FIELDS)
 
     def reset(self, dmem, imem, s_addr=0, stop_addr=None, clear_regs=False):
         self.M = False
@@ -204,18 +336,82 @@ class _PyMachine(object):
         self.call_stack = []
         self.dmem.clear()
         self.init_dmem.clear()
+        if isinstance(dmem, (bytes, bytearray, memoryview)):
+            dmem = self.__unpack_dmem_bytes(dmem)
         for item in dmem:
             self.dmem.append(item)
             self.init_dmem.append(True)
         for i in range(len(dmem), self.DMEM_DEPTH):
             self.dmem.append(0)
             self.init_dmem.append(False)
+        if isinstance(imem, (Program, _PyProgram)):
+            self.program = imem
+            imem = imem._slots if isinstance(imem, _PyProgram) else imem.instructions
+        else:
+            self.program = None
         self.imem = imem
         self.pc = s_addr
         if not stop_addr:
             self.stop_addr = len(self.imem) - 1
         else:
             self.stop_addr = stop_addr
+        self._break_resume = False
+
+    # Architectural state captured by snapshot()
+    _SNAPSHOT_ATTRS = (
+        "r", "mod", "dmp", "rfp", "lc", "rnd", "acc", "gpr",
+        "M", "L", "Z", "C", "XM", "XL", "XZ", "XC",
+        "pc", "stop_addr", "finishFlag", "dmem", "init_dmem",
+        "loop_stack", "call_stack", "r_valid_half_limbs",
+        "force_break", "_break_resume",
+    )
+
+    def snapshot(self):
+        """Opaque copy of the machine state for restore()"""
+        return copy.deepcopy({name: getattr(self, name) for name in self._SNAPSHOT_ATTRS})
+
+    def restore(self, snapshot):
+        """Rewind to a state captured by snapshot()"""
+        for name, value in copy.deepcopy(snapshot).items():
+            setattr(self, name, value)
+
+    def fork(self):
+        """New machine running the same program from a copy of this state"""
+        clone = copy.copy(self)
+        clone.restore(self.snapshot())
+        clone.breakpoints = copy.deepcopy(self.breakpoints)
+        clone.stats = {}
+        clone.reset_perf_counters()
+        return clone
+
+    def state_bytes(self):
+        """Canonical image of the architectural state, see _state_layout()"""
+        loop_stack = [v for entry in self.loop_stack for v in entry]
+        valid = [self.get_reg_valid_half_limb_mask(i) for i in range(len(self.r))]
+        fields = {
+            "r": self.r,
+            "mod": (self.mod,),
+            "dmp": (self.dmp,),
+            "rfp": (self.rfp,),
+            "lc": (self.lc,),
+            "rnd": (self.rnd,),
+            "acc": (self.acc & _ACC_MASK,),
+            "gpr": [v & self.gpr_mask for v in self.gpr],
+            "flags": (self.get_flags_as_bin(),),
+            "finishFlag": (int(bool(self.finishFlag)),),
+            "pc": (self.pc & 0xFFFFFFFF,),
+            "loop_sp": (len(self.loop_stack),),
+            "loop_stack": loop_stack + [0] * (3 * self.LOOP_STACK_SIZE - len(loop_stack)),
+            "call_sp": (len(self.call_stack),),
+            "call_stack": self.call_stack + [0] * (self.CALL_STACK_SIZE - len(self.call_stack)),
+            "valid_half_limbs": valid,
+            "dmem": self.dmem,
+        }
+        return b"".join(
+            v.to_bytes(size, "little")
+            for name, _, size in _state_layout(self.DMEM_DEPTH)
+            for v in fields[name]
+        )
 
     def clear_regs(self):
         self.dmp = 0
@@ -305,7 +501,7 @@ class _PyMachine(object):
         self.__check_limb_idx(lidx)
         self.__check_reg_val(regval)
         self.__check_limb_val(limbval)
-        mask = self.half_limb_mask << (lidx * self.limb_width)
+        mask = self.limb_mask << (lidx * self.limb_width)
         masked_reg = regval | mask
         masked_reg2 = masked_reg ^ mask
         reg = masked_reg2 | (limbval << (lidx * self.limb_width))
@@ -369,6 +565,10 @@ class _PyMachine(object):
     def get_reg_valid_half_limbs(self, ridx):
         return self.r_valid_half_limbs[ridx]
 
+    def get_reg_valid_half_limb_mask(self, ridx):
+        """get_reg_valid_half_limbs() as an int, bit j for half limb j"""
+        return sum(1 << j for j, v in enumerate(self.r_valid_half_limbs[ridx]) if v)
+
     def set_reg(self, ridx, value, valid_limb=None, valid_half_limb=None):
         """Set register value at register index"""
         self.__check_reg_val(value)
@@ -580,6 +780,40 @@ class _PyMachine(object):
         )
         self.init_dmem[address] = True
 
+    def __unpack_dmem_bytes(self, data):
+        cell_bytes = self.XLEN // 8
+        data = memoryview(data).cast("B")
+        if len(data) % cell_bytes:
+            raise ValueError("DMEM image must be a whole number of 32-byte cells")
+        return [
+            int.from_bytes(data[i : i + cell_bytes], "little")
+            for i in range(0, len(data), cell_bytes)
+        ]
+
+    def get_dmem_bytes(self, address=0, count=None):
+        """Get count dmem cells from address as one little-endian byte string"""
+        if count is None:
+            count = self.DMEM_DEPTH - address
+        if address < 0 or count < 0 or address + count > self.DMEM_DEPTH:
+            raise IndexError("DMEM address out of range")
+        cell_bytes = self.XLEN // 8
+        return b"".join(
+            v.to_bytes(cell_bytes, "little") for v in self.dmem[address : address + count]
+        )
+
+    def set_dmem_bytes(self, address, data):
+        """Set consecutive dmem cells from a little-endian byte image"""
+        values = self.__unpack_dmem_bytes(data)
+        if address < 0 or address + len(values) > self.DMEM_DEPTH:
+            raise IndexError("DMEM address out of range")
+        self.dmem[address : address + len(values)] = values
+        self.init_dmem[address : address + len(values)] = [True] * len(values)
+
+    @property
+    def dmem_view(self):
+        """Read-only view of a dmem byte image (a copy, unlike the C machine)"""
+        return memoryview(self.get_dmem_bytes())
+
     def push_loop_stack(self, cnt, end_addr, start_addr):
         """Push tuple of loop count, loop end address and loop start address to loop stack"""
         self.__check_imem_addr(start_addr)
@@ -1205,18 +1439,88 @@ class _PyMachine(object):
 
     def step(self):
         """Next step"""
-        halt = False
+        if self._break_resume:
+            # run() already stopped at this breakpoint
+            self._break_resume = False
+        else:
+            is_break, passes = self.__check_break()
+            if is_break:
+                self.__handle_break_command(passes)
+
+        start = time.perf_counter_ns()
+        try:
+            cont, trace_str, cycles, _ = self.__exec_current()
+        finally:
+            self._perf[_PERF_PYTHON_OPS] += 1
+            self._perf[_PERF_RUN_NS] += time.perf_counter_ns() - start
+        return cont, trace_str, cycles
+
+    def run(self, max_steps=None, collect_trace=False, release_gil=False):
+        """Run until finished, past stop_addr, at a breakpoint or after max_steps
+
+        Returns (inst_cnt, cycle_cnt, stop_reason) with stop_reason one of
+        'finish', 'stop_addr', 'end_of_imem', 'breakpoint' or 'max_steps'.
+        With collect_trace the list of trace strings is appended to the tuple.
+        A run stopped at a breakpoint does not execute the instruction there;
+        the next run() or step() resumes with it. release_gil only has an
+        effect on the C machine.
+        """
+        if max_steps is not None and max_steps < 0:
+            raise ValueError("max_steps must be non-negative")
+        traces = [] if collect_trace else None
+        inst_cnt = 0
+        cycle_cnt = 0
+        reason = "max_steps"
+        start = time.perf_counter_ns()
+        try:
+            while max_steps is None or inst_cnt < max_steps:
+                if self._break_resume:
+                    self._break_resume = False
+                elif self.__check_break()[0]:
+                    self._break_resume = True
+                    reason = "breakpoint"
+                    break
+                inst_cnt += 1
+                cont, trace_str, cycles, halt = self.__exec_current()
+                cycle_cnt += cycles
+                if collect_trace:
+                    traces.append(trace_str)
+                if not cont:
+                    reason = halt
+                    break
+        finally:
+            self._perf[_PERF_PYTHON_OPS] += inst_cnt
+            self._perf[_PERF_RUN_NS] += time.perf_counter_ns() - start
+        if collect_trace:
+            return inst_cnt, cycle_cnt, reason, traces
+        return inst_cnt, cycle_cnt, reason
+
+    @staticmethod
+    def run_lanes(machines, max_steps=None, release_gil=False):
+        """run(max_steps) of each machine, see the module's run_lanes()"""
+        return [m.run(max_steps) for m in machines]
+
+    def submit(self, max_steps=None, progress=None, progress_every=None, executor=None):
+        """run() on a worker thread with the GIL released, returns a RunFuture
+
+        See _submit_run() for progress and cancellation.
+        """
+        return _submit_run(self, max_steps, progress, progress_every, executor)
+
+    def run_async(self, max_steps=None, progress=None, progress_every=None, executor=None):
+        """Awaitable submit(); progress is called on the event loop"""
+        return _run_async(self, max_steps, progress, progress_every, executor)
+
+    def __exec_current(self):
+        """Execute the instruction at pc, returns (cont, trace_str, cycles, halt_reason)"""
+        halt = None
         if self.get_pc() == self.stop_addr:
-            halt = True  # halt after this instruction
+            halt = "stop_addr"  # halt after this instruction
 
         if self.finishFlag:
-            halt = True
+            halt = "finish"
             # print('\nECALL hit or reached \'ret\' instruction with empty call stack. Finishing here.\n')
 
-        is_break, passes = self.__check_break()
-        if is_break:
-            self.__handle_break_command(passes)
-
         instr = self.get_instruction(self.get_pc())
         cycles = instr.get_cycles()
         self.stat_record_instr(instr)
@@ -1238,20 +1542,21 @@ class _PyMachine(object):
         else:
             if (self.get_pc() + 1) >= len(self.imem):
                 cont = False
+                halt = halt or "end_of_imem"
             else:
                 cont = True
                 self.inc_pc()
 
         if halt:
-            return False, trace_str, cycles
+            return False, trace_str, cycles, halt
         else:
-            return cont, trace_str, cycles
+            return cont, trace_str, cycles, None
 
 
 if _USE_C_MACHINE:
 
-    class Machine(_CMachineBase):
-        """C-accelerated Machine with Python-level debug/display helpers."""
+    class _CMachineHelpers(object):
+        """Python-level debug/display helpers shared by every C Machine build."""
 
         # Class-level constants (must be plain ints for code that accesses
         # them on the class without an instance, e.g. Machine.NUM_REGS).
@@ -1276,69 +1581,37 @@ if _USE_C_MACHINE:
         # CallStackUnderrun is already defined at module level
 
         def __init__(
-            self, dmem, imem, s_addr=0, stop_addr=None, ctx=None, breakpoints=None
+            self,
+            dmem,
+            imem,
+            s_addr=0,
+            stop_addr=None,
+            ctx=None,
+            breakpoints=None,
+            timing_model=None,
+            dmem_depth=None,
+            imem_depth=None,
         ):
-            super().__init__(dmem, imem, s_addr, stop_addr, ctx, breakpoints)
-
-        # ---- stat recording helpers (lightweight, stay in Python) ----
-
-        def stat_record_func_call(self, call_site, callee_func):
-            caller_func = self.get_func_addr_for_pc(call_site)
-            if "func_calls" not in self.stats:
-                self.stats["func_calls"] = []
-            self.stats["func_calls"].append(
-                {
-                    "call_site": call_site,
-                    "caller_func": caller_func,
-                    "callee_func": callee_func,
-                }
-            )
+            super().__init__(dmem, imem, s_addr, stop_addr, ctx, breakpoints, timing_model)
 
-        def stat_record_loop(
-            self, loop_addr, loop_len, new_loop_stack_depth, iterations
-        ):
-            if "loops" not in self.stats:
-                self.stats["loops"] = []
-            self.stats["loops"].append(
-                {
-                    "loop_addr": loop_addr,
-                    "loop_len": loop_len,
-                    "new_loop_stack_depth": new_loop_stack_depth,
-                    "iterations": iterations,
-                }
-            )
+        def __new__(cls, *args, dmem_depth=None, imem_depth=None, **kwargs):
+            target = _geometry_class(cls, dmem_depth, imem_depth)
+            if not issubclass(target, cls):
+                return target(*args, **kwargs)
+            return super().__new__(target)
 
-        def stat_record_movi(self, imm_size):
-            if "movi" not in self.stats:
-                self.stats["movi"] = Counter()
-            self.stats["movi"][imm_size] += 1
-
-        def stat_record_wide_mem_op(self, op, inc_src, inc_dst):
-            if "wide_mem_ops" not in self.stats:
-                self.stats["wide_mem_ops"] = []
-            self.stats["wide_mem_ops"].append(
-                {
-                    "op": op,
-                    "inc_src": inc_src,
-                    "inc_dst": inc_dst,
-                }
-            )
+        # ---- Background runs ----
 
-        def stat_record_flag_access(self, flag_group, op):
-            if "flag_access" not in self.stats:
-                self.stats["flag_access"] = []
-            self.stats["flag_access"].append(
-                {
-                    "flag_group": flag_group,
-                    "op": op,
-                }
-            )
+        def submit(self, max_steps=None, progress=None, progress_every=None, executor=None):
+            """run() on a worker thread with the GIL released, returns a RunFuture
 
-        def get_func_addr_for_pc(self, pc):
-            for pc in range(pc, 0, -1):
-                if pc in self.ctx.functions:
-                    break
-            return pc
+            See _submit_run() for progress and cancellation.
+            """
+            return _submit_run(self, max_steps, progress, progress_every, executor)
+
+        def run_async(self, max_steps=None, progress=None, progress_every=None, executor=None):
+            """Awaitable submit(); progress is called on the event loop"""
+            return _run_async(self, max_steps, progress, progress_every, executor)
 
         # ---- Display / debug methods ----
 
@@ -1432,22 +1705,34 @@ if _USE_C_MACHINE:
             return res_str
 
         def get_dmem_table(self, low, high):
+            # self.dmem builds a fresh list from the native DMEM, fetch it once
+            dmem = self.dmem
             s = ""
             for i in range(low, min(high + 1, self.DMEM_DEPTH)):
                 if (i % 4) == 0 and i > 0:
                     s += "\n"
-                s += ("" + str(i)).rjust(4) + ": " + self.get_xlen_hex_str(self.dmem[i])
+                s += ("" + str(i)).rjust(4) + ": " + self.get_xlen_hex_str(dmem[i])
                 s += "\n"
             return s
 
         def dump_dmem(self, length, filename):
+            dmem = self.dmem
             f = open(filename, "w")
             for i in range(0, min(length, self.DMEM_DEPTH)):
                 f.write(
-                    str(i).zfill(4) + ": " + self.get_xlen_hex_str(self.dmem[i]) + "\n"
+                    str(i).zfill(4) + ": " + self.get_xlen_hex_str(dmem[i]) + "\n"
                 )
             f.close()
 
+        def write_folded_profile(self, file):
+            """Write get_profile() call paths as folded stacks
+
+            One "root;callee;... cycles" line per path, the input format of
+            flamegraph.pl and speedscope.
+            """
+            for path, cycles in sorted(self.get_profile()["paths"].items()):
+                file.write(path + " " + str(cycles) + "\n")
+
         def __loop_depth(self, address):
             if not self.ctx:
                 return 0
@@ -1622,10 +1907,483 @@ if _USE_C_MACHINE:
             print("dump <length> [filename] - dump dmem content to hex file")
             print("q  - quit")
 
+    class Machine(_CMachineHelpers, _CMachineBase):
+        """C-accelerated Machine with Python-level debug/display helpers."""
+
 else:
     # Fallback: use the pure-Python implementation
     Machine = _PyMachine
 
 
+_machine_classes = {}
+
+
+def machine_class(dmem_depth=None, imem_depth=None):
+    """Smallest Machine class with at least the given DMEM and IMEM depths
+
+    The C core fixes its memory sizes at compile time, so each geometry is
+    its own build; Machine is the default (128, 1024) one. The pure-Python
+    fallback offers the same geometries so both backends agree on DMEM
+    wraparound. Raises ValueError if no build is large enough.
+    """
+    geometries = [(Machine.DMEM_DEPTH, Machine.IMEM_DEPTH)]
+    if _USE_C_MACHINE:
+        geometries += sorted(_c_machine_variant_mods)
+    else:
+        geometries += sorted(_C_MACHINE_VARIANTS)
+    for geometry in geometries:
+        if geometry[0] >= (dmem_depth or 0) and geometry[1] >= (imem_depth or 0):
+            break
+    else:
+        raise ValueError(
+            "no machine build with dmem_depth >= %s and imem_depth >= %s"
+            % (dmem_depth, imem_depth)
+        )
+    if geometry == (Machine.DMEM_DEPTH, Machine.IMEM_DEPTH):
+        return Machine
+    cls = _machine_classes.get(geometry)
+    if cls is None:
+        if _USE_C_MACHINE:
+            bases = (_CMachineHelpers, _c_machine_variant_mods[geometry].CMachine)
+        else:
+            bases = (Machine,)
+        cls = type(
+            "Machine",
+            bases,
+            {
+                "__doc__": Machine.__doc__,
+                "__module__": __name__,
+                "DMEM_DEPTH": geometry[0],
+                "IMEM_DEPTH": geometry[1],
+            },
+        )
+        _machine_classes[geometry] = cls
+    return cls
+
+
+def _geometry_class(cls, dmem_depth, imem_depth):
+    """Class to construct for Machine(..., dmem_depth=, imem_depth=)"""
+    if (dmem_depth or 0) <= cls.DMEM_DEPTH and (imem_depth or 0) <= cls.IMEM_DEPTH:
+        return cls
+    return machine_class(dmem_depth, imem_depth)
+
+
+class _PyMachinePool(object):
+    """Pure-Python MachinePool: acquire() re-initialises an idle machine"""
+
+    def __init__(self, program, size, machine_type=None):
+        if not isinstance(program, (Program, _PyProgram)):
+            raise TypeError("MachinePool needs a Program")
+        if size < 1:
+            raise ValueError("pool size must be at least 1")
+        self._program = program
+        self._machines = [(machine_type or Machine)([], program) for _ in range(size)]
+        self._idle = list(reversed(self._machines))
+
+    program = property(lambda self: self._program)
+    available = property(lambda self: len(self._idle))
+
+    def __len__(self):
+        return len(self._machines)
+
+    def acquire(self, dmem=None, s_addr=0, stop_addr=None):
+        if not self._idle:
+            raise RuntimeError("all machines of the pool are in use")
+        machine = self._idle[-1]
+        machine.__init__([] if dmem is None else dmem, self._program, s_addr, stop_addr)
+        return self._idle.pop()
+
+    def release(self, machine):
+        if not any(machine is m for m in self._machines):
+            raise ValueError("machine does not belong to this pool")
+        if any(machine is m for m in self._idle):
+            raise ValueError("machine is not acquired")
+        self._idle.append(machine)
+
+
+if _USE_C_MACHINE:
+
+    def MachinePool(program, size, machine_type=None):
+        """size machines of machine_type (default Machine) running program
+
+        The machines are built once; acquire(dmem=None, s_addr=0,
+        stop_addr=None) hands out an idle one in the state a new
+        machine_type(dmem, program, s_addr, stop_addr) would start in and
+        release(machine) takes it back, so drivers running many short jobs
+        on one Program skip the per-job construction. Raises RuntimeError
+        when every machine is in use.
+        """
+        machine_type = machine_type or Machine
+        for mod in [_machine_mod] + list(_c_machine_variant_mods.values()):
+            if issubclass(machine_type, mod.CMachine):
+                return mod.MachinePool(program, size, machine_type)
+        raise TypeError("machine_type must be a Machine class")
+
+else:
+    MachinePool = _PyMachinePool
+
+
+BatchResult = namedtuple(
+    "BatchResult", ["dmem", "inst_cnt", "cycle_cnt", "stop_reason", "machine"]
+)
+
+
+def run_lanes(machines, max_steps=None, release_gil=False):
+    """Run machines in lockstep, returns run(max_steps)'s tuple for each
+
+    Machines sharing a Program whose control state agrees (pc, loop and
+    call stacks) run straight-line code as one group: their wide registers,
+    flags and accumulator are held limb by limb across the group, and the
+    add/sub, logic, shift, select and multiply-accumulate kernels run each
+    op as a loop over the lanes. A lane that branches elsewhere runs on the
+    scalar engine until it meets the others again. Results, statistics and
+    final states are those of separate run() calls. The machines must be
+    of one class and have no breakpoints, watchpoints or binary trace; on
+    the Python machine the runs are simply sequential.
+    """
+    machines = list(machines)
+    if not machines:
+        return []
+    return type(machines[0]).run_lanes(machines, max_steps, release_gil)
+
+
+def run_batch(machine, dmem_images, threads=None, max_steps=None, lanes=1):
+    """Run one fork of machine per DMEM image on a pool of threads
+
+    Each job starts from machine's current state (program, registers,
+    pc, DMEM) with its image written over DMEM from address 0, and runs
+    with the GIL released around native ops. With lanes > 1 the jobs go
+    to the threads in groups of that many, each run by run_lanes().
+    Returns a BatchResult per image, in order; the first job error is
+    raised once all jobs ended.
+    """
+    if lanes < 1:
+        raise ValueError("lanes must be at least 1")
+    jobs = []
+    for image in dmem_images:
+        job = machine.fork()
+        job.set_dmem_bytes(0, image)
+        jobs.append(job)
+
+    def run_group(group):
+        if lanes == 1:
+            runs = [group[0].run(max_steps, release_gil=True)]
+        else:
+            runs = run_lanes(group, max_steps, release_gil=True)
+        return [
+            BatchResult(job.get_dmem_bytes(), inst_cnt, cycle_cnt, reason, job)
+            for job, (inst_cnt, cycle_cnt, reason) in zip(group, runs)
+        ]
+
+    with ThreadPoolExecutor(max_workers=threads) as pool:
+        futures = [pool.submit(run_group, jobs[i:i + lanes]) for i in range(0, len(jobs), lanes)]
+    return [res for future in futures for res in future.result()]
+
+
+# ---------------------------------------------------------------------------
+# Background runs
+# ---------------------------------------------------------------------------
+
+# instructions per run() call of a background run without progress_every
+_RUN_CHUNK = 1 << 16
+
+_run_executor = None
+_run_executor_lock = threading.Lock()
+
+
+def _default_run_executor():
+    global _run_executor
+    with _run_executor_lock:
+        if _run_executor is None:
+            _run_executor = ThreadPoolExecutor(thread_name_prefix="ot_dsim-run")
+        return _run_executor
+
+
+class RunFuture(Future):
+    """Future of a background machine run, see Machine.submit()
+
+    cancel() also stops a run that already started: the worker checks
+    between chunks and fails the future with CancelledError, leaving the
+    machine where it stopped. Unlike a future cancelled before it started,
+    cancelled() stays False for it.
+    """
+
+    def __init__(self):
+        super().__init__()
+        self._stop = False
+
+    def cancel(self):
+        with self._condition:
+            if super().cancel():
+                return True
+            if self.done():
+                return False
+            self._stop = True
+            return True
+
+
+def _run_chunks(machine, future, max_steps, progress, progress_every):
+    every = progress_every or _RUN_CHUNK
+    inst_cnt = cycle_cnt = 0
+    while True:
+        if future._stop:
+            raise CancelledError("run cancelled after %d instructions" % inst_cnt)
+        steps = every if max_steps is None else min(every, max_steps - inst_cnt)
+        inst, cycles, reason = machine.run(steps, release_gil=True)
+        inst_cnt += inst
+        cycle_cnt += cycles
+        if reason != "max_steps" or inst_cnt == max_steps:
+            return inst_cnt, cycle_cnt, reason
+        if progress is not None:
+            progress(inst_cnt, cycle_cnt)
+
+
+def _submit_run(machine, max_steps=None, progress=None, progress_every=None, executor=None):
+    """Start machine.run(max_steps) on executor, returns its RunFuture
+
+    The run goes in chunks of progress_every instructions, calling
+    progress(inst_cnt, cycle_cnt) on the worker thread after each one that
+    did not end the run. executor defaults to a shared thread pool. The
+    result is run()'s (inst_cnt, cycle_cnt, stop_reason). A machine runs
+    one background run at a time; while a chunk runs, the C machine raises
+    RuntimeError from reset(), restore(), step(), run() and the other
+    calls that replace its program, state or DMEM.
+    """
+    if max_steps is not None and max_steps < 0:
+        raise ValueError("max_steps must be non-negative")
+    if progress_every is not None and progress_every < 1:
+        raise ValueError("progress_every must be at least 1")
+    pending = getattr(machine, "_background_run", None)
+    if pending is not None and not pending.done():
+        raise RuntimeError("machine already has a background run in progress")
+    future = RunFuture()
+    machine._background_run = future
+
+    def job():
+        if not future.set_running_or_notify_cancel():
+            return
+        try:
+            result = _run_chunks(machine, future, max_steps, progress, progress_every)
+        except BaseException as e:
+            future.set_exception(e)
+        else:
+            future.set_result(result)
+
+    (executor or _default_run_executor()).submit(job)
+    return future
+
+
+async def _run_async(machine, max_steps=None, progress=None, progress_every=None, executor=None):
+    loop = asyncio.get_running_loop()
+    if progress is not None:
+        on_loop = progress
+
+        def progress(inst_cnt, cycle_cnt):
+            loop.call_soon_threadsafe(on_loop, inst_cnt, cycle_cnt)
+
+    # cancelling the awaiting task cancels the run
+    future = _submit_run(machine, max_steps, progress, progress_every, executor)
+    return await asyncio.wrap_future(future, loop=loop)
+
+
+_ACC_MASK = (1 << 512) - 1
+
+
+def _state_layout(dmem_depth):
+    """(field, slots, bytes per slot) of state_bytes(), all little endian
+
+    Both engines produce this image (CMachine.state_bytes() in C), so
+    their states compare by digest. Stack slots above the stack pointer
+    are zero; valid_half_limbs holds one bit per half limb.
+    """
+    return (
+        ("r", 32, 32),
+        ("mod", 1, 32),
+        ("dmp", 1, 32),
+        ("rfp", 1, 32),
+        ("lc", 1, 32),
+        ("rnd", 1, 32),
+        ("acc", 1, 64),
+        ("gpr", 32, 4),
+        ("flags", 1, 1),
+        ("finishFlag", 1, 1),
+        ("pc", 1, 4),
+        ("loop_sp", 1, 1),
+        ("loop_stack", 3 * 16, 4),
+        ("call_sp", 1, 1),
+        ("call_stack", 16, 4),
+        ("valid_half_limbs", 32, 2),
+        ("dmem", dmem_depth, 32),
+    )
+
+
+def decode_state(blob, dmem_depth=None):
+    """Dict of field name to list of slot values of a state_bytes() image"""
+    if dmem_depth is None:
+        dmem_depth = Machine.DMEM_DEPTH
+    state = {}
+    pos = 0
+    for name, slots, size in _state_layout(dmem_depth):
+        state[name] = [
+            int.from_bytes(blob[pos + i * size:pos + (i + 1) * size], "little") for i in range(slots)
+        ]
+        pos += slots * size
+    if pos != len(blob):
+        raise ValueError("state image of %d bytes does not match dmem_depth %d" % (len(blob), dmem_depth))
+    return state
+
+
+def state_digest(machine):
+    """8 byte digest of machine.state_bytes()"""
+    return hashlib.blake2b(machine.state_bytes(), digest_size=8).digest()
+
+
+def _state_diff(native, reference, dmem_depth):
+    """[(slot, native value, reference value)] of two differing state images"""
+    a = decode_state(native, dmem_depth)
+    b = decode_state(reference, dmem_depth)
+    diff = []
+    for name, slots, _ in _state_layout(dmem_depth):
+        for i in range(slots):
+            if a[name][i] != b[name][i]:
+                diff.append((name if slots == 1 else "%s[%d]" % (name, i), a[name][i], b[name][i]))
+    return diff
+
+
+def _reference_twin(machine):
+    """Pure-Python machine in the architectural state of machine"""
+    geometry = (machine.DMEM_DEPTH, machine.IMEM_DEPTH)
+    cls = _PyMachine
+    if geometry != (_PyMachine.DMEM_DEPTH, _PyMachine.IMEM_DEPTH):
+        cls = _machine_classes.get(("py",) + geometry)
+        if cls is None:
+            cls = type(
+                "_PyMachine",
+                (_PyMachine,),
+                {"__module__": __name__, "DMEM_DEPTH": geometry[0], "IMEM_DEPTH": geometry[1]},
+            )
+            _machine_classes[("py",) + geometry] = cls
+    state = decode_state(machine.state_bytes(), geometry[0])
+    program = machine.program if machine.program is not None else machine.imem
+    ref = cls(state["dmem"], program, state["pc"][0], machine.stop_addr, ctx=machine.ctx)
+    ref.init_dmem = list(machine.init_dmem)
+    ref.r = state["r"]
+    for name in ("mod", "dmp", "rfp", "lc", "rnd", "acc"):
+        setattr(ref, name, state[name][0])
+    ref.gpr = state["gpr"]
+    ref.set_flags_as_bin(state["flags"][0])
+    ref.finishFlag = bool(state["finishFlag"][0])
+    loops = state["loop_stack"]
+    ref.loop_stack = [tuple(loops[3 * i:3 * i + 3]) for i in range(state["loop_sp"][0])]
+    ref.call_stack = state["call_stack"][:state["call_sp"][0]]
+    ref.r_valid_half_limbs = [
+        [bool(mask >> j & 1) for j in range(2 * ref.LIMBS)] for mask in state["valid_half_limbs"]
+    ]
+    return ref
+
+
+Divergence = namedtuple("Divergence", ["inst_cnt", "pc", "diff"])
+
+LockstepResult = namedtuple(
+    "LockstepResult", ["inst_cnt", "cycle_cnt", "stop_reason", "divergence", "reference"]
+)
+
+
+def _reference_block(ref, limit=None):
+    """Step ref to the end of its basic block or over limit instructions,
+    returns the summed run() result"""
+    pc = ref.get_pc()
+    inst_cnt = cycle_cnt = 0
+    while True:
+        inst, cycles, reason = ref.run(1)
+        inst_cnt += inst
+        cycle_cnt += cycles
+        if reason != "max_steps" or ref.get_pc() != pc + 1 or inst_cnt == limit:
+            return inst_cnt, cycle_cnt, reason
+        pc += 1
+
+
+def _lockstep_run(machine, ref, steps, blocks=False):
+    """Run ref and then machine for as many instructions, returns
+    (native run() result, differences or None)
+
+    With blocks ref runs to the end of its basic block, at most steps.
+    """
+    started = ref._perf[_PERF_PYTHON_OPS]
+    try:
+        reference = _reference_block(ref, steps) if blocks else ref.run(steps)
+    except Exception as e:
+        # python_ops includes the instruction that raised: machine runs up
+        # to and including it, not on to steps (None with blocks)
+        ran = ref._perf[_PERF_PYTHON_OPS] - started
+        return machine.run(ran), [("exception", None, "%s: %s" % (type(e).__name__, e))]
+    native = machine.run(reference[0])
+    diff = []
+    if native[0] != reference[0] or native[2] != reference[2]:
+        diff.append(("stop", native[0::2], reference[0::2]))
+    if state_digest(machine) != state_digest(ref):
+        diff += _state_diff(machine.state_bytes(), ref.state_bytes(), machine.DMEM_DEPTH)
+    return native, diff or None
+
+
+def lockstep(machine, every=1, blocks=False, max_steps=None):
+    """Run machine with a pure-Python reference comparing their states
+
+    A _PyMachine twin starts from machine's state and both engines run
+    the same instructions; their state_bytes() digests are compared after
+    every instruction, every Nth instruction or, with blocks, at the end
+    of each basic block. On a mismatch a fork of machine rewinds to the
+    last check, gets a fresh twin and both single-step to the first
+    diverging instruction; machine then takes the fork's state, so its
+    statistics count each instruction it ran once, up to the check that
+    caught the mismatch. Returns a LockstepResult with the native counts
+    and stop reason, the twin, and a divergence of None or a Divergence of
+    the instruction count and pc it happened at and its [(slot, native,
+    reference)] differences, with both machines left just after it.
+    """
+    if every < 1:
+        raise ValueError("every must be at least 1")
+    if max_steps is not None and max_steps < 0:
+        raise ValueError("max_steps must be non-negative")
+    if machine.breakpoints:
+        raise ValueError("lockstep() does not support breakpoints")
+    ref = _reference_twin(machine)
+    inst_cnt = 0
+    cycle_cnt = 0
+    while max_steps is None or inst_cnt < max_steps:
+        limit = None if max_steps is None else max_steps - inst_cnt
+        if blocks:
+            steps = limit
+        else:
+            steps = every if limit is None else min(every, limit)
+        # the states agreed up to here, so restoring the native snapshot
+        # and rebuilding the twin rewinds both
+        checkpoint = machine.snapshot()
+        pc = machine.get_pc()
+        (inst, cycles, reason), diff = _lockstep_run(machine, ref, steps, blocks)
+        if diff and inst > 1:
+            # Rewound on a fork: restore() leaves the statistics alone,
+            # and machine's already count the instructions once
+            probe = machine.fork()
+            probe.restore(checkpoint)
+            ref = _reference_twin(probe)
+            for _ in range(inst):
+                pc = probe.get_pc()
+                (inst, cycles, reason), diff = _lockstep_run(probe, ref, 1)
+                inst_cnt += inst
+                cycle_cnt += cycles
+                if diff or reason != "max_steps":
+                    break
+            machine.restore(probe.snapshot())
+        else:
+            inst_cnt += inst
+            cycle_cnt += cycles
+        if diff:
+            return LockstepResult(inst_cnt, cycle_cnt, reason, Divergence(inst_cnt, pc, diff), ref)
+        if reason != "max_steps":
+            return LockstepResult(inst_cnt, cycle_cnt, reason, None, ref)
+    return LockstepResult(inst_cnt, cycle_cnt, "max_steps", None, ref)
+
+
 if __name__ == "__main__":
     raise Exception("This file is not executable")
@@ -0,0 +1,158 @@
+# Copyright lowRISC contributors.
+# Licensed under the Apache License, Version 2.0, see LICENSE for details.
+# SPDX-License-Identifier: Apache-2.0
+
+"""On-disk cache of assembled programs
+
+An entry holds the pickled instruction objects, context and breakpoints of
+one assembly source together with the C machine's decoded op table, so a
+fresh process skips both assembly and decode. Entries are keyed by the
+source bytes, the ISA flags, the backend build and the modules that define
+the instruction objects; a change to any of them simply misses the cache.
+
+The cache lives in $OT_DSIM_CACHE_DIR, or ~/.cache/ot_dsim by default;
+OT_DSIM_CACHE_DIR=off disables it.
+"""
+
+import hashlib
+import mmap
+import os
+import pickle
+import struct
+import tempfile
+
+from . import assembler, instructions, instructions_ot, machine
+from .machine import Program
+
+CACHE_VERSION = 2
+
+# magic, version, pickle length, ops image length, SHA-256 of the payload
+# (pickle and ops image), checked before anything is unpickled
+_HEADER = struct.Struct("<8sIQQ32s")
+_MAGIC = b"OTDSIMPC"
+
+
+def cache_dir():
+    """Directory of the cache entries, None when disabled"""
+    path = os.environ.get("OT_DSIM_CACHE_DIR")
+    if path is None:
+        path = os.path.join(os.path.expanduser("~"), ".cache", "ot_dsim")
+    elif path.strip().lower() in ("", "0", "off", "no", "false"):
+        return None
+    return path
+
+
+def _code_stamp():
+    stamp = []
+    for mod in (assembler, instructions, instructions_ot, machine):
+        st = os.stat(mod.__file__)
+        stamp.append("%s:%d:%d" % (os.path.basename(mod.__file__), st.st_size, st.st_mtime_ns))
+    return ";".join(stamp)
+
+
+def cache_key(source, dmem_byte_addressing=False, otbn_only=False):
+    """Hex digest naming the entry of source (bytes) under the ISA flags"""
+    if machine._USE_C_MACHINE:
+        backend = "c%d" % machine._C_MACHINE_ABI_VERSION
+    else:
+        backend = "py"
+    h = hashlib.sha256()
+    h.update(
+        ("%d|%d|%d|%s|%s|" % (CACHE_VERSION, bool(dmem_byte_addressing), bool(otbn_only),
+                              backend, _code_stamp())).encode()
+    )
+    h.update(source)
+    return h.hexdigest()
+
+
+def _assemble(source, dmem_byte_addressing, otbn_only):
+    lines = source.decode().splitlines(keepends=True)
+    asm = assembler.Assembler(lines, dmem_byte_addressing=dmem_byte_addressing, otbn_only=otbn_only)
+    asm.assemble()
+    return asm.get_instruction_objects(), asm.get_instruction_context(), asm.breakpoints
+
+
+def _read_entry(path):
+    """(Program, ctx, breakpoints) of the entry at path, None if unusable"""
+    try:
+        f = open(path, "rb")
+    except OSError:
+        return None
+    with f:
+        try:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (OSError, ValueError):
+            return None
+    with mm:
+        if len(mm) < _HEADER.size:
+            return None
+        magic, version, blob_len, ops_len, digest = _HEADER.unpack_from(mm)
+        if magic != _MAGIC or version != CACHE_VERSION or len(mm) != _HEADER.size + blob_len + ops_len:
+            return None
+        view = memoryview(mm)
+        try:
+            payload = view[_HEADER.size:]
+            try:
+                if hashlib.sha256(payload).digest() != digest:
+                    return None
+            finally:
+                payload.release()
+            ins, ctx, breakpoints = pickle.loads(view[_HEADER.size:_HEADER.size + blob_len])
+            if ops_len:
+                ops = view[_HEADER.size + blob_len:]
+                try:
+                    program = Program(ins, ctx, ops=ops)
+                finally:
+                    ops.release()
+            else:
+                program = Program(ins, ctx)
+        except Exception:
+            return None
+        finally:
+            view.release()
+    return program, ctx, breakpoints
+
+
+def _write_entry(path, program, breakpoints):
+    blob = pickle.dumps((list(program.instructions), program.ctx, breakpoints),
+                        protocol=pickle.HIGHEST_PROTOCOL)
+    ops = program.ops_image() if machine._USE_C_MACHINE else b""
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+    try:
+        with os.fdopen(fd, "wb") as f:
+            digest = hashlib.sha256(blob + ops).digest()
+            f.write(_HEADER.pack(_MAGIC, CACHE_VERSION, len(blob), len(ops), digest))
+            f.write(blob)
+            f.write(ops)
+        os.replace(tmp, path)
+    except BaseException:
+        os.unlink(tmp)
+        raise
+
+
+def load_asm_program(asm_path, dmem_byte_addressing=False, otbn_only=False, directory=None):
+    """Assembled and decoded program of asm_path, through the cache
+
+    Returns (Program, ctx, breakpoints) like ins_objects_from_asm_file()
+    with the instructions already frozen into a Program. directory
+    overrides cache_dir(); a failing cache write never fails the load.
+    """
+    with open(asm_path, "rb") as f:
+        source = f.read()
+    if directory is None:
+        directory = cache_dir()
+    path = None
+    if directory is not None:
+        path = os.path.join(directory, cache_key(source, dmem_byte_addressing, otbn_only) + ".otpc")
+        entry = _read_entry(path)
+        if entry is not None:
+            return entry
+    ins, ctx, breakpoints = _assemble(source, dmem_byte_addressing, otbn_only)
+    program = Program(ins, ctx)
+    if path is not None:
+        try:
+            _write_entry(path, program, breakpoints)
+        except OSError:
+            pass
+    return program, ctx, breakpoints
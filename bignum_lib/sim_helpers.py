@@ -4,38 +4,68 @@
 
 from . assembler import Assembler
 from . disassembler import Disassembler
-from . machine import Machine
-
-from collections import Counter
+from . instructions import InsContext, InstructionFactory, UnknownOpcodeError
+from . machine import Machine, Program
+from . import c_backend
+
+import argparse
+import json
+import os
+import struct
+import sys
+from collections import Counter, deque
+from concurrent.futures import Future, ThreadPoolExecutor
 from tabulate import tabulate
 
 
-def read_dmem_from_file(dmemfile):
-    line_cnt = 0
-    dmem = []
+def _read_bytes(f, size=-1):
+    data = f.read(size)
+    return data.encode() if isinstance(data, str) else data
+
+
+def dmem_image_from_file(dmemfile):
+    """DMEM init file as one little-endian byte image, 32 bytes per cell
+
+    Parsed natively when the C backend is available; pass the image as a
+    Machine's dmem or to set_dmem_bytes().
+    """
+    image, lines, _ = c_backend.parse_dmem_hex(_read_bytes(dmemfile))
+    if lines > Machine.DMEM_DEPTH:
+        raise OverflowError('Dmem file to large')
+    return image
+
+
+def iter_dmem_images(dmemfile, cells=None, chunk_size=1 << 16):
+    """Stream a DMEM init file of any length as byte images of cells cells
+
+    Reads chunk_size bytes at a time, so generated test images far larger
+    than DMEM never sit in memory as a whole. Line addresses count on
+    across images; the last image may be short.
+    """
+    cell_bytes = Machine.XLEN // 8
+    image_bytes = (cells or Machine.DMEM_DEPTH) * cell_bytes
+    pending = b''
+    images = bytearray()
+    line = 0
     while True:
-        line_str = dmemfile.readline()
-        if not line_str:
+        chunk = _read_bytes(dmemfile, chunk_size)
+        data = pending + chunk
+        image, lines, consumed = c_backend.parse_dmem_hex(data, line, not chunk)
+        line += lines
+        pending = data[consumed:]
+        images += image
+        while len(images) >= image_bytes:
+            yield bytes(images[:image_bytes])
+            del images[:image_bytes]
+        if not chunk:
             break
-        if line_cnt == Machine.DMEM_DEPTH:
-            raise OverflowError('Dmem file to large')
-        if ':' in line_str:
-            addr = line_str.split(':')[0].strip()
-            if int(addr) != line_cnt:
-                raise Exception('Error in Dmem file line ' + str(line_cnt+1)
-                                + ' (non continues mem files currently not supported)')
-            line_str = line_str.split(':')[1].lower().strip()
-        words = line_str.split()
-        if len(words) != 8:
-            raise Exception('Error in Dmem file line ' + str(line_cnt+1)
-                            + ' 8 32-bit words expected per line, found ' + str(len(words)) + '.')
-        line_str = ''.join(words)
-        if len(line_str) != 32*2:
-            raise Exception('Error in Dmem file line ' + str(line_cnt+1) + '. Expecting data 32 bytes per line. Found '
-                            + str(len(line_str)) + ' characters.')
-        dmem.append(int(line_str, 16))
-        line_cnt += 1
-    return dmem
+    if images:
+        yield bytes(images)
+
+
+def read_dmem_from_file(dmemfile):
+    image = dmem_image_from_file(dmemfile)
+    return c_backend.unpack_u256_many(image)
 
 
 def ins_objects_from_hex_file(hex_file):
@@ -44,12 +74,176 @@ def ins_objects_from_hex_file(hex_file):
     return disassembler.get_instruction_objects(), disassembler.ctx
 
 
+def program_from_hex_file(hex_file):
+    """Load a .hex program straight into a Program, returns (program, ctx)
+
+    The instruction words are parsed natively and decoded once; unlike
+    ins_objects_from_hex_file() no per-line disassembly is printed, and
+    unknown opcodes raise ValueError.
+    """
+    ctx = InsContext()
+    if 0 not in ctx.functions:
+        ctx.functions.update({0: 'fun0'})
+    factory = InstructionFactory()
+    ins_objects = []
+    words = c_backend.parse_hex_words(_read_bytes(hex_file))
+    for addr, (word,) in enumerate(struct.iter_unpack('<I', words)):
+        try:
+            ins_objects.append(factory.factory_bin(word, ctx))
+        except UnknownOpcodeError:
+            raise ValueError('Unknown opcode in instruction word ' + hex(word)
+                             + ' at address ' + str(addr)) from None
+    return Program(ins_objects, ctx), ctx
+
+
 def ins_objects_from_asm_file(asm_file, dmem_byte_addressing=False, otbn_only=False):
     lines = asm_file.readlines()
     assembler = Assembler(lines, dmem_byte_addressing=dmem_byte_addressing, otbn_only=otbn_only)
     assembler.assemble()
     return assembler.get_instruction_objects(), assembler.get_instruction_context(), assembler.breakpoints
 
+
+def run_machine(machine, trace_cb=None, binary_trace=None):
+    """Run machine until it halts, returns (inst_cnt, cycle_cnt)
+
+    Uses Machine.run() and only builds trace strings when trace_cb is given.
+    Machines with breakpoints are stepped so the interactive break handler
+    of step() stays in charge.  binary_trace names a file the C machine
+    writes its binary trace to (render it with dasm.py --trace).
+    """
+    if binary_trace:
+        machine.enable_trace(path=binary_trace)
+        try:
+            return run_machine(machine, trace_cb)
+        finally:
+            machine.disable_trace()
+    if machine.breakpoints:
+        inst_cnt = 0
+        cycle_cnt = 0
+        cont = True
+        while cont:
+            cont, trace_str, cycles = machine.step()
+            if trace_cb:
+                trace_cb(trace_str)
+            inst_cnt += 1
+            cycle_cnt += cycles
+        return inst_cnt, cycle_cnt
+    if trace_cb:
+        inst_cnt, cycle_cnt, _, traces = machine.run(collect_trace=True)
+        for trace_str in traces:
+            trace_cb(trace_str)
+        return inst_cnt, cycle_cnt
+    inst_cnt, cycle_cnt, _ = machine.run()
+    return inst_cnt, cycle_cnt
+
+
+def iter_vectors(vector_file):
+    """Test vectors of a JSON lines stream, one dict per line
+
+    Reads lazily, so vector files of any length stream through. Blank
+    lines and lines starting with '#' are skipped.
+    """
+    for line in vector_file:
+        line = line.strip()
+        if line and not line.startswith('#'):
+            yield json.loads(line)
+
+
+def vector_int(val):
+    """Integer of a vector field, given as int or as string ("0x..." for hex)"""
+    return int(val, 0) if isinstance(val, str) else int(val)
+
+
+def stream_vectors(vectors, prepare, execute, check, results=None, workers=None, window=None):
+    """Run test vectors through a prepare / execute / check pipeline
+
+    prepare(vector) computes the host side reference values and builds the
+    job, execute(job) runs the simulation and check(vector, job, result)
+    returns a dict of result fields with an 'ok' entry. prepare and check
+    run on the calling thread while up to workers execute() calls run on a
+    thread pool; execute() should run its machines with release_gil=True so
+    both sides overlap. At most window vectors (default 2 * workers) are in
+    flight: before preparing the next one the oldest is waited for, so
+    vectors are read no faster than they are simulated.
+
+    With results given, one JSON line per vector is written to it in input
+    order as soon as the vector is checked: its index, 'ok' and the fields
+    from check(), or 'error' when one of the stages raised. Returns the
+    summary dict {'vectors', 'passed', 'failed'}.
+    """
+    if workers is None:
+        workers = os.cpu_count() or 1
+    if window is None:
+        window = 2 * workers
+    if workers < 1 or window < 1:
+        raise ValueError("workers and window must be at least 1")
+    summary = {'vectors': 0, 'passed': 0, 'failed': 0}
+
+    def retire(index, vector, job, future):
+        try:
+            record = {'index': index, 'ok': False}
+            record.update(check(vector, job, future.result()))
+        except Exception as e:
+            record = {'index': index, 'ok': False, 'error': "%s: %s" % (type(e).__name__, e)}
+        summary['vectors'] += 1
+        summary['passed' if record['ok'] else 'failed'] += 1
+        if results is not None:
+            results.write(json.dumps(record) + '\n')
+            results.flush()
+
+    pending = deque()
+    with ThreadPoolExecutor(max_workers=workers) as pool:
+        for index, vector in enumerate(vectors):
+            while len(pending) >= window:
+                retire(*pending.popleft())
+            try:
+                job = prepare(vector)
+            except Exception as e:
+                job = None
+                future = Future()
+                future.set_exception(e)
+            else:
+                future = pool.submit(execute, job)
+            pending.append((index, vector, job, future))
+        while pending:
+            retire(*pending.popleft())
+    return summary
+
+
+def vectors_main(argv, description, load_program, run_vectors):
+    """Command line driver of a test vector stream, returns the exit status
+
+    Parses argv (vector file, -o results, -j workers, -w window), calls
+    load_program() and then run_vectors(vector_file, results, workers,
+    window), which returns stream_vectors()'s summary. '-' stands for
+    stdin and stdout. The summary goes to stderr; the status is 1 when a
+    vector failed.
+    """
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument("vectors", help="JSON lines vector file, - for stdin")
+    parser.add_argument("-o", "--results", help="JSON lines results file, - for stdout")
+    parser.add_argument("-j", "--workers", type=int, help="simulation threads")
+    parser.add_argument("-w", "--window", type=int, help="vectors in flight")
+    args = parser.parse_args(argv)
+
+    load_program()
+    vector_file = sys.stdin if args.vectors == "-" else open(args.vectors)
+    results = None
+    if args.results == "-":
+        results = sys.stdout
+    elif args.results:
+        results = open(args.results, "w")
+    try:
+        summary = run_vectors(vector_file, results, args.workers, args.window)
+    finally:
+        if vector_file is not sys.stdin:
+            vector_file.close()
+        if results not in (None, sys.stdout):
+            results.close()
+    print("%(vectors)d vectors, %(passed)d passed, %(failed)d failed" % summary, file=sys.stderr)
+    return 1 if summary["failed"] else 0
+
+
 def dump_instruction_histo(instruction_histo, sort_by="key"):
     if sort_by == "key":
         data = sorted(instruction_histo.items())
@@ -5,6 +5,12 @@
 
 #define U256_BYTES 32
 #define U256_LIMBS 8
+#define ACC_BYTES 64
+#define ACC_WORDS (ACC_BYTES / 8)
+
+#if !defined(__SIZEOF_INT128__) && defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
 static int parse_fixed_buffer(PyObject *obj,
                               const char *name,
@@ -571,6 +577,818 @@ static PyObject *py_u256_set_half_word(PyObject *self, PyObject *args) {
     return bytes_from_u256(out);
 }
 
+/* Multiply-accumulate.  The accumulator is a 512-bit little-endian value
+ * (ACC_BYTES), wide enough for the shifted 128-bit quarter-word products
+ * of BN.MULQACC; carries out of it are dropped. */
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_MSC_VER)
+#define LE64_NATIVE 1
+#else
+#define LE64_NATIVE 0
+#endif
+
+static uint64_t load_le64(const uint8_t *p) {
+    uint64_t v = 0;
+    int i;
+    if (LE64_NATIVE) {
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    for (i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void store_le64(uint8_t *p, uint64_t v) {
+    int i;
+    if (LE64_NATIVE) {
+        memcpy(p, &v, sizeof(v));
+        return;
+    }
+    for (i = 0; i < 8; ++i) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static void mul_64x64(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 prod = (unsigned __int128)a * b;
+    *lo = (uint64_t)prod;
+    *hi = (uint64_t)(prod >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *lo = _umul128(a, b, hi);
+#else
+    uint64_t a_lo = (uint32_t)a;
+    uint64_t a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b;
+    uint64_t b_hi = b >> 32;
+    uint64_t p0 = a_lo * b_lo;
+    uint64_t p1 = a_lo * b_hi;
+    uint64_t p2 = a_hi * b_lo;
+    uint64_t p3 = a_hi * b_hi;
+    uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+    *lo = (mid << 32) | (uint32_t)p0;
+    *hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+#endif
+}
+
+/* words += (hi:lo) << shift over n_words 64-bit words */
+static void add_shifted_product(uint64_t *words,
+                                int n_words,
+                                uint64_t lo,
+                                uint64_t hi,
+                                Py_ssize_t shift) {
+    uint64_t parts[3];
+    int bit = (int)(shift % 64);
+    int idx = (int)(shift / 64);
+    uint64_t carry = 0;
+    int i;
+
+    parts[0] = lo << bit;
+    parts[1] = bit ? (hi << bit) | (lo >> (64 - bit)) : hi;
+    parts[2] = bit ? hi >> (64 - bit) : 0;
+
+    for (i = idx; i < n_words; ++i) {
+        uint64_t add = (i - idx < 3) ? parts[i - idx] : 0;
+        uint64_t sum = words[i] + add;
+        uint64_t c1 = sum < add;
+        words[i] = sum + carry;
+        carry = c1 | (words[i] < sum);
+        if (i - idx >= 2 && carry == 0) {
+            break;
+        }
+    }
+}
+
+static int parse_qw_sel(Py_ssize_t qw_sel, const char *name) {
+    if (qw_sel < 0 || qw_sel >= 4) {
+        PyErr_Format(PyExc_IndexError, "%s quarter-word index out of range", name);
+        return -1;
+    }
+    return 0;
+}
+
+/* Shared argument handling of u256_mulqacc and u256_mulqacc_so: loads the
+ * accumulator into acc and adds the shifted quarter-word product. */
+static int mulqacc_args(PyObject *args, const char *format, uint64_t acc[ACC_WORDS]) {
+    PyObject *acc_obj;
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    Py_ssize_t lhs_qw;
+    Py_ssize_t rhs_qw;
+    Py_ssize_t shift;
+    Py_buffer acc_view;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    uint64_t lo;
+    uint64_t hi;
+    int i;
+
+    if (!PyArg_ParseTuple(args, format, &acc_obj, &lhs_obj, &rhs_obj,
+                          &lhs_qw, &rhs_qw, &shift)) {
+        return -1;
+    }
+    if (parse_qw_sel(lhs_qw, "lhs") != 0 || parse_qw_sel(rhs_qw, "rhs") != 0) {
+        return -1;
+    }
+    if (shift < 0 || shift > ACC_BYTES * 8 - 128) {
+        PyErr_Format(PyExc_ValueError,
+                     "shift must be in range 0..%d",
+                     ACC_BYTES * 8 - 128);
+        return -1;
+    }
+    if (parse_fixed_buffer(acc_obj, "acc", ACC_BYTES, &acc_view) != 0) {
+        return -1;
+    }
+    if (parse_fixed_buffer(lhs_obj, "lhs", U256_BYTES, &lhs) != 0) {
+        PyBuffer_Release(&acc_view);
+        return -1;
+    }
+    if (parse_fixed_buffer(rhs_obj, "rhs", U256_BYTES, &rhs) != 0) {
+        PyBuffer_Release(&acc_view);
+        PyBuffer_Release(&lhs);
+        return -1;
+    }
+
+    for (i = 0; i < ACC_WORDS; ++i) {
+        acc[i] = load_le64((const uint8_t *)acc_view.buf + 8 * i);
+    }
+    mul_64x64(load_le64((const uint8_t *)lhs.buf + 8 * lhs_qw),
+              load_le64((const uint8_t *)rhs.buf + 8 * rhs_qw),
+              &lo,
+              &hi);
+    add_shifted_product(acc, ACC_WORDS, lo, hi, shift);
+
+    PyBuffer_Release(&acc_view);
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+    return 0;
+}
+
+static PyObject *bytes_from_words(const uint64_t *words, int n_words) {
+    uint8_t out[ACC_BYTES];
+    int i;
+
+    for (i = 0; i < n_words; ++i) {
+        store_le64(out + 8 * i, words[i]);
+    }
+    return PyBytes_FromStringAndSize((const char *)out, 8 * n_words);
+}
+
+static PyObject *py_u256_mulqacc(PyObject *self, PyObject *args) {
+    uint64_t acc[ACC_WORDS];
+
+    (void)self;
+
+    if (mulqacc_args(args, "OOOnnn:u256_mulqacc", acc) != 0) {
+        return NULL;
+    }
+    return bytes_from_words(acc, ACC_WORDS);
+}
+
+static PyObject *py_u256_mulqacc_so(PyObject *self, PyObject *args) {
+    uint64_t acc[ACC_WORDS];
+    uint64_t shifted[ACC_WORDS];
+
+    (void)self;
+
+    if (mulqacc_args(args, "OOOnnn:u256_mulqacc_so", acc) != 0) {
+        return NULL;
+    }
+    /* Shift the lower half-word out of the accumulator */
+    memset(shifted, 0, sizeof(shifted));
+    memcpy(shifted, acc + 2, sizeof(uint64_t) * (ACC_WORDS - 2));
+    return Py_BuildValue("NN",
+                         bytes_from_words(shifted, ACC_WORDS),
+                         bytes_from_words(acc, 2));
+}
+
+static PyObject *py_u256_mulh(PyObject *self, PyObject *args) {
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    int lhs_upper = 0;
+    int rhs_upper = 0;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    uint64_t a[2];
+    uint64_t b[2];
+    uint64_t res[U256_BYTES / 8];
+    uint64_t lo;
+    uint64_t hi;
+    int i;
+    int j;
+
+    (void)self;
+
+    if (!PyArg_ParseTuple(args, "OO|pp:u256_mulh", &lhs_obj, &rhs_obj, &lhs_upper, &rhs_upper)) {
+        return NULL;
+    }
+    if (parse_fixed_buffer(lhs_obj, "lhs", U256_BYTES, &lhs) != 0) {
+        return NULL;
+    }
+    if (parse_fixed_buffer(rhs_obj, "rhs", U256_BYTES, &rhs) != 0) {
+        PyBuffer_Release(&lhs);
+        return NULL;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        a[i] = load_le64((const uint8_t *)lhs.buf + 16 * lhs_upper + 8 * i);
+        b[i] = load_le64((const uint8_t *)rhs.buf + 16 * rhs_upper + 8 * i);
+    }
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+
+    memset(res, 0, sizeof(res));
+    for (i = 0; i < 2; ++i) {
+        for (j = 0; j < 2; ++j) {
+            mul_64x64(a[i], b[j], &lo, &hi);
+            add_shifted_product(res, U256_BYTES / 8, lo, hi, 64 * (i + j));
+        }
+    }
+    return bytes_from_words(res, U256_BYTES / 8);
+}
+
+/* Batched operations.  The *_many functions take contiguous buffers of
+ * N little-endian 256-bit values (N x 32 bytes) and return one output
+ * buffer, so large vector sets cost one call and no per-value int
+ * conversions.  rhs may also be a single 32-byte value, which is paired
+ * with every lhs value.  The GIL is released while the loops run. */
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+/* Bitwise kernels vectorize; pick an AVX2 build at load time when the
+ * CPU has it.  The extension builds with -O2, where GCC 12 leaves these
+ * loops scalar, so the clones ask for the vectorizer explicitly.
+ * Elsewhere (including NEON, which aarch64 always has) the
+ * compiler's default vectorization applies. */
+#define MANY_TARGET_CLONES \
+    __attribute__((target_clones("avx2", "default"), optimize("O3", "tree-vectorize")))
+#else
+#define MANY_TARGET_CLONES
+#endif
+
+enum { MANY_AND, MANY_OR, MANY_XOR };
+
+static int parse_many(PyObject *lhs_obj,
+                      PyObject *rhs_obj,
+                      Py_buffer *lhs,
+                      Py_buffer *rhs,
+                      Py_ssize_t *count) {
+    if (PyObject_GetBuffer(lhs_obj, lhs, PyBUF_CONTIG_RO) != 0) {
+        return -1;
+    }
+    if (lhs->len % U256_BYTES != 0) {
+        PyErr_Format(PyExc_ValueError, "lhs must be a multiple of %d bytes", U256_BYTES);
+        PyBuffer_Release(lhs);
+        return -1;
+    }
+    if (PyObject_GetBuffer(rhs_obj, rhs, PyBUF_CONTIG_RO) != 0) {
+        PyBuffer_Release(lhs);
+        return -1;
+    }
+    if (rhs->len != lhs->len && rhs->len != U256_BYTES) {
+        PyErr_Format(PyExc_ValueError,
+                     "rhs must be %zd bytes or a single %d-byte value",
+                     lhs->len,
+                     U256_BYTES);
+        PyBuffer_Release(lhs);
+        PyBuffer_Release(rhs);
+        return -1;
+    }
+    *count = lhs->len / U256_BYTES;
+    return 0;
+}
+
+static const uint8_t *many_rhs(const Py_buffer *rhs, Py_ssize_t idx) {
+    return (const uint8_t *)rhs->buf + (rhs->len == U256_BYTES ? 0 : idx * U256_BYTES);
+}
+
+/* Add (sub = 0) or subtract (sub = 1) n value pairs; flags receives the
+ * carry/borrow of each. */
+static void addsub_many(const Py_buffer *lhs,
+                        const Py_buffer *rhs,
+                        Py_ssize_t n,
+                        int sub,
+                        unsigned int carry_in,
+                        uint8_t *out,
+                        uint8_t *flags) {
+    Py_ssize_t idx;
+    int w;
+
+    for (idx = 0; idx < n; ++idx) {
+        const uint8_t *a = (const uint8_t *)lhs->buf + idx * U256_BYTES;
+        const uint8_t *b = many_rhs(rhs, idx);
+        uint64_t carry = carry_in;
+        for (w = 0; w < U256_BYTES / 8; ++w) {
+            uint64_t x = load_le64(a + 8 * w);
+            uint64_t y = load_le64(b + 8 * w);
+            uint64_t r;
+            if (sub) {
+                r = x - y - carry;
+                carry = (x < y) | ((x == y) & carry);
+            } else {
+                uint64_t t = x + y;
+                r = t + carry;
+                carry = (t < x) | (r < t);
+            }
+            store_le64(out + idx * U256_BYTES + 8 * w, r);
+        }
+        flags[idx] = (uint8_t)carry;
+    }
+}
+
+static PyObject *addsub_many_py(PyObject *args, const char *format, int sub) {
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    int carry_in = 0;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    Py_ssize_t n;
+    PyObject *out;
+    PyObject *flags;
+
+    if (!PyArg_ParseTuple(args, format, &lhs_obj, &rhs_obj, &carry_in)) {
+        return NULL;
+    }
+    if (parse_many(lhs_obj, rhs_obj, &lhs, &rhs, &n) != 0) {
+        return NULL;
+    }
+    out = PyBytes_FromStringAndSize(NULL, n * U256_BYTES);
+    flags = PyBytes_FromStringAndSize(NULL, n);
+    if (out != NULL && flags != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        addsub_many(&lhs, &rhs, n, sub, carry_in ? 1U : 0U,
+                    (uint8_t *)PyBytes_AS_STRING(out),
+                    (uint8_t *)PyBytes_AS_STRING(flags));
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+    if (out == NULL || flags == NULL) {
+        Py_XDECREF(out);
+        Py_XDECREF(flags);
+        return NULL;
+    }
+    return Py_BuildValue("NN", out, flags);
+}
+
+static PyObject *py_u256_add_many(PyObject *self, PyObject *args) {
+    (void)self;
+    return addsub_many_py(args, "OO|p:u256_add_many", 0);
+}
+
+static PyObject *py_u256_sub_many(PyObject *self, PyObject *args) {
+    (void)self;
+    return addsub_many_py(args, "OO|p:u256_sub_many", 1);
+}
+
+static void cmp_many(const Py_buffer *lhs, const Py_buffer *rhs, Py_ssize_t n, int8_t *out) {
+    Py_ssize_t idx;
+    int w;
+
+    for (idx = 0; idx < n; ++idx) {
+        const uint8_t *a = (const uint8_t *)lhs->buf + idx * U256_BYTES;
+        const uint8_t *b = many_rhs(rhs, idx);
+        int res = 0;
+        for (w = U256_BYTES / 8 - 1; w >= 0 && res == 0; --w) {
+            uint64_t x = load_le64(a + 8 * w);
+            uint64_t y = load_le64(b + 8 * w);
+            res = (x > y) - (x < y);
+        }
+        out[idx] = (int8_t)res;
+    }
+}
+
+static PyObject *py_u256_cmp_many(PyObject *self, PyObject *args) {
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    Py_ssize_t n;
+    PyObject *out;
+
+    (void)self;
+
+    if (!PyArg_ParseTuple(args, "OO:u256_cmp_many", &lhs_obj, &rhs_obj)) {
+        return NULL;
+    }
+    if (parse_many(lhs_obj, rhs_obj, &lhs, &rhs, &n) != 0) {
+        return NULL;
+    }
+    out = PyBytes_FromStringAndSize(NULL, n);
+    if (out != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        cmp_many(&lhs, &rhs, n, (int8_t *)PyBytes_AS_STRING(out));
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+    return out;
+}
+
+/* One loop per op over 64-bit words, with the broadcast rhs held in
+ * registers: no per-byte index arithmetic or op tests for the vectorizer
+ * to trip over.  Bitwise ops do not care about byte order. */
+#define BITWISE_LOOP(OP)                                                   \
+    do {                                                                   \
+        if (broadcast) {                                                   \
+            for (i = 0; i < n_words; i += 4) {                             \
+                out[i] = a[i] OP y[0];                                     \
+                out[i + 1] = a[i + 1] OP y[1];                             \
+                out[i + 2] = a[i + 2] OP y[2];                             \
+                out[i + 3] = a[i + 3] OP y[3];                             \
+            }                                                              \
+        } else {                                                           \
+            for (i = 0; i < n_words; ++i) {                                \
+                out[i] = a[i] OP b[i];                                     \
+            }                                                              \
+        }                                                                  \
+    } while (0)
+
+MANY_TARGET_CLONES
+static void bitwise_many(const uint64_t *a,
+                         const uint64_t *b,
+                         size_t n_words,
+                         int broadcast,
+                         int op,
+                         uint64_t *out) {
+    uint64_t y[4];
+    size_t i;
+
+    memcpy(y, b, sizeof(y));
+    if (op == MANY_AND) {
+        BITWISE_LOOP(&);
+    } else if (op == MANY_OR) {
+        BITWISE_LOOP(|);
+    } else {
+        BITWISE_LOOP(^);
+    }
+}
+
+#undef BITWISE_LOOP
+
+/* Word-aligned buffers (bytes and bytearray data always are) take the
+ * word kernel; anything else, e.g. an odd memoryview slice, goes byte by
+ * byte. */
+static void bitwise_many_buffers(const Py_buffer *lhs,
+                                 const Py_buffer *rhs,
+                                 Py_ssize_t n,
+                                 int op,
+                                 uint8_t *out) {
+    const uint8_t *a = (const uint8_t *)lhs->buf;
+    const uint8_t *b = (const uint8_t *)rhs->buf;
+    int broadcast = rhs->len != lhs->len;
+    Py_ssize_t i;
+
+    if ((((uintptr_t)a | (uintptr_t)b | (uintptr_t)out) % sizeof(uint64_t)) == 0) {
+        bitwise_many((const uint64_t *)a, (const uint64_t *)b, (size_t)n * (U256_BYTES / 8),
+                     broadcast, op, (uint64_t *)out);
+        return;
+    }
+    for (i = 0; i < n * U256_BYTES; ++i) {
+        uint8_t y = b[broadcast ? i % U256_BYTES : i];
+        out[i] = op == MANY_AND ? a[i] & y : op == MANY_OR ? a[i] | y : a[i] ^ y;
+    }
+}
+
+static PyObject *bitwise_many_py(PyObject *args, const char *format, int op) {
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    Py_ssize_t n;
+    PyObject *out;
+
+    if (!PyArg_ParseTuple(args, format, &lhs_obj, &rhs_obj)) {
+        return NULL;
+    }
+    if (parse_many(lhs_obj, rhs_obj, &lhs, &rhs, &n) != 0) {
+        return NULL;
+    }
+    out = PyBytes_FromStringAndSize(NULL, n * U256_BYTES);
+    if (out != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        bitwise_many_buffers(&lhs, &rhs, n, op, (uint8_t *)PyBytes_AS_STRING(out));
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+    return out;
+}
+
+static PyObject *py_u256_and_many(PyObject *self, PyObject *args) {
+    (void)self;
+    return bitwise_many_py(args, "OO:u256_and_many", MANY_AND);
+}
+
+static PyObject *py_u256_or_many(PyObject *self, PyObject *args) {
+    (void)self;
+    return bitwise_many_py(args, "OO:u256_or_many", MANY_OR);
+}
+
+static PyObject *py_u256_xor_many(PyObject *self, PyObject *args) {
+    (void)self;
+    return bitwise_many_py(args, "OO:u256_xor_many", MANY_XOR);
+}
+
+/* Full 512-bit products of n value pairs, by product scanning: column k
+ * of the result sums the 128-bit products x[i] * y[k - i] into a
+ * three-word accumulator, so every word of the result is written once. */
+static void mul_many(const Py_buffer *lhs, const Py_buffer *rhs, Py_ssize_t n, uint8_t *out) {
+    enum { W = U256_BYTES / 8 };
+    Py_ssize_t idx;
+    int i;
+    int k;
+
+    for (idx = 0; idx < n; ++idx) {
+        const uint8_t *a = (const uint8_t *)lhs->buf + idx * U256_BYTES;
+        const uint8_t *b = many_rhs(rhs, idx);
+        uint8_t *res = out + idx * ACC_BYTES;
+        uint64_t x[W];
+        uint64_t y[W];
+        uint64_t c0 = 0;
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+
+        for (i = 0; i < W; ++i) {
+            x[i] = load_le64(a + 8 * i);
+            y[i] = load_le64(b + 8 * i);
+        }
+        for (k = 0; k < 2 * W - 1; ++k) {
+            int lo_i = k < W ? 0 : k - W + 1;
+            int hi_i = k < W ? k : W - 1;
+            for (i = lo_i; i <= hi_i; ++i) {
+                uint64_t lo;
+                uint64_t hi;
+                mul_64x64(x[i], y[k - i], &lo, &hi);
+                c0 += lo;
+                hi += c0 < lo;
+                c1 += hi;
+                c2 += c1 < hi;
+            }
+            store_le64(res + 8 * k, c0);
+            c0 = c1;
+            c1 = c2;
+            c2 = 0;
+        }
+        store_le64(res + 8 * (2 * W - 1), c0);
+    }
+}
+
+static PyObject *py_u256_mul_many(PyObject *self, PyObject *args) {
+    PyObject *lhs_obj;
+    PyObject *rhs_obj;
+    Py_buffer lhs;
+    Py_buffer rhs;
+    Py_ssize_t n;
+    PyObject *out;
+
+    (void)self;
+
+    if (!PyArg_ParseTuple(args, "OO:u256_mul_many", &lhs_obj, &rhs_obj)) {
+        return NULL;
+    }
+    if (parse_many(lhs_obj, rhs_obj, &lhs, &rhs, &n) != 0) {
+        return NULL;
+    }
+    out = PyBytes_FromStringAndSize(NULL, n * ACC_BYTES);
+    if (out != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        mul_many(&lhs, &rhs, n, (uint8_t *)PyBytes_AS_STRING(out));
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&lhs);
+    PyBuffer_Release(&rhs);
+    return out;
+}
+
+/* Text image parsers.  They turn hex dumps into packed buffers without
+ * creating a Python object per line; only whole lines are consumed, so a
+ * caller can feed a large file chunk by chunk and carry the tail over. */
+
+static int hex_digit(int c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static int is_space(int c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* Parse one DMEM line "[addr:] w7 w6 ... w0" (eight words, 64 hex digits
+ * in total, most significant first) into a little-endian 256-bit cell. */
+static int parse_dmem_line(const char *p, const char *end, long line, uint8_t *cell) {
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+    uint8_t digits[2 * U256_BYTES];
+    int n_digits = 0;
+    int n_words = 0;
+    int in_word = 0;
+    int i;
+
+    if (colon != NULL) {
+        long addr = 0;
+        int any = 0;
+        while (p < colon && is_space(*p)) {
+            ++p;
+        }
+        while (p < colon && *p >= '0' && *p <= '9') {
+            addr = addr * 10 + (*p++ - '0');
+            any = 1;
+            if (addr > line) {
+                break;
+            }
+        }
+        while (p < colon && is_space(*p)) {
+            ++p;
+        }
+        if (!any || p != colon || addr != line) {
+            PyErr_Format(PyExc_ValueError,
+                         "Error in Dmem file line %ld (non continues mem files currently not supported)",
+                         line + 1);
+            return -1;
+        }
+        p = colon + 1;
+    }
+    for (; p < end; ++p) {
+        int d;
+        if (is_space(*p)) {
+            in_word = 0;
+            continue;
+        }
+        if (!in_word) {
+            in_word = 1;
+            ++n_words;
+        }
+        d = hex_digit(*p);
+        if (d < 0 || n_digits == 2 * U256_BYTES) {
+            n_digits = -1;
+            break;
+        }
+        digits[n_digits++] = (uint8_t)d;
+    }
+    if (n_words != 8) {
+        PyErr_Format(PyExc_ValueError,
+                     "Error in Dmem file line %ld 8 32-bit words expected per line",
+                     line + 1);
+        return -1;
+    }
+    if (n_digits != 2 * U256_BYTES) {
+        PyErr_Format(PyExc_ValueError,
+                     "Error in Dmem file line %ld. Expecting data 32 bytes per line",
+                     line + 1);
+        return -1;
+    }
+    for (i = 0; i < U256_BYTES; ++i) {
+        cell[i] = (uint8_t)(digits[2 * U256_BYTES - 2 - 2 * i] << 4 |
+                            digits[2 * U256_BYTES - 1 - 2 * i]);
+    }
+    return 0;
+}
+
+/* parse_dmem_hex(data, first_line=0, final=True) -> (image, lines, consumed)
+ *
+ * Packs the DMEM init lines of data into image (32 bytes per line).  A
+ * line without its newline is only parsed when final is set; consumed
+ * is the number of bytes of data used. */
+static PyObject *py_parse_dmem_hex(PyObject *self, PyObject *args) {
+    PyObject *data_obj;
+    long first_line = 0;
+    int final = 1;
+    Py_buffer data;
+    const char *p;
+    const char *end;
+    Py_ssize_t max_lines = 0;
+    Py_ssize_t i;
+    long line;
+    PyObject *image;
+    uint8_t *out;
+
+    (void)self;
+
+    if (!PyArg_ParseTuple(args, "O|lp:parse_dmem_hex", &data_obj, &first_line, &final)) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(data_obj, &data, PyBUF_CONTIG_RO) != 0) {
+        return NULL;
+    }
+    p = (const char *)data.buf;
+    end = p + data.len;
+    for (i = 0; i < data.len; ++i) {
+        max_lines += p[i] == '\n';
+    }
+    image = PyBytes_FromStringAndSize(NULL, (max_lines + 1) * U256_BYTES);
+    if (image == NULL) {
+        PyBuffer_Release(&data);
+        return NULL;
+    }
+    out = (uint8_t *)PyBytes_AS_STRING(image);
+    line = first_line;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (eol == NULL && !final) {
+            break;
+        }
+        if (eol == NULL) {
+            eol = end;
+        }
+        if (parse_dmem_line(p, eol, line, out + (line - first_line) * U256_BYTES) != 0) {
+            Py_DECREF(image);
+            PyBuffer_Release(&data);
+            return NULL;
+        }
+        ++line;
+        p = eol < end ? eol + 1 : end;
+    }
+    i = p - (const char *)data.buf;
+    PyBuffer_Release(&data);
+    if (_PyBytes_Resize(&image, (line - first_line) * U256_BYTES) != 0) {
+        return NULL;
+    }
+    return Py_BuildValue("Nln", image, line - first_line, i);
+}
+
+/* parse_hex_words(data) -> bytes of little-endian 32-bit words
+ *
+ * Instruction words of a .hex program: every line "[addr:] 0xXXXXXXXX",
+ * other lines are skipped like the disassembler does. */
+static PyObject *py_parse_hex_words(PyObject *self, PyObject *args) {
+    PyObject *data_obj;
+    Py_buffer data;
+    const char *p;
+    const char *end;
+    Py_ssize_t max_words = 0;
+    Py_ssize_t n = 0;
+    Py_ssize_t i;
+    long line = 0;
+    PyObject *words;
+    uint8_t *out;
+
+    (void)self;
+
+    if (!PyArg_ParseTuple(args, "O:parse_hex_words", &data_obj)) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(data_obj, &data, PyBUF_CONTIG_RO) != 0) {
+        return NULL;
+    }
+    p = (const char *)data.buf;
+    end = p + data.len;
+    for (i = 0; i < data.len; ++i) {
+        max_words += p[i] == '\n';
+    }
+    words = PyBytes_FromStringAndSize(NULL, (max_words + 1) * 4);
+    if (words == NULL) {
+        PyBuffer_Release(&data);
+        return NULL;
+    }
+    out = (uint8_t *)PyBytes_AS_STRING(words);
+    for (; p < end; ++line) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        const char *colon;
+        uint32_t word = 0;
+        if (eol == NULL) {
+            eol = end;
+        }
+        colon = memchr(p, ':', (size_t)(eol - p));
+        if (colon != NULL) {
+            p = colon + 1;
+        }
+        while (p < eol && is_space(*p)) {
+            ++p;
+        }
+        if (eol - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') {
+            for (i = 2; i < 10; ++i) {
+                int d = p + i < eol ? hex_digit(p[i]) : -1;
+                if (d < 0) {
+                    PyErr_Format(PyExc_ValueError,
+                                 "line %ld: instruction word must be 8 hex digits", line + 1);
+                    Py_DECREF(words);
+                    PyBuffer_Release(&data);
+                    return NULL;
+                }
+                word = word << 4 | (uint32_t)d;
+            }
+            out[4 * n] = (uint8_t)word;
+            out[4 * n + 1] = (uint8_t)(word >> 8);
+            out[4 * n + 2] = (uint8_t)(word >> 16);
+            out[4 * n + 3] = (uint8_t)(word >> 24);
+            ++n;
+        }
+        p = eol < end ? eol + 1 : end;
+    }
+    PyBuffer_Release(&data);
+    if (_PyBytes_Resize(&words, n * 4) != 0) {
+        return NULL;
+    }
+    return words;
+}
+
 static PyMethodDef module_methods[] = {
     {"u256_add", py_u256_add, METH_VARARGS, "Add two little-endian 256-bit values."},
     {"u256_sub", py_u256_sub, METH_VARARGS, "Subtract two little-endian 256-bit values."},
@@ -585,6 +1403,18 @@ static PyMethodDef module_methods[] = {
     {"u256_set_limb", py_u256_set_limb, METH_VARARGS, "Write a 32-bit limb into a 256-bit value."},
     {"u256_set_half_limb", py_u256_set_half_limb, METH_VARARGS, "Write a 16-bit half-limb into a 256-bit value."},
     {"u256_set_half_word", py_u256_set_half_word, METH_VARARGS, "Write a 128-bit half-word into a 256-bit value."},
+    {"u256_mulqacc", py_u256_mulqacc, METH_VARARGS, "Add a shifted 64x64-bit quarter-word product to a 512-bit accumulator."},
+    {"u256_mulqacc_so", py_u256_mulqacc_so, METH_VARARGS, "Multiply-accumulate, then shift the lower 128 bits out of the accumulator."},
+    {"u256_mulh", py_u256_mulh, METH_VARARGS, "Multiply two 128-bit half-words of 256-bit values."},
+    {"u256_add_many", py_u256_add_many, METH_VARARGS, "Add buffers of 256-bit values; returns (sums, carries)."},
+    {"u256_sub_many", py_u256_sub_many, METH_VARARGS, "Subtract buffers of 256-bit values; returns (differences, borrows)."},
+    {"u256_cmp_many", py_u256_cmp_many, METH_VARARGS, "Compare buffers of 256-bit values; returns signed bytes."},
+    {"u256_and_many", py_u256_and_many, METH_VARARGS, "Bitwise and for buffers of 256-bit values."},
+    {"u256_or_many", py_u256_or_many, METH_VARARGS, "Bitwise or for buffers of 256-bit values."},
+    {"u256_xor_many", py_u256_xor_many, METH_VARARGS, "Bitwise xor for buffers of 256-bit values."},
+    {"u256_mul_many", py_u256_mul_many, METH_VARARGS, "Multiply buffers of 256-bit values into 512-bit products."},
+    {"parse_dmem_hex", py_parse_dmem_hex, METH_VARARGS, "Pack DMEM init file lines into 256-bit cells; returns (image, lines, consumed)."},
+    {"parse_hex_words", py_parse_hex_words, METH_VARARGS, "Pack the instruction words of a .hex program into 32-bit words."},
     {NULL, NULL, 0, NULL},
 };
 
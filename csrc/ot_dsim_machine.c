@@ -4,8 +4,13 @@
  * Implements the Machine state (registers, flags, DMEM, IMEM references,
  * loop/call stacks) entirely in C and exposes it as a CPython extension type.
  *
- * The instruction decode/execute layer stays in Python but calls into this
- * fast C machine for all state access (the hot path).
+ * Instruction objects are decoded once into a table of native ops
+ * (MicroOp, see "Decoded instruction table") that machines running the
+ * same Program share.
+ * run() and step() execute that table with C kernels: basic blocks,
+ * fused superinstructions and whole routines, with the GIL released on
+ * request.  Instructions without a kernel are executed by calling their
+ * Python execute(), which reaches the state through the methods below.
  *
  * Copyright lowRISC contributors.
  * Licensed under the Apache License, Version 2.0, see LICENSE for details.
@@ -17,18 +22,48 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 /* ------------------------------------------------------------------ */
 /* Constants matching machine.py                                       */
 /* ------------------------------------------------------------------ */
 
+/* The memory sizes are fixed per build so every loop over them stays
+ * constant-bound.  setup.py builds the default _machine and specialized
+ * variants (OT_DSIM_MACHINE_VARIANT) under their own module names; the
+ * variants share _machine's Program and CallStackUnderrun. */
+#ifndef OT_DSIM_MACHINE_NAME
+#define OT_DSIM_MACHINE_NAME _machine
+#endif
+#ifndef DMEM_DEPTH
+#define DMEM_DEPTH     128
+#endif
+#ifndef IMEM_DEPTH
+#define IMEM_DEPTH     1024
+#endif
+#if (DMEM_DEPTH & (DMEM_DEPTH - 1)) || (IMEM_DEPTH % 64)
+#error "DMEM_DEPTH must be a power of two and IMEM_DEPTH a multiple of 64"
+#endif
+
+#define OT_STR_(x)     #x
+#define OT_STR(x)      OT_STR_(x)
+#define OT_CAT_(a, b)  a##b
+#define OT_CAT(a, b)   OT_CAT_(a, b)
+#define MODULE_NAME    OT_STR(OT_DSIM_MACHINE_NAME)
+
 #define NUM_REGS       32
 #define NUM_GPRS       32
 #define XLEN           256
 #define GPR_WIDTH      32
 #define LIMBS          8
-#define DMEM_DEPTH     128
-#define IMEM_DEPTH     1024
 #define LOOP_STACK_SZ  16
 #define CALL_STACK_SZ  16
 
@@ -38,14 +73,30 @@
 #define QW_BITS        (XLEN / 4)       /* 64 */
 #define HW_BITS        (XLEN / 2)       /* 128 */
 
-/* Python int masks are computed in __init__ and cached as PyObject* */
+/* The Python Machine lets the accumulator grow past XLEN between
+ * shift-outs, so the native accumulator carries extra headroom. */
+#define ACC_LIMBS      (LIMBS * 2)
+/* Flag operands are XLEN + 1 bits wide (carry-out in bit XLEN). */
+#define FLAG_LIMBS     (LIMBS + 1)
+/* Valid half-limb mask of a fully written register (one bit per half limb) */
+#define VALID_HALF_LIMBS_ALL ((uint16_t)((1u << (LIMBS * 2)) - 1))
+
+/* Bit of each flag in CMachine.flags, which uses the get_flags_as_bin()
+ * (and CSR_FLAG) layout: the standard group in the low nibble, the
+ * extension group (FG1) in the high one. */
+enum { FLAG_C, FLAG_L, FLAG_M, FLAG_Z, FLAG_XC, FLAG_XL, FLAG_XM, FLAG_XZ };
+#define FLAG_GROUP_SHIFT(fg) ((fg) ? FLAG_XC : FLAG_C)
+
+/* Python int masks are computed once at module init (see make_mask) */
 
 #define CSR_FLAG     0x7C0
 #define CSR_MOD_BASE 0x7D0
 #define CSR_RNG      0xFC0
 #define WSR_MOD      0
 #define WSR_RND      1
-#define OT_DSIM_MACHINE_ABI_VERSION 1
+#define OT_DSIM_MACHINE_ABI_VERSION 16
+
+#define RND_DEFAULT_LIMB 0x99999999U
 
 /* ------------------------------------------------------------------ */
 /* Loop-stack entry                                                    */
@@ -56,39 +107,206 @@ typedef struct {
     long start_addr;
 } LoopEntry;
 
+/* ------------------------------------------------------------------ */
+/* Decoded instruction (see "Decoded instruction table" below)         */
+/* ------------------------------------------------------------------ */
+/* Native kernels; field use per op is documented with the table. */
+enum {
+    OP_PYTHON = 0,
+    /* OTBN bignum */
+    OP_BN_ADD, OP_BN_ADDC, OP_BN_ADDI, OP_BN_ADDM,
+    OP_BN_SUB, OP_BN_SUBB, OP_BN_SUBI, OP_BN_SUBM,
+    OP_BN_CMP, OP_BN_CMPB,
+    OP_BN_MULQACC, OP_BN_MULQACC_Z, OP_BN_MULQACC_SO, OP_BN_MULH,
+    OP_BN_AND, OP_BN_OR, OP_BN_XOR, OP_BN_NOT, OP_BN_RSHI, OP_BN_SEL,
+    OP_BN_MOV, OP_BN_MOVR, OP_BN_LID, OP_BN_SID,
+    OP_BN_WSRRS, OP_BN_WSRRW,
+    /* OTBN base */
+    OP_LOOP, OP_LOOPI,
+    OP_ADD, OP_ADDI, OP_SUB, OP_AND, OP_ANDI, OP_OR, OP_ORI,
+    OP_XOR, OP_XORI, OP_SLLI, OP_LUI, OP_LI,
+    OP_LW, OP_SW, OP_CSRRS, OP_CSRRW,
+    OP_BEQ, OP_BNE, OP_JAL, OP_JALR, OP_RET, OP_ECALL, OP_NOP,
+    /* dcrypto */
+    OP_DC_ADD, OP_DC_ADDC, OP_DC_ADDI, OP_DC_ADDX, OP_DC_ADDCX,
+    OP_DC_SUB, OP_DC_SUBB, OP_DC_SUBI, OP_DC_SUBX, OP_DC_SUBBX,
+    OP_DC_ADDM, OP_DC_SUBM, OP_DC_CMP, OP_DC_CMPBX,
+    OP_DC_LDRFP, OP_DC_LDLC, OP_DC_LDDMP, OP_DC_STDMP,
+    OP_DC_LDMOD, OP_DC_STMOD, OP_DC_LDRND, OP_DC_STRND,
+    OP_DC_LDI, OP_DC_STI, OP_DC_LDR, OP_DC_LD, OP_DC_ST, OP_DC_MOVI,
+    OP_DC_B, OP_DC_CALL, OP_DC_LOOP,
+    NUM_OPCODES
+};
+
+typedef struct {
+    PyObject *instr;    /* imem entry this op was decoded from (owned) */
+    uint16_t opcode;    /* OP_PYTHON: run instr.execute() */
+    uint8_t fg;
+    uint8_t rd, rs1, rs2;
+    uint8_t routine;    /* ROUTINE_* kernel of a fuse run, see link_routines() */
+    int32_t shift;      /* shift and aux are small; int32 keeps an op */
+    int32_t aux;        /* within one cache line */
+    long imm;
+    long cycles;
+    PyObject *stat_key; /* instruction_histo key, computed on flush */
+
+    /* Basic-block links (see link_blocks()) */
+    uint32_t block_len; /* straight-line native ops starting here */
+    uint32_t fuse;      /* ops of the superinstruction starting here */
+
+    /* Registers read through operand fields (see op_read_sets()) */
+    uint32_t reads_wdr;
+    uint32_t reads_gpr;
+} MicroOp;
+
+/* Per-opcode cycle table with stall rules (see "Timing models") */
+typedef struct {
+    int active;
+    long cycles[NUM_OPCODES];
+    uint8_t has[NUM_OPCODES];   /* cycles[] overrides get_cycles() */
+    long load_use;              /* op reads a register the previous op loaded */
+    long acc_use;               /* op accumulates onto the previous op's ACC */
+    long dmem_wait;             /* per DMEM access */
+    PyObject *spec;             /* dict it was built from, or NULL */
+} TimingModel;
+
+/* Per-machine execution statistics of one imem slot (see "Statistics") */
+typedef struct {
+    uint64_t exec_count;
+    uint64_t cycle_count;
+    uint64_t flushed;       /* part of exec_count already in the histo */
+} SlotCounts;
+
+/* Profile call-path tree node (see "Profiler") */
+typedef struct {
+    long func;              /* entry address */
+    Py_ssize_t parent;      /* -1 for the root */
+    Py_ssize_t child;       /* first child, -1 if none */
+    Py_ssize_t sibling;     /* next child of parent, -1 if none */
+    uint64_t calls;
+    uint64_t cycles;        /* exclusive */
+} ProfNode;
+
+typedef struct {
+    uint64_t entries;
+    uint64_t iterations;
+    uint64_t cycles;        /* inclusive */
+} ProfLoop;
+
+typedef struct {
+    long addr;              /* address of the LOOP instruction */
+    uint64_t start;         /* prof_cycles when entered */
+} ProfLoopFrame;
+
+/* Hot-path performance counters (see "Performance counters") */
+typedef struct {
+    uint64_t native_base;       /* opcode_counts[] totals at the last reset */
+    uint64_t python_base;
+    uint64_t superinstructions;
+    uint64_t fused_ops;
+    uint64_t blocks;
+    uint64_t block_ops;
+    uint64_t bp_checks;
+    uint64_t trace_bytes;
+    uint64_t dmem_op_bytes;
+    uint64_t dmem_host_bytes;
+    uint64_t pylongs;
+    uint64_t decode_ns;
+    uint64_t run_ns;
+    uint64_t readback_ns;
+    uint64_t routines;
+    uint64_t lane_ops;
+} PerfCounters;
+
+/* Shared decoded imem (see "Program images") */
+typedef struct {
+    PyObject_HEAD
+    PyObject *instrs;   /* tuple of instruction objects, patched in place:
+                         * only copies of it are handed out */
+    PyObject *ctx;
+    MicroOp *ops;
+    Py_ssize_t n_ops;
+    TimingModel timing;
+    uint64_t decode_ns;         /* spent decoding instrs */
+    Py_ssize_t running;         /* machines in run(release_gil=True) on it */
+} ProgramObject;
+
+/* Growable array of fixed-size statistics records */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} EventBuf;
+
+/* Events recorded by the native kernels borrow module-level objects
+ * (owned == 0) so recording them needs no reference counting. */
+typedef struct {
+    PyObject *flag_group;
+    PyObject *op;
+    int owned;
+} FlagAccessEvent;
+
+typedef struct {
+    PyObject *op;
+    PyObject *inc_src;
+    PyObject *inc_dst;
+    int owned;
+} WideMemEvent;
+
+typedef struct {
+    long call_site;
+    long callee_func;
+} FuncCallEvent;
+
+typedef struct {
+    long loop_addr;
+    long loop_len;
+    long new_loop_stack_depth;
+    long iterations;
+} LoopEvent;
+
 /* ------------------------------------------------------------------ */
 /* CMachine type                                                       */
 /* ------------------------------------------------------------------ */
 typedef struct {
     PyObject_HEAD
 
-    /* Wide data registers (WDRs): stored as Python ints for 256-bit width */
-    PyObject *r[NUM_REGS];          /* r0..r31 */
-    PyObject *mod;
-    PyObject *dmp;
-    PyObject *rfp;
-    PyObject *lc;
-    PyObject *rnd;
-    PyObject *acc;
+    /* Wide data registers (WDRs): 32-bit limbs, least significant first.
+     * Python ints are only created when a value is read from Python. */
+    uint32_t r[NUM_REGS][LIMBS];    /* r0..r31 */
+    uint32_t mod[LIMBS];
+    uint32_t dmp[LIMBS];
+    uint32_t rfp[LIMBS];
+    uint32_t lc[LIMBS];
+    uint32_t rnd[LIMBS];
+    uint32_t acc[ACC_LIMBS];
 
     /* GPRs (32-bit) */
     long gpr[NUM_GPRS];
 
-    /* Flags */
-    int M, L, Z, C;
-    int XM, XL, XZ, XC;
+    /* Flags, packed (see FLAG_C) */
+    uint8_t flags;
 
     /* Program counter */
     long pc;
     long stop_addr;
     int finishFlag;
 
-    /* DMEM: stored as Python list (elements are Python ints for 256-bit) */
-    PyObject *dmem;       /* Python list */
-    PyObject *init_dmem;  /* Python list of bools */
+    /* DMEM: one limb array per 256-bit cell */
+    uint32_t dmem[DMEM_DEPTH][LIMBS];
+    uint8_t init_dmem[DMEM_DEPTH];
 
-    /* IMEM: Python list (instruction objects) */
+    /* IMEM: Python list of instruction objects, or the tuple of program */
     PyObject *imem;
+    PyObject *program;          /* shared Program, or NULL */
+
+    /* IMEM decoded into native ops, one per entry; borrowed from
+     * program when there is one */
+    MicroOp *ops;
+    Py_ssize_t n_ops;
+    SlotCounts *counts;         /* n_ops entries */
+    PyObject *counts_arena;     /* a MachinePool's arena holding counts, or NULL */
+    int running;                /* inside run(), see machine_idle_check() */
 
     /* Loop stack */
     LoopEntry loop_stack[LOOP_STACK_SZ];
@@ -98,20 +316,15 @@ typedef struct {
     long call_stack[CALL_STACK_SZ];
     int call_sp;
 
-    /* Valid half-limb tracking per register */
-    /* r_valid_half_limbs[reg][half_limb] */
-    int r_valid_half_limbs[NUM_REGS][LIMBS * 2];
-
-    /* Precomputed masks (Python ints) */
-    PyObject *xlen_mask;     /* (1<<256)-1 */
-    PyObject *limb_mask;     /* (1<<32)-1  */
-    PyObject *half_limb_mask;/* (1<<16)-1  */
-    PyObject *hw_mask;       /* (1<<128)-1 */
-    PyObject *qw_mask;       /* (1<<64)-1  */
-    PyObject *gpr_mask;      /* (1<<32)-1  */
+    /* Valid half-limb tracking per register: bit j of
+     * r_valid_half_limbs[reg] is set once half limb j was written */
+    uint16_t r_valid_half_limbs[NUM_REGS];
 
-    /* Breakpoints dict: addr -> (passes, counter) */
-    PyObject *breakpoints;
+    /* Breakpoints (see "Breakpoint operations") */
+    uint64_t bp_map[IMEM_DEPTH / 64];
+    long bp_passes[IMEM_DEPTH];
+    long bp_count[IMEM_DEPTH];
+    int n_breakpoints;
 
     /* Force-break state */
     int fb_active;
@@ -120,12 +333,66 @@ typedef struct {
     int fb_consider_loopstack;
     long fb_loopstack;
 
+    /* Set when run() stopped at a breakpoint; the next step()/run()
+     * executes that instruction without breaking again. */
+    int break_resume;
+
     /* Context (assembler context, may be None) */
     PyObject *ctx;
 
     /* Stats dict */
     PyObject *stats;
 
+    /* Executions per decoded opcode over the machine's lifetime */
+    uint64_t opcode_counts[NUM_OPCODES];
+
+    /* Statistics recorded since the last flush into stats */
+    EventBuf exec_order;        /* Py_ssize_t slots with unflushed counts */
+    EventBuf flag_events;
+    EventBuf wide_mem_events;
+    EventBuf func_call_events;
+    EventBuf loop_events;
+    uint64_t movi_counts[XLEN + 1];
+
+    /* Binary trace (see "Binary trace" below) */
+    int trace_active;
+    uint8_t *trace_buf;         /* ring of trace_cap records */
+    size_t trace_cap;
+    uint64_t trace_count;       /* records produced since enable_trace() */
+    FILE *trace_file;           /* records go here instead when set */
+    uint32_t trace_r[NUM_REGS][LIMBS];  /* register state of the last record */
+    long trace_gpr[NUM_GPRS];
+
+    /* Profile (see "Profiler") */
+    int prof_active;
+    ProfNode *prof_nodes;
+    Py_ssize_t prof_n, prof_cap;
+    Py_ssize_t prof_node;       /* node of the running function */
+    int prof_depth;             /* call_sp it corresponds to */
+    int prof_loop_depth;
+    ProfLoopFrame prof_loop_frames[LOOP_STACK_SZ];
+    ProfLoop *prof_loops;       /* prof_n_loops entries, by address */
+    Py_ssize_t prof_n_loops;
+    uint64_t prof_cycles;
+    long prof_root_pc;
+
+    /* Timing model and the hazards the last op left for the next one */
+    TimingModel timing;
+    uint32_t hz_wdr;
+    uint32_t hz_gpr;
+    int hz_acc;
+
+    /* Write watchpoints (see "Watchpoints") */
+    uint64_t watch_dmem[(DMEM_DEPTH + 63) / 64];
+    uint32_t watch_wdr;
+    int n_watch;
+    int watch_kind;             /* WATCH_NONE until one fired in run() */
+    long watch_index;
+    long watch_pc;
+
+    /* Performance counters since creation or reset_perf_counters() */
+    PerfCounters perf;
+
     /* Limb/half/qw widths (as C ints for fast access) */
     int limb_width;
     int half_limb_width;
@@ -136,6 +403,94 @@ typedef struct {
 /* Forward declarations */
 static PyTypeObject CMachineType;
 static PyObject *CallStackUnderrun;
+static int load_imem(CMachine *self, PyObject *imem);
+static Py_ssize_t imem_len(CMachine *self);
+static void free_ops(CMachine *self);
+static int stats_flush(CMachine *self);
+static int flush_histo(CMachine *self);
+static void stats_clear(CMachine *self);
+static void event_free(EventBuf *buf);
+static void trace_close(CMachine *self);
+static void bp_set(CMachine *self, long addr, long passes, long count);
+static void bp_clear_all(CMachine *self);
+static int resolve_bp_addr(CMachine *self, PyObject *bp, long *addr);
+static int prof_account(CMachine *self, Py_ssize_t addr, long cycles);
+static void prof_free(CMachine *self);
+static int timing_parse(PyObject *spec, TimingModel *tm);
+static long dc_ptr(const uint32_t *preg, int field, long mask);
+static void timing_copy(TimingModel *dst, const TimingModel *src);
+static void put_le16(uint8_t *p, uint32_t v);
+static void put_le32(uint8_t *p, uint32_t v);
+
+/* The native kernels may run with the GIL released (run(release_gil=True)),
+ * so everything they call raises through raise_error(), which takes the
+ * GIL for as long as it needs it.  Costs nothing but bookkeeping when the
+ * GIL is already held. */
+static void raise_error(PyObject *type, const char *fmt, ...) {
+    PyGILState_STATE gil = PyGILState_Ensure();
+    va_list vargs;
+    va_start(vargs, fmt);
+    PyErr_FormatV(type, fmt, vargs);
+    va_end(vargs);
+    PyGILState_Release(gil);
+}
+
+/* Monotonic clock of the perf_counters() phase timers, in ns */
+static uint64_t perf_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Index of the lowest set bit of a non-zero word */
+static int ctz64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long idx;
+    _BitScanForward64(&idx, word);
+    return (int)idx;
+#else
+    int n = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+/* Watchpoints                                                         */
+/* ------------------------------------------------------------------ */
+/* Writes to a watched DMEM cell or WDR record the first hit; run()
+ * stops after the instruction that made it. */
+enum { WATCH_NONE, WATCH_DMEM, WATCH_WDR };
+
+static void watch_hit(CMachine *self, int kind, long index) {
+    if (self->watch_kind != WATCH_NONE)
+        return;
+    self->watch_kind = kind;
+    self->watch_index = index;
+    self->watch_pc = self->pc;
+}
+
+static inline void watch_dmem_write(CMachine *self, long address) {
+    if (self->n_watch && (self->watch_dmem[address / 64] >> (address % 64)) & 1)
+        watch_hit(self, WATCH_DMEM, address);
+}
+
+static inline void watch_wdr_write(CMachine *self, long idx) {
+    if (self->n_watch && idx >= 0 && (self->watch_wdr >> idx) & 1)
+        watch_hit(self, WATCH_WDR, idx);
+}
 
 /* ------------------------------------------------------------------ */
 /* Helper: create Python int mask for N bits                           */
@@ -151,150 +506,237 @@ static PyObject *make_mask(int bits) {
     return result;
 }
 
-/* Helper: Python int zero */
-static PyObject *py_zero(void) {
-    return PyLong_FromLong(0);
-}
-
-/* Helper: extract 32-bit limb from Python int value */
-static long extract_limb(PyObject *val, int lidx) {
-    /* (val >> (lidx * 32)) & 0xFFFFFFFF */
-    PyObject *shift = PyLong_FromLong(lidx * LIMB_BITS);
-    PyObject *shifted = PyNumber_Rshift(val, shift);
-    PyObject *mask = PyLong_FromUnsignedLong(0xFFFFFFFFUL);
-    PyObject *result = PyNumber_And(shifted, mask);
-    long ret = PyLong_AsLong(result);
-    Py_DECREF(shift);
-    Py_DECREF(shifted);
-    Py_DECREF(mask);
-    Py_DECREF(result);
-    return ret;
+/* Masks behind the *_mask properties, shared by every machine */
+static PyObject *xlen_mask;         /* (1<<XLEN)-1 */
+static PyObject *limb_mask;         /* (1<<32)-1   */
+static PyObject *half_limb_mask;    /* (1<<16)-1   */
+static PyObject *hw_mask;           /* (1<<128)-1  */
+static PyObject *qw_mask;           /* (1<<64)-1   */
+static PyObject *gpr_mask;          /* (1<<32)-1   */
+
+static int masks_init_module(void) {
+    if (!(xlen_mask = make_mask(XLEN)) || !(limb_mask = make_mask(LIMB_BITS)) ||
+        !(half_limb_mask = make_mask(HALF_LIMB_BITS)) || !(hw_mask = make_mask(HW_BITS)) ||
+        !(qw_mask = make_mask(QW_BITS)) || !(gpr_mask = make_mask(GPR_WIDTH)))
+        return -1;
+    return 0;
 }
 
-/* Helper: modify a limb in a Python int value, return new Python int (new ref) */
-static PyObject *modify_limb(PyObject *val, int lidx, long limbval, PyObject *xlen_mask_obj) {
-    int shift_amt = lidx * LIMB_BITS;
-    PyObject *shift = PyLong_FromLong(shift_amt);
-    PyObject *limb_mask_py = PyLong_FromUnsignedLong(0xFFFFFFFFUL);
-
-    /* clear_mask = ~(limb_mask << shift) & xlen_mask */
-    PyObject *shifted_mask = PyNumber_Lshift(limb_mask_py, shift);
-    PyObject *inv = PyNumber_Invert(shifted_mask);
-    PyObject *clear_mask = PyNumber_And(inv, xlen_mask_obj);
-
-    /* cleared = val & clear_mask */
-    PyObject *cleared = PyNumber_And(val, clear_mask);
-
-    /* new_bits = limbval << shift */
-    PyObject *limb_py = PyLong_FromLong(limbval);
-    PyObject *new_bits = PyNumber_Lshift(limb_py, shift);
-
-    /* result = cleared | new_bits */
-    PyObject *result = PyNumber_Or(cleared, new_bits);
+/* ------------------------------------------------------------------ */
+/* Limb array <-> Python int conversion                                */
+/* ------------------------------------------------------------------ */
 
-    Py_DECREF(shift);
-    Py_DECREF(limb_mask_py);
-    Py_DECREF(shifted_mask);
-    Py_DECREF(inv);
-    Py_DECREF(clear_mask);
-    Py_DECREF(cleared);
-    Py_DECREF(limb_py);
-    Py_DECREF(new_bits);
+#if PY_VERSION_HEX >= 0x030D0000
+#define OT_LONG_AS_BYTES(v, buf, n, is_signed) \
+    _PyLong_AsByteArray((PyLongObject *)(v), (buf), (n), 1, (is_signed), 1)
+#else
+#define OT_LONG_AS_BYTES(v, buf, n, is_signed) \
+    _PyLong_AsByteArray((PyLongObject *)(v), (buf), (n), 1, (is_signed))
+#endif
+
+/* New reference to the Python int held in n little-endian limbs. */
+static PyObject *limbs_to_pylong(const uint32_t *limbs, int n) {
+    unsigned char buf[ACC_LIMBS * 4];
+    for (int i = 0; i < n; i++) {
+        buf[i * 4 + 0] = (unsigned char)(limbs[i]);
+        buf[i * 4 + 1] = (unsigned char)(limbs[i] >> 8);
+        buf[i * 4 + 2] = (unsigned char)(limbs[i] >> 16);
+        buf[i * 4 + 3] = (unsigned char)(limbs[i] >> 24);
+    }
+    return _PyLong_FromByteArray(buf, (size_t)n * 4, 1, 0);
+}
 
-    return result;
+/* limbs_to_pylong() of a machine's state, counted in its perf counters */
+static PyObject *machine_pylong(CMachine *self, const uint32_t *limbs, int n) {
+    self->perf.pylongs++;
+    return limbs_to_pylong(limbs, n);
 }
 
-/* Helper: modify half-limb in a Python int */
-static PyObject *modify_half_limb(PyObject *val, int lidx, long half_val, int upper, PyObject *xlen_mask_obj) {
-    int shift_amt = (lidx * 2 + (upper ? 1 : 0)) * HALF_LIMB_BITS;
-    PyObject *shift = PyLong_FromLong(shift_amt);
-    PyObject *hl_mask = PyLong_FromUnsignedLong(0xFFFFUL);
+static void bytes_to_limbs(const unsigned char *buf, uint32_t *limbs, int n) {
+    for (int i = 0; i < n; i++) {
+        limbs[i] = (uint32_t)buf[i * 4]
+                 | ((uint32_t)buf[i * 4 + 1] << 8)
+                 | ((uint32_t)buf[i * 4 + 2] << 16)
+                 | ((uint32_t)buf[i * 4 + 3] << 24);
+    }
+}
 
-    PyObject *shifted_mask = PyNumber_Lshift(hl_mask, shift);
-    PyObject *inv = PyNumber_Invert(shifted_mask);
-    PyObject *clear_mask = PyNumber_And(inv, xlen_mask_obj);
-    PyObject *cleared = PyNumber_And(val, clear_mask);
+/* Store a non-negative Python int that fits in n limbs.  Raises
+ * OverflowError(msg) when the value is negative or too wide. */
+static int pylong_to_limbs(PyObject *val, uint32_t *limbs, int n, const char *msg) {
+    unsigned char buf[ACC_LIMBS * 4];
+    if (!PyLong_Check(val)) {
+        PyErr_SetString(PyExc_TypeError, "integer value required");
+        return -1;
+    }
+    if (OT_LONG_AS_BYTES(val, buf, (size_t)n * 4, 0) < 0) {
+        if (PyErr_ExceptionMatches(PyExc_OverflowError)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_OverflowError, msg);
+        }
+        return -1;
+    }
+    bytes_to_limbs(buf, limbs, n);
+    return 0;
+}
 
-    PyObject *hl_py = PyLong_FromLong(half_val);
-    PyObject *new_bits = PyNumber_Lshift(hl_py, shift);
-    PyObject *result = PyNumber_Or(cleared, new_bits);
+/* Low n limbs of an arbitrary Python int (two's complement for negative
+ * values), i.e. val & ((1 << 32*n) - 1).  Used for flag and formatting
+ * helpers that accept intermediate results of any width. */
+static int pylong_low_limbs(PyObject *val, uint32_t *limbs, int n) {
+    unsigned char buf[ACC_LIMBS * 4];
+    if (!PyLong_Check(val)) {
+        PyErr_SetString(PyExc_TypeError, "integer value required");
+        return -1;
+    }
+    if (OT_LONG_AS_BYTES(val, buf, (size_t)n * 4, 1) == 0) {
+        bytes_to_limbs(buf, limbs, n);
+        return 0;
+    }
+    if (!PyErr_ExceptionMatches(PyExc_OverflowError))
+        return -1;
+    PyErr_Clear();
 
-    Py_DECREF(shift);
-    Py_DECREF(hl_mask);
-    Py_DECREF(shifted_mask);
-    Py_DECREF(inv);
-    Py_DECREF(clear_mask);
-    Py_DECREF(cleared);
-    Py_DECREF(hl_py);
-    Py_DECREF(new_bits);
+    /* Wider than the buffer: mask in Python first (rare path). */
+    PyObject *mask = make_mask(n * 32);
+    if (!mask) return -1;
+    PyObject *masked = PyNumber_And(val, mask);
+    Py_DECREF(mask);
+    if (!masked) return -1;
+    int rc = OT_LONG_AS_BYTES(masked, buf, (size_t)n * 4, 0);
+    Py_DECREF(masked);
+    if (rc < 0) return -1;
+    bytes_to_limbs(buf, limbs, n);
+    return 0;
+}
 
-    return result;
+static int limbs_is_zero(const uint32_t *limbs, int n) {
+    uint32_t acc = 0;
+    for (int i = 0; i < n; i++)
+        acc |= limbs[i];
+    return acc == 0;
 }
 
-/* Helper: modify half-word in a Python int */
-static PyObject *modify_half_word(PyObject *val, int hw_idx, PyObject *hw_val, PyObject *hw_mask_obj, PyObject *xlen_mask_obj) {
-    int shift_amt = hw_idx * HW_BITS;
-    PyObject *shift = PyLong_FromLong(shift_amt);
+static int limbs_test_bit(const uint32_t *limbs, int pos) {
+    return (int)((limbs[pos / 32] >> (pos % 32)) & 1U);
+}
 
-    PyObject *shifted_mask = PyNumber_Lshift(hw_mask_obj, shift);
-    PyObject *inv = PyNumber_Invert(shifted_mask);
-    PyObject *clear_mask = PyNumber_And(inv, xlen_mask_obj);
-    PyObject *cleared = PyNumber_And(val, clear_mask);
+static void limbs_fill(uint32_t *limbs, int n, uint32_t v) {
+    for (int i = 0; i < n; i++)
+        limbs[i] = v;
+}
 
-    PyObject *new_bits = PyNumber_Lshift(hw_val, shift);
-    PyObject *result = PyNumber_Or(cleared, new_bits);
+static uint64_t limbs_get_qw(const uint32_t *limbs, int qwidx) {
+    return (uint64_t)limbs[qwidx * 2] | ((uint64_t)limbs[qwidx * 2 + 1] << 32);
+}
 
-    Py_DECREF(shift);
-    Py_DECREF(shifted_mask);
-    Py_DECREF(inv);
-    Py_DECREF(clear_mask);
-    Py_DECREF(cleared);
-    Py_DECREF(new_bits);
+/* Range-checked 32-bit limb value (matches the Python Machine checks). */
+static int check_limb_value(long value, long max, const char *msg) {
+    if (value < 0 || value > max) {
+        raise_error(PyExc_OverflowError, msg);
+        return -1;
+    }
+    return 0;
+}
 
-    return result;
+/* ------------------------------------------------------------------ */
+/* Register file / DMEM initialisation                                 */
+/* ------------------------------------------------------------------ */
+static void clear_wide_regs(CMachine *self) {
+    memset(self->r, 0, sizeof(self->r));
+    memset(self->mod, 0, sizeof(self->mod));
+    memset(self->dmp, 0, sizeof(self->dmp));
+    memset(self->rfp, 0, sizeof(self->rfp));
+    memset(self->lc, 0, sizeof(self->lc));
+    /* rnd has a special default */
+    limbs_fill(self->rnd, LIMBS, RND_DEFAULT_LIMB);
+    memset(self->acc, 0, sizeof(self->acc));
 }
 
-/* Helper: extract a quarter-word from a Python int */
-static PyObject *extract_qw(PyObject *val, int qwidx) {
-    PyObject *shift = PyLong_FromLong(qwidx * QW_BITS);
-    PyObject *shifted = PyNumber_Rshift(val, shift);
-    PyObject *mask = make_mask(QW_BITS);
-    PyObject *result = PyNumber_And(shifted, mask);
-    Py_DECREF(shift);
-    Py_DECREF(shifted);
-    Py_DECREF(mask);
-    return result;
+/* DMEM cells are host-order limb arrays, so their bytes are the
+ * little-endian cell values only on little-endian hosts. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define DMEM_BYTES_NATIVE 0
+#else
+#define DMEM_BYTES_NATIVE 1
+#endif
+
+static int dmem_bytes_check(void) {
+    if (!DMEM_BYTES_NATIVE) {
+        PyErr_SetString(PyExc_BufferError, "DMEM byte access needs a little-endian host");
+        return -1;
+    }
+    return 0;
 }
 
-/* Helper: test bit at position */
-static int test_bit(PyObject *val, int pos) {
-    PyObject *shift = PyLong_FromLong(pos);
-    PyObject *shifted = PyNumber_Rshift(val, shift);
-    PyObject *one = PyLong_FromLong(1);
-    PyObject *result = PyNumber_And(shifted, one);
-    int ret = PyObject_IsTrue(result);
-    Py_DECREF(shift);
-    Py_DECREF(shifted);
-    Py_DECREF(one);
-    Py_DECREF(result);
-    return ret;
+/* Methods that replace the program, state or DMEM a run() works on
+ * refuse while one is in progress.  The run drops the GIL for native ops
+ * and takes it back for Python-backed ones, so another thread (a
+ * submit() caller, say) could otherwise free the decoded table and the
+ * counters under it. */
+static int machine_idle_check(CMachine *self) {
+    if (self->running) {
+        PyErr_SetString(PyExc_RuntimeError, "machine is running");
+        return -1;
+    }
+    return 0;
 }
 
-/* Helper: check Python int is in [0, mask] */
-static int check_val_range(PyObject *val, PyObject *mask, const char *msg) {
-    PyObject *zero = PyLong_FromLong(0);
-    int lt_zero = PyObject_RichCompareBool(val, zero, Py_LT);
-    if (lt_zero) {
-        Py_DECREF(zero);
-        PyErr_SetString(PyExc_OverflowError, msg);
+/* Copy a little-endian byte image over DMEM from cell `address`, marking
+ * every cell it covers as initialised. */
+static int write_dmem_bytes(CMachine *self, long address, PyObject *data) {
+    Py_buffer view;
+    if (dmem_bytes_check() < 0)
+        return -1;
+    if (PyObject_GetBuffer(data, &view, PyBUF_CONTIG_RO) < 0)
+        return -1;
+    if (view.len % (LIMBS * 4) != 0) {
+        PyErr_SetString(PyExc_ValueError, "DMEM image must be a whole number of 32-byte cells");
+        PyBuffer_Release(&view);
         return -1;
     }
-    int gt_mask = PyObject_RichCompareBool(val, mask, Py_GT);
-    Py_DECREF(zero);
-    if (gt_mask) {
-        PyErr_SetString(PyExc_OverflowError, msg);
+    Py_ssize_t cells = view.len / (LIMBS * 4);
+    if (address < 0 || address > DMEM_DEPTH || cells > DMEM_DEPTH - address) {
+        PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
+        PyBuffer_Release(&view);
         return -1;
     }
+    memcpy(self->dmem[address], view.buf, (size_t)view.len);
+    memset(self->init_dmem + address, 1, (size_t)cells);
+    self->perf.dmem_host_bytes += (uint64_t)view.len;
+    PyBuffer_Release(&view);
+    return 0;
+}
+
+/* Load DMEM from a sequence of Python ints, or from a bytes-like image
+ * of whole 32-byte cells.  Cells past the end of the input are zeroed
+ * and flagged as uninitialised; list entries past DMEM_DEPTH are
+ * ignored. */
+static int load_dmem(CMachine *self, PyObject *dmem_seq) {
+    if (PyObject_CheckBuffer(dmem_seq)) {
+        memset(self->dmem, 0, sizeof(self->dmem));
+        memset(self->init_dmem, 0, sizeof(self->init_dmem));
+        return write_dmem_bytes(self, 0, dmem_seq);
+    }
+    PyObject *fast = PySequence_Fast(dmem_seq, "dmem must be a sequence");
+    if (!fast) return -1;
+    Py_ssize_t dmem_len = PySequence_Fast_GET_SIZE(fast);
+    PyObject **items = PySequence_Fast_ITEMS(fast);
+
+    for (Py_ssize_t i = 0; i < DMEM_DEPTH; i++) {
+        if (i < dmem_len) {
+            if (pylong_to_limbs(items[i], self->dmem[i], LIMBS, "DMEM value out of range") < 0) {
+                Py_DECREF(fast);
+                return -1;
+            }
+            self->init_dmem[i] = 1;
+            self->perf.dmem_host_bytes += XLEN_BYTES;
+        } else {
+            memset(self->dmem[i], 0, sizeof(self->dmem[i]));
+            self->init_dmem[i] = 0;
+        }
+    }
+    Py_DECREF(fast);
     return 0;
 }
 
@@ -309,87 +751,52 @@ CMachine_init(CMachine *self, PyObject *args, PyObject *kwds) {
     PyObject *stop_addr_obj = Py_None;
     PyObject *ctx_obj = Py_None;
     PyObject *breakpoints_obj = Py_None;
+    PyObject *timing_obj = Py_None;
 
-    static char *kwlist[] = {"dmem", "imem", "s_addr", "stop_addr", "ctx", "breakpoints", NULL};
+    static char *kwlist[] = {"dmem", "imem", "s_addr", "stop_addr", "ctx", "breakpoints",
+                             "timing_model", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|lOOO", kwlist,
+    if (machine_idle_check(self) < 0)
+        return -1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|lOOOO", kwlist,
                                       &dmem_list, &imem_list,
-                                      &s_addr, &stop_addr_obj, &ctx_obj, &breakpoints_obj))
+                                      &s_addr, &stop_addr_obj, &ctx_obj, &breakpoints_obj,
+                                      &timing_obj))
         return -1;
 
-    /* Precompute masks */
-    self->xlen_mask = make_mask(XLEN);
-    self->limb_mask = make_mask(LIMB_BITS);
-    self->half_limb_mask = make_mask(HALF_LIMB_BITS);
-    self->hw_mask = make_mask(HW_BITS);
-    self->qw_mask = make_mask(QW_BITS);
-    self->gpr_mask = make_mask(GPR_WIDTH);
-
     self->limb_width = LIMB_BITS;
     self->half_limb_width = HALF_LIMB_BITS;
     self->qw_width = QW_BITS;
     self->hw_width = HW_BITS;
 
-    /* Initialize all wide registers to 0 */
-    for (int i = 0; i < NUM_REGS; i++) {
-        self->r[i] = py_zero();
-    }
-    self->mod = py_zero();
-    self->dmp = py_zero();
-    self->rfp = py_zero();
-    self->lc = py_zero();
-    /* rnd has a special default */
-    self->rnd = PyLong_FromString(
-        "9999999999999999999999999999999999999999999999999999999999999999", NULL, 16);
-    self->acc = py_zero();
-
-    /* GPRs */
+    /* Wide registers, accumulator, GPRs */
+    clear_wide_regs(self);
     memset(self->gpr, 0, sizeof(self->gpr));
 
     /* Flags */
-    self->M = self->L = self->Z = self->C = 0;
-    self->XM = self->XL = self->XZ = self->XC = 0;
+    self->flags = 0;
 
     /* Valid half-limb tracking */
-    for (int i = 0; i < NUM_REGS; i++) {
-        for (int j = 0; j < LIMBS * 2; j++) {
-            self->r_valid_half_limbs[i][j] = 0;
-        }
-    }
+    memset(self->r_valid_half_limbs, 0, sizeof(self->r_valid_half_limbs));
 
     /* PC */
     self->pc = s_addr;
     self->finishFlag = 0;
 
-    /* IMEM - store reference */
-    Py_INCREF(imem_list);
-    self->imem = imem_list;
+    /* IMEM */
+    if (load_imem(self, imem_list) < 0)
+        return -1;
 
     /* stop_addr */
     if (stop_addr_obj == Py_None || stop_addr_obj == NULL) {
-        self->stop_addr = PyList_Size(imem_list) - 1;
+        self->stop_addr = imem_len(self) - 1;
     } else {
         self->stop_addr = PyLong_AsLong(stop_addr_obj);
     }
 
     /* DMEM */
-    Py_ssize_t dmem_len = PyList_Size(dmem_list);
-    self->dmem = PyList_New(DMEM_DEPTH);
-    self->init_dmem = PyList_New(DMEM_DEPTH);
-    for (Py_ssize_t i = 0; i < DMEM_DEPTH; i++) {
-        if (i < dmem_len) {
-            PyObject *item = PyList_GetItem(dmem_list, i);
-            Py_INCREF(item);
-            PyList_SET_ITEM(self->dmem, i, item);
-            Py_INCREF(Py_True);
-            PyList_SET_ITEM(self->init_dmem, i, Py_True);
-        } else {
-            PyObject *z = py_zero();
-            PyList_SET_ITEM(self->dmem, i, z);
-            Py_INCREF(Py_False);
-            PyList_SET_ITEM(self->init_dmem, i, Py_False);
-        }
-    }
+    if (load_dmem(self, dmem_list) < 0)
+        return -1;
 
     /* Loop/call stacks */
     self->loop_sp = 0;
@@ -401,27 +808,39 @@ CMachine_init(CMachine *self, PyObject *args, PyObject *kwds) {
     self->fb_callstack = 0;
     self->fb_consider_loopstack = 0;
     self->fb_loopstack = 0;
+    self->break_resume = 0;
 
-    /* Context */
+    /* Context and timing model: a Program brings its own */
+    if (ctx_obj == Py_None && self->program)
+        ctx_obj = ((ProgramObject *)self->program)->ctx;
     Py_INCREF(ctx_obj);
     self->ctx = ctx_obj;
+    if (timing_obj != Py_None) {
+        if (timing_parse(timing_obj, &self->timing) < 0)
+            return -1;
+    } else if (self->program) {
+        timing_copy(&self->timing, &((ProgramObject *)self->program)->timing);
+    }
 
-    /* Breakpoints */
-    self->breakpoints = PyDict_New();
+    /* Breakpoints: iterable of addresses or labels */
+    bp_clear_all(self);
     if (breakpoints_obj != Py_None && breakpoints_obj != NULL) {
-        /* Iterable of breakpoint addresses */
         PyObject *iter = PyObject_GetIter(breakpoints_obj);
-        if (iter) {
-            PyObject *item;
-            while ((item = PyIter_Next(iter)) != NULL) {
-                PyObject *val = Py_BuildValue("(li)", 1, 1);
-                PyDict_SetItem(self->breakpoints, item, val);
-                Py_DECREF(val);
-                Py_DECREF(item);
+        if (!iter) return -1;
+        PyObject *item;
+        while ((item = PyIter_Next(iter)) != NULL) {
+            long addr;
+            int rc = resolve_bp_addr(self, item, &addr);
+            Py_DECREF(item);
+            if (rc < 0) {
+                Py_DECREF(iter);
+                return -1;
             }
-            Py_DECREF(iter);
+            if (addr >= 0 && addr < IMEM_DEPTH)
+                bp_set(self, addr, 1, 1);
         }
-        PyErr_Clear();
+        Py_DECREF(iter);
+        if (PyErr_Occurred()) return -1;
     }
 
     /* Stats */
@@ -432,25 +851,25 @@ CMachine_init(CMachine *self, PyObject *args, PyObject *kwds) {
 
 static void
 CMachine_dealloc(CMachine *self) {
-    for (int i = 0; i < NUM_REGS; i++) {
-        Py_XDECREF(self->r[i]);
-    }
-    Py_XDECREF(self->mod);
-    Py_XDECREF(self->dmp);
-    Py_XDECREF(self->rfp);
-    Py_XDECREF(self->lc);
-    Py_XDECREF(self->rnd);
-    Py_XDECREF(self->acc);
-    Py_XDECREF(self->dmem);
-    Py_XDECREF(self->init_dmem);
+    /* A stats dict assigned from Python outlives the machine: hand it
+     * the pending statistics first. */
+    PyObject *err_type, *err_value, *err_tb;
+    PyErr_Fetch(&err_type, &err_value, &err_tb);
+    if (stats_flush(self) < 0)
+        PyErr_WriteUnraisable((PyObject *)self);
+    PyErr_Restore(err_type, err_value, err_tb);
+    stats_clear(self);
+    event_free(&self->exec_order);
+    event_free(&self->flag_events);
+    event_free(&self->wide_mem_events);
+    event_free(&self->func_call_events);
+    event_free(&self->loop_events);
+    trace_close(self);
+    PyMem_Free(self->trace_buf);
+    prof_free(self);
+    Py_XDECREF(self->timing.spec);
+    free_ops(self);
     Py_XDECREF(self->imem);
-    Py_XDECREF(self->xlen_mask);
-    Py_XDECREF(self->limb_mask);
-    Py_XDECREF(self->half_limb_mask);
-    Py_XDECREF(self->hw_mask);
-    Py_XDECREF(self->qw_mask);
-    Py_XDECREF(self->gpr_mask);
-    Py_XDECREF(self->breakpoints);
     Py_XDECREF(self->ctx);
     Py_XDECREF(self->stats);
     Py_TYPE(self)->tp_free((PyObject *)self);
@@ -459,28 +878,30 @@ CMachine_dealloc(CMachine *self) {
 /* ------------------------------------------------------------------ */
 /* get_reg / set_reg                                                   */
 /* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_get_reg(CMachine *self, PyObject *args) {
-    PyObject *ridx_obj;
-    if (!PyArg_ParseTuple(args, "O", &ridx_obj))
-        return NULL;
 
+/* Resolve a register index (int WDR index or special register name) to
+ * its limb array.  *wdr_idx is set to the WDR index or -1 for special
+ * registers. */
+static uint32_t *resolve_reg(CMachine *self, PyObject *ridx_obj, long *wdr_idx) {
     if (PyLong_Check(ridx_obj)) {
         long idx = PyLong_AsLong(ridx_obj);
         if (idx < 0 || idx >= NUM_REGS) {
-            PyErr_SetString(PyExc_IndexError, "register index out of range");
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_IndexError, "register index out of range");
             return NULL;
         }
-        Py_INCREF(self->r[idx]);
+        *wdr_idx = idx;
         return self->r[idx];
     }
     if (PyUnicode_Check(ridx_obj)) {
         const char *name = PyUnicode_AsUTF8(ridx_obj);
-        if (strcmp(name, "mod") == 0) { Py_INCREF(self->mod); return self->mod; }
-        if (strcmp(name, "dmp") == 0) { Py_INCREF(self->dmp); return self->dmp; }
-        if (strcmp(name, "rfp") == 0) { Py_INCREF(self->rfp); return self->rfp; }
-        if (strcmp(name, "lc") == 0)  { Py_INCREF(self->lc);  return self->lc; }
-        if (strcmp(name, "rnd") == 0) { Py_INCREF(self->rnd); return self->rnd; }
+        if (!name) return NULL;
+        *wdr_idx = -1;
+        if (strcmp(name, "mod") == 0) return self->mod;
+        if (strcmp(name, "dmp") == 0) return self->dmp;
+        if (strcmp(name, "rfp") == 0) return self->rfp;
+        if (strcmp(name, "lc") == 0)  return self->lc;
+        if (strcmp(name, "rnd") == 0) return self->rnd;
         PyErr_SetString(PyExc_ValueError, "Invalid special register");
         return NULL;
     }
@@ -488,66 +909,68 @@ CMachine_get_reg(CMachine *self, PyObject *args) {
     return NULL;
 }
 
+static void mark_valid_all(CMachine *self, long idx) {
+    if (idx < 0) return;
+    watch_wdr_write(self, idx);
+    self->r_valid_half_limbs[idx] = VALID_HALF_LIMBS_ALL;
+}
+
+static PyObject *
+CMachine_get_reg(CMachine *self, PyObject *args) {
+    PyObject *ridx_obj;
+    long idx;
+    if (!PyArg_ParseTuple(args, "O", &ridx_obj))
+        return NULL;
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
+    return machine_pylong(self, reg, LIMBS);
+}
+
 static PyObject *
 CMachine_set_reg(CMachine *self, PyObject *args) {
     PyObject *ridx_obj;
     PyObject *value;
     PyObject *valid_limb_obj = Py_None;
     PyObject *valid_half_limb_obj = Py_None;
+    uint32_t limbs[LIMBS];
+    long idx;
 
     if (!PyArg_ParseTuple(args, "OO|OO", &ridx_obj, &value, &valid_limb_obj, &valid_half_limb_obj))
         return NULL;
 
     /* Range check */
-    if (check_val_range(value, self->xlen_mask, "register value out of range") < 0)
+    if (pylong_to_limbs(value, limbs, LIMBS, "register value out of range") < 0)
         return NULL;
 
-    if (PyLong_Check(ridx_obj)) {
-        long idx = PyLong_AsLong(ridx_obj);
-        if (idx < 0 || idx >= NUM_REGS) {
-            PyErr_SetString(PyExc_IndexError, "register index out of range");
-            return NULL;
-        }
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
 
-        /* Update valid half-limb tracking */
+    /* Update valid half-limb tracking */
+    if (idx >= 0) {
         if (valid_limb_obj != Py_None) {
             long vl = PyLong_AsLong(valid_limb_obj);
-            self->r_valid_half_limbs[idx][vl * 2] = 1;
-            self->r_valid_half_limbs[idx][vl * 2 + 1] = 1;
+            if (vl < 0 || vl >= LIMBS) {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_IndexError, "limb index out of range");
+                return NULL;
+            }
+            self->r_valid_half_limbs[idx] |= (uint16_t)(3u << (vl * 2));
         } else if (valid_half_limb_obj != Py_None) {
             long vhl = PyLong_AsLong(valid_half_limb_obj);
-            self->r_valid_half_limbs[idx][vhl] = 1;
+            if (vhl < 0 || vhl >= LIMBS * 2) {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_IndexError, "half-limb index out of range");
+                return NULL;
+            }
+            self->r_valid_half_limbs[idx] |= (uint16_t)(1u << vhl);
         } else {
-            for (int j = 0; j < LIMBS * 2; j++)
-                self->r_valid_half_limbs[idx][j] = 1;
-        }
-
-        Py_INCREF(value);
-        Py_DECREF(self->r[idx]);
-        self->r[idx] = value;
-        Py_RETURN_NONE;
-    }
-
-    if (PyUnicode_Check(ridx_obj)) {
-        const char *name = PyUnicode_AsUTF8(ridx_obj);
-        PyObject **target = NULL;
-        if (strcmp(name, "mod") == 0) target = &self->mod;
-        else if (strcmp(name, "dmp") == 0) target = &self->dmp;
-        else if (strcmp(name, "rfp") == 0) target = &self->rfp;
-        else if (strcmp(name, "lc") == 0)  target = &self->lc;
-        else if (strcmp(name, "rnd") == 0) target = &self->rnd;
-        else {
-            PyErr_SetString(PyExc_ValueError, "Invalid special register");
-            return NULL;
+            mark_valid_all(self, idx);
         }
-        Py_INCREF(value);
-        Py_DECREF(*target);
-        *target = value;
-        Py_RETURN_NONE;
     }
 
-    PyErr_SetString(PyExc_TypeError, "register index must be int or str");
-    return NULL;
+    watch_wdr_write(self, idx);
+    memcpy(reg, limbs, sizeof(limbs));
+    Py_RETURN_NONE;
 }
 
 /* ------------------------------------------------------------------ */
@@ -557,6 +980,7 @@ static PyObject *
 CMachine_get_reg_limb(CMachine *self, PyObject *args) {
     PyObject *ridx_obj;
     int lidx;
+    long idx;
     if (!PyArg_ParseTuple(args, "Oi", &ridx_obj, &lidx))
         return NULL;
     if (lidx < 0 || lidx >= LIMBS) {
@@ -564,15 +988,9 @@ CMachine_get_reg_limb(CMachine *self, PyObject *args) {
         return NULL;
     }
 
-    /* Get the register value */
-    PyObject *reg_args = Py_BuildValue("(O)", ridx_obj);
-    PyObject *regval = CMachine_get_reg(self, reg_args);
-    Py_DECREF(reg_args);
-    if (!regval) return NULL;
-
-    long limb = extract_limb(regval, lidx);
-    Py_DECREF(regval);
-    return PyLong_FromLong(limb);
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
+    return PyLong_FromUnsignedLong(reg[lidx]);
 }
 
 static PyObject *
@@ -580,30 +998,25 @@ CMachine_set_reg_limb(CMachine *self, PyObject *args) {
     PyObject *ridx_obj;
     int lidx;
     long value;
+    long idx;
     if (!PyArg_ParseTuple(args, "Oil", &ridx_obj, &lidx, &value))
         return NULL;
     if (lidx < 0 || lidx >= LIMBS) {
         PyErr_SetString(PyExc_IndexError, "limb index out of range");
         return NULL;
     }
+    if (check_limb_value(value, 0xFFFFFFFFL, "limb value out of range") < 0)
+        return NULL;
 
-    /* Get current register value */
-    PyObject *reg_args = Py_BuildValue("(O)", ridx_obj);
-    PyObject *regval = CMachine_get_reg(self, reg_args);
-    Py_DECREF(reg_args);
-    if (!regval) return NULL;
-
-    PyObject *new_val = modify_limb(regval, lidx, value, self->xlen_mask);
-    Py_DECREF(regval);
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
 
-    /* set_reg with valid_limb=lidx */
-    PyObject *lidx_py = PyLong_FromLong(lidx);
-    PyObject *set_args = Py_BuildValue("(OOOO)", ridx_obj, new_val, lidx_py, Py_None);
-    PyObject *result = CMachine_set_reg(self, set_args);
-    Py_DECREF(set_args);
-    Py_DECREF(new_val);
-    Py_DECREF(lidx_py);
-    return result;
+    reg[lidx] = (uint32_t)value;
+    if (idx >= 0) {
+        self->r_valid_half_limbs[idx] |= (uint16_t)(3u << (lidx * 2));
+    }
+    watch_wdr_write(self, idx);
+    Py_RETURN_NONE;
 }
 
 /* ------------------------------------------------------------------ */
@@ -615,26 +1028,25 @@ CMachine_set_reg_half_limb(CMachine *self, PyObject *args) {
     int lidx;
     long value;
     int upper;
+    long idx;
     if (!PyArg_ParseTuple(args, "Oilp", &ridx_obj, &lidx, &value, &upper))
         return NULL;
     if (lidx < 0 || lidx >= LIMBS) {
         PyErr_SetString(PyExc_IndexError, "limb index out of range");
         return NULL;
     }
+    if (check_limb_value(value, 0xFFFFL, "half-limb value out of range") < 0)
+        return NULL;
 
-    PyObject *reg_args = Py_BuildValue("(O)", ridx_obj);
-    PyObject *regval = CMachine_get_reg(self, reg_args);
-    Py_DECREF(reg_args);
-    if (!regval) return NULL;
-
-    PyObject *new_val = modify_half_limb(regval, lidx, value, upper, self->xlen_mask);
-    Py_DECREF(regval);
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
 
-    PyObject *set_args = Py_BuildValue("(OO)", ridx_obj, new_val);
-    PyObject *result = CMachine_set_reg(self, set_args);
-    Py_DECREF(set_args);
-    Py_DECREF(new_val);
-    return result;
+    if (upper)
+        reg[lidx] = (reg[lidx] & 0x0000FFFFU) | ((uint32_t)value << HALF_LIMB_BITS);
+    else
+        reg[lidx] = (reg[lidx] & 0xFFFF0000U) | (uint32_t)value;
+    mark_valid_all(self, idx);
+    Py_RETURN_NONE;
 }
 
 /* ------------------------------------------------------------------ */
@@ -644,6 +1056,7 @@ static PyObject *
 CMachine_get_reg_qw(CMachine *self, PyObject *args) {
     PyObject *ridx_obj;
     int qwidx;
+    long idx;
     if (!PyArg_ParseTuple(args, "Oi", &ridx_obj, &qwidx))
         return NULL;
     if (qwidx < 0 || qwidx >= 4) {
@@ -651,14 +1064,9 @@ CMachine_get_reg_qw(CMachine *self, PyObject *args) {
         return NULL;
     }
 
-    PyObject *reg_args = Py_BuildValue("(O)", ridx_obj);
-    PyObject *regval = CMachine_get_reg(self, reg_args);
-    Py_DECREF(reg_args);
-    if (!regval) return NULL;
-
-    PyObject *qw = extract_qw(regval, qwidx);
-    Py_DECREF(regval);
-    return qw;
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
+    return PyLong_FromUnsignedLongLong(limbs_get_qw(reg, qwidx));
 }
 
 /* ------------------------------------------------------------------ */
@@ -669,26 +1077,23 @@ CMachine_set_reg_half_word(CMachine *self, PyObject *args) {
     PyObject *ridx_obj;
     int hw_idx;
     PyObject *hw_value;
+    uint32_t hw[LIMBS / 2];
+    long idx;
     if (!PyArg_ParseTuple(args, "OiO", &ridx_obj, &hw_idx, &hw_value))
         return NULL;
     if (hw_idx < 0 || hw_idx >= 2) {
         PyErr_SetString(PyExc_IndexError, "half-word index out of range");
         return NULL;
     }
+    if (pylong_to_limbs(hw_value, hw, LIMBS / 2, "half-word value out of range") < 0)
+        return NULL;
 
-    PyObject *reg_args = Py_BuildValue("(O)", ridx_obj);
-    PyObject *regval = CMachine_get_reg(self, reg_args);
-    Py_DECREF(reg_args);
-    if (!regval) return NULL;
-
-    PyObject *new_val = modify_half_word(regval, hw_idx, hw_value, self->hw_mask, self->xlen_mask);
-    Py_DECREF(regval);
+    uint32_t *reg = resolve_reg(self, ridx_obj, &idx);
+    if (!reg) return NULL;
 
-    PyObject *set_args = Py_BuildValue("(OO)", ridx_obj, new_val);
-    PyObject *result = CMachine_set_reg(self, set_args);
-    Py_DECREF(set_args);
-    Py_DECREF(new_val);
-    return result;
+    memcpy(reg + hw_idx * (LIMBS / 2), hw, sizeof(hw));
+    mark_valid_all(self, idx);
+    Py_RETURN_NONE;
 }
 
 /* ------------------------------------------------------------------ */
@@ -704,31 +1109,44 @@ CMachine_get_reg_valid_half_limbs(CMachine *self, PyObject *args) {
         return NULL;
     }
     PyObject *lst = PyList_New(LIMBS * 2);
+    if (!lst) return NULL;
     for (int j = 0; j < LIMBS * 2; j++) {
-        PyList_SET_ITEM(lst, j, PyBool_FromLong(self->r_valid_half_limbs[ridx][j]));
+        PyList_SET_ITEM(lst, j, PyBool_FromLong(self->r_valid_half_limbs[ridx] >> j & 1));
     }
     return lst;
 }
 
+/* The same as an int: bit j set when half limb j is valid. */
+static PyObject *
+CMachine_get_reg_valid_half_limb_mask(CMachine *self, PyObject *args) {
+    int ridx;
+    if (!PyArg_ParseTuple(args, "i", &ridx))
+        return NULL;
+    if (ridx < 0 || ridx >= NUM_REGS) {
+        PyErr_SetString(PyExc_IndexError, "register index out of range");
+        return NULL;
+    }
+    return PyLong_FromLong(self->r_valid_half_limbs[ridx]);
+}
+
 /* ------------------------------------------------------------------ */
 /* GPR operations                                                      */
 /* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_set_gpr(CMachine *self, PyObject *args) {
-    int gpr;
-    long value;
-    if (!PyArg_ParseTuple(args, "il", &gpr, &value))
-        return NULL;
+
+/* GPR access shared by the Python methods and the native kernels.
+ * Writing x1 pushes and reading x1 pops the call stack; x8..x31 are
+ * mapped onto the limbs of rfp, dmp and lc. */
+static int gpr_write(CMachine *self, int gpr, long value) {
     if (gpr < 0 || gpr >= NUM_GPRS) {
-        PyErr_SetString(PyExc_ValueError, "Invalid GPR referenced");
-        return NULL;
+        raise_error(PyExc_ValueError, "Invalid GPR referenced");
+        return -1;
     }
 
     /* Writing to x1 pushes to call stack */
     if (gpr == 1) {
         if (self->call_sp >= CALL_STACK_SZ) {
-            PyErr_SetString(PyExc_OverflowError, "Call stack overflow");
-            return NULL;
+            raise_error(PyExc_OverflowError, "Call stack overflow");
+            return -1;
         }
         self->call_stack[self->call_sp++] = value;
     }
@@ -737,160 +1155,172 @@ CMachine_set_gpr(CMachine *self, PyObject *args) {
     }
 
     /* Mirror to special wide registers */
-    if (gpr >= 8 && gpr < 16) {
-        PyObject *new_rfp = modify_limb(self->rfp, gpr - 8, value, self->xlen_mask);
-        Py_DECREF(self->rfp);
-        self->rfp = new_rfp;
-    }
-    if (gpr >= 16 && gpr < 24) {
-        PyObject *new_dmp = modify_limb(self->dmp, gpr - 16, value, self->xlen_mask);
-        Py_DECREF(self->dmp);
-        self->dmp = new_dmp;
-    }
-    if (gpr >= 24) {
-        PyObject *new_lc = modify_limb(self->lc, gpr - 24, value, self->xlen_mask);
-        Py_DECREF(self->lc);
-        self->lc = new_lc;
-    }
-
-    Py_RETURN_NONE;
+    if (gpr >= 8 && gpr < 16)
+        self->rfp[gpr - 8] = (uint32_t)value;
+    if (gpr >= 16 && gpr < 24)
+        self->dmp[gpr - 16] = (uint32_t)value;
+    if (gpr >= 24)
+        self->lc[gpr - 24] = (uint32_t)value;
+    return 0;
 }
 
-static PyObject *
-CMachine_get_gpr(CMachine *self, PyObject *args) {
-    int gpr;
-    if (!PyArg_ParseTuple(args, "i", &gpr))
-        return NULL;
+static int gpr_read(CMachine *self, int gpr, long *value) {
     if (gpr < 0 || gpr >= NUM_GPRS) {
-        PyErr_SetString(PyExc_ValueError, "Invalid GPR referenced");
-        return NULL;
+        raise_error(PyExc_ValueError, "Invalid GPR referenced");
+        return -1;
     }
 
-    if (gpr == 0) return PyLong_FromLong(0);
-    if (gpr == 1) {
+    if (gpr == 0) {
+        *value = 0;
+    } else if (gpr == 1) {
         /* Pop from call stack */
         if (self->call_sp <= 0) {
-            PyErr_SetString(PyExc_OverflowError, "Call stack underrun");
-            return NULL;
+            raise_error(CallStackUnderrun, "Call stack underrun");
+            return -1;
         }
-        return PyLong_FromLong(self->call_stack[--self->call_sp]);
+        *value = self->call_stack[--self->call_sp];
+    } else if (gpr < 8) {
+        *value = self->gpr[gpr];
+    } else if (gpr < 16) {
+        *value = (long)self->rfp[gpr - 8];
+    } else if (gpr < 24) {
+        *value = (long)self->dmp[gpr - 16];
+    } else {
+        *value = (long)self->lc[gpr - 24];
     }
-    if (gpr >= 2 && gpr < 8) return PyLong_FromLong(self->gpr[gpr]);
-    if (gpr >= 8 && gpr < 16) return PyLong_FromLong(extract_limb(self->rfp, gpr - 8));
-    if (gpr >= 16 && gpr < 24) return PyLong_FromLong(extract_limb(self->dmp, gpr - 16));
-    if (gpr >= 24) return PyLong_FromLong(extract_limb(self->lc, gpr - 24));
+    return 0;
+}
 
-    Py_RETURN_NONE;  /* unreachable */
+static int gpr_add(CMachine *self, int gpr, long inc) {
+    long val;
+    if (gpr_read(self, gpr, &val) < 0)
+        return -1;
+    return gpr_write(self, gpr, (val + inc) & 0xFFFFFFFF);
 }
 
 static PyObject *
-CMachine_inc_gpr(CMachine *self, PyObject *args) {
+CMachine_set_gpr(CMachine *self, PyObject *args) {
     int gpr;
-    if (!PyArg_ParseTuple(args, "i", &gpr))
+    long value;
+    if (!PyArg_ParseTuple(args, "il", &gpr, &value))
         return NULL;
-
-    PyObject *gpr_val_obj = CMachine_get_gpr(self, args);
-    if (!gpr_val_obj) return NULL;
-    long val = PyLong_AsLong(gpr_val_obj);
-    Py_DECREF(gpr_val_obj);
-
-    long new_val = (val + 1) & 0xFFFFFFFF;
-    PyObject *set_args = Py_BuildValue("(il)", gpr, new_val);
-    PyObject *result = CMachine_set_gpr(self, set_args);
-    Py_DECREF(set_args);
-    return result;
+    if (gpr_write(self, gpr, value) < 0)
+        return NULL;
+    Py_RETURN_NONE;
 }
 
 static PyObject *
-CMachine_inc_gpr_wlen_bytes(CMachine *self, PyObject *args) {
+CMachine_get_gpr(CMachine *self, PyObject *args) {
     int gpr;
+    long value;
     if (!PyArg_ParseTuple(args, "i", &gpr))
         return NULL;
+    if (gpr_read(self, gpr, &value) < 0)
+        return NULL;
+    return PyLong_FromLong(value);
+}
 
-    PyObject *get_args = Py_BuildValue("(i)", gpr);
-    PyObject *gpr_val_obj = CMachine_get_gpr(self, get_args);
-    Py_DECREF(get_args);
-    if (!gpr_val_obj) return NULL;
-    long val = PyLong_AsLong(gpr_val_obj);
-    Py_DECREF(gpr_val_obj);
-
-    long new_val = (val + XLEN / 8) & 0xFFFFFFFF;
-    PyObject *set_args = Py_BuildValue("(il)", gpr, new_val);
-    PyObject *result = CMachine_set_gpr(self, set_args);
-    Py_DECREF(set_args);
-    return result;
+static PyObject *
+CMachine_inc_gpr(CMachine *self, PyObject *args) {
+    int gpr;
+    if (!PyArg_ParseTuple(args, "i", &gpr))
+        return NULL;
+    if (gpr_add(self, gpr, 1) < 0)
+        return NULL;
+    Py_RETURN_NONE;
 }
 
-/* ------------------------------------------------------------------ */
-/* CSR / WSR                                                           */
-/* ------------------------------------------------------------------ */
 static PyObject *
-CMachine_get_csr(CMachine *self, PyObject *args) {
-    int csr;
-    if (!PyArg_ParseTuple(args, "i", &csr))
+CMachine_inc_gpr_wlen_bytes(CMachine *self, PyObject *args) {
+    int gpr;
+    if (!PyArg_ParseTuple(args, "i", &gpr))
+        return NULL;
+    if (gpr_add(self, gpr, XLEN / 8) < 0)
         return NULL;
+    Py_RETURN_NONE;
+}
 
+/* ------------------------------------------------------------------ */
+/* CSR / WSR                                                           */
+/* ------------------------------------------------------------------ */
+static int csr_read(CMachine *self, long csr, long *val) {
     if (csr == CSR_FLAG) {
         /* Return flags as binary */
-        int val = self->C | (self->L << 1) | (self->M << 2) | (self->Z << 3)
-                  | (self->XC << 4) | (self->XL << 5) | (self->XM << 6) | (self->XZ << 7);
-        return PyLong_FromLong(val);
+        *val = self->flags;
+        return 0;
     }
     if ((csr & 0xFF8) == CSR_MOD_BASE) {
-        int limb_idx = csr & 0x7;
-        return PyLong_FromLong(extract_limb(self->mod, limb_idx));
+        *val = (long)self->mod[csr & 0x7];
+        return 0;
     }
     if (csr == CSR_RNG) {
-        return PyLong_FromLong(extract_limb(self->rnd, 0));
+        *val = (long)self->rnd[0];
+        return 0;
     }
-    PyErr_SetString(PyExc_ValueError, "Invalid CSR");
-    return NULL;
+    raise_error(PyExc_ValueError, "Invalid CSR");
+    return -1;
 }
 
-static PyObject *
-CMachine_set_csr(CMachine *self, PyObject *args) {
-    int csr;
-    long val;
-    if (!PyArg_ParseTuple(args, "il", &csr, &val))
-        return NULL;
-
+static int csr_write(CMachine *self, long csr, long val) {
     if (csr == CSR_FLAG) {
-        self->C  = (val >> 0) & 1;
-        self->L  = (val >> 1) & 1;
-        self->M  = (val >> 2) & 1;
-        self->Z  = (val >> 3) & 1;
-        self->XC = (val >> 4) & 1;
-        self->XL = (val >> 5) & 1;
-        self->XM = (val >> 6) & 1;
-        self->XZ = (val >> 7) & 1;
-        Py_RETURN_NONE;
+        self->flags = (uint8_t)val;
+        return 0;
     }
     if ((csr & 0xFF8) == CSR_MOD_BASE) {
-        int limb_idx = csr & 0x7;
-        PyObject *new_mod = modify_limb(self->mod, limb_idx, val, self->xlen_mask);
-        Py_DECREF(self->mod);
-        self->mod = new_mod;
-        Py_RETURN_NONE;
+        if (check_limb_value(val, 0xFFFFFFFFL, "limb value out of range") < 0)
+            return -1;
+        self->mod[csr & 0x7] = (uint32_t)val;
+        return 0;
     }
     if (csr == CSR_RNG) {
-        PyObject *new_rnd = modify_limb(self->rnd, 0, val, self->xlen_mask);
-        Py_DECREF(self->rnd);
-        self->rnd = new_rnd;
-        Py_RETURN_NONE;
+        if (check_limb_value(val, 0xFFFFFFFFL, "limb value out of range") < 0)
+            return -1;
+        self->rnd[0] = (uint32_t)val;
+        return 0;
     }
-    PyErr_SetString(PyExc_ValueError, "Invalid CSR");
+    raise_error(PyExc_ValueError, "Invalid CSR");
+    return -1;
+}
+
+/* Limbs backing a WSR; writes to the RND WSR are discarded by the
+ * caller (not writable per spec). */
+static uint32_t *wsr_limbs(CMachine *self, long wsr) {
+    if (wsr == WSR_MOD) return self->mod;
+    if (wsr == WSR_RND) return self->rnd;
+    raise_error(PyExc_ValueError, "Invalid WSR: %ld", wsr);
     return NULL;
 }
 
+static PyObject *
+CMachine_get_csr(CMachine *self, PyObject *args) {
+    int csr;
+    long val;
+    if (!PyArg_ParseTuple(args, "i", &csr))
+        return NULL;
+    if (csr_read(self, csr, &val) < 0)
+        return NULL;
+    return PyLong_FromLong(val);
+}
+
+static PyObject *
+CMachine_set_csr(CMachine *self, PyObject *args) {
+    int csr;
+    long val;
+    if (!PyArg_ParseTuple(args, "il", &csr, &val))
+        return NULL;
+    if (csr_write(self, csr, val) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
 static PyObject *
 CMachine_get_wsr(CMachine *self, PyObject *args) {
     int wsr;
     if (!PyArg_ParseTuple(args, "i", &wsr))
         return NULL;
-    if (wsr == WSR_MOD) { Py_INCREF(self->mod); return self->mod; }
-    if (wsr == WSR_RND) { Py_INCREF(self->rnd); return self->rnd; }
-    PyErr_Format(PyExc_ValueError, "Invalid WSR: %d", wsr);
-    return NULL;
+    uint32_t *limbs = wsr_limbs(self, wsr);
+    if (!limbs) return NULL;
+    return machine_pylong(self, limbs, LIMBS);
 }
 
 static PyObject *
@@ -900,9 +1330,8 @@ CMachine_set_wsr(CMachine *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "iO", &wsr, &val))
         return NULL;
     if (wsr == WSR_MOD) {
-        Py_INCREF(val);
-        Py_DECREF(self->mod);
-        self->mod = val;
+        if (pylong_to_limbs(val, self->mod, LIMBS, "register value out of range") < 0)
+            return NULL;
         Py_RETURN_NONE;
     }
     if (wsr == WSR_RND) {
@@ -916,26 +1345,52 @@ CMachine_set_wsr(CMachine *self, PyObject *args) {
 /* ------------------------------------------------------------------ */
 /* Flag operations                                                     */
 /* ------------------------------------------------------------------ */
+static inline int flag_get(const CMachine *self, int bit) {
+    return (self->flags >> bit) & 1;
+}
+
+static inline void flag_put(CMachine *self, int bit, int val) {
+    self->flags = (uint8_t)((self->flags & ~(1u << bit)) | (unsigned)(val != 0) << bit);
+}
+
+/* Replace the flags in mask (standard group bits) of group fg by bits */
+static inline void flags_put(CMachine *self, int fg, unsigned mask, unsigned bits) {
+    int shift = FLAG_GROUP_SHIFT(fg);
+    self->flags = (uint8_t)((self->flags & ~(mask << shift)) | (bits & mask) << shift);
+}
+
+/* M, L and Z of an XLEN bit result, with C = carry, as a group nibble */
+static unsigned flags_of_result(const uint32_t *res, uint32_t carry) {
+    return carry << FLAG_C | (res[LIMBS - 1] >> 31) << FLAG_M | (res[0] & 1) << FLAG_L |
+           (unsigned)limbs_is_zero(res, LIMBS) << FLAG_Z;
+}
+
+/* Group nibble of an XLEN+1 bit value: C = bit XLEN */
+static unsigned flags_of(const uint32_t *v) {
+    return flags_of_result(v, v[LIMBS] & 1);
+}
+
+static const char *const flag_names[] = {"C", "L", "M", "Z", "XC", "XL", "XM", "XZ"};
+
+static int flag_index(const char *name) {
+    for (int bit = FLAG_C; bit <= FLAG_XZ; bit++) {
+        if (strcmp(name, flag_names[bit]) == 0)
+            return bit;
+    }
+    PyErr_SetString(PyExc_ValueError, "Invalid flag identifier");
+    return -1;
+}
+
 static PyObject *
 CMachine_get_flag(CMachine *self, PyObject *args) {
     const char *flag;
     if (!PyArg_ParseTuple(args, "s", &flag))
         return NULL;
 
-    int val = 0;
-    if (strcmp(flag, "M") == 0) val = self->M;
-    else if (strcmp(flag, "L") == 0) val = self->L;
-    else if (strcmp(flag, "Z") == 0) val = self->Z;
-    else if (strcmp(flag, "C") == 0) val = self->C;
-    else if (strcmp(flag, "XM") == 0) val = self->XM;
-    else if (strcmp(flag, "XL") == 0) val = self->XL;
-    else if (strcmp(flag, "XZ") == 0) val = self->XZ;
-    else if (strcmp(flag, "XC") == 0) val = self->XC;
-    else {
-        PyErr_SetString(PyExc_ValueError, "Invalid flag identifier");
+    int bit = flag_index(flag);
+    if (bit < 0)
         return NULL;
-    }
-    return PyBool_FromLong(val);
+    return PyBool_FromLong(flag_get(self, bit));
 }
 
 static PyObject *
@@ -945,133 +1400,98 @@ CMachine_set_flag(CMachine *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "si", &flag, &val))
         return NULL;
 
-    val = val ? 1 : 0;
-    if (strcmp(flag, "M") == 0) self->M = val;
-    else if (strcmp(flag, "L") == 0) self->L = val;
-    else if (strcmp(flag, "Z") == 0) self->Z = val;
-    else if (strcmp(flag, "C") == 0) self->C = val;
-    else if (strcmp(flag, "XM") == 0) self->XM = val;
-    else if (strcmp(flag, "XL") == 0) self->XL = val;
-    else if (strcmp(flag, "XZ") == 0) self->XZ = val;
-    else if (strcmp(flag, "XC") == 0) self->XC = val;
-    else {
-        PyErr_SetString(PyExc_ValueError, "Invalid flag identifier");
+    int bit = flag_index(flag);
+    if (bit < 0)
         return NULL;
-    }
+    flag_put(self, bit, val);
     Py_RETURN_NONE;
 }
 
+/* Flag setters examine an XLEN+1 bit result: C = bit XLEN, M = bit
+ * XLEN-1, L = bit 0, Z = low XLEN bits are zero. */
+static int parse_flag_operand(PyObject *args, uint32_t *limbs) {
+    PyObject *val;
+    if (!PyArg_ParseTuple(args, "O", &val))
+        return -1;
+    return pylong_low_limbs(val, limbs, FLAG_LIMBS);
+}
+
 /* set_c_z_m_l(val) - set C, Z, M, L from 257-bit value */
 static PyObject *
 CMachine_set_c_z_m_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-
-    /* C = bit 256, M = bit 255, L = bit 0, Z = (val & xlen_mask) == 0 */
-    self->C = test_bit(val, XLEN);
-    self->M = test_bit(val, XLEN - 1);
-    self->L = test_bit(val, 0);
-    PyObject *masked = PyNumber_And(val, self->xlen_mask);
-    PyObject *zero = PyLong_FromLong(0);
-    self->Z = PyObject_RichCompareBool(masked, zero, Py_EQ);
-    Py_DECREF(masked);
-    Py_DECREF(zero);
+    flags_put(self, 0, 1 << FLAG_C | 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_setx_c_z_m_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-
-    self->XC = test_bit(val, XLEN);
-    self->XM = test_bit(val, XLEN - 1);
-    self->XL = test_bit(val, 0);
-    PyObject *masked = PyNumber_And(val, self->xlen_mask);
-    PyObject *zero = PyLong_FromLong(0);
-    self->XZ = PyObject_RichCompareBool(masked, zero, Py_EQ);
-    Py_DECREF(masked);
-    Py_DECREF(zero);
+    flags_put(self, 1, 1 << FLAG_C | 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_set_z_m_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-
-    PyObject *masked = PyNumber_And(val, self->xlen_mask);
-    PyObject *zero = PyLong_FromLong(0);
-    self->Z = PyObject_RichCompareBool(masked, zero, Py_EQ);
-    Py_DECREF(masked);
-    Py_DECREF(zero);
-    self->M = test_bit(val, XLEN - 1);
-    self->L = test_bit(val, 0);
+    flags_put(self, 0, 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_setx_z_m_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-
-    PyObject *masked = PyNumber_And(val, self->xlen_mask);
-    PyObject *zero = PyLong_FromLong(0);
-    self->XZ = PyObject_RichCompareBool(masked, zero, Py_EQ);
-    Py_DECREF(masked);
-    Py_DECREF(zero);
-    self->XM = test_bit(val, XLEN - 1);
-    self->XL = test_bit(val, 0);
+    flags_put(self, 1, 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_set_c_m(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-    self->C = test_bit(val, XLEN);
-    self->M = test_bit(val, XLEN - 1);
+    flags_put(self, 0, 1 << FLAG_C | 1 << FLAG_M, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_setx_c_m(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-    self->XC = test_bit(val, XLEN);
-    self->XM = test_bit(val, XLEN - 1);
+    flags_put(self, 1, 1 << FLAG_C | 1 << FLAG_M, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_set_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-    self->L = test_bit(val, 0);
+    flags_put(self, 0, 1 << FLAG_L, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_setx_l(CMachine *self, PyObject *args) {
-    PyObject *val;
-    if (!PyArg_ParseTuple(args, "O", &val))
+    uint32_t v[FLAG_LIMBS];
+    if (parse_flag_operand(args, v) < 0)
         return NULL;
-    self->XL = test_bit(val, 0);
+    flags_put(self, 1, 1 << FLAG_L, flags_of(v));
     Py_RETURN_NONE;
 }
 
 static PyObject *
 CMachine_get_flags_as_bin(CMachine *self, PyObject *Py_UNUSED(args)) {
-    int val = self->C | (self->L << 1) | (self->M << 2) | (self->Z << 3)
-              | (self->XC << 4) | (self->XL << 5) | (self->XM << 6) | (self->XZ << 7);
-    return PyLong_FromLong(val);
+    return PyLong_FromLong(self->flags);
 }
 
 static PyObject *
@@ -1079,14 +1499,7 @@ CMachine_set_flags_as_bin(CMachine *self, PyObject *args) {
     int flags;
     if (!PyArg_ParseTuple(args, "i", &flags))
         return NULL;
-    self->C  = (flags >> 0) & 1;
-    self->L  = (flags >> 1) & 1;
-    self->M  = (flags >> 2) & 1;
-    self->Z  = (flags >> 3) & 1;
-    self->XC = (flags >> 4) & 1;
-    self->XL = (flags >> 5) & 1;
-    self->XM = (flags >> 6) & 1;
-    self->XZ = (flags >> 7) & 1;
+    self->flags = (uint8_t)flags;
     Py_RETURN_NONE;
 }
 
@@ -1095,8 +1508,7 @@ CMachine_set_flags_as_bin(CMachine *self, PyObject *args) {
 /* ------------------------------------------------------------------ */
 static PyObject *
 CMachine_get_acc(CMachine *self, PyObject *Py_UNUSED(args)) {
-    Py_INCREF(self->acc);
-    return self->acc;
+    return machine_pylong(self, self->acc, ACC_LIMBS);
 }
 
 static PyObject *
@@ -1104,9 +1516,8 @@ CMachine_set_acc(CMachine *self, PyObject *args) {
     PyObject *val;
     if (!PyArg_ParseTuple(args, "O", &val))
         return NULL;
-    Py_INCREF(val);
-    Py_DECREF(self->acc);
-    self->acc = val;
+    if (pylong_to_limbs(val, self->acc, ACC_LIMBS, "accumulator value out of range") < 0)
+        return NULL;
     Py_RETURN_NONE;
 }
 
@@ -1124,8 +1535,8 @@ CMachine_set_pc(CMachine *self, PyObject *args) {
     int clearfinish = 0;
     if (!PyArg_ParseTuple(args, "l|p", &pc, &clearfinish))
         return NULL;
-    if (pc < 0 || pc >= PyList_Size(self->imem)) {
-        PyErr_Format(PyExc_IndexError, "Address %ld out of range (0 to %zd)", pc, PyList_Size(self->imem));
+    if (pc < 0 || pc >= imem_len(self)) {
+        PyErr_Format(PyExc_IndexError, "Address %ld out of range (0 to %zd)", pc, imem_len(self));
         return NULL;
     }
     self->pc = pc;
@@ -1137,7 +1548,7 @@ CMachine_set_pc(CMachine *self, PyObject *args) {
 static PyObject *
 CMachine_inc_pc(CMachine *self, PyObject *Py_UNUSED(args)) {
     long new_pc = self->pc + 1;
-    if (new_pc < 0 || new_pc >= PyList_Size(self->imem)) {
+    if (new_pc < 0 || new_pc >= imem_len(self)) {
         PyErr_Format(PyExc_IndexError, "PC increment out of range");
         return NULL;
     }
@@ -1148,43 +1559,69 @@ CMachine_inc_pc(CMachine *self, PyObject *Py_UNUSED(args)) {
 /* ------------------------------------------------------------------ */
 /* DMEM operations                                                     */
 /* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_get_dmem(CMachine *self, PyObject *args) {
-    long address;
-    if (!PyArg_ParseTuple(args, "l", &address))
+
+/* Limbs of the DMEM cell at a word address, warning (like the Python
+ * Machine) when the cell was never written. */
+static uint32_t *dmem_read_cell(CMachine *self, long address) {
+    if (address < 0 || address >= DMEM_DEPTH) {
+        raise_error(PyExc_IndexError, "DMEM address out of range");
         return NULL;
+    }
+    if (!self->init_dmem[address]) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PySys_WriteStderr("Warning: reading from uninitialized dmem memory address: 0x%lx\n", address);
+        PyGILState_Release(gil);
+    }
+    return self->dmem[address];
+}
+
+static uint32_t *dmem_write_cell(CMachine *self, long address) {
     if (address < 0 || address >= DMEM_DEPTH) {
-        PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
+        raise_error(PyExc_IndexError, "DMEM address out of range");
         return NULL;
     }
+    self->init_dmem[address] = 1;
+    watch_dmem_write(self, address);
+    return self->dmem[address];
+}
 
-    PyObject *init = PyList_GetItem(self->init_dmem, address);
-    if (init == Py_False) {
-        PySys_WriteStderr("Warning: reading from uninitialized dmem memory address: 0x%lx\n", address);
+/* 32-bit limb at an OTBN byte address (LW/SW). */
+static uint32_t *dmem_otbn_limb(CMachine *self, long address) {
+    long dmem_addr = address / 32;
+    int limb = (int)((address % 32) / 4);
+    if (address < 0 || dmem_addr >= DMEM_DEPTH) {
+        raise_error(PyExc_IndexError, "DMEM address out of range");
+        return NULL;
     }
+    return &self->dmem[dmem_addr][limb];
+}
 
-    PyObject *val = PyList_GetItem(self->dmem, address);
-    Py_INCREF(val);
-    return val;
+static PyObject *
+CMachine_get_dmem(CMachine *self, PyObject *args) {
+    long address;
+    if (!PyArg_ParseTuple(args, "l", &address))
+        return NULL;
+    uint32_t *cell = dmem_read_cell(self, address);
+    if (!cell) return NULL;
+    self->perf.dmem_host_bytes += XLEN_BYTES;
+    return machine_pylong(self, cell, LIMBS);
 }
 
 static PyObject *
 CMachine_set_dmem(CMachine *self, PyObject *args) {
     long address;
     PyObject *value;
+    uint32_t limbs[LIMBS];
     if (!PyArg_ParseTuple(args, "lO", &address, &value))
         return NULL;
     if (address < 0 || address >= DMEM_DEPTH) {
         PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
         return NULL;
     }
-    if (check_val_range(value, self->xlen_mask, "DMEM value out of range") < 0)
+    if (pylong_to_limbs(value, limbs, LIMBS, "DMEM value out of range") < 0)
         return NULL;
-
-    Py_INCREF(value);
-    PyList_SetItem(self->dmem, address, value);  /* steals ref */
-    Py_INCREF(Py_True);
-    PyList_SetItem(self->init_dmem, address, Py_True);  /* steals ref */
+    memcpy(dmem_write_cell(self, address), limbs, sizeof(limbs));
+    self->perf.dmem_host_bytes += XLEN_BYTES;
     Py_RETURN_NONE;
 }
 
@@ -1193,15 +1630,10 @@ CMachine_get_dmem_otbn(CMachine *self, PyObject *args) {
     long address;
     if (!PyArg_ParseTuple(args, "l", &address))
         return NULL;
-    long dmem_addr = address / 32;
-    int limb = (int)((address % 32) / 4);
-    if (dmem_addr < 0 || dmem_addr >= DMEM_DEPTH) {
-        PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
-        return NULL;
-    }
-    PyObject *cell = PyList_GetItem(self->dmem, dmem_addr);
-    long val = extract_limb(cell, limb);
-    return PyLong_FromLong(val);
+    uint32_t *limb = dmem_otbn_limb(self, address);
+    if (!limb) return NULL;
+    self->perf.dmem_host_bytes += 4;
+    return PyLong_FromUnsignedLong(*limb);
 }
 
 static PyObject *
@@ -1210,20 +1642,87 @@ CMachine_set_dmem_otbn(CMachine *self, PyObject *args) {
     long value;
     if (!PyArg_ParseTuple(args, "ll", &address, &value))
         return NULL;
-    long dmem_addr = address / 32;
-    int limb = (int)((address % 32) / 4);
-    if (dmem_addr < 0 || dmem_addr >= DMEM_DEPTH) {
+    uint32_t *limb = dmem_otbn_limb(self, address);
+    if (!limb) return NULL;
+    if (check_limb_value(value, 0xFFFFFFFFL, "limb value out of range") < 0)
+        return NULL;
+    *limb = (uint32_t)value;
+    self->init_dmem[address / 32] = 1;
+    watch_dmem_write(self, address / 32);
+    self->perf.dmem_host_bytes += 4;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_get_dmem_bytes(CMachine *self, PyObject *args) {
+    long address = 0;
+    long count = -1;
+    if (!PyArg_ParseTuple(args, "|ll", &address, &count))
+        return NULL;
+    if (dmem_bytes_check() < 0)
+        return NULL;
+    if (address < 0 || address > DMEM_DEPTH) {
+        PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
+        return NULL;
+    }
+    if (count < 0)
+        count = DMEM_DEPTH - address;
+    if (count > DMEM_DEPTH - address) {
         PyErr_SetString(PyExc_IndexError, "DMEM address out of range");
         return NULL;
     }
-    PyObject *cell = PyList_GetItem(self->dmem, dmem_addr);
-    PyObject *new_val = modify_limb(cell, limb, value, self->xlen_mask);
-    PyList_SetItem(self->dmem, dmem_addr, new_val); /* steals ref */
-    Py_INCREF(Py_True);
-    PyList_SetItem(self->init_dmem, dmem_addr, Py_True);
+    uint64_t start = perf_now();
+    PyObject *res = PyBytes_FromStringAndSize((const char *)self->dmem[address],
+                                              (Py_ssize_t)count * LIMBS * 4);
+    self->perf.dmem_host_bytes += (uint64_t)count * XLEN_BYTES;
+    self->perf.readback_ns += perf_now() - start;
+    return res;
+}
+
+static PyObject *
+CMachine_set_dmem_bytes(CMachine *self, PyObject *args) {
+    long address;
+    PyObject *data;
+    if (!PyArg_ParseTuple(args, "lO", &address, &data))
+        return NULL;
+    if (machine_idle_check(self) < 0 || write_dmem_bytes(self, address, data) < 0)
+        return NULL;
     Py_RETURN_NONE;
 }
 
+/* Buffer protocol: the machine exports DMEM as DMEM_DEPTH * 32 writable
+ * little-endian bytes.  Writes through the view land in DMEM directly
+ * and do not touch init_dmem; set_dmem_bytes() is the tracked path. */
+static int CMachine_getbuffer(CMachine *self, Py_buffer *view, int flags) {
+    if (dmem_bytes_check() < 0) {
+        view->obj = NULL;
+        return -1;
+    }
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->dmem, sizeof(self->dmem), 0, flags);
+}
+
+static PyBufferProcs CMachine_as_buffer = {
+    .bf_getbuffer = (getbufferproc)CMachine_getbuffer,
+};
+
+/* New list of Python ints holding the current DMEM contents. */
+static PyObject *dmem_to_list(CMachine *self) {
+    uint64_t start = perf_now();
+    PyObject *lst = PyList_New(DMEM_DEPTH);
+    if (!lst) return NULL;
+    for (Py_ssize_t i = 0; i < DMEM_DEPTH; i++) {
+        PyObject *v = machine_pylong(self, self->dmem[i], LIMBS);
+        if (!v) {
+            Py_DECREF(lst);
+            return NULL;
+        }
+        PyList_SET_ITEM(lst, i, v);
+    }
+    self->perf.dmem_host_bytes += sizeof(self->dmem);
+    self->perf.readback_ns += perf_now() - start;
+    return lst;
+}
+
 /* ------------------------------------------------------------------ */
 /* Loop stack                                                          */
 /* ------------------------------------------------------------------ */
@@ -1317,13 +1816,11 @@ CMachine_get_instruction(CMachine *self, PyObject *args) {
     long address;
     if (!PyArg_ParseTuple(args, "l", &address))
         return NULL;
-    if (address < 0 || address >= PyList_Size(self->imem)) {
-        PyErr_Format(PyExc_IndexError, "Address %ld out of range (0 to %zd)", address, PyList_Size(self->imem));
+    if (address < 0 || address >= imem_len(self)) {
+        PyErr_Format(PyExc_IndexError, "Address %ld out of range (0 to %zd)", address, imem_len(self));
         return NULL;
     }
-    PyObject *instr = PyList_GetItem(self->imem, address);
-    Py_INCREF(instr);
-    return instr;
+    return PySequence_GetItem(self->imem, address);
 }
 
 /* ------------------------------------------------------------------ */
@@ -1344,18 +1841,7 @@ CMachine_finish(CMachine *self, PyObject *args, PyObject *kwargs) {
 /* ------------------------------------------------------------------ */
 static PyObject *
 CMachine_clear_regs(CMachine *self, PyObject *Py_UNUSED(args)) {
-    for (int i = 0; i < NUM_REGS; i++) {
-        Py_DECREF(self->r[i]);
-        self->r[i] = py_zero();
-    }
-    Py_DECREF(self->mod); self->mod = py_zero();
-    Py_DECREF(self->dmp); self->dmp = py_zero();
-    Py_DECREF(self->rfp); self->rfp = py_zero();
-    Py_DECREF(self->lc);  self->lc = py_zero();
-    Py_DECREF(self->rnd);
-    self->rnd = PyLong_FromString(
-        "9999999999999999999999999999999999999999999999999999999999999999", NULL, 16);
-    Py_DECREF(self->acc); self->acc = py_zero();
+    clear_wide_regs(self);
     self->pc = 0;
     memset(self->gpr, 0, sizeof(self->gpr));
     Py_RETURN_NONE;
@@ -1376,53 +1862,42 @@ CMachine_reset(CMachine *self, PyObject *args, PyObject *kwds) {
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|lOp", kwlist,
                                       &dmem_list, &imem_list, &s_addr, &stop_addr_obj, &clear_regs))
         return NULL;
+    if (machine_idle_check(self) < 0)
+        return NULL;
 
     /* Flags */
-    self->M = self->L = self->Z = self->C = 0;
-    self->XM = self->XL = self->XZ = self->XC = 0;
+    self->flags = 0;
 
     if (clear_regs) {
         CMachine_clear_regs(self, NULL);
     }
 
     /* Valid half limbs */
-    for (int i = 0; i < NUM_REGS; i++)
-        for (int j = 0; j < LIMBS * 2; j++)
-            self->r_valid_half_limbs[i][j] = 0;
+    memset(self->r_valid_half_limbs, 0, sizeof(self->r_valid_half_limbs));
 
     /* DMEM */
-    Py_ssize_t dmem_len = PyList_Size(dmem_list);
-    Py_DECREF(self->dmem);
-    Py_DECREF(self->init_dmem);
-    self->dmem = PyList_New(DMEM_DEPTH);
-    self->init_dmem = PyList_New(DMEM_DEPTH);
-    for (Py_ssize_t i = 0; i < DMEM_DEPTH; i++) {
-        if (i < dmem_len) {
-            PyObject *item = PyList_GetItem(dmem_list, i);
-            Py_INCREF(item);
-            PyList_SET_ITEM(self->dmem, i, item);
-            Py_INCREF(Py_True);
-            PyList_SET_ITEM(self->init_dmem, i, Py_True);
-        } else {
-            PyList_SET_ITEM(self->dmem, i, py_zero());
-            Py_INCREF(Py_False);
-            PyList_SET_ITEM(self->init_dmem, i, Py_False);
-        }
-    }
+    if (load_dmem(self, dmem_list) < 0)
+        return NULL;
 
     /* IMEM */
-    Py_DECREF(self->imem);
-    Py_INCREF(imem_list);
-    self->imem = imem_list;
+    if (stats_flush(self) < 0)
+        return NULL;
+    if (load_imem(self, imem_list) < 0)
+        return NULL;
 
     /* Loop/call stacks */
     self->loop_sp = 0;
     self->call_sp = 0;
+    self->break_resume = 0;
+
+    /* No hazards from before the reset */
+    self->hz_wdr = self->hz_gpr = 0;
+    self->hz_acc = 0;
 
     /* PC */
     self->pc = s_addr;
     if (stop_addr_obj == Py_None || stop_addr_obj == NULL) {
-        self->stop_addr = PyList_Size(imem_list) - 1;
+        self->stop_addr = imem_len(self) - 1;
     } else {
         self->stop_addr = PyLong_AsLong(stop_addr_obj);
     }
@@ -1430,6 +1905,197 @@ CMachine_reset(CMachine *self, PyObject *args, PyObject *kwds) {
     Py_RETURN_NONE;
 }
 
+/* ------------------------------------------------------------------ */
+/* Snapshots                                                           */
+/* ------------------------------------------------------------------ */
+
+/* snapshot() packs the architectural state into a bytes blob that
+ * restore() copies back, so a warmed-up machine (e.g. after modload) can
+ * be rewound without rebuilding lists or re-running setup.  The program,
+ * ctx, breakpoints, stats and trace are not part of the state; the
+ * hazards the last op left are, so a restored run stalls as the
+ * original did.
+ *
+ * The blob is SNAPSHOT_MAGIC followed by each field below, raw and in
+ * order.  loop_sp and call_sp come first so restore() can bounds-check
+ * them before touching the machine. */
+#define SNAPSHOT_MAGIC "OTDSTATE"
+#define SNAPSHOT_MAGIC_LEN 8
+
+#define SNAPSHOT_FIELDS(X) \
+    X(loop_sp) X(call_sp) \
+    X(r) X(mod) X(dmp) X(rfp) X(lc) X(rnd) X(acc) X(gpr) \
+    X(flags) \
+    X(pc) X(stop_addr) X(finishFlag) \
+    X(dmem) X(init_dmem) X(loop_stack) X(call_stack) \
+    X(r_valid_half_limbs) \
+    X(fb_active) X(fb_consider_callstack) X(fb_callstack) \
+    X(fb_consider_loopstack) X(fb_loopstack) X(break_resume) \
+    X(hz_wdr) X(hz_gpr) X(hz_acc)
+
+static size_t snapshot_size(void) {
+    size_t n = SNAPSHOT_MAGIC_LEN;
+#define X(f) n += sizeof(((CMachine *)0)->f);
+    SNAPSHOT_FIELDS(X)
+#undef X
+    return n;
+}
+
+/* Copy the architectural state of src into dst. */
+static void copy_state(CMachine *dst, const CMachine *src) {
+#define X(f) memcpy(&dst->f, &src->f, sizeof(dst->f));
+    SNAPSHOT_FIELDS(X)
+#undef X
+}
+
+/* snapshot() -> bytes */
+static PyObject *
+CMachine_snapshot(CMachine *self, PyObject *Py_UNUSED(args)) {
+    PyObject *blob = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)snapshot_size());
+    if (!blob) return NULL;
+    char *p = PyBytes_AS_STRING(blob);
+    memcpy(p, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+    p += SNAPSHOT_MAGIC_LEN;
+#define X(f) memcpy(p, &self->f, sizeof(self->f)); p += sizeof(self->f);
+    SNAPSHOT_FIELDS(X)
+#undef X
+    return blob;
+}
+
+/* restore(blob): rewind to the state captured by snapshot() */
+static PyObject *
+CMachine_restore(CMachine *self, PyObject *args) {
+    Py_buffer view;
+    int loop_sp, call_sp;
+    if (machine_idle_check(self) < 0)
+        return NULL;
+    if (!PyArg_ParseTuple(args, "y*", &view))
+        return NULL;
+    const char *p = view.buf;
+    if ((size_t)view.len != snapshot_size() ||
+        memcmp(p, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "not a snapshot of this machine type");
+        return NULL;
+    }
+    p += SNAPSHOT_MAGIC_LEN;
+    memcpy(&loop_sp, p, sizeof(loop_sp));
+    memcpy(&call_sp, p + sizeof(loop_sp), sizeof(call_sp));
+    if (loop_sp < 0 || loop_sp > LOOP_STACK_SZ || call_sp < 0 || call_sp > CALL_STACK_SZ) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "corrupt snapshot");
+        return NULL;
+    }
+#define X(f) memcpy(&self->f, p, sizeof(self->f)); p += sizeof(self->f);
+    SNAPSHOT_FIELDS(X)
+#undef X
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+/* fork() -> new machine of the same type running the same program from
+ * a copy of this state.  Breakpoints (with their pass counters),
+ * watchpoints and the timing model are copied; stats and the profile
+ * start empty. */
+static PyObject *
+CMachine_fork(CMachine *self, PyObject *Py_UNUSED(args)) {
+    PyObject *empty = PyList_New(0);
+    if (!empty) return NULL;
+    PyObject *clone = PyObject_CallFunction((PyObject *)Py_TYPE(self), "OOlOO",
+                                            empty, self->program ? self->program : self->imem,
+                                            self->pc, Py_None, self->ctx);
+    Py_DECREF(empty);
+    if (!clone) return NULL;
+    if (!PyObject_TypeCheck(clone, &CMachineType)) {
+        Py_DECREF(clone);
+        PyErr_SetString(PyExc_TypeError, "fork() constructor did not return a CMachine");
+        return NULL;
+    }
+    CMachine *c = (CMachine *)clone;
+    memcpy(c->bp_map, self->bp_map, sizeof(c->bp_map));
+    memcpy(c->bp_passes, self->bp_passes, sizeof(c->bp_passes));
+    memcpy(c->bp_count, self->bp_count, sizeof(c->bp_count));
+    c->n_breakpoints = self->n_breakpoints;
+    memcpy(c->watch_dmem, self->watch_dmem, sizeof(c->watch_dmem));
+    c->watch_wdr = self->watch_wdr;
+    c->n_watch = self->n_watch;
+    timing_copy(&c->timing, &self->timing);
+    copy_state(c, self);
+    return clone;
+}
+
+/* ------------------------------------------------------------------ */
+/* State image                                                         */
+/* ------------------------------------------------------------------ */
+
+/* state_bytes() is a canonical image of the architectural state which
+ * _PyMachine.state_bytes() reproduces byte for byte, so the two engines
+ * can be compared by digest (see lockstep() in machine.py).  Unlike a
+ * snapshot it is independent of struct layout and host.  All fields are
+ * little endian, stack slots above the stack pointer are zero:
+ *
+ *   r[NUM_REGS] 32 B, mod dmp rfp lc rnd 32 B each, acc 64 B,
+ *   gpr[NUM_GPRS] u32, u8 flags (get_flags_as_bin() layout),
+ *   u8 finishFlag, u32 pc,
+ *   u8 loop_sp, LOOP_STACK_SZ x (u32 cnt, u32 end_addr, u32 start_addr),
+ *   u8 call_sp, CALL_STACK_SZ x u32,
+ *   NUM_REGS x u16 valid half limb mask (bit j: half limb j),
+ *   dmem[DMEM_DEPTH] 32 B
+ *
+ * stop_addr, init_dmem and the debugger state are left out. */
+#define STATE_BYTES_SIZE                                                 \
+    (NUM_REGS * 4 * LIMBS + 5 * 4 * LIMBS + 4 * ACC_LIMBS + 4 * NUM_GPRS \
+     + 1 + 1 + 4 + 1 + 12 * LOOP_STACK_SZ + 1 + 4 * CALL_STACK_SZ       \
+     + 2 * NUM_REGS + DMEM_DEPTH * 4 * LIMBS)
+
+static uint8_t *put_limbs(uint8_t *p, const uint32_t *limbs, int n) {
+    for (int i = 0; i < n; i++, p += 4)
+        put_le32(p, limbs[i]);
+    return p;
+}
+
+/* state_bytes() -> bytes */
+static PyObject *
+CMachine_state_bytes(CMachine *self, PyObject *Py_UNUSED(args)) {
+    uint64_t start = perf_now();
+    PyObject *blob = PyBytes_FromStringAndSize(NULL, STATE_BYTES_SIZE);
+    if (!blob) return NULL;
+    uint8_t *p = (uint8_t *)PyBytes_AS_STRING(blob);
+    memset(p, 0, STATE_BYTES_SIZE);
+    for (int i = 0; i < NUM_REGS; i++)
+        p = put_limbs(p, self->r[i], LIMBS);
+    p = put_limbs(p, self->mod, LIMBS);
+    p = put_limbs(p, self->dmp, LIMBS);
+    p = put_limbs(p, self->rfp, LIMBS);
+    p = put_limbs(p, self->lc, LIMBS);
+    p = put_limbs(p, self->rnd, LIMBS);
+    p = put_limbs(p, self->acc, ACC_LIMBS);
+    for (int i = 0; i < NUM_GPRS; i++, p += 4)
+        put_le32(p, (uint32_t)self->gpr[i]);
+    *p++ = self->flags;
+    *p++ = self->finishFlag ? 1 : 0;
+    put_le32(p, (uint32_t)self->pc);
+    p += 4;
+    *p++ = (uint8_t)self->loop_sp;
+    for (int i = 0; i < self->loop_sp; i++) {
+        put_le32(p + 12 * i, (uint32_t)self->loop_stack[i].cnt);
+        put_le32(p + 12 * i + 4, (uint32_t)self->loop_stack[i].end_addr);
+        put_le32(p + 12 * i + 8, (uint32_t)self->loop_stack[i].start_addr);
+    }
+    p += 12 * LOOP_STACK_SZ;
+    *p++ = (uint8_t)self->call_sp;
+    for (int i = 0; i < self->call_sp; i++)
+        put_le32(p + 4 * i, (uint32_t)self->call_stack[i]);
+    p += 4 * CALL_STACK_SZ;
+    for (int i = 0; i < NUM_REGS; i++, p += 2)
+        put_le16(p, self->r_valid_half_limbs[i]);
+    for (int i = 0; i < DMEM_DEPTH; i++)
+        p = put_limbs(p, self->dmem[i], LIMBS);
+    self->perf.dmem_host_bytes += sizeof(self->dmem);
+    self->perf.readback_ns += perf_now() - start;
+    return blob;
+}
+
 /* ------------------------------------------------------------------ */
 /* Hex formatting (matching Python Machine)                            */
 /* ------------------------------------------------------------------ */
@@ -1437,23 +2103,33 @@ static PyObject *
 CMachine_get_limb_hex_str(CMachine *self, PyObject *args) {
     PyObject *val;
     int idx;
+    uint32_t limbs[LIMBS];
     if (!PyArg_ParseTuple(args, "Oi", &val, &idx))
         return NULL;
-    long limb = extract_limb(val, idx);
-    return PyUnicode_FromFormat("0x%08lx", limb);
+    if (idx < 0 || idx >= LIMBS) {
+        PyErr_SetString(PyExc_IndexError, "limb index out of range");
+        return NULL;
+    }
+    if (pylong_low_limbs(val, limbs, LIMBS) < 0)
+        return NULL;
+    char buf[16];
+    snprintf(buf, sizeof(buf), "0x%08lx", (unsigned long)limbs[idx]);
+    return PyUnicode_FromString(buf);
 }
 
 static PyObject *
 CMachine_get_xlen_hex_str(CMachine *self, PyObject *args) {
     PyObject *val;
+    uint32_t limbs[LIMBS];
     if (!PyArg_ParseTuple(args, "O", &val))
         return NULL;
+    if (pylong_low_limbs(val, limbs, LIMBS) < 0)
+        return NULL;
 
     char buf[80];
     int pos = 0;
     for (int i = LIMBS - 1; i >= 0; i--) {
-        long limb = extract_limb(val, i);
-        pos += snprintf(buf + pos, sizeof(buf) - pos, "%08lx", limb);
+        pos += snprintf(buf + pos, sizeof(buf) - pos, "%08lx", (unsigned long)limbs[i]);
         if (i > 0)
             buf[pos++] = ' ';
     }
@@ -1466,332 +2142,4786 @@ CMachine_get_xlen_hex_str(CMachine *self, PyObject *args) {
 /* ------------------------------------------------------------------ */
 static PyObject *
 CMachine_get_full_dmem(CMachine *self, PyObject *Py_UNUSED(args)) {
-    Py_INCREF(self->dmem);
-    return self->dmem;
+    return dmem_to_list(self);
 }
 
 /* ------------------------------------------------------------------ */
-/* stat_record_instr (delegated to Python stats dict)                  */
+/* Breakpoint operations                                               */
 /* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_stat_record_instr(CMachine *self, PyObject *args) {
-    PyObject *instr;
-    if (!PyArg_ParseTuple(args, "O", &instr))
-        return NULL;
+/* Breakpoints live in bp_map (one bit per IMEM address) with the passes
+ * required and the pass counter in bp_passes/bp_count; the breakpoints
+ * attribute builds the {addr: (passes, counter)} dict from them. */
+static int bp_is_set(const CMachine *self, long addr) {
+    return addr >= 0 && addr < IMEM_DEPTH && ((self->bp_map[addr >> 6] >> (addr & 63)) & 1);
+}
 
-    /* instr.get_asm_str() -> (encoding, asm_str) */
-    PyObject *asm_result = PyObject_CallMethod(instr, "get_asm_str", NULL);
-    if (!asm_result) return NULL;
-
-    PyObject *asm_str = PyTuple_GetItem(asm_result, 1);
-    /* Split on space, take first token, strip */
-    PyObject *parts = PyUnicode_Split(asm_str, NULL, 1);
-    PyObject *opcode = PyList_GetItem(parts, 0);
-    PyObject *stripped = PyObject_CallMethod(opcode, "strip", NULL);
-
-    /* stats['instruction_histo'] counter */
-    PyObject *key = PyUnicode_FromString("instruction_histo");
-    PyObject *histo = PyDict_GetItem(self->stats, key);
-    if (!histo) {
-        /* import collections.Counter */
-        PyObject *collections = PyImport_ImportModule("collections");
-        PyObject *counter_cls = PyObject_GetAttrString(collections, "Counter");
-        histo = PyObject_CallNoArgs(counter_cls);
-        PyDict_SetItem(self->stats, key, histo);
-        Py_DECREF(counter_cls);
-        Py_DECREF(collections);
-        /* histo is now borrowed from dict + our extra ref */
-    } else {
-        Py_INCREF(histo);
+static void bp_set(CMachine *self, long addr, long passes, long count) {
+    if (!bp_is_set(self, addr)) {
+        self->bp_map[addr >> 6] |= (uint64_t)1 << (addr & 63);
+        self->n_breakpoints++;
     }
+    self->bp_passes[addr] = passes;
+    self->bp_count[addr] = count;
+}
 
-    /* histo[stripped] += 1 */
-    PyObject *cur = PyObject_GetItem(histo, stripped);
-    if (!cur) {
-        PyErr_Clear();
-        cur = PyLong_FromLong(0);
+static void bp_clear(CMachine *self, long addr) {
+    if (bp_is_set(self, addr)) {
+        self->bp_map[addr >> 6] &= ~((uint64_t)1 << (addr & 63));
+        self->n_breakpoints--;
     }
-    PyObject *one = PyLong_FromLong(1);
-    PyObject *new_cnt = PyNumber_Add(cur, one);
-    PyObject_SetItem(histo, stripped, new_cnt);
+}
 
-    Py_DECREF(new_cnt);
-    Py_DECREF(one);
-    Py_DECREF(cur);
-    Py_DECREF(histo);
-    Py_DECREF(key);
-    Py_DECREF(stripped);
-    Py_DECREF(parts);
-    Py_DECREF(asm_result);
+static void bp_clear_all(CMachine *self) {
+    memset(self->bp_map, 0, sizeof(self->bp_map));
+    self->n_breakpoints = 0;
+}
 
-    Py_RETURN_NONE;
+/* First armed address in [from, to), or to. */
+static long bp_next(const CMachine *self, long from, long to) {
+    if (!self->n_breakpoints)
+        return to;
+    if (from < 0)
+        from = 0;
+    long end = to < IMEM_DEPTH ? to : IMEM_DEPTH;
+    while (from < end) {
+        uint64_t word = self->bp_map[from >> 6] >> (from & 63);
+        if (word) {
+            long addr = from + ctz64(word);
+            return addr < end ? addr : to;
+        }
+        from = (from | 63) + 1;
+    }
+    return to;
 }
 
-/* ------------------------------------------------------------------ */
-/* Breakpoint operations (minimal for now)                             */
-/* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_get_breakpoints(CMachine *self, PyObject *Py_UNUSED(args)) {
-    Py_INCREF(self->breakpoints);
-    return self->breakpoints;
+static PyObject *breakpoints_dict(CMachine *self) {
+    PyObject *res = PyDict_New();
+    if (!res) return NULL;
+    for (long addr = bp_next(self, 0, IMEM_DEPTH); addr < IMEM_DEPTH;
+         addr = bp_next(self, addr + 1, IMEM_DEPTH)) {
+        PyObject *key = PyLong_FromLong(addr);
+        PyObject *val = Py_BuildValue("(ll)", self->bp_passes[addr], self->bp_count[addr]);
+        if (!key || !val || PyDict_SetItem(res, key, val) < 0) {
+            Py_XDECREF(key);
+            Py_XDECREF(val);
+            Py_DECREF(res);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(val);
+    }
+    return res;
 }
 
-static PyObject *
-CMachine_toggle_breakpoint(CMachine *self, PyObject *args) {
-    PyObject *bp;
+/* Replace all breakpoints by a {addr: (passes, counter)} mapping */
+static int load_breakpoints(CMachine *self, PyObject *mapping) {
+    PyObject *items = PyMapping_Items(mapping);
+    if (!items) return -1;
+    bp_clear_all(self);
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+        long addr, passes, count;
+        if (!PyArg_ParseTuple(PyList_GET_ITEM(items, i), "l(ll)", &addr, &passes, &count)) {
+            Py_DECREF(items);
+            return -1;
+        }
+        if (addr >= 0 && addr < IMEM_DEPTH)
+            bp_set(self, addr, passes, count);
+    }
+    Py_DECREF(items);
+    return 0;
+}
+
+/* Name -> address lookup in a ctx table mapping addresses to names */
+static int ctx_name_addr(PyObject *ctx, const char *table_name, PyObject *name, long *addr) {
+    PyObject *table = PyObject_GetAttrString(ctx, table_name);
+    if (!table) {
+        PyErr_Clear();
+        return 0;
+    }
+    int found = 0;
+    if (PyDict_Check(table)) {
+        Py_ssize_t pos = 0;
+        PyObject *key, *val;
+        while (PyDict_Next(table, &pos, &key, &val)) {
+            if (PyUnicode_Check(val) && PyUnicode_Compare(val, name) == 0) {
+                *addr = PyLong_AsLong(key);
+                found = 1;
+                break;
+            }
+        }
+    }
+    Py_DECREF(table);
+    return found;
+}
+
+/* Breakpoint address from an int, a decimal or 0x-prefixed hex string,
+ * or a function or label name of ctx (functions first). */
+static int resolve_bp_addr(CMachine *self, PyObject *bp, long *addr) {
+    if (PyLong_Check(bp)) {
+        *addr = PyLong_AsLong(bp);
+        return (*addr == -1 && PyErr_Occurred()) ? -1 : 0;
+    }
+    if (!PyUnicode_Check(bp)) {
+        PyErr_SetString(PyExc_TypeError, "breakpoint must be int or str");
+        return -1;
+    }
+    const char *s = PyUnicode_AsUTF8(bp);
+    if (!s) return -1;
+    char *endp;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+        *addr = strtol(s + 2, &endp, 16);
+    else
+        *addr = strtol(s, &endp, 10);
+    if (*s && *endp == '\0')
+        return 0;
+
+    if (self->ctx == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "Label breakpoints only possible with assembly context");
+        return -1;
+    }
+    if (ctx_name_addr(self->ctx, "functions", bp, addr) ||
+        ctx_name_addr(self->ctx, "labels", bp, addr))
+        return PyErr_Occurred() ? -1 : 0;
+    PyErr_Format(PyExc_ValueError, "function or label '%s' not found", s);
+    return -1;
+}
+
+static PyObject *
+CMachine_get_breakpoints(CMachine *self, PyObject *Py_UNUSED(args)) {
+    return breakpoints_dict(self);
+}
+
+static int
+CMachine_set_breakpoints(CMachine *self, PyObject *value, void *c) {
+    (void)c;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError, "cannot delete breakpoints");
+        return -1;
+    }
+    return load_breakpoints(self, value);
+}
+
+static PyObject *
+CMachine_toggle_breakpoint(CMachine *self, PyObject *args) {
+    PyObject *bp;
     int passes = 1;
     int msg = 0;
+    long addr;
     if (!PyArg_ParseTuple(args, "O|ip", &bp, &passes, &msg))
         return NULL;
+    if (resolve_bp_addr(self, bp, &addr) < 0)
+        return NULL;
 
+    if (bp_is_set(self, addr))
+        bp_clear(self, addr);
+    else if (addr >= 0 && addr < IMEM_DEPTH)
+        bp_set(self, addr, passes, 1);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_set_breakpoint(CMachine *self, PyObject *args) {
+    PyObject *bp;
+    int passes = 1;
+    int msg = 0;
     long addr;
-    if (PyLong_Check(bp)) {
-        addr = PyLong_AsLong(bp);
-    } else if (PyUnicode_Check(bp)) {
-        /* Try numeric string first */
-        const char *s = PyUnicode_AsUTF8(bp);
-        char *endp;
-        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
-            addr = strtol(s + 2, &endp, 16);
+    if (!PyArg_ParseTuple(args, "O|ip", &bp, &passes, &msg))
+        return NULL;
+    if (resolve_bp_addr(self, bp, &addr) < 0)
+        return NULL;
+
+    if (addr >= 0 && addr < IMEM_DEPTH)
+        bp_set(self, addr, passes, 1);
+    Py_RETURN_NONE;
+}
+
+/* Watchpoint kind and index from (kind, index) arguments */
+static int watch_parse(PyObject *args, int *kind, long *index) {
+    const char *name;
+    if (!PyArg_ParseTuple(args, "sl", &name, index))
+        return -1;
+    if (strcmp(name, "dmem") == 0)
+        *kind = WATCH_DMEM;
+    else if (strcmp(name, "wdr") == 0)
+        *kind = WATCH_WDR;
+    else {
+        PyErr_Format(PyExc_ValueError, "unknown watchpoint kind '%s'", name);
+        return -1;
+    }
+    if (*index < 0 || *index >= (*kind == WATCH_DMEM ? DMEM_DEPTH : NUM_REGS)) {
+        PyErr_SetString(PyExc_IndexError, "watchpoint index out of range");
+        return -1;
+    }
+    return 0;
+}
+
+static int watch_is_set(const CMachine *self, int kind, long index) {
+    if (kind == WATCH_DMEM)
+        return (self->watch_dmem[index / 64] >> (index % 64)) & 1;
+    return (self->watch_wdr >> index) & 1;
+}
+
+/* set_watchpoint(kind, index): stop run() after writes to DMEM cell
+ * index ("dmem") or to WDR index ("wdr") */
+static PyObject *
+CMachine_set_watchpoint(CMachine *self, PyObject *args) {
+    int kind;
+    long index;
+    if (watch_parse(args, &kind, &index) < 0)
+        return NULL;
+    if (!watch_is_set(self, kind, index)) {
+        if (kind == WATCH_DMEM)
+            self->watch_dmem[index / 64] |= (uint64_t)1 << (index % 64);
+        else
+            self->watch_wdr |= (uint32_t)1 << index;
+        self->n_watch++;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_clear_watchpoint(CMachine *self, PyObject *args) {
+    int kind;
+    long index;
+    if (watch_parse(args, &kind, &index) < 0)
+        return NULL;
+    if (watch_is_set(self, kind, index)) {
+        if (kind == WATCH_DMEM)
+            self->watch_dmem[index / 64] &= ~((uint64_t)1 << (index % 64));
+        else
+            self->watch_wdr &= ~((uint32_t)1 << index);
+        self->n_watch--;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_clear_watchpoints(CMachine *self, PyObject *Py_UNUSED(args)) {
+    memset(self->watch_dmem, 0, sizeof(self->watch_dmem));
+    self->watch_wdr = 0;
+    self->n_watch = 0;
+    Py_RETURN_NONE;
+}
+
+/* watchpoints -> [(kind, index), ...] */
+static PyObject *CMachine_get_watchpoints(CMachine *self, void *c) {
+    (void)c;
+    PyObject *res = PyList_New(0);
+    if (!res) return NULL;
+    for (long i = 0; i < DMEM_DEPTH + NUM_REGS; i++) {
+        int kind = i < DMEM_DEPTH ? WATCH_DMEM : WATCH_WDR;
+        long index = i < DMEM_DEPTH ? i : i - DMEM_DEPTH;
+        if (!watch_is_set(self, kind, index))
+            continue;
+        PyObject *item = Py_BuildValue("(sl)", kind == WATCH_DMEM ? "dmem" : "wdr", index);
+        if (!item || PyList_Append(res, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(res);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return res;
+}
+
+/* watch_hit -> (kind, index, pc) of the write that stopped the last
+ * run(), or None */
+static PyObject *CMachine_get_watch_hit(CMachine *self, void *c) {
+    (void)c;
+    if (self->watch_kind == WATCH_NONE)
+        Py_RETURN_NONE;
+    return Py_BuildValue("(sll)", self->watch_kind == WATCH_DMEM ? "dmem" : "wdr",
+                         self->watch_index, self->watch_pc);
+}
+
+/* ------------------------------------------------------------------ */
+/* Decoded instruction table                                           */
+/* ------------------------------------------------------------------ */
+
+/* Instruction objects describe themselves to the decoder through
+ * get_native_op(), which returns None or
+ *
+ *     (mnemonic, rd, rs1, rs2, shift, imm, flag_group, aux)
+ *
+ * Objects without a description, and mnemonics without a kernel below,
+ * decode to OP_PYTHON and keep running through instr.execute(self).
+ *
+ * Field use beyond the obvious register operands:
+ *   shift  input shift of rs2 in bits (< 0: right shift), the
+ *          accumulator shift for BN.MULQACC*, the shift amount of
+ *          BN.RSHI
+ *   imm    immediate, offset, branch/jump distance, CSR or WSR number,
+ *          LOOPI iteration count
+ *   fg     1 when the op uses the extension flag group
+ *   aux    BN.MULQACC*: qw sel rs1 | qw sel rs2 << 2 | upper half << 4
+ *          BN.MULH:     rs1 upper | rs2 upper << 1
+ *          BN.SEL:      flag bit in get_flags_as_bin() layout
+ *          BN.MOVR:     inc xd | inc xs << 1
+ *          BN.LID/SID:  inc x1 | inc x2 << 1 | byte addressing << 2
+ *          LOOP/LOOPI:  loop body length
+ *
+ * The dcrypto ISA uses the same tuple.  Its mnemonics are lower case, so
+ * they share the lookup below; instructions whose semantics match an
+ * OTBN kernel exactly map onto it through opcode_aliases[].  dcrypto
+ * field use:
+ *   shift  input shift of rs2 in bits (< 0: right shift); rshi amount
+ *   imm    immediate, DMEM index (ldi/sti), call/branch target, direct
+ *          loop count
+ *   rd/rs1 ldr/ld/st: the raw limb pointer fields (limb | inc << 3)
+ *   rs2    loop: 1 when the count comes from lc limb rs1
+ *   aux    sel:  flag bit in get_flags_as_bin() layout
+ *          b:    condition flag bit | taken when clear << 3, -1 always
+ *          movi: limb | upper half << 3
+ *          loop: loop body length
+ */
+static const char *const opcode_names[NUM_OPCODES] = {
+    [OP_PYTHON] = NULL,
+    [OP_BN_ADD] = "BN.ADD", [OP_BN_ADDC] = "BN.ADDC",
+    [OP_BN_ADDI] = "BN.ADDI", [OP_BN_ADDM] = "BN.ADDM",
+    [OP_BN_SUB] = "BN.SUB", [OP_BN_SUBB] = "BN.SUBB",
+    [OP_BN_SUBI] = "BN.SUBI", [OP_BN_SUBM] = "BN.SUBM",
+    [OP_BN_CMP] = "BN.CMP", [OP_BN_CMPB] = "BN.CMPB",
+    [OP_BN_MULQACC] = "BN.MULQACC", [OP_BN_MULQACC_Z] = "BN.MULQACC.Z",
+    [OP_BN_MULQACC_SO] = "BN.MULQACC.SO", [OP_BN_MULH] = "BN.MULH",
+    [OP_BN_AND] = "BN.AND", [OP_BN_OR] = "BN.OR", [OP_BN_XOR] = "BN.XOR",
+    [OP_BN_NOT] = "BN.NOT", [OP_BN_RSHI] = "BN.RSHI", [OP_BN_SEL] = "BN.SEL",
+    [OP_BN_MOV] = "BN.MOV", [OP_BN_MOVR] = "BN.MOVR",
+    [OP_BN_LID] = "BN.LID", [OP_BN_SID] = "BN.SID",
+    [OP_BN_WSRRS] = "BN.WSRRS", [OP_BN_WSRRW] = "BN.WSRRW",
+    [OP_LOOP] = "LOOP", [OP_LOOPI] = "LOOPI",
+    [OP_ADD] = "ADD", [OP_ADDI] = "ADDI", [OP_SUB] = "SUB",
+    [OP_AND] = "AND", [OP_ANDI] = "ANDI", [OP_OR] = "OR", [OP_ORI] = "ORI",
+    [OP_XOR] = "XOR", [OP_XORI] = "XORI", [OP_SLLI] = "SLLI",
+    [OP_LUI] = "LUI", [OP_LI] = "LI", [OP_LW] = "LW", [OP_SW] = "SW",
+    [OP_CSRRS] = "CSRRS", [OP_CSRRW] = "CSRRW",
+    [OP_BEQ] = "BEQ", [OP_BNE] = "BNE", [OP_JAL] = "JAL", [OP_JALR] = "JALR",
+    [OP_RET] = "RET", [OP_ECALL] = "ECALL", [OP_NOP] = "NOP",
+    [OP_DC_ADD] = "add", [OP_DC_ADDC] = "addc", [OP_DC_ADDI] = "addi",
+    [OP_DC_ADDX] = "addx", [OP_DC_ADDCX] = "addcx",
+    [OP_DC_SUB] = "sub", [OP_DC_SUBB] = "subb", [OP_DC_SUBI] = "subi",
+    [OP_DC_SUBX] = "subx", [OP_DC_SUBBX] = "subbx",
+    [OP_DC_ADDM] = "addm", [OP_DC_SUBM] = "subm",
+    [OP_DC_CMP] = "cmp", [OP_DC_CMPBX] = "cmpbx",
+    [OP_DC_LDRFP] = "ldrfp", [OP_DC_LDLC] = "ldlc",
+    [OP_DC_LDDMP] = "lddmp", [OP_DC_STDMP] = "stdmp",
+    [OP_DC_LDMOD] = "ldmod", [OP_DC_STMOD] = "stmod",
+    [OP_DC_LDRND] = "ldrnd", [OP_DC_STRND] = "strnd",
+    [OP_DC_LDI] = "ldi", [OP_DC_STI] = "sti", [OP_DC_LDR] = "ldr",
+    [OP_DC_LD] = "ld", [OP_DC_ST] = "st", [OP_DC_MOVI] = "movi",
+    [OP_DC_B] = "b", [OP_DC_CALL] = "call", [OP_DC_LOOP] = "loop",
+};
+
+/* dcrypto instructions that run through an OTBN kernel unchanged */
+static const struct {
+    const char *name;
+    int opcode;
+} opcode_aliases[] = {
+    {"and", OP_BN_AND}, {"or", OP_BN_OR}, {"xor", OP_BN_XOR},
+    {"not", OP_BN_NOT}, {"rshi", OP_BN_RSHI}, {"sel", OP_BN_SEL},
+    {"mul128", OP_BN_MULH}, {"mov", OP_BN_MOV},
+    {"nop", OP_NOP}, {"ret", OP_RET},
+};
+
+/* Registers an op reads through its operand fields, for the load-use
+ * rule of timing models.  Registers selected at run time (BN.MOVR,
+ * BN.SID and dcrypto pointer sources) only count their index GPRs. */
+static void op_read_sets(MicroOp *op) {
+    uint32_t rs1 = (uint32_t)1 << op->rs1, rs2 = (uint32_t)1 << op->rs2;
+    uint32_t rd = (uint32_t)1 << op->rd;
+    switch (op->opcode) {
+    case OP_BN_ADD: case OP_BN_ADDC: case OP_BN_ADDM:
+    case OP_BN_SUB: case OP_BN_SUBB: case OP_BN_SUBM:
+    case OP_BN_CMP: case OP_BN_CMPB:
+    case OP_BN_MULQACC: case OP_BN_MULQACC_Z: case OP_BN_MULQACC_SO: case OP_BN_MULH:
+    case OP_BN_AND: case OP_BN_OR: case OP_BN_XOR: case OP_BN_RSHI: case OP_BN_SEL:
+    case OP_DC_ADD: case OP_DC_ADDC: case OP_DC_ADDX: case OP_DC_ADDCX:
+    case OP_DC_SUB: case OP_DC_SUBB: case OP_DC_SUBX: case OP_DC_SUBBX:
+    case OP_DC_ADDM: case OP_DC_SUBM: case OP_DC_CMP: case OP_DC_CMPBX:
+        op->reads_wdr = rs1 | rs2;
+        break;
+    case OP_BN_ADDI: case OP_BN_SUBI: case OP_BN_NOT: case OP_BN_MOV:
+    case OP_BN_WSRRS: case OP_BN_WSRRW:
+    case OP_DC_ADDI: case OP_DC_SUBI:
+    case OP_DC_LDRFP: case OP_DC_LDLC: case OP_DC_LDDMP: case OP_DC_LDMOD: case OP_DC_LDRND:
+        op->reads_wdr = rs1;
+        break;
+    case OP_DC_STI: case OP_DC_MOVI:
+        op->reads_wdr = rd;
+        break;
+    case OP_ADD: case OP_SUB: case OP_AND: case OP_OR: case OP_XOR:
+    case OP_SW: case OP_BEQ: case OP_BNE:
+        op->reads_gpr = rs1 | rs2;
+        break;
+    case OP_ADDI: case OP_ANDI: case OP_ORI: case OP_XORI: case OP_SLLI:
+    case OP_LW: case OP_CSRRS: case OP_CSRRW: case OP_JALR: case OP_LOOP:
+        op->reads_gpr = rs1;
+        break;
+    case OP_BN_MOVR: case OP_BN_LID: case OP_BN_SID:
+        op->reads_gpr = rd | rs1;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Whether the kernels of opcode can take these operand fields. */
+static int op_fields_valid(int opcode, long rd, long rs1, long rs2, long shift, long imm) {
+    /* Register operands index both WDRs and GPRs (32 of each). */
+    if (rd < 0 || rd >= NUM_REGS || rs1 < 0 || rs1 >= NUM_REGS || rs2 < 0 || rs2 >= NUM_REGS)
+        return 0;
+    /* Negative shifts raise in Python; leave them to execute(). */
+    if ((opcode == OP_BN_MULQACC || opcode == OP_BN_MULQACC_Z ||
+         opcode == OP_BN_MULQACC_SO || opcode == OP_BN_RSHI) && shift < 0)
+        return 0;
+    if ((opcode == OP_SLLI || opcode == OP_BN_ADDI || opcode == OP_BN_SUBI) && imm < 0)
+        return 0;
+    return 1;
+}
+
+/* Decode one instruction object.  Never fails: anything the native
+ * path cannot represent becomes OP_PYTHON. */
+static void decode_instr(PyObject *instr, MicroOp *op) {
+    memset(op, 0, sizeof(*op));
+    Py_INCREF(instr);
+    op->instr = instr;
+    op->opcode = OP_PYTHON;
+
+    PyObject *desc = PyObject_CallMethod(instr, "get_native_op", NULL);
+    if (!desc) {
+        PyErr_Clear();
+        return;
+    }
+    if (!PyTuple_Check(desc) || PyTuple_GET_SIZE(desc) != 8) {
+        Py_DECREF(desc);
+        return;
+    }
+
+    const char *name = PyUnicode_Check(PyTuple_GET_ITEM(desc, 0))
+                       ? PyUnicode_AsUTF8(PyTuple_GET_ITEM(desc, 0)) : NULL;
+    int opcode = OP_PYTHON;
+    for (int i = 1; name && i < NUM_OPCODES; i++) {
+        if (strcmp(name, opcode_names[i]) == 0) {
+            opcode = i;
+            break;
+        }
+    }
+    for (size_t i = 0; name && opcode == OP_PYTHON &&
+                       i < sizeof(opcode_aliases) / sizeof(opcode_aliases[0]); i++) {
+        if (strcmp(name, opcode_aliases[i].name) == 0)
+            opcode = opcode_aliases[i].opcode;
+    }
+
+    long f[7];
+    for (int i = 0; i < 7 && opcode != OP_PYTHON; i++) {
+        f[i] = PyLong_AsLong(PyTuple_GET_ITEM(desc, i + 1));
+        if (f[i] == -1 && PyErr_Occurred())
+            opcode = OP_PYTHON;
+    }
+    Py_DECREF(desc);
+    PyErr_Clear();
+    if (opcode == OP_PYTHON)
+        return;
+
+    if (f[3] < INT32_MIN || f[3] > INT32_MAX || f[6] < INT32_MIN || f[6] > INT32_MAX)
+        return;
+    if (!op_fields_valid(opcode, f[0], f[1], f[2], f[3], f[4]))
+        return;
+
+    PyObject *cycles = PyObject_CallMethod(instr, "get_cycles", NULL);
+    if (!cycles) {
+        PyErr_Clear();
+        return;
+    }
+    op->cycles = PyLong_AsLong(cycles);
+    Py_DECREF(cycles);
+    if (op->cycles == -1 && PyErr_Occurred()) {
+        PyErr_Clear();
+        return;
+    }
+
+    op->opcode = (uint16_t)opcode;
+    op->rd = (uint8_t)f[0];
+    op->rs1 = (uint8_t)f[1];
+    op->rs2 = (uint8_t)f[2];
+    op->shift = (int32_t)f[3];
+    op->imm = f[4];
+    op->fg = f[5] ? 1 : 0;
+    op->aux = (int32_t)f[6];
+    op_read_sets(op);
+}
+
+/* Ops that only fall through to pc + 1: no jumps, loop or call stack
+ * changes, and no finish. */
+static int op_is_straight(int opcode) {
+    switch (opcode) {
+    case OP_PYTHON:
+    case OP_LOOP: case OP_LOOPI:
+    case OP_BEQ: case OP_BNE: case OP_JAL: case OP_JALR: case OP_RET: case OP_ECALL:
+    case OP_DC_B: case OP_DC_CALL: case OP_DC_LOOP:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/* Whether next continues the superinstruction started by first:
+ *   BN.ADD/ADDC (BN.SUB/SUBB) followed by BN.ADDC (BN.SUBB) of the same
+ *     flag group: a carry chain, flags are only settled at its end
+ *   BN.MULQACC/.Z runs: a multiply-accumulate chain in one dispatch */
+static int op_fuses(const MicroOp *first, const MicroOp *next) {
+    switch (first->opcode) {
+    case OP_BN_ADD:
+    case OP_BN_ADDC:
+        return next->opcode == OP_BN_ADDC && next->fg == first->fg;
+    case OP_BN_SUB:
+    case OP_BN_SUBB:
+        return next->opcode == OP_BN_SUBB && next->fg == first->fg;
+    case OP_BN_MULQACC:
+    case OP_BN_MULQACC_Z:
+        return next->opcode == OP_BN_MULQACC || next->opcode == OP_BN_MULQACC_Z;
+    default:
+        return 0;
+    }
+}
+
+/* Routine kernels: whole routines recognized by their exact op sequence
+ * and run by one kernel as a superinstruction (see exec_routine()).
+ *
+ *   ROUTINE_DC_MULMOD  MulMod of dcrypto_p256: r19 = r24 * r25 mod r29 by
+ *                      Barrett reduction with mu low in r28, leaving the
+ *                      temporaries r20..r25 and the flags behind */
+enum { ROUTINE_NONE, ROUTINE_DC_MULMOD, NUM_ROUTINES };
+
+typedef struct {
+    uint16_t opcode;
+    uint8_t rd, rs1, rs2;
+    int32_t shift;
+    int32_t aux;
+} RoutineOp;
+
+static const RoutineOp dc_mulmod_ops[] = {
+    {OP_BN_MULH, 19, 24, 25, 0, 0},   {OP_BN_MULH, 20, 24, 25, 0, 3},
+    {OP_BN_MULH, 21, 24, 25, 0, 1},   {OP_DC_ADD, 19, 19, 21, 128, 0},
+    {OP_DC_ADDC, 20, 20, 21, -128, 0}, {OP_BN_MULH, 21, 24, 25, 0, 2},
+    {OP_DC_ADD, 19, 19, 21, 128, 0},  {OP_DC_ADDC, 20, 20, 21, -128, 0},
+    {OP_BN_SEL, 22, 28, 31, 0, FLAG_M}, {OP_BN_RSHI, 21, 19, 20, 255, 0},
+    {OP_BN_MULH, 23, 21, 28, 0, 0},   {OP_BN_MULH, 24, 21, 28, 0, 3},
+    {OP_BN_MULH, 25, 21, 28, 0, 1},   {OP_DC_ADD, 23, 23, 25, 128, 0},
+    {OP_DC_ADDC, 24, 24, 25, -128, 0}, {OP_BN_MULH, 25, 21, 28, 0, 2},
+    {OP_DC_ADD, 23, 23, 25, 128, 0},  {OP_DC_ADDC, 24, 24, 25, -128, 0},
+    {OP_BN_RSHI, 25, 20, 31, 255, 0}, {OP_DC_ADD, 24, 24, 21, 0, 0},
+    {OP_DC_ADDC, 25, 25, 31, 0, 0},   {OP_DC_ADD, 24, 24, 22, 0, 0},
+    {OP_DC_ADDC, 25, 25, 31, 0, 0},   {OP_BN_RSHI, 21, 24, 25, 1, 0},
+    {OP_BN_MULH, 22, 29, 21, 0, 0},   {OP_BN_MULH, 23, 29, 21, 0, 3},
+    {OP_BN_MULH, 24, 29, 21, 0, 1},   {OP_DC_ADD, 22, 22, 24, 128, 0},
+    {OP_DC_ADDC, 23, 23, 24, -128, 0}, {OP_BN_MULH, 24, 29, 21, 0, 2},
+    {OP_DC_ADD, 22, 22, 24, 128, 0},  {OP_DC_ADDC, 23, 23, 24, -128, 0},
+    {OP_DC_SUB, 22, 19, 22, 0, 0},    {OP_DC_SUBB, 20, 20, 23, 0, 0},
+    {OP_BN_SEL, 21, 29, 31, 0, FLAG_L}, {OP_DC_SUB, 21, 22, 21, 0, 0},
+    {OP_DC_ADDM, 19, 21, 31, 0, 0},
+};
+
+static const struct {
+    const RoutineOp *ops;
+    Py_ssize_t len;
+} routine_table[NUM_ROUTINES] = {
+    [ROUTINE_DC_MULMOD] = {dc_mulmod_ops, sizeof(dc_mulmod_ops) / sizeof(dc_mulmod_ops[0])},
+};
+
+/* Whether ops[i..) (with the table ending at hi) is routine k */
+static int routine_at(const MicroOp *ops, Py_ssize_t i, Py_ssize_t hi, int k) {
+    const RoutineOp *r = routine_table[k].ops;
+    Py_ssize_t len = routine_table[k].len;
+    if (hi - i < len)
+        return 0;
+    for (Py_ssize_t j = 0; j < len; j++) {
+        const MicroOp *op = &ops[i + j];
+        if (op->opcode != r[j].opcode || op->rd != r[j].rd || op->rs1 != r[j].rs1 ||
+            op->rs2 != r[j].rs2 || op->shift != r[j].shift || op->aux != r[j].aux ||
+            op->fg || op->imm)
+            return 0;
+    }
+    return 1;
+}
+
+/* Mark the routines in ops[lo, hi): their first op gets the routine and
+ * a fuse over the whole body.  The pairs linked inside stay in place for
+ * runs that enter the body elsewhere or cannot take the routine. */
+static void link_routines(MicroOp *ops, Py_ssize_t lo, Py_ssize_t hi) {
+    for (Py_ssize_t i = lo; i < hi; i++) {
+        ops[i].routine = ROUTINE_NONE;
+        if (ops[i].fuse)
+            continue;
+        for (int k = ROUTINE_NONE + 1; k < NUM_ROUTINES; k++) {
+            if (routine_at(ops, i, hi, k)) {
+                ops[i].routine = (uint8_t)k;
+                ops[i].fuse = (uint32_t)routine_table[k].len;
+                break;
+            }
+        }
+    }
+}
+
+/* Split a decoded table into basic blocks: block_len counts the straight
+ * ops from each slot up to the next control or Python-backed op, and
+ * fuse the length of the superinstruction a slot starts (0 for none),
+ * a pair chain or a routine.
+ * Relinked whenever a slot is (re)decoded. */
+static void link_blocks(MicroOp *ops, Py_ssize_t n) {
+    uint32_t len = 0;
+    for (Py_ssize_t i = n - 1; i >= 0; i--) {
+        len = op_is_straight(ops[i].opcode) ? (len < UINT32_MAX ? len + 1 : len) : 0;
+        ops[i].block_len = len;
+        ops[i].fuse = 0;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        Py_ssize_t j = i + 1;
+        while (j < n && op_fuses(&ops[i], &ops[j]))
+            j++;
+        if (j - i > 1) {
+            ops[i].fuse = (uint32_t)(j - i);
+            i = j - 1;
+        }
+    }
+    link_routines(ops, 0, n);
+}
+
+/* link_blocks() after slots [lo, hi) were redecoded.  Superinstructions
+ * only chain straight ops, so nothing outside the straight run around
+ * the slots changes: it is relinked from the control op before lo to
+ * the one at or after hi. */
+static void link_blocks_range(MicroOp *ops, Py_ssize_t n, Py_ssize_t lo, Py_ssize_t hi) {
+    while (lo > 0 && op_is_straight(ops[lo - 1].opcode))
+        lo--;
+    while (hi < n && op_is_straight(ops[hi].opcode))
+        hi++;
+    uint32_t len = 0;
+    for (Py_ssize_t i = hi - 1; i >= lo; i--) {
+        len = op_is_straight(ops[i].opcode) ? (len < UINT32_MAX ? len + 1 : len) : 0;
+        ops[i].block_len = len;
+        ops[i].fuse = 0;
+    }
+    for (Py_ssize_t i = lo; i < hi; i++) {
+        Py_ssize_t j = i + 1;
+        while (j < hi && op_fuses(&ops[i], &ops[j]))
+            j++;
+        if (j - i > 1) {
+            ops[i].fuse = (uint32_t)(j - i);
+            i = j - 1;
+        }
+    }
+    link_routines(ops, lo, hi);
+}
+
+/* ------------------------------------------------------------------ */
+/* Timing models                                                       */
+/* ------------------------------------------------------------------ */
+/* A timing model replaces get_cycles() for natively decoded ops by a
+ * mapping of mnemonics to cycles, plus optional stall rules under the
+ * reserved keys
+ *
+ *   load_use   extra cycles when an op reads a register loaded from
+ *              DMEM by the op just before it (LW, BN.LID, ldi, ld)
+ *   acc_use    extra cycles when BN.MULQACC/.SO accumulates onto the
+ *              ACC the op just before it produced
+ *   dmem_wait  wait states added to every DMEM load and store
+ *
+ * dcrypto mnemonics aliased to an OTBN kernel (and, or, mov, ...) share
+ * its entry.  Python-backed ops keep get_cycles() and clear hazards. */
+static int timing_opcode(const char *name) {
+    for (int i = 1; i < NUM_OPCODES; i++)
+        if (strcmp(name, opcode_names[i]) == 0)
+            return i;
+    for (size_t i = 0; i < sizeof(opcode_aliases) / sizeof(opcode_aliases[0]); i++)
+        if (strcmp(name, opcode_aliases[i].name) == 0)
+            return opcode_aliases[i].opcode;
+    return OP_PYTHON;
+}
+
+/* Build tm from a mapping (None: no model).  tm is only replaced on
+ * success. */
+static int timing_parse(PyObject *spec, TimingModel *tm) {
+    TimingModel res;
+    memset(&res, 0, sizeof(res));
+    if (spec != Py_None) {
+        res.spec = PyDict_New();
+        if (!res.spec || PyDict_Update(res.spec, spec) < 0)
+            goto error;
+        Py_ssize_t pos = 0;
+        PyObject *key, *val;
+        while (PyDict_Next(res.spec, &pos, &key, &val)) {
+            const char *name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+            if (!name) {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_TypeError, "timing model keys must be mnemonics");
+                goto error;
+            }
+            long cycles = PyLong_AsLong(val);
+            if (cycles == -1 && PyErr_Occurred())
+                goto error;
+            if (cycles < 0) {
+                PyErr_Format(PyExc_ValueError, "negative cycles for '%s'", name);
+                goto error;
+            }
+            if (strcmp(name, "load_use") == 0) {
+                res.load_use = cycles;
+            } else if (strcmp(name, "acc_use") == 0) {
+                res.acc_use = cycles;
+            } else if (strcmp(name, "dmem_wait") == 0) {
+                res.dmem_wait = cycles;
+            } else {
+                int opcode = timing_opcode(name);
+                if (opcode == OP_PYTHON) {
+                    PyErr_Format(PyExc_ValueError, "unknown mnemonic '%s' in timing model", name);
+                    goto error;
+                }
+                res.cycles[opcode] = cycles;
+                res.has[opcode] = 1;
+            }
+        }
+        res.active = 1;
+    }
+    Py_XDECREF(tm->spec);
+    *tm = res;
+    return 0;
+
+error:
+    Py_XDECREF(res.spec);
+    return -1;
+}
+
+static void timing_copy(TimingModel *dst, const TimingModel *src) {
+    Py_XINCREF(src->spec);
+    Py_XDECREF(dst->spec);
+    *dst = *src;
+}
+
+/* timing_model -> a copy of the mapping, or None */
+static PyObject *timing_spec(const TimingModel *tm) {
+    if (!tm->spec)
+        Py_RETURN_NONE;
+    return PyDict_Copy(tm->spec);
+}
+
+/* Cycles of op under the machine's model; base is what the op costs
+ * without one.  Called once per execution, before the op runs (the
+ * hazards it leaves depend on its operands' pre-execution values). */
+static long timed_cycles(CMachine *self, const MicroOp *op, long base) {
+    const TimingModel *tm = &self->timing;
+    long cycles = tm->has[op->opcode] ? tm->cycles[op->opcode] : base;
+    if ((op->reads_wdr & self->hz_wdr) || (op->reads_gpr & self->hz_gpr))
+        cycles += tm->load_use;
+    if (self->hz_acc && (op->opcode == OP_BN_MULQACC || op->opcode == OP_BN_MULQACC_SO))
+        cycles += tm->acc_use;
+
+    self->hz_wdr = self->hz_gpr = 0;
+    self->hz_acc = 0;
+    switch (op->opcode) {
+    case OP_LW:
+        self->hz_gpr = ((uint32_t)1 << op->rd) & ~(uint32_t)1;   /* not x0 */
+        cycles += tm->dmem_wait;
+        break;
+    case OP_BN_LID: {
+        long wdr = op->rd > 1 ? self->gpr[op->rd] : -1;
+        if (wdr >= 0 && wdr < NUM_REGS)
+            self->hz_wdr = (uint32_t)1 << wdr;
+        cycles += tm->dmem_wait;
+        break;
+    }
+    case OP_DC_LDI:
+        self->hz_wdr = (uint32_t)1 << op->rd;
+        cycles += tm->dmem_wait;
+        break;
+    case OP_DC_LD:
+        self->hz_wdr = (uint32_t)1 << dc_ptr(self->rfp, op->rd, NUM_REGS - 1);
+        cycles += tm->dmem_wait;
+        break;
+    case OP_SW:
+    case OP_BN_SID:
+    case OP_DC_STI:
+    case OP_DC_ST:
+        cycles += tm->dmem_wait;
+        break;
+    case OP_BN_MULQACC:
+    case OP_BN_MULQACC_Z:
+    case OP_BN_MULQACC_SO:
+        self->hz_acc = 1;
+        break;
+    default:
+        break;
+    }
+    return cycles;
+}
+
+static inline long op_cycles(CMachine *self, const MicroOp *op, long base) {
+    return self->timing.active ? timed_cycles(self, op, base) : base;
+}
+
+static PyObject *CMachine_get_timing_model(CMachine *self, void *c) {
+    (void)c;
+    return timing_spec(&self->timing);
+}
+
+static int CMachine_set_timing_model(CMachine *self, PyObject *value, void *c) {
+    (void)c;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError, "cannot delete timing_model");
+        return -1;
+    }
+    if (machine_idle_check(self) < 0 || timing_parse(value, &self->timing) < 0)
+        return -1;
+    self->hz_wdr = self->hz_gpr = 0;
+    self->hz_acc = 0;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Program images                                                      */
+/* ------------------------------------------------------------------ */
+
+/* Program(instructions, ctx=None, timing_model=None, ops=None): an imem
+ * frozen into a tuple together with its decoded op table, so any number of
+ * machines (and threads) can share one decode.  The timing model is folded
+ * into the decoded cycles and becomes the default of machines running it.
+ * Pass it as a machine's imem; the machine keeps its statistics counters
+ * to itself and the ops are only written by patch() and for the lazily
+ * computed histo keys (GIL held).
+ *
+ * ops takes a buffer written by ops_image() for the same instructions and
+ * copies the table from it instead of decoding (see program_cache.py). */
+static PyTypeObject ProgramType;
+
+/* Header of an ops_image() buffer; n_ops MicroOps with their object
+ * pointers cleared follow it */
+typedef struct {
+    uint32_t magic;
+    uint32_t abi;
+    uint32_t op_size;
+    uint32_t n_opcodes;
+    int64_t n_ops;
+} OpsImageHeader;
+
+#define OPS_IMAGE_MAGIC 0x4f53504fu /* "OPSO" */
+
+/* The Program type machines accept: ProgramType, or _machine's in the
+ * specialized variants (see the module init) */
+static PyTypeObject *program_type = &ProgramType;
+
+#define Program_Check(obj) PyObject_TypeCheck((obj), program_type)
+
+/* Fill ops[0..n) from an ops_image() buffer of n ops; the instructions
+ * are taken from instrs.  Images of another build or length, with operand
+ * fields decode_instr() would not produce, or with links link_blocks()
+ * would not make, raise ValueError and leave no references behind. */
+static int
+ops_image_load(PyObject *image, MicroOp *ops, PyObject *instrs) {
+    Py_ssize_t n = PyTuple_GET_SIZE(instrs);
+    Py_buffer view;
+    if (PyObject_GetBuffer(image, &view, PyBUF_SIMPLE) < 0)
+        return -1;
+    OpsImageHeader hdr;
+    int ok = view.len == (Py_ssize_t)(sizeof(hdr) + (size_t)n * sizeof(MicroOp));
+    if (ok) {
+        memcpy(&hdr, view.buf, sizeof(hdr));
+        ok = hdr.magic == OPS_IMAGE_MAGIC && hdr.abi == OT_DSIM_MACHINE_ABI_VERSION &&
+             hdr.op_size == sizeof(MicroOp) && hdr.n_opcodes == NUM_OPCODES && hdr.n_ops == n;
+    }
+    if (ok)
+        memcpy(ops, (const char *)view.buf + sizeof(hdr), (size_t)n * sizeof(MicroOp));
+    PyBuffer_Release(&view);
+    for (Py_ssize_t i = 0; ok && i < n; i++) {
+        MicroOp check = ops[i];
+        ok = check.opcode < NUM_OPCODES && check.fg <= 1 &&
+             (check.opcode == OP_PYTHON ||
+              op_fields_valid(check.opcode, check.rd, check.rs1, check.rs2, check.shift,
+                              check.imm));
+        if (ok) {
+            check.reads_wdr = check.reads_gpr = 0;
+            op_read_sets(&check);
+            ok = check.reads_wdr == ops[i].reads_wdr && check.reads_gpr == ops[i].reads_gpr;
+        }
+    }
+    /* The links must be the ones this build makes for these ops: block
+     * lengths, fuses and routine ids are trusted by the dispatch loops. */
+    MicroOp *linked = ok && n ? PyMem_Malloc((size_t)n * sizeof(MicroOp)) : NULL;
+    if (ok && n && !linked) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (linked) {
+        memcpy(linked, ops, (size_t)n * sizeof(MicroOp));
+        link_blocks(linked, n);
+        for (Py_ssize_t i = 0; ok && i < n; i++)
+            ok = linked[i].block_len == ops[i].block_len && linked[i].fuse == ops[i].fuse &&
+                 linked[i].routine == ops[i].routine;
+        PyMem_Free(linked);
+    }
+    if (!ok) {
+        PyErr_SetString(PyExc_ValueError, "ops image does not match this build and program");
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        ops[i].instr = PyTuple_GET_ITEM(instrs, i);
+        Py_INCREF(ops[i].instr);
+        ops[i].stat_key = NULL;
+    }
+    return 0;
+}
+
+static int
+Program_init(ProgramObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"instructions", "ctx", "timing_model", "ops", NULL};
+    PyObject *instructions;
+    PyObject *ctx = Py_None;
+    PyObject *timing = Py_None;
+    PyObject *image = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOO", kwlist, &instructions, &ctx,
+                                     &timing, &image))
+        return -1;
+    if (self->instrs) {
+        PyErr_SetString(PyExc_TypeError, "Program is immutable");
+        return -1;
+    }
+    if (timing_parse(timing, &self->timing) < 0)
+        return -1;
+    /* A tuple of its own: patch() replaces items in place */
+    PyObject *seq = PySequence_Fast(instructions, "instructions must be a sequence");
+    if (!seq) return -1;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    PyObject *instrs = PyTuple_New(n);
+    if (!instrs) {
+        Py_DECREF(seq);
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *instr = PySequence_Fast_GET_ITEM(seq, i);
+        Py_INCREF(instr);
+        PyTuple_SET_ITEM(instrs, i, instr);
+    }
+    Py_DECREF(seq);
+    self->ops = PyMem_Calloc(n ? (size_t)n : 1, sizeof(MicroOp));
+    if (!self->ops) {
+        Py_DECREF(instrs);
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (image != Py_None) {
+        if (ops_image_load(image, self->ops, instrs) < 0) {
+            PyMem_Free(self->ops);
+            self->ops = NULL;
+            Py_DECREF(instrs);
+            return -1;
+        }
+    } else {
+        uint64_t start = perf_now();
+        for (Py_ssize_t i = 0; i < n; i++)
+            decode_instr(PyTuple_GET_ITEM(instrs, i), &self->ops[i]);
+        link_blocks(self->ops, n);
+        self->decode_ns += perf_now() - start;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        MicroOp *op = &self->ops[i];
+        if (self->timing.has[op->opcode])
+            op->cycles = self->timing.cycles[op->opcode];
+    }
+    self->n_ops = n;
+    self->instrs = instrs;
+    Py_INCREF(ctx);
+    self->ctx = ctx;
+    return 0;
+}
+
+static void
+Program_dealloc(ProgramObject *self) {
+    for (Py_ssize_t i = 0; i < self->n_ops; i++) {
+        Py_XDECREF(self->ops[i].instr);
+        Py_XDECREF(self->ops[i].stat_key);
+    }
+    PyMem_Free(self->ops);
+    Py_XDECREF(self->instrs);
+    Py_XDECREF(self->ctx);
+    Py_XDECREF(self->timing.spec);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t Program_len(ProgramObject *self) { return self->n_ops; }
+
+/* A new tuple of the instructions as they are now: patch() rewrites
+ * self->instrs, which must not change under its holders. */
+static PyObject *program_instructions(ProgramObject *self) {
+    Py_ssize_t n = PyTuple_GET_SIZE(self->instrs);
+    PyObject *res = PyTuple_New(n);
+    if (!res) return NULL;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *instr = PyTuple_GET_ITEM(self->instrs, i);
+        Py_INCREF(instr);
+        PyTuple_SET_ITEM(res, i, instr);
+    }
+    return res;
+}
+
+static PyObject *Program_get_instructions(ProgramObject *self, void *c) {
+    (void)c;
+    return program_instructions(self);
+}
+
+static PyObject *Program_get_decode_ns(ProgramObject *self, void *c) {
+    (void)c;
+    return PyLong_FromUnsignedLongLong(self->decode_ns);
+}
+
+static PyObject *Program_get_ctx(ProgramObject *self, void *c) {
+    (void)c;
+    Py_INCREF(self->ctx);
+    return self->ctx;
+}
+
+static PyObject *Program_get_timing_model(ProgramObject *self, void *c) {
+    (void)c;
+    return timing_spec(&self->timing);
+}
+
+/* Read-only view of a ctx mapping attribute ({} without a ctx). */
+static PyObject *program_ctx_table(ProgramObject *self, const char *name) {
+    PyObject *table = self->ctx == Py_None ? NULL : PyObject_GetAttrString(self->ctx, name);
+    if (!table) {
+        PyErr_Clear();
+        table = PyDict_New();
+        if (!table) return NULL;
+    }
+    PyObject *view = PyDictProxy_New(table);
+    Py_DECREF(table);
+    return view;
+}
+
+static PyObject *Program_get_labels(ProgramObject *self, void *c) {
+    (void)c;
+    return program_ctx_table(self, "labels");
+}
+
+static PyObject *Program_get_functions(ProgramObject *self, void *c) {
+    (void)c;
+    return program_ctx_table(self, "functions");
+}
+
+/* cycles -> tuple of per-address cycle counts */
+static PyObject *Program_get_cycles(ProgramObject *self, void *c) {
+    (void)c;
+    PyObject *res = PyTuple_New(self->n_ops);
+    if (!res) return NULL;
+    for (Py_ssize_t i = 0; i < self->n_ops; i++) {
+        const MicroOp *op = &self->ops[i];
+        PyObject *v = op->opcode == OP_PYTHON
+                      ? PyObject_CallMethod(op->instr, "get_cycles", NULL)
+                      : PyLong_FromLong(op->cycles);
+        if (!v) {
+            Py_DECREF(res);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(res, i, v);
+    }
+    return res;
+}
+
+/* ops_image() -> bytes of the decoded op table for Program(ops=...).
+ * Programs with a timing model have it folded into their cycles, so
+ * only plain decodes are exported. */
+static PyObject *Program_ops_image(ProgramObject *self, PyObject *Py_UNUSED(args)) {
+    if (self->timing.active) {
+        PyErr_SetString(PyExc_ValueError, "ops_image() of a Program with a timing model");
+        return NULL;
+    }
+    size_t size = sizeof(OpsImageHeader) + (size_t)self->n_ops * sizeof(MicroOp);
+    PyObject *res = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)size);
+    if (!res) return NULL;
+    char *buf = PyBytes_AS_STRING(res);
+    OpsImageHeader hdr = {OPS_IMAGE_MAGIC, OT_DSIM_MACHINE_ABI_VERSION, sizeof(MicroOp),
+                          NUM_OPCODES, self->n_ops};
+    memcpy(buf, &hdr, sizeof(hdr));
+    MicroOp *ops = (MicroOp *)(buf + sizeof(hdr));
+    memcpy(ops, self->ops, (size_t)self->n_ops * sizeof(MicroOp));
+    for (Py_ssize_t i = 0; i < self->n_ops; i++) {
+        ops[i].instr = NULL;
+        ops[i].stat_key = NULL;
+    }
+    return res;
+}
+
+/* patch(address, instructions): replace the instructions from address on,
+ * in place for every machine running the program.  Only the new slots
+ * are decoded and only the straight-line run around them is relinked;
+ * the length stays.  Counts a machine recorded for a replaced slot and
+ * did not flush yet are reported under the new instruction.  Raises
+ * RuntimeError while a machine runs the program with the GIL released,
+ * as its kernels read the table without the lock. */
+static PyObject *Program_patch(ProgramObject *self, PyObject *args) {
+    Py_ssize_t addr;
+    PyObject *instructions;
+    if (!PyArg_ParseTuple(args, "nO", &addr, &instructions))
+        return NULL;
+    PyObject *seq = PySequence_Fast(instructions, "instructions must be a sequence");
+    if (!seq) return NULL;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    if (addr < 0 || n > self->n_ops - addr) {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_IndexError, "patch() outside the program");
+        return NULL;
+    }
+    if (self->running) {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_RuntimeError,
+                        "patch() while a machine runs the program with the GIL released");
+        return NULL;
+    }
+    uint64_t start = perf_now();
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *instr = PySequence_Fast_GET_ITEM(seq, i);
+        MicroOp *op = &self->ops[addr + i];
+        PyObject *old = PyTuple_GET_ITEM(self->instrs, addr + i);
+        Py_INCREF(instr);
+        PyTuple_SET_ITEM(self->instrs, addr + i, instr);
+        Py_DECREF(old);
+        Py_XDECREF(op->instr);
+        Py_XDECREF(op->stat_key);
+        decode_instr(instr, op);
+        if (self->timing.has[op->opcode])
+            op->cycles = self->timing.cycles[op->opcode];
+    }
+    if (n)
+        link_blocks_range(self->ops, self->n_ops, addr, addr + n);
+    self->decode_ns += perf_now() - start;
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Program_methods[] = {
+    {"ops_image", (PyCFunction)Program_ops_image, METH_NOARGS, NULL},
+    {"patch", (PyCFunction)Program_patch, METH_VARARGS, NULL},
+    {NULL}
+};
+
+static PySequenceMethods Program_as_sequence = {
+    .sq_length = (lenfunc)Program_len,
+};
+
+static PyGetSetDef Program_getset[] = {
+    {"instructions", (getter)Program_get_instructions, NULL, NULL, NULL},
+    {"ctx", (getter)Program_get_ctx, NULL, NULL, NULL},
+    {"labels", (getter)Program_get_labels, NULL, NULL, NULL},
+    {"functions", (getter)Program_get_functions, NULL, NULL, NULL},
+    {"cycles", (getter)Program_get_cycles, NULL, NULL, NULL},
+    {"timing_model", (getter)Program_get_timing_model, NULL, NULL, NULL},
+    {"decode_ns", (getter)Program_get_decode_ns, NULL, NULL, NULL},
+    {NULL}
+};
+
+static PyTypeObject ProgramType = {
+    .ob_base = PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = MODULE_NAME ".Program",
+    .tp_doc = "Decoded program image shared by machines.",
+    .tp_basicsize = sizeof(ProgramObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Program_init,
+    .tp_dealloc = (destructor)Program_dealloc,
+    .tp_as_sequence = &Program_as_sequence,
+    .tp_methods = Program_methods,
+    .tp_getset = Program_getset,
+};
+
+/* Length of imem (a list, or a Program's tuple) */
+static Py_ssize_t imem_len(CMachine *self) {
+    if (PyTuple_Check(self->imem))
+        return PyTuple_GET_SIZE(self->imem);
+    return PyList_Check(self->imem) ? PyList_GET_SIZE(self->imem) : 0;
+}
+
+static void free_ops(CMachine *self) {
+    if (self->program) {
+        Py_CLEAR(self->program);
+    } else {
+        for (Py_ssize_t i = 0; i < self->n_ops; i++) {
+            Py_XDECREF(self->ops[i].instr);
+            Py_XDECREF(self->ops[i].stat_key);
+        }
+        PyMem_Free(self->ops);
+    }
+    if (self->counts_arena)
+        Py_CLEAR(self->counts_arena);
+    else
+        PyMem_Free(self->counts);
+    self->ops = NULL;
+    self->counts = NULL;
+    self->n_ops = 0;
+    self->exec_order.len = 0;
+}
+
+/* Install imem (at __init__/reset): a Program's shared decode, or a list
+ * decoded into the machine's own table. */
+static int load_imem(CMachine *self, PyObject *imem) {
+    free_ops(self);
+    Py_INCREF(imem);
+    if (Program_Check(imem)) {
+        ProgramObject *prog = (ProgramObject *)imem;
+        Py_INCREF(prog->instrs);
+        Py_XSETREF(self->imem, prog->instrs);
+        self->program = imem;
+        self->ops = prog->ops;
+        self->n_ops = prog->n_ops;
+    } else {
+        Py_XSETREF(self->imem, imem);
+        if (PyList_Check(imem)) {
+            Py_ssize_t n = PyList_GET_SIZE(imem);
+            self->ops = PyMem_Calloc(n ? (size_t)n : 1, sizeof(MicroOp));
+            if (!self->ops) {
+                PyErr_NoMemory();
+                return -1;
+            }
+            self->n_ops = n;
+            uint64_t start = perf_now();
+            for (Py_ssize_t i = 0; i < n; i++)
+                decode_instr(PyList_GET_ITEM(imem, i), &self->ops[i]);
+            link_blocks(self->ops, n);
+            self->perf.decode_ns += perf_now() - start;
+        }
+    }
+    self->counts = PyMem_Calloc(self->n_ops ? (size_t)self->n_ops : 1, sizeof(SlotCounts));
+    if (!self->counts) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+/* Decoded op for an imem address.  Slots whose list item was replaced,
+ * or that lie past the decoded range, are (re)decoded on the fly; a
+ * Program's ops are fixed. */
+static MicroOp *op_at(CMachine *self, long addr) {
+    if (self->program) {
+        if (addr < 0 || addr >= self->n_ops) {
+            PyErr_SetString(PyExc_IndexError, "tuple index out of range");
+            return NULL;
+        }
+        return &self->ops[addr];
+    }
+    PyObject *instr = PyList_GetItem(self->imem, addr);
+    if (!instr) return NULL;
+    if (addr >= self->n_ops) {
+        Py_ssize_t n = PyList_GET_SIZE(self->imem);
+        MicroOp *ops = PyMem_Realloc(self->ops, (size_t)n * sizeof(MicroOp));
+        if (!ops) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        memset(ops + self->n_ops, 0, (size_t)(n - self->n_ops) * sizeof(MicroOp));
+        self->ops = ops;
+        SlotCounts *counts = PyMem_Realloc(self->counts, (size_t)n * sizeof(SlotCounts));
+        if (!counts) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        memset(counts + self->n_ops, 0, (size_t)(n - self->n_ops) * sizeof(SlotCounts));
+        self->counts = counts;
+        self->n_ops = n;
+    }
+    MicroOp *op = &self->ops[addr];
+    if (op->instr != instr) {
+        /* The slot's counters restart with the new instruction */
+        SlotCounts *cnt = &self->counts[addr];
+        if (cnt->exec_count != cnt->flushed && flush_histo(self) < 0)
+            return NULL;
+        memset(cnt, 0, sizeof(*cnt));
+        Py_XDECREF(op->instr);
+        Py_XDECREF(op->stat_key);
+        uint64_t start = perf_now();
+        decode_instr(instr, op);
+        link_blocks_range(self->ops, self->n_ops, addr, addr + 1);
+        self->perf.decode_ns += perf_now() - start;
+    }
+    return op;
+}
+
+/* ------------------------------------------------------------------ */
+/* Statistics                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Statistics are kept in C while the machine runs and only turned into
+ * the Python structures sim_helpers.dump_stats() expects (the stats dict
+ * entries instruction_histo, func_calls, loops, movi, wide_mem_ops and
+ * flag_access) by stats_flush().  That happens when stats is read or
+ * replaced, on reset() and when the machine is released, so a dict
+ * assigned to stats is complete once the machine is gone.
+ *
+ * Every executed instruction bumps its slot's exec_count/cycle_count and
+ * opcode_counts[]; the histo key (the first word of get_asm_str()[1]) is
+ * computed once per slot on the first flush that needs it.  exec_order
+ * lists slots in the order they first gained unflushed executions, which
+ * keeps the Counter's key order the same as counting every step. */
+
+static PyObject *counter_type;                      /* collections.Counter */
+static PyObject *opcode_name_objs[NUM_OPCODES];     /* interned opcode_names */
+static PyObject *flag_group_names[2];               /* "n", "x" */
+
+static int stats_init_module(void) {
+    PyObject *collections = PyImport_ImportModule("collections");
+    if (!collections) return -1;
+    counter_type = PyObject_GetAttrString(collections, "Counter");
+    Py_DECREF(collections);
+    if (!counter_type) return -1;
+    for (int i = 0; i < NUM_OPCODES; i++) {
+        if (opcode_names[i] && !(opcode_name_objs[i] = PyUnicode_InternFromString(opcode_names[i])))
+            return -1;
+    }
+    if (!(flag_group_names[0] = PyUnicode_InternFromString("n")) ||
+        !(flag_group_names[1] = PyUnicode_InternFromString("x")))
+        return -1;
+    return 0;
+}
+
+/* Append a zeroed record of the given size; NULL (MemoryError) on failure. */
+static void *event_push(EventBuf *buf, size_t size) {
+    if (buf->len == buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : 64;
+        char *data = PyMem_RawRealloc(buf->data, cap * size);
+        if (!data) {
+            raise_error(PyExc_MemoryError, "out of memory recording statistics");
+            return NULL;
+        }
+        buf->data = data;
+        buf->cap = cap;
+    }
+    void *rec = buf->data + buf->len++ * size;
+    memset(rec, 0, size);
+    return rec;
+}
+
+static void event_free(EventBuf *buf) {
+    PyMem_RawFree(buf->data);
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+/* Count one execution of op (the slot at addr) taking cycles cycles. */
+static int stats_count_exec(CMachine *self, MicroOp *op, Py_ssize_t addr, long cycles) {
+    SlotCounts *cnt = &self->counts[addr];
+    if (cnt->exec_count == cnt->flushed) {
+        Py_ssize_t *slot = event_push(&self->exec_order, sizeof(Py_ssize_t));
+        if (!slot) return -1;
+        *slot = addr;
+    }
+    cnt->exec_count++;
+    cnt->cycle_count += (uint64_t)cycles;
+    self->opcode_counts[op->opcode]++;
+    if (self->prof_active && prof_account(self, addr, cycles) < 0)
+        return -1;
+    return 0;
+}
+
+static int stats_flag_access(CMachine *self, PyObject *flag_group, PyObject *op) {
+    FlagAccessEvent *ev = event_push(&self->flag_events, sizeof(*ev));
+    if (!ev) return -1;
+    Py_INCREF(flag_group);
+    Py_INCREF(op);
+    ev->flag_group = flag_group;
+    ev->op = op;
+    ev->owned = 1;
+    return 0;
+}
+
+static int stats_wide_mem_op(CMachine *self, PyObject *op, PyObject *inc_src, PyObject *inc_dst) {
+    WideMemEvent *ev = event_push(&self->wide_mem_events, sizeof(*ev));
+    if (!ev) return -1;
+    Py_INCREF(op);
+    Py_INCREF(inc_src);
+    Py_INCREF(inc_dst);
+    ev->op = op;
+    ev->inc_src = inc_src;
+    ev->inc_dst = inc_dst;
+    ev->owned = 1;
+    return 0;
+}
+
+/* Kernel-side variants: the objects are module-level and borrowed. */
+static int stats_kernel_flag_access(CMachine *self, int flag_group, int opcode) {
+    FlagAccessEvent *ev = event_push(&self->flag_events, sizeof(*ev));
+    if (!ev) return -1;
+    ev->flag_group = flag_group_names[flag_group];
+    ev->op = opcode_name_objs[opcode];
+    return 0;
+}
+
+static int stats_kernel_wide_mem_op(CMachine *self, int opcode, int inc_src, int inc_dst) {
+    WideMemEvent *ev = event_push(&self->wide_mem_events, sizeof(*ev));
+    if (!ev) return -1;
+    ev->op = opcode_name_objs[opcode];
+    ev->inc_src = inc_src ? Py_True : Py_False;
+    ev->inc_dst = inc_dst ? Py_True : Py_False;
+    return 0;
+}
+
+static void flag_event_release(FlagAccessEvent *ev) {
+    if (ev->owned) {
+        Py_DECREF(ev->flag_group);
+        Py_DECREF(ev->op);
+    }
+}
+
+static void wide_mem_event_release(WideMemEvent *ev) {
+    if (ev->owned) {
+        Py_DECREF(ev->op);
+        Py_DECREF(ev->inc_src);
+        Py_DECREF(ev->inc_dst);
+    }
+}
+
+static int stats_func_call(CMachine *self, long call_site, long callee_func) {
+    FuncCallEvent *ev = event_push(&self->func_call_events, sizeof(*ev));
+    if (!ev) return -1;
+    ev->call_site = call_site;
+    ev->callee_func = callee_func;
+    return 0;
+}
+
+static int stats_loop(CMachine *self, long loop_addr, long loop_len, long depth, long iterations) {
+    LoopEvent *ev = event_push(&self->loop_events, sizeof(*ev));
+    if (!ev) return -1;
+    ev->loop_addr = loop_addr;
+    ev->loop_len = loop_len;
+    ev->new_loop_stack_depth = depth;
+    ev->iterations = iterations;
+    return 0;
+}
+
+static int stats_movi(CMachine *self, long imm_size) {
+    if (imm_size < 0 || imm_size > XLEN) {
+        PyErr_SetString(PyExc_ValueError, "movi immediate size out of range");
+        return -1;
+    }
+    self->movi_counts[imm_size]++;
+    return 0;
+}
+
+/* Drop everything recorded but not yet flushed. */
+static void stats_clear(CMachine *self) {
+    FlagAccessEvent *fa = (FlagAccessEvent *)self->flag_events.data;
+    for (size_t i = 0; i < self->flag_events.len; i++)
+        flag_event_release(&fa[i]);
+    WideMemEvent *wm = (WideMemEvent *)self->wide_mem_events.data;
+    for (size_t i = 0; i < self->wide_mem_events.len; i++)
+        wide_mem_event_release(&wm[i]);
+    self->flag_events.len = 0;
+    self->wide_mem_events.len = 0;
+    self->func_call_events.len = 0;
+    self->loop_events.len = 0;
+    self->exec_order.len = 0;
+    for (Py_ssize_t i = 0; i < self->n_ops; i++)
+        self->counts[i].flushed = self->counts[i].exec_count;
+    memset(self->movi_counts, 0, sizeof(self->movi_counts));
+}
+
+/* get_func_addr_for_pc(): scans back from pc for an address listed in
+ * ctx.functions, stopping at 1 like the Python Machine. */
+static int func_addr_for_pc(CMachine *self, PyObject *functions, long pc, long *addr) {
+    for (; pc > 1; pc--) {
+        PyObject *key = PyLong_FromLong(pc);
+        if (!key) return -1;
+        int found = PySequence_Contains(functions, key);
+        Py_DECREF(key);
+        if (found < 0) return -1;
+        if (found) break;
+    }
+    *addr = pc;
+    return 0;
+}
+
+/* stats[name], created with factory() when missing.  New reference. */
+static PyObject *stats_entry(CMachine *self, const char *name, PyObject *factory) {
+    PyObject *entry = PyMapping_GetItemString(self->stats, name);
+    if (entry || !PyErr_ExceptionMatches(PyExc_KeyError))
+        return entry;
+    PyErr_Clear();
+    entry = PyObject_CallNoArgs(factory);
+    if (entry && PyMapping_SetItemString(self->stats, name, entry) < 0)
+        Py_CLEAR(entry);
+    return entry;
+}
+
+/* counter[key] += n */
+static int counter_add(PyObject *counter, PyObject *key, uint64_t n) {
+    PyObject *cur = PyObject_GetItem(counter, key);
+    if (!cur) {
+        if (!PyErr_ExceptionMatches(PyExc_KeyError))
+            return -1;
+        PyErr_Clear();
+        cur = PyLong_FromLong(0);
+        if (!cur) return -1;
+    }
+    PyObject *inc = PyLong_FromUnsignedLongLong(n);
+    PyObject *sum = inc ? PyNumber_Add(cur, inc) : NULL;
+    Py_DECREF(cur);
+    Py_XDECREF(inc);
+    if (!sum) return -1;
+    int rc = PyObject_SetItem(counter, key, sum);
+    Py_DECREF(sum);
+    return rc;
+}
+
+/* First word of instr.get_asm_str()[1], the histo key the Python machine's
+ * stat_record_instr() counts under.
+ * Instructions without one are left out of the histo. */
+static PyObject *histo_key(PyObject *instr) {
+    PyObject *asm_result = PyObject_CallMethod(instr, "get_asm_str", NULL);
+    PyObject *asm_str = asm_result ? PySequence_GetItem(asm_result, 1) : NULL;
+    PyObject *parts = asm_str ? PyUnicode_Split(asm_str, NULL, 1) : NULL;
+    PyObject *key = NULL;
+    if (parts && PyList_GET_SIZE(parts) > 0)
+        key = PyObject_CallMethod(PyList_GET_ITEM(parts, 0), "strip", NULL);
+    Py_XDECREF(parts);
+    Py_XDECREF(asm_str);
+    Py_XDECREF(asm_result);
+    if (!key)
+        PyErr_Clear();
+    return key;
+}
+
+static int flush_histo(CMachine *self) {
+    if (!self->exec_order.len)
+        return 0;
+    PyObject *histo = stats_entry(self, "instruction_histo", counter_type);
+    if (!histo) return -1;
+    const Py_ssize_t *order = (const Py_ssize_t *)self->exec_order.data;
+    for (size_t i = 0; i < self->exec_order.len; i++) {
+        MicroOp *op = &self->ops[order[i]];
+        SlotCounts *cnt = &self->counts[order[i]];
+        uint64_t n = cnt->exec_count - cnt->flushed;
+        if (!n) continue;
+        if (!op->stat_key && !(op->stat_key = histo_key(op->instr))) {
+            cnt->flushed = cnt->exec_count;
+            continue;
+        }
+        if (counter_add(histo, op->stat_key, n) < 0) {
+            Py_DECREF(histo);
+            return -1;
+        }
+        cnt->flushed = cnt->exec_count;
+    }
+    self->exec_order.len = 0;
+    Py_DECREF(histo);
+    return 0;
+}
+
+static int flush_func_calls(CMachine *self) {
+    if (!self->func_call_events.len)
+        return 0;
+    PyObject *calls = stats_entry(self, "func_calls", (PyObject *)&PyList_Type);
+    PyObject *functions = calls ? PyObject_GetAttrString(self->ctx, "functions") : NULL;
+    PyObject *callers = functions ? PyDict_New() : NULL;  /* call_site -> caller_func */
+    int rc = callers ? 0 : -1;
+    const FuncCallEvent *ev = (const FuncCallEvent *)self->func_call_events.data;
+    for (size_t i = 0; i < self->func_call_events.len && rc == 0; i++) {
+        PyObject *site = PyLong_FromLong(ev[i].call_site);
+        PyObject *caller = site ? PyDict_GetItemWithError(callers, site) : NULL;
+        PyObject *rec = NULL;
+        long addr;
+        if (caller) {
+            Py_INCREF(caller);
+        } else if (site && !PyErr_Occurred() &&
+                   func_addr_for_pc(self, functions, ev[i].call_site, &addr) == 0 &&
+                   (caller = PyLong_FromLong(addr)) != NULL &&
+                   PyDict_SetItem(callers, site, caller) < 0) {
+            Py_CLEAR(caller);
+        }
+        if (caller)
+            rec = Py_BuildValue("{s:O,s:O,s:l}", "call_site", site, "caller_func", caller,
+                                "callee_func", ev[i].callee_func);
+        if (!rec || PyList_Append(calls, rec) < 0)
+            rc = -1;
+        Py_XDECREF(rec);
+        Py_XDECREF(caller);
+        Py_XDECREF(site);
+    }
+    Py_XDECREF(callers);
+    Py_XDECREF(functions);
+    Py_XDECREF(calls);
+    if (rc == 0)
+        self->func_call_events.len = 0;
+    return rc;
+}
+
+static int flush_loops(CMachine *self) {
+    if (!self->loop_events.len)
+        return 0;
+    PyObject *loops = stats_entry(self, "loops", (PyObject *)&PyList_Type);
+    if (!loops) return -1;
+    const LoopEvent *ev = (const LoopEvent *)self->loop_events.data;
+    for (size_t i = 0; i < self->loop_events.len; i++) {
+        PyObject *rec = Py_BuildValue("{s:l,s:l,s:l,s:l}", "loop_addr", ev[i].loop_addr,
+                                      "loop_len", ev[i].loop_len,
+                                      "new_loop_stack_depth", ev[i].new_loop_stack_depth,
+                                      "iterations", ev[i].iterations);
+        if (!rec || PyList_Append(loops, rec) < 0) {
+            Py_XDECREF(rec);
+            Py_DECREF(loops);
+            return -1;
+        }
+        Py_DECREF(rec);
+    }
+    self->loop_events.len = 0;
+    Py_DECREF(loops);
+    return 0;
+}
+
+static int flush_movi(CMachine *self) {
+    PyObject *movi = NULL;
+    for (int size = 0; size <= XLEN; size++) {
+        if (!self->movi_counts[size]) continue;
+        if (!movi && !(movi = stats_entry(self, "movi", counter_type)))
+            return -1;
+        PyObject *key = PyLong_FromLong(size);
+        if (!key || counter_add(movi, key, self->movi_counts[size]) < 0) {
+            Py_XDECREF(key);
+            Py_DECREF(movi);
+            return -1;
+        }
+        Py_DECREF(key);
+        self->movi_counts[size] = 0;
+    }
+    Py_XDECREF(movi);
+    return 0;
+}
+
+static int flush_wide_mem_ops(CMachine *self) {
+    if (!self->wide_mem_events.len)
+        return 0;
+    PyObject *ops = stats_entry(self, "wide_mem_ops", (PyObject *)&PyList_Type);
+    if (!ops) return -1;
+    WideMemEvent *ev = (WideMemEvent *)self->wide_mem_events.data;
+    for (size_t i = 0; i < self->wide_mem_events.len; i++) {
+        PyObject *rec = Py_BuildValue("{s:O,s:O,s:O}", "op", ev[i].op,
+                                      "inc_src", ev[i].inc_src, "inc_dst", ev[i].inc_dst);
+        if (!rec || PyList_Append(ops, rec) < 0) {
+            Py_XDECREF(rec);
+            Py_DECREF(ops);
+            return -1;
+        }
+        Py_DECREF(rec);
+    }
+    Py_DECREF(ops);
+    for (size_t i = 0; i < self->wide_mem_events.len; i++)
+        wide_mem_event_release(&ev[i]);
+    self->wide_mem_events.len = 0;
+    return 0;
+}
+
+static int flush_flag_access(CMachine *self) {
+    if (!self->flag_events.len)
+        return 0;
+    PyObject *accesses = stats_entry(self, "flag_access", (PyObject *)&PyList_Type);
+    if (!accesses) return -1;
+    FlagAccessEvent *ev = (FlagAccessEvent *)self->flag_events.data;
+    for (size_t i = 0; i < self->flag_events.len; i++) {
+        PyObject *rec = Py_BuildValue("{s:O,s:O}", "flag_group", ev[i].flag_group, "op", ev[i].op);
+        if (!rec || PyList_Append(accesses, rec) < 0) {
+            Py_XDECREF(rec);
+            Py_DECREF(accesses);
+            return -1;
+        }
+        Py_DECREF(rec);
+    }
+    Py_DECREF(accesses);
+    for (size_t i = 0; i < self->flag_events.len; i++)
+        flag_event_release(&ev[i]);
+    self->flag_events.len = 0;
+    return 0;
+}
+
+/* Materialize everything recorded since the last flush into stats. */
+static int stats_flush(CMachine *self) {
+    if (!self->stats)
+        return 0;
+    if (flush_histo(self) < 0 || flush_func_calls(self) < 0 || flush_loops(self) < 0 ||
+        flush_movi(self) < 0 || flush_wide_mem_ops(self) < 0 || flush_flag_access(self) < 0)
+        return -1;
+    return 0;
+}
+
+/* stat_record_*(): the Python Machine's stats hooks, for instructions
+ * that run through execute(). */
+static PyObject *
+CMachine_stat_record_func_call(CMachine *self, PyObject *args, PyObject *kwds) {
+    long call_site, callee_func;
+    static char *kwlist[] = {"call_site", "callee_func", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ll", kwlist, &call_site, &callee_func))
+        return NULL;
+    if (stats_func_call(self, call_site, callee_func) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_stat_record_loop(CMachine *self, PyObject *args, PyObject *kwds) {
+    long loop_addr, loop_len, depth, iterations;
+    static char *kwlist[] = {"loop_addr", "loop_len", "new_loop_stack_depth", "iterations", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "llll", kwlist,
+                                     &loop_addr, &loop_len, &depth, &iterations))
+        return NULL;
+    if (stats_loop(self, loop_addr, loop_len, depth, iterations) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_stat_record_movi(CMachine *self, PyObject *args, PyObject *kwds) {
+    long imm_size;
+    static char *kwlist[] = {"imm_size", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "l", kwlist, &imm_size))
+        return NULL;
+    if (stats_movi(self, imm_size) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_stat_record_wide_mem_op(CMachine *self, PyObject *args, PyObject *kwds) {
+    PyObject *op, *inc_src, *inc_dst;
+    static char *kwlist[] = {"op", "inc_src", "inc_dst", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO", kwlist, &op, &inc_src, &inc_dst))
+        return NULL;
+    if (stats_wide_mem_op(self, op, inc_src, inc_dst) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_stat_record_flag_access(CMachine *self, PyObject *args, PyObject *kwds) {
+    PyObject *flag_group, *op;
+    static char *kwlist[] = {"flag_group", "op", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO", kwlist, &flag_group, &op))
+        return NULL;
+    if (stats_flag_access(self, flag_group, op) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CMachine_get_func_addr_for_pc(CMachine *self, PyObject *args) {
+    long pc, addr;
+    if (!PyArg_ParseTuple(args, "l", &pc))
+        return NULL;
+    PyObject *functions = PyObject_GetAttrString(self->ctx, "functions");
+    if (!functions) return NULL;
+    int rc = func_addr_for_pc(self, functions, pc, &addr);
+    Py_DECREF(functions);
+    if (rc < 0) return NULL;
+    return PyLong_FromLong(addr);
+}
+
+/* get_opcode_counts(): {kernel mnemonic: executions}, with None for
+ * instructions that ran through execute(). */
+static PyObject *
+CMachine_get_opcode_counts(CMachine *self, PyObject *Py_UNUSED(args)) {
+    PyObject *res = PyDict_New();
+    if (!res) return NULL;
+    for (int i = 0; i < NUM_OPCODES; i++) {
+        if (!self->opcode_counts[i]) continue;
+        PyObject *n = PyLong_FromUnsignedLongLong(self->opcode_counts[i]);
+        if (!n || PyDict_SetItem(res, i == OP_PYTHON ? Py_None : opcode_name_objs[i], n) < 0) {
+            Py_XDECREF(n);
+            Py_DECREF(res);
+            return NULL;
+        }
+        Py_DECREF(n);
+    }
+    return res;
+}
+
+/* Per-address counters since the program was loaded: one entry per
+ * imem address. */
+static PyObject *pc_counters(CMachine *self, int cycles) {
+    Py_ssize_t n = imem_len(self);
+    PyObject *res = PyList_New(n);
+    if (!res) return NULL;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        uint64_t v = 0;
+        if (i < self->n_ops)
+            v = cycles ? self->counts[i].cycle_count : self->counts[i].exec_count;
+        PyObject *item = PyLong_FromUnsignedLongLong(v);
+        if (!item) {
+            Py_DECREF(res);
+            return NULL;
+        }
+        PyList_SET_ITEM(res, i, item);
+    }
+    return res;
+}
+
+/* get_exec_counts(): times each imem address was executed */
+static PyObject *
+CMachine_get_exec_counts(CMachine *self, PyObject *Py_UNUSED(args)) {
+    return pc_counters(self, 0);
+}
+
+/* get_cycle_counts(): cycles spent at each imem address */
+static PyObject *
+CMachine_get_cycle_counts(CMachine *self, PyObject *Py_UNUSED(args)) {
+    return pc_counters(self, 1);
+}
+
+/* ------------------------------------------------------------------ */
+/* Performance counters                                                */
+/* ------------------------------------------------------------------ */
+/* perf_counters() reports where a run's time went, as a PerfCounters
+ * struct sequence (fields below, in this order; new ones are only ever
+ * appended).  Native and Python-backed executions come out of
+ * opcode_counts[], which every executed instruction bumps anyway; the
+ * rest are single adds at the places they count, and the phase timers
+ * read the clock once per call of the timed function, so keeping the
+ * counters costs next to nothing.  dmem_host_bytes counts copies
+ * between DMEM and Python (including Python-backed instructions'
+ * get_dmem()/set_dmem()), dmem_op_bytes the loads and stores of native
+ * kernels.  decode_ns only covers the machine's own decodes of a list
+ * imem; a shared Program keeps its own decode_ns.  run_lanes() adds its
+ * whole duration to every lane's run_ns.  routines counts the
+ * superinstructions that ran a routine kernel (see exec_routine()),
+ * lane_ops the instructions a lane ran in run_lanes()' structure-of-arrays
+ * kernels (see "Lockstep lanes"). */
+#ifndef OT_DSIM_MACHINE_VARIANT
+/* The variants share _machine's type */
+static PyStructSequence_Field perf_counters_fields[] = {
+    {"native_ops", "instructions run by native kernels"},
+    {"python_ops", "instructions run through execute()"},
+    {"superinstructions", "fused runs dispatched as one superinstruction"},
+    {"fused_ops", "instructions run inside superinstructions"},
+    {"blocks", "straight-line stretches run by the block loop"},
+    {"block_ops", "instructions run inside those stretches"},
+    {"breakpoint_checks", "breakpoint checks before an instruction or stretch"},
+    {"trace_bytes", "binary trace bytes recorded"},
+    {"dmem_op_bytes", "DMEM bytes loaded and stored by native kernels"},
+    {"dmem_host_bytes", "DMEM bytes copied from or to Python"},
+    {"pylongs", "Python ints created from wide values"},
+    {"decode_ns", "time spent decoding instructions, ns"},
+    {"run_ns", "time spent in run(), step() and run_lanes(), ns"},
+    {"readback_ns", "time spent copying DMEM and state images out, ns"},
+    {"routines", "recognized routines run by a routine kernel"},
+    {"lane_ops", "instructions run by run_lanes()' lane kernels"},
+    {NULL, NULL},
+};
+
+static PyStructSequence_Desc perf_counters_desc = {
+    MODULE_NAME ".PerfCounters",
+    "Hot-path performance counters of a machine, see perf_counters().",
+    perf_counters_fields,
+    16,
+};
+#endif
+
+static PyTypeObject *perf_counters_type;
+
+static void perf_totals(CMachine *self, uint64_t *native, uint64_t *python) {
+    *native = 0;
+    for (int i = 0; i < NUM_OPCODES; i++) {
+        if (i != OP_PYTHON)
+            *native += self->opcode_counts[i];
+    }
+    *python = self->opcode_counts[OP_PYTHON];
+}
+
+/* perf_counters() -> PerfCounters */
+static PyObject *
+CMachine_perf_counters(CMachine *self, PyObject *Py_UNUSED(args)) {
+    const PerfCounters *p = &self->perf;
+    uint64_t native, python;
+    perf_totals(self, &native, &python);
+    uint64_t values[] = {
+        native - p->native_base, python - p->python_base,
+        p->superinstructions, p->fused_ops, p->blocks, p->block_ops,
+        p->bp_checks, p->trace_bytes, p->dmem_op_bytes, p->dmem_host_bytes,
+        p->pylongs, p->decode_ns, p->run_ns, p->readback_ns, p->routines, p->lane_ops,
+    };
+    PyObject *res = PyStructSequence_New(perf_counters_type);
+    if (!res) return NULL;
+    for (Py_ssize_t i = 0; i < (Py_ssize_t)(sizeof(values) / sizeof(values[0])); i++) {
+        PyObject *v = PyLong_FromUnsignedLongLong(values[i]);
+        if (!v) {
+            Py_DECREF(res);
+            return NULL;
+        }
+        PyStructSequence_SET_ITEM(res, i, v);
+    }
+    return res;
+}
+
+/* reset_perf_counters(): start all counters over from zero */
+static PyObject *
+CMachine_reset_perf_counters(CMachine *self, PyObject *Py_UNUSED(args)) {
+    memset(&self->perf, 0, sizeof(self->perf));
+    perf_totals(self, &self->perf.native_base, &self->perf.python_base);
+    Py_RETURN_NONE;
+}
+
+/* ------------------------------------------------------------------ */
+/* Profiler                                                            */
+/* ------------------------------------------------------------------ */
+/* enable_profile() attributes every executed cycle to the call path it
+ * ran on and to the loops around it.  Nothing hooks calls or loops
+ * directly: prof_account(), called for each instruction before it runs,
+ * compares the call and loop stack depths with the ones it last saw.  A
+ * deeper call stack means the instruction is the entry of a callee (the
+ * path tree grows a child keyed by its address); a shallower one
+ * returns to the parent.  Returns past the function running at
+ * enable_profile() stay with the root.  A deeper loop stack opens a loop
+ * frame (keyed by the LOOP instruction, start_addr - 1), a shallower one
+ * closes it with its inclusive cycles.  Plain C, so it also runs with
+ * the GIL released. */
+static Py_ssize_t prof_new_node(CMachine *self, long func, Py_ssize_t parent) {
+    if (self->prof_n == self->prof_cap) {
+        Py_ssize_t cap = self->prof_cap ? self->prof_cap * 2 : 64;
+        ProfNode *nodes = PyMem_RawRealloc(self->prof_nodes, (size_t)cap * sizeof(ProfNode));
+        if (!nodes) {
+            raise_error(PyExc_MemoryError, "out of memory for profile");
+            return -1;
+        }
+        self->prof_nodes = nodes;
+        self->prof_cap = cap;
+    }
+    ProfNode *node = &self->prof_nodes[self->prof_n];
+    memset(node, 0, sizeof(*node));
+    node->func = func;
+    node->parent = parent;
+    node->child = node->sibling = -1;
+    if (parent >= 0) {
+        node->sibling = self->prof_nodes[parent].child;
+        self->prof_nodes[parent].child = self->prof_n;
+    }
+    return self->prof_n++;
+}
+
+static int prof_account(CMachine *self, Py_ssize_t addr, long cycles) {
+    while (self->call_sp > self->prof_depth) {
+        Py_ssize_t child = self->prof_nodes[self->prof_node].child;
+        while (child >= 0 && self->prof_nodes[child].func != (long)addr)
+            child = self->prof_nodes[child].sibling;
+        if (child < 0 && (child = prof_new_node(self, (long)addr, self->prof_node)) < 0)
+            return -1;
+        self->prof_nodes[child].calls++;
+        self->prof_node = child;
+        self->prof_depth++;
+    }
+    while (self->call_sp < self->prof_depth) {
+        if (self->prof_nodes[self->prof_node].parent >= 0)
+            self->prof_node = self->prof_nodes[self->prof_node].parent;
+        self->prof_depth--;
+    }
+
+    while (self->loop_sp < self->prof_loop_depth) {
+        ProfLoopFrame *fr = &self->prof_loop_frames[--self->prof_loop_depth];
+        if (fr->addr >= 0 && fr->addr < self->prof_n_loops)
+            self->prof_loops[fr->addr].cycles += self->prof_cycles - fr->start;
+    }
+    while (self->loop_sp > self->prof_loop_depth) {
+        const LoopEntry *le = &self->loop_stack[self->prof_loop_depth];
+        ProfLoopFrame *fr = &self->prof_loop_frames[self->prof_loop_depth++];
+        fr->addr = le->start_addr - 1;
+        fr->start = self->prof_cycles;
+        if (fr->addr >= 0 && fr->addr < self->prof_n_loops) {
+            self->prof_loops[fr->addr].entries++;
+            self->prof_loops[fr->addr].iterations += (uint64_t)(le->cnt + 1);
+        }
+    }
+
+    self->prof_nodes[self->prof_node].cycles += (uint64_t)cycles;
+    self->prof_cycles += (uint64_t)cycles;
+    return 0;
+}
+
+static void prof_free(CMachine *self) {
+    PyMem_RawFree(self->prof_nodes);
+    PyMem_RawFree(self->prof_loops);
+    self->prof_nodes = NULL;
+    self->prof_loops = NULL;
+    self->prof_n = self->prof_cap = self->prof_n_loops = 0;
+    self->prof_active = 0;
+}
+
+/* enable_profile(): start a fresh profile from the current state */
+static PyObject *
+CMachine_enable_profile(CMachine *self, PyObject *Py_UNUSED(args)) {
+    if (machine_idle_check(self) < 0)
+        return NULL;
+    prof_free(self);
+    Py_ssize_t n = imem_len(self);
+    self->prof_loops = PyMem_RawCalloc(n ? (size_t)n : 1, sizeof(ProfLoop));
+    if (!self->prof_loops)
+        return PyErr_NoMemory();
+    self->prof_n_loops = n;
+    self->prof_root_pc = self->pc;
+    if (prof_new_node(self, self->pc, -1) < 0)
+        return NULL;
+    self->prof_node = 0;
+    self->prof_depth = self->call_sp;
+    self->prof_loop_depth = 0;
+    self->prof_cycles = 0;
+    /* Loops already running get frames (with their remaining
+     * iterations) at the next instruction */
+    self->prof_active = 1;
+    Py_RETURN_NONE;
+}
+
+/* disable_profile(): stop collecting; get_profile() still reports */
+static PyObject *
+CMachine_disable_profile(CMachine *self, PyObject *Py_UNUSED(args)) {
+    self->prof_active = 0;
+    Py_RETURN_NONE;
+}
+
+/* Name of the function at addr: ctx.functions, then ctx.labels, else the
+ * address.  With scan, the nearest entry at or below addr. */
+static PyObject *prof_func_name(CMachine *self, long addr, int scan) {
+    static const char *const tables[] = {"functions", "labels"};
+    if (self->ctx != Py_None) {
+        for (int t = 0; t < 2; t++) {
+            PyObject *table = PyObject_GetAttrString(self->ctx, tables[t]);
+            if (!table) {
+                PyErr_Clear();
+                continue;
+            }
+            for (long a = addr; a >= 0 && (scan || a == addr); a--) {
+                PyObject *key = PyLong_FromLong(a);
+                PyObject *name = key ? PyObject_GetItem(table, key) : NULL;
+                Py_XDECREF(key);
+                if (name) {
+                    PyObject *res = PyObject_Str(name);
+                    Py_DECREF(name);
+                    Py_DECREF(table);
+                    return res;
+                }
+                PyErr_Clear();
+            }
+            Py_DECREF(table);
+        }
+    }
+    return PyUnicode_FromFormat("%ld", addr);
+}
+
+/* Set d[key] = value, stealing value; -1 on error */
+static int dict_set_steal(PyObject *d, PyObject *key, PyObject *value) {
+    int rc = value ? PyDict_SetItem(d, key, value) : -1;
+    Py_XDECREF(value);
+    return rc;
+}
+
+/* get_profile() -> dict
+ *
+ *   cycles     cycles profiled
+ *   functions  {name: {"calls", "inclusive", "exclusive"}}; recursion
+ *              counts a function's inclusive cycles once
+ *   paths      {"root;callee;...": exclusive cycles}, the folded-stack
+ *              input of flame graph tools
+ *   loops      {loop address: {"entries", "iterations", "cycles"}} with
+ *              inclusive cycles, open loops up to now
+ */
+static PyObject *
+CMachine_get_profile(CMachine *self, PyObject *Py_UNUSED(args)) {
+    PyObject *res = NULL, *functions = NULL, *paths = NULL, *loops = NULL;
+    PyObject **names = NULL, **path_strs = NULL;
+    uint64_t *incl = NULL;
+    Py_ssize_t n = self->prof_n;
+
+    if (!(res = PyDict_New()) || !(functions = PyDict_New()) ||
+        !(paths = PyDict_New()) || !(loops = PyDict_New()))
+        goto error;
+    if (n) {
+        names = PyMem_Calloc((size_t)n, sizeof(PyObject *));
+        path_strs = PyMem_Calloc((size_t)n, sizeof(PyObject *));
+        incl = PyMem_Calloc((size_t)n, sizeof(uint64_t));
+        if (!names || !path_strs || !incl) {
+            PyErr_NoMemory();
+            goto error;
+        }
+    }
+
+    /* Parents precede their children, so one pass builds the paths and
+     * a reverse one the inclusive cycles. */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        const ProfNode *node = &self->prof_nodes[i];
+        if (!(names[i] = prof_func_name(self, node->func, node->parent < 0)))
+            goto error;
+        path_strs[i] = node->parent < 0
+                       ? (Py_INCREF(names[i]), names[i])
+                       : PyUnicode_FromFormat("%U;%U", path_strs[node->parent], names[i]);
+        if (!path_strs[i])
+            goto error;
+        incl[i] = node->cycles;
+    }
+    for (Py_ssize_t i = n - 1; i > 0; i--)
+        if (self->prof_nodes[i].parent >= 0)
+            incl[self->prof_nodes[i].parent] += incl[i];
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        const ProfNode *node = &self->prof_nodes[i];
+        if (node->cycles &&
+            dict_set_steal(paths, path_strs[i], PyLong_FromUnsignedLongLong(node->cycles)) < 0)
+            goto error;
+
+        int outermost = 1;
+        for (Py_ssize_t a = node->parent; a >= 0; a = self->prof_nodes[a].parent) {
+            int eq = PyUnicode_Compare(names[a], names[i]);
+            if (eq == -1 && PyErr_Occurred())
+                goto error;
+            if (eq == 0) {
+                outermost = 0;
+                break;
+            }
+        }
+        PyObject *entry = PyDict_GetItemWithError(functions, names[i]);
+        unsigned long long calls = node->calls, in = outermost ? incl[i] : 0, ex = node->cycles;
+        if (entry) {
+            calls += PyLong_AsUnsignedLongLong(PyDict_GetItemString(entry, "calls"));
+            in += PyLong_AsUnsignedLongLong(PyDict_GetItemString(entry, "inclusive"));
+            ex += PyLong_AsUnsignedLongLong(PyDict_GetItemString(entry, "exclusive"));
+        } else if (PyErr_Occurred()) {
+            goto error;
+        }
+        if (dict_set_steal(functions, names[i],
+                           Py_BuildValue("{sKsKsK}", "calls", calls,
+                                         "inclusive", in, "exclusive", ex)) < 0)
+            goto error;
+    }
+
+    for (Py_ssize_t a = 0; a < self->prof_n_loops; a++) {
+        ProfLoop lp = self->prof_loops[a];
+        if (!lp.entries)
+            continue;
+        for (int d = 0; d < self->prof_loop_depth; d++)
+            if (self->prof_loop_frames[d].addr == a)
+                lp.cycles += self->prof_cycles - self->prof_loop_frames[d].start;
+        PyObject *key = PyLong_FromSsize_t(a);
+        if (!key)
+            goto error;
+        int rc = dict_set_steal(loops, key,
+                                Py_BuildValue("{sKsKsK}", "entries", (unsigned long long)lp.entries,
+                                              "iterations", (unsigned long long)lp.iterations,
+                                              "cycles", (unsigned long long)lp.cycles));
+        Py_DECREF(key);
+        if (rc < 0)
+            goto error;
+    }
+
+    if (PyDict_SetItemString(res, "functions", functions) < 0 ||
+        PyDict_SetItemString(res, "paths", paths) < 0 ||
+        PyDict_SetItemString(res, "loops", loops) < 0)
+        goto error;
+    PyObject *total = PyLong_FromUnsignedLongLong(self->prof_cycles);
+    if (!total || PyDict_SetItemString(res, "cycles", total) < 0) {
+        Py_XDECREF(total);
+        goto error;
+    }
+    Py_DECREF(total);
+    goto done;
+
+error:
+    Py_CLEAR(res);
+done:
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (names) Py_XDECREF(names[i]);
+        if (path_strs) Py_XDECREF(path_strs[i]);
+    }
+    PyMem_Free(names);
+    PyMem_Free(path_strs);
+    PyMem_Free(incl);
+    Py_XDECREF(functions);
+    Py_XDECREF(paths);
+    Py_XDECREF(loops);
+    return res;
+}
+
+/* ------------------------------------------------------------------ */
+/* Binary trace                                                        */
+/* ------------------------------------------------------------------ */
+
+/* enable_trace() makes the machine log one fixed-size record per executed
+ * instruction instead of formatting trace strings.  Records go to a ring
+ * buffer holding the last `capacity` of them (read with get_trace()), or
+ * are appended to a file.  Both produce the same self-describing format,
+ * decoded by bignum_lib/disassembler.py:
+ *
+ *   header  "OTDTRACE", u16 version, u16 record size, u16 opcode count,
+ *           then the opcode names, each NUL terminated ("" for OP_PYTHON)
+ *   record  u32 pc, u16 opcode, u8 flags (get_flags_as_bin() layout),
+ *           u8 changed WDR, u8 changed GPR (0xFF: none), 3 pad bytes,
+ *           u32 new GPR value, u32[LIMBS] new WDR value
+ *
+ * All fields are little endian.  The changed registers are found by
+ * comparing against the state of the previous record, which is resynced
+ * at each step()/run() so writes from Python between calls are not
+ * attributed to the next instruction.  When an instruction writes more
+ * than one register of a kind, the lowest numbered one is logged. */
+
+#define TRACE_VERSION      1
+#define TRACE_RECORD_SIZE  (16 + 4 * LIMBS)
+#define TRACE_NONE         0xFF
+#define TRACE_DEFAULT_CAP  65536
+
+static void put_le16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+static void trace_sync(CMachine *self) {
+    memcpy(self->trace_r, self->r, sizeof(self->r));
+    memcpy(self->trace_gpr, self->gpr, sizeof(self->gpr));
+}
+
+/* Trace header as a bytes object. */
+static PyObject *trace_header(void) {
+    size_t size = 14;
+    for (int i = 0; i < NUM_OPCODES; i++)
+        size += (opcode_names[i] ? strlen(opcode_names[i]) : 0) + 1;
+    PyObject *res = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)size);
+    if (!res) return NULL;
+    uint8_t *p = (uint8_t *)PyBytes_AS_STRING(res);
+    memcpy(p, "OTDTRACE", 8);
+    put_le16(p + 8, TRACE_VERSION);
+    put_le16(p + 10, TRACE_RECORD_SIZE);
+    put_le16(p + 12, NUM_OPCODES);
+    p += 14;
+    for (int i = 0; i < NUM_OPCODES; i++) {
+        size_t n = opcode_names[i] ? strlen(opcode_names[i]) : 0;
+        memcpy(p, opcode_names[i] ? opcode_names[i] : "", n + 1);
+        p += n + 1;
+    }
+    return res;
+}
+
+static void trace_close(CMachine *self) {
+    if (self->trace_file) {
+        fclose(self->trace_file);
+        self->trace_file = NULL;
+    }
+    self->trace_active = 0;
+}
+
+/* Log the instruction at pc that just executed through opcode. */
+static int trace_record(CMachine *self, long pc, int opcode) {
+    uint8_t rec[TRACE_RECORD_SIZE];
+    memset(rec, 0, sizeof(rec));
+    put_le32(rec, (uint32_t)pc);
+    put_le16(rec + 4, (uint32_t)opcode);
+    rec[6] = self->flags;
+    rec[7] = rec[8] = TRACE_NONE;
+    for (int i = 0; i < NUM_REGS; i++) {
+        if (memcmp(self->r[i], self->trace_r[i], sizeof(self->r[i])) == 0)
+            continue;
+        if (rec[7] == TRACE_NONE) {
+            rec[7] = (uint8_t)i;
+            for (int l = 0; l < LIMBS; l++)
+                put_le32(rec + 16 + 4 * l, self->r[i][l]);
+        }
+        memcpy(self->trace_r[i], self->r[i], sizeof(self->r[i]));
+    }
+    for (int i = 0; i < NUM_GPRS; i++) {
+        if (self->gpr[i] == self->trace_gpr[i])
+            continue;
+        if (rec[8] == TRACE_NONE) {
+            rec[8] = (uint8_t)i;
+            put_le32(rec + 12, (uint32_t)self->gpr[i]);
+        }
+        self->trace_gpr[i] = self->gpr[i];
+    }
+
+    if (self->trace_file) {
+        if (fwrite(rec, sizeof(rec), 1, self->trace_file) != 1) {
+            PyGILState_STATE gil = PyGILState_Ensure();
+            PyErr_SetFromErrno(PyExc_OSError);
+            trace_close(self);
+            PyGILState_Release(gil);
+            return -1;
+        }
+    } else {
+        memcpy(self->trace_buf + (self->trace_count % self->trace_cap) * TRACE_RECORD_SIZE,
+               rec, sizeof(rec));
+    }
+    self->trace_count++;
+    self->perf.trace_bytes += TRACE_RECORD_SIZE;
+    return 0;
+}
+
+/* enable_trace(capacity=65536, path=None): start logging binary trace
+ * records, to a ring of `capacity` records or appended to the file at
+ * path.  Restarting a trace discards the previous one. */
+static PyObject *
+CMachine_enable_trace(CMachine *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"capacity", "path", NULL};
+    Py_ssize_t capacity = TRACE_DEFAULT_CAP;
+    PyObject *path = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nO", kwlist, &capacity, &path))
+        return NULL;
+    if (capacity <= 0) {
+        PyErr_SetString(PyExc_ValueError, "trace capacity must be positive");
+        return NULL;
+    }
+    if (machine_idle_check(self) < 0)
+        return NULL;
+    trace_close(self);
+    PyMem_Free(self->trace_buf);
+    self->trace_buf = NULL;
+    self->trace_cap = 0;
+    self->trace_count = 0;
+
+    if (path != Py_None) {
+        PyObject *fspath = NULL;
+        if (!PyUnicode_FSConverter(path, &fspath))
+            return NULL;
+        self->trace_file = fopen(PyBytes_AS_STRING(fspath), "wb");
+        if (!self->trace_file) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            Py_DECREF(fspath);
+            return NULL;
+        }
+        Py_DECREF(fspath);
+        PyObject *header = trace_header();
+        if (!header || fwrite(PyBytes_AS_STRING(header), (size_t)PyBytes_GET_SIZE(header), 1,
+                              self->trace_file) != 1) {
+            if (header)
+                PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+            Py_XDECREF(header);
+            trace_close(self);
+            return NULL;
+        }
+        Py_DECREF(header);
+    } else {
+        if ((size_t)capacity > SIZE_MAX / TRACE_RECORD_SIZE ||
+            !(self->trace_buf = PyMem_Malloc((size_t)capacity * TRACE_RECORD_SIZE)))
+            return PyErr_NoMemory();
+        self->trace_cap = (size_t)capacity;
+    }
+    trace_sync(self);
+    self->trace_active = 1;
+    Py_RETURN_NONE;
+}
+
+/* disable_trace() -> number of records produced.  A ring trace stays
+ * readable through get_trace(); a trace file is closed. */
+static PyObject *
+CMachine_disable_trace(CMachine *self, PyObject *Py_UNUSED(args)) {
+    if (machine_idle_check(self) < 0)
+        return NULL;
+    int failed = self->trace_file && fflush(self->trace_file) != 0;
+    trace_close(self);
+    if (failed)
+        return PyErr_SetFromErrno(PyExc_OSError);
+    return PyLong_FromUnsignedLongLong(self->trace_count);
+}
+
+/* get_trace() -> bytes: header plus the ring's records, oldest first */
+static PyObject *
+CMachine_get_trace(CMachine *self, PyObject *Py_UNUSED(args)) {
+    PyObject *header = trace_header();
+    if (!header) return NULL;
+    size_t n = self->trace_count < self->trace_cap ? (size_t)self->trace_count : self->trace_cap;
+    Py_ssize_t hsize = PyBytes_GET_SIZE(header);
+    PyObject *res = PyBytes_FromStringAndSize(NULL, hsize + (Py_ssize_t)(n * TRACE_RECORD_SIZE));
+    if (!res) {
+        Py_DECREF(header);
+        return NULL;
+    }
+    char *p = PyBytes_AS_STRING(res);
+    memcpy(p, PyBytes_AS_STRING(header), (size_t)hsize);
+    Py_DECREF(header);
+    p += hsize;
+    if (n) {
+        /* Oldest record first: once wrapped, that is the next slot to write */
+        size_t start = self->trace_count > self->trace_cap ? (size_t)(self->trace_count % self->trace_cap) : 0;
+        size_t tail = (self->trace_cap - start) < n ? self->trace_cap - start : n;
+        memcpy(p, self->trace_buf + start * TRACE_RECORD_SIZE, tail * TRACE_RECORD_SIZE);
+        memcpy(p + tail * TRACE_RECORD_SIZE, self->trace_buf, (n - tail) * TRACE_RECORD_SIZE);
+    }
+    return res;
+}
+
+/* ------------------------------------------------------------------ */
+/* Native kernels                                                      */
+/* ------------------------------------------------------------------ */
+
+static uint32_t wide_add(uint32_t *out, const uint32_t *a, const uint32_t *b, uint32_t carry) {
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t t = (uint64_t)a[i] + b[i] + carry;
+        out[i] = (uint32_t)t;
+        carry = (uint32_t)(t >> 32);
+    }
+    return carry;
+}
+
+static uint32_t wide_sub(uint32_t *out, const uint32_t *a, const uint32_t *b, uint32_t borrow) {
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t t = (uint64_t)a[i] - b[i] - borrow;
+        out[i] = (uint32_t)t;
+        borrow = (uint32_t)(t >> 63);
+    }
+    return borrow;
+}
+
+static int wide_cmp(const uint32_t *a, const uint32_t *b) {
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/* out = in << bits (bits > 0) or in >> -bits, truncated to XLEN. */
+static void wide_shift(uint32_t *out, const uint32_t *in, long bits) {
+    uint32_t tmp[LIMBS];
+    long n = bits < 0 ? -bits : bits;
+    if (n >= XLEN) {
+        memset(out, 0, sizeof(tmp));
+        return;
+    }
+    int ls = (int)(n / 32), bs = (int)(n % 32);
+    for (int i = 0; i < LIMBS; i++) {
+        uint32_t lo, hi;
+        if (bits < 0) {
+            lo = i + ls < LIMBS ? in[i + ls] : 0;
+            hi = i + ls + 1 < LIMBS ? in[i + ls + 1] : 0;
+            tmp[i] = bs ? (lo >> bs) | (hi << (32 - bs)) : lo;
+        } else {
+            hi = i - ls >= 0 ? in[i - ls] : 0;
+            lo = i - ls - 1 >= 0 ? in[i - ls - 1] : 0;
+            tmp[i] = bs ? (hi << bs) | (lo >> (32 - bs)) : hi;
+        }
+    }
+    memcpy(out, tmp, sizeof(tmp));
+}
+
+/* out = (hi * 2^XLEN + lo) >> bits for 0 <= bits < 2 * XLEN, truncated
+ * to XLEN (BN.RSHI and dcrypto rshi). */
+static void wide_rshi(uint32_t *out, const uint32_t *lo, const uint32_t *hi, long bits) {
+    uint32_t tmp[LIMBS];
+    if (bits < XLEN) {
+        wide_shift(tmp, hi, XLEN - bits);
+        wide_shift(out, lo, -bits);
+        for (int i = 0; i < LIMBS; i++)
+            out[i] |= tmp[i];
+    } else {
+        wide_shift(out, hi, -(bits - XLEN));
+    }
+}
+
+/* out[0..na+nb) = a * b, schoolbook on 32-bit limbs. */
+static void limbs_mul(uint32_t *out, const uint32_t *a, int na, const uint32_t *b, int nb) {
+    memset(out, 0, (size_t)(na + nb) * sizeof(uint32_t));
+    for (int i = 0; i < na; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < nb; j++) {
+            uint64_t t = (uint64_t)a[i] * b[j] + out[i + j] + carry;
+            out[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        out[i + nb] = (uint32_t)carry;
+    }
+}
+
+/* acc += (a * b) << shift with the same range check as set_acc(); the
+ * accumulator is left untouched on overflow. */
+static int acc_add_product(CMachine *self, uint64_t a, uint64_t b, long shift) {
+    uint32_t qa[2] = {(uint32_t)a, (uint32_t)(a >> 32)};
+    uint32_t qb[2] = {(uint32_t)b, (uint32_t)(b >> 32)};
+    uint32_t prod[4], sh[5];
+    limbs_mul(prod, qa, 2, qb, 2);
+    if (limbs_is_zero(prod, 4))
+        return 0;
+
+    long ls = shift / 32;
+    int bs = (int)(shift % 32);
+    sh[0] = prod[0] << bs;
+    for (int i = 1; i < 4; i++)
+        sh[i] = bs ? (prod[i] << bs) | (prod[i - 1] >> (32 - bs)) : prod[i];
+    sh[4] = bs ? prod[3] >> (32 - bs) : 0;
+
+    uint32_t acc[ACC_LIMBS];
+    memcpy(acc, self->acc, sizeof(acc));
+    uint64_t carry = 0;
+    for (long i = 0; i < 5 || carry; i++) {
+        uint64_t t = carry + (i < 5 ? sh[i] : 0);
+        if (ls + i >= ACC_LIMBS) {
+            if (t) {
+                raise_error(PyExc_OverflowError, "accumulator value out of range");
+                return -1;
+            }
+            continue;
+        }
+        t += acc[ls + i];
+        acc[ls + i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    memcpy(self->acc, acc, sizeof(acc));
+    return 0;
+}
+
+/* out = (hi * 2^XLEN + v) % mod for hi in {0, 1}, by shift-and-subtract
+ * unless mod has its top bit set; raises ZeroDivisionError like Python's % for a zero modulus. */
+static int wide_mod(uint32_t *out, const uint32_t *v, uint32_t hi, const uint32_t *mod) {
+    if (limbs_is_zero(mod, LIMBS)) {
+        raise_error(PyExc_ZeroDivisionError, "integer modulo by zero");
+        return -1;
+    }
+    if (!hi && wide_cmp(v, mod) < 0) {
+        memmove(out, v, LIMBS * sizeof(uint32_t));
+        return 0;
+    }
+    if (mod[LIMBS - 1] >> 31) {
+        /* A full-width modulus (P-256's p and n among them): the value is
+         * below 4 * mod, so at most three subtractions reduce it */
+        uint32_t r[LIMBS];
+        memcpy(r, v, sizeof(r));
+        while (hi || wide_cmp(r, mod) >= 0)
+            hi -= wide_sub(r, r, mod, 0);
+        memcpy(out, r, sizeof(r));
+        return 0;
+    }
+    uint32_t r[LIMBS] = {0};
+    for (int i = hi ? XLEN : XLEN - 1; i >= 0; i--) {
+        uint32_t top = r[LIMBS - 1] >> 31;
+        for (int j = LIMBS - 1; j > 0; j--)
+            r[j] = (r[j] << 1) | (r[j - 1] >> 31);
+        r[0] = (r[0] << 1) | (i == XLEN ? hi : (uint32_t)limbs_test_bit(v, i));
+        /* r < 2 * mod, so one subtraction reduces it */
+        if (top || wide_cmp(r, mod) >= 0)
+            wide_sub(r, r, mod, 0);
+    }
+    memcpy(out, r, sizeof(r));
+    return 0;
+}
+
+static void flags_set_czml(CMachine *self, int fg, const uint32_t *res, uint32_t carry) {
+    flags_put(self, fg, 1 << FLAG_C | 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z,
+              flags_of_result(res, carry));
+}
+
+static void flags_set_zml(CMachine *self, int fg, const uint32_t *res) {
+    flags_put(self, fg, 1 << FLAG_M | 1 << FLAG_L | 1 << FLAG_Z, flags_of_result(res, 0));
+}
+
+static int flag_bit(CMachine *self, long bit) {
+    return flag_get(self, (int)(bit & 7));
+}
+
+/* WDR limbs for an index read from a GPR at run time. */
+static uint32_t *wdr_at(CMachine *self, long idx) {
+    if (idx < 0 || idx >= NUM_REGS) {
+        raise_error(PyExc_IndexError, "register index out of range");
+        return NULL;
+    }
+    return self->r[idx];
+}
+
+static void wdr_write(CMachine *self, int idx, const uint32_t *val) {
+    memmove(self->r[idx], val, sizeof(self->r[idx]));
+    mark_valid_all(self, idx);
+}
+
+static int loop_push(CMachine *self, long cnt, long end_addr, long start_addr) {
+    if (self->loop_sp >= LOOP_STACK_SZ) {
+        raise_error(PyExc_OverflowError, "Loop stack overflow");
+        return -1;
+    }
+    self->loop_stack[self->loop_sp].cnt = cnt;
+    self->loop_stack[self->loop_sp].end_addr = end_addr;
+    self->loop_stack[self->loop_sp].start_addr = start_addr;
+    self->loop_sp++;
+    return 0;
+}
+
+/* Return target of JALR/RET: an empty call stack finishes the program
+ * unless we are at the stop address already. */
+static int return_target(CMachine *self, int gpr, long imm, long *target) {
+    long v;
+    if (gpr_read(self, gpr, &v) == 0) {
+        *target = v + imm;
+        return 0;
+    }
+    PyGILState_STATE gil = PyGILState_Ensure();
+    int underrun = PyErr_ExceptionMatches(CallStackUnderrun);
+    if (underrun)
+        PyErr_Clear();
+    PyGILState_Release(gil);
+    if (!underrun)
+        return -1;
+    if (self->pc != self->stop_addr)
+        self->finishFlag = 1;
+    *target = self->pc;
+    return 0;
+}
+
+static long floor_div32(long v) {
+    return v >= 0 ? v / 32 : -((-v + 31) / 32);
+}
+
+/* Special register behind a dcrypto ld<reg>/st<reg> op. */
+static uint32_t *dc_special_reg(CMachine *self, int opcode) {
+    switch (opcode) {
+    case OP_DC_LDRFP: return self->rfp;
+    case OP_DC_LDLC:  return self->lc;
+    case OP_DC_LDDMP:
+    case OP_DC_STDMP: return self->dmp;
+    case OP_DC_LDMOD:
+    case OP_DC_STMOD: return self->mod;
+    default:          return self->rnd;
+    }
+}
+
+/* Operand of a dcrypto limb pointer field: the pointer register limb,
+ * masked to the index range.  The increment stores the unmasked
+ * successor back, as the Python ops do. */
+static long dc_ptr(const uint32_t *preg, int field, long mask) {
+    return (long)(preg[field & 7] & (uint32_t)mask);
+}
+
+static void dc_ptr_inc(uint32_t *preg, int field, long ptr) {
+    if ((field >> 3) & 1)
+        preg[field & 7] = (uint32_t)(ptr + 1);
+}
+
+static int bit_length(long v) {
+    int n = 0;
+    for (unsigned long u = (unsigned long)v; u; u >>= 1)
+        n++;
+    return n;
+}
+
+/* Execute a decoded op.  Returns 0 or -1 on error; *jump is set when the
+ * op redirects the pc to *jump_addr. */
+static int exec_native(CMachine *self, const MicroOp *op, int *jump, long *jump_addr) {
+    uint32_t res[LIMBS], tmp[LIMBS];
+    uint32_t *src, *dst;
+    long a, b, v;
+
+    switch (op->opcode) {
+    case OP_BN_ADD:
+    case OP_BN_ADDC:
+        wide_shift(tmp, self->r[op->rs2], op->shift);
+        flags_set_czml(self, op->fg, res,
+                       wide_add(res, self->r[op->rs1], tmp,
+                                op->opcode == OP_BN_ADDC ? (uint32_t)flag_bit(self, op->fg ? 4 : 0) : 0));
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_SUB:
+    case OP_BN_SUBB:
+    case OP_BN_CMP:
+    case OP_BN_CMPB: {
+        uint32_t bin = (op->opcode == OP_BN_SUBB || op->opcode == OP_BN_CMPB)
+                       ? (uint32_t)flag_bit(self, op->fg ? 4 : 0) : 0;
+        wide_shift(tmp, self->r[op->rs2], op->shift);
+        flags_set_czml(self, op->fg, res, wide_sub(res, self->r[op->rs1], tmp, bin));
+        if (op->opcode == OP_BN_SUB || op->opcode == OP_BN_SUBB)
+            wdr_write(self, op->rd, res);
+        break;
+    }
+    case OP_BN_ADDI:
+    case OP_BN_SUBI:
+        memset(tmp, 0, sizeof(tmp));
+        tmp[0] = (uint32_t)op->imm;
+        tmp[1] = (uint32_t)((uint64_t)op->imm >> 32);
+        if (op->opcode == OP_BN_ADDI)
+            flags_set_czml(self, op->fg, res, wide_add(res, self->r[op->rs1], tmp, 0));
+        else
+            flags_set_czml(self, op->fg, res, wide_sub(res, self->r[op->rs1], tmp, 0));
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_ADDM:
+        if (wide_add(res, self->r[op->rs1], self->r[op->rs2], 0) || wide_cmp(res, self->mod) >= 0)
+            wide_sub(res, res, self->mod, 0);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_SUBM:
+        if (wide_sub(res, self->r[op->rs1], self->r[op->rs2], 0))
+            wide_add(res, res, self->mod, 0);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_MULQACC:
+    case OP_BN_MULQACC_Z:
+    case OP_BN_MULQACC_SO: {
+        uint64_t q1 = limbs_get_qw(self->r[op->rs1], (int)(op->aux & 3));
+        uint64_t q2 = limbs_get_qw(self->r[op->rs2], (int)((op->aux >> 2) & 3));
+        if (op->opcode == OP_BN_MULQACC_Z)
+            memset(self->acc, 0, sizeof(self->acc));
+        if (acc_add_product(self, q1, q2, op->shift) < 0)
+            return -1;
+        if (op->opcode != OP_BN_MULQACC_SO)
+            break;
+        /* Shift out the lower half word of the accumulator into rd */
+        int upper = (int)((op->aux >> 4) & 1);
+        memcpy(self->r[op->rd] + upper * (LIMBS / 2), self->acc, (LIMBS / 2) * sizeof(uint32_t));
+        memmove(self->acc, self->acc + LIMBS / 2, (ACC_LIMBS - LIMBS / 2) * sizeof(uint32_t));
+        memset(self->acc + ACC_LIMBS - LIMBS / 2, 0, (LIMBS / 2) * sizeof(uint32_t));
+        mark_valid_all(self, op->rd);
+        const uint32_t *so = self->r[op->rd] + upper * (LIMBS / 2);
+        if (!upper) {
+            flags_put(self, op->fg, 1 << FLAG_L, (so[0] & 1) << FLAG_L);
+        } else {
+            /* set_c_m(shift_out << 128): no carry, M from the MSB */
+            flags_put(self, op->fg, 1 << FLAG_C | 1 << FLAG_M,
+                      (so[LIMBS / 2 - 1] >> 31) << FLAG_M);
+        }
+        break;
+    }
+    case OP_BN_MULH:
+        limbs_mul(res, self->r[op->rs1] + (op->aux & 1) * (LIMBS / 2), LIMBS / 2,
+                  self->r[op->rs2] + ((op->aux >> 1) & 1) * (LIMBS / 2), LIMBS / 2);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_AND:
+    case OP_BN_OR:
+    case OP_BN_XOR:
+        wide_shift(tmp, self->r[op->rs2], op->shift);
+        for (int i = 0; i < LIMBS; i++) {
+            uint32_t x = self->r[op->rs1][i];
+            res[i] = op->opcode == OP_BN_AND ? x & tmp[i]
+                   : op->opcode == OP_BN_OR ? x | tmp[i] : x ^ tmp[i];
+        }
+        flags_set_zml(self, op->fg, res);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_NOT:
+        wide_shift(res, self->r[op->rs1], op->shift);
+        for (int i = 0; i < LIMBS; i++)
+            res[i] = ~res[i];
+        flags_set_zml(self, op->fg, res);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_RSHI:
+        wide_rshi(res, self->r[op->rs1], self->r[op->rs2], op->shift);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_BN_SEL:
+        wdr_write(self, op->rd, flag_bit(self, op->aux) ? self->r[op->rs1] : self->r[op->rs2]);
+        break;
+    case OP_BN_MOV:
+        wdr_write(self, op->rd, self->r[op->rs1]);
+        break;
+    case OP_BN_MOVR:
+        if (gpr_read(self, op->rd, &a) < 0 || gpr_read(self, op->rs1, &b) < 0)
+            return -1;
+        if (!(src = wdr_at(self, b)) || !(dst = wdr_at(self, a)))
+            return -1;
+        wdr_write(self, (int)a, src);
+        if ((op->aux & 1) && gpr_add(self, op->rd, 1) < 0)
+            return -1;
+        if ((op->aux & 2) && gpr_add(self, op->rs1, 1) < 0)
+            return -1;
+        break;
+    case OP_BN_LID:
+    case OP_BN_SID: {
+        int byte_addr = (int)((op->aux >> 2) & 1);
+        if (gpr_read(self, op->rd, &a) < 0 || gpr_read(self, op->rs1, &b) < 0)
+            return -1;
+        long addr = op->imm + b;
+        if (byte_addr)
+            addr = floor_div32(addr);
+        if (op->opcode == OP_BN_LID) {
+            if (!(src = dmem_read_cell(self, addr)) || !wdr_at(self, a))
+                return -1;
+            wdr_write(self, (int)a, src);
+        } else {
+            if (!(src = wdr_at(self, a)) || !(dst = dmem_write_cell(self, addr)))
+                return -1;
+            memcpy(dst, src, sizeof(self->dmem[0]));
+        }
+        self->perf.dmem_op_bytes += XLEN_BYTES;
+        if ((op->aux & 1) && gpr_add(self, op->rd, 1) < 0)
+            return -1;
+        if ((op->aux & 2) && gpr_add(self, op->rs1, byte_addr ? XLEN / 8 : 1) < 0)
+            return -1;
+        break;
+    }
+    case OP_BN_WSRRS:
+    case OP_BN_WSRRW:
+        if (!(src = wsr_limbs(self, op->imm)))
+            return -1;
+        memcpy(tmp, src, sizeof(tmp));
+        wdr_write(self, op->rd, tmp);
+        for (int i = 0; i < LIMBS; i++)
+            res[i] = op->opcode == OP_BN_WSRRS ? tmp[i] | self->r[op->rs1][i] : self->r[op->rs1][i];
+        if (op->imm == WSR_MOD)
+            memcpy(self->mod, res, sizeof(res));
+        break;
+    case OP_LOOPI:
+        if (loop_push(self, op->imm - 1, op->aux + self->pc, self->pc + 1) < 0)
+            return -1;
+        break;
+    case OP_LOOP:
+        if (gpr_read(self, op->rs1, &v) < 0 || loop_push(self, v - 1, op->aux + self->pc, self->pc + 1) < 0)
+            return -1;
+        break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+        if (gpr_read(self, op->rs1, &a) < 0 || gpr_read(self, op->rs2, &b) < 0)
+            return -1;
+        v = op->opcode == OP_ADD ? a + b : op->opcode == OP_SUB ? a - b
+          : op->opcode == OP_AND ? (a & b) : op->opcode == OP_OR ? (a | b) : (a ^ b);
+        if (gpr_write(self, op->rd, v & 0xFFFFFFFF) < 0)
+            return -1;
+        break;
+    case OP_ADDI:
+    case OP_ANDI:
+    case OP_ORI:
+    case OP_XORI:
+    case OP_SLLI:
+        if (gpr_read(self, op->rs1, &a) < 0)
+            return -1;
+        switch (op->opcode) {
+        case OP_ADDI: v = a + op->imm; break;
+        case OP_ANDI: v = a & op->imm; break;
+        case OP_ORI:  v = a | op->imm; break;
+        case OP_XORI: v = a ^ op->imm; break;
+        default:      v = op->imm >= 32 ? 0 : (long)((unsigned long)a << op->imm); break;
+        }
+        if (gpr_write(self, op->rd, v & 0xFFFFFFFF) < 0)
+            return -1;
+        break;
+    case OP_LUI:
+        if (gpr_write(self, op->rd, op->imm * 4096) < 0)
+            return -1;
+        break;
+    case OP_LI:
+        if (gpr_write(self, op->rd, op->imm) < 0)
+            return -1;
+        break;
+    case OP_LW: {
+        uint32_t *limb;
+        if (gpr_read(self, op->rs1, &a) < 0 || !(limb = dmem_otbn_limb(self, a + op->imm)))
+            return -1;
+        if (gpr_write(self, op->rd, (long)*limb) < 0)
+            return -1;
+        self->perf.dmem_op_bytes += 4;
+        break;
+    }
+    case OP_SW: {
+        uint32_t *limb;
+        if (gpr_read(self, op->rs1, &a) < 0 || gpr_read(self, op->rs2, &b) < 0)
+            return -1;
+        if (!(limb = dmem_otbn_limb(self, a + op->imm)))
+            return -1;
+        if (check_limb_value(b, 0xFFFFFFFFL, "limb value out of range") < 0)
+            return -1;
+        *limb = (uint32_t)b;
+        self->init_dmem[(a + op->imm) / 32] = 1;
+        watch_dmem_write(self, (a + op->imm) / 32);
+        self->perf.dmem_op_bytes += 4;
+        break;
+    }
+    case OP_CSRRS:
+    case OP_CSRRW:
+        if (csr_read(self, op->imm, &a) < 0 || gpr_write(self, op->rd, a) < 0)
+            return -1;
+        if (gpr_read(self, op->rs1, &b) < 0)
+            return -1;
+        if (csr_write(self, op->imm, op->opcode == OP_CSRRS ? (a | b) : b) < 0)
+            return -1;
+        break;
+    case OP_BEQ:
+    case OP_BNE:
+        if (gpr_read(self, op->rs1, &a) < 0 || gpr_read(self, op->rs2, &b) < 0)
+            return -1;
+        if ((a == b) == (op->opcode == OP_BEQ)) {
+            *jump = 1;
+            *jump_addr = self->pc + op->imm;
+        }
+        break;
+    case OP_JAL:
+        if (gpr_write(self, op->rd, self->pc + 1) < 0)
+            return -1;
+        *jump = 1;
+        *jump_addr = self->pc + op->imm;
+        break;
+    case OP_JALR:
+        /* The link register gets the address of the JALR itself */
+        if (gpr_write(self, op->rd, self->pc) < 0 || return_target(self, op->rs1, op->imm, jump_addr) < 0)
+            return -1;
+        *jump = 1;
+        break;
+    case OP_RET:
+        if (return_target(self, 1, 0, jump_addr) < 0)
+            return -1;
+        *jump = 1;
+        break;
+    case OP_ECALL:
+        self->finishFlag = 1;
+        break;
+    case OP_NOP:
+        break;
+    case OP_DC_ADD:
+    case OP_DC_ADDC:
+    case OP_DC_ADDI:
+    case OP_DC_ADDX:
+    case OP_DC_ADDCX: {
+        /* addx takes its carry from the standard C flag (as execute() does) */
+        int x = op->opcode == OP_DC_ADDX || op->opcode == OP_DC_ADDCX;
+        uint32_t cin = op->opcode == OP_DC_ADDC || op->opcode == OP_DC_ADDX ? (uint32_t)flag_get(self, FLAG_C)
+                     : op->opcode == OP_DC_ADDCX ? (uint32_t)flag_get(self, FLAG_XC) : 0;
+        if (op->opcode == OP_DC_ADDI) {
+            memset(tmp, 0, sizeof(tmp));
+            tmp[0] = (uint32_t)op->imm;
+        } else {
+            wide_shift(tmp, self->r[op->rs2], op->shift);
+        }
+        uint32_t carry = wide_add(res, self->r[op->rs1], tmp, cin);
+        if (stats_kernel_flag_access(self, x, op->opcode) < 0)
+            return -1;
+        flags_set_czml(self, x, res, carry);
+        wdr_write(self, op->rd, res);
+        break;
+    }
+    case OP_DC_SUB:
+    case OP_DC_SUBB:
+    case OP_DC_SUBI:
+    case OP_DC_SUBX:
+    case OP_DC_SUBBX: {
+        /* The carry flag is rs2 > rs1 on the unshifted operands */
+        int x = op->opcode == OP_DC_SUBX || op->opcode == OP_DC_SUBBX;
+        int borrow = wide_cmp(self->r[op->rs2], self->r[op->rs1]) > 0;
+        uint32_t bin = op->opcode == OP_DC_SUBB ? (uint32_t)flag_get(self, FLAG_C)
+                     : op->opcode == OP_DC_SUBBX ? (uint32_t)flag_get(self, FLAG_XC) : 0;
+        if (op->opcode == OP_DC_SUBI) {
+            memset(tmp, 0, sizeof(tmp));
+            tmp[0] = (uint32_t)op->imm;
+        } else {
+            wide_shift(tmp, self->r[op->rs2], op->shift);
+        }
+        wide_sub(res, self->r[op->rs1], tmp, bin);
+        flags_put(self, x, 1 << FLAG_C, (unsigned)borrow << FLAG_C);
+        if (stats_kernel_flag_access(self, x, op->opcode) < 0)
+            return -1;
+        flags_set_zml(self, x, res);
+        wdr_write(self, op->rd, res);
+        break;
+    }
+    case OP_DC_ADDM:
+        wide_shift(tmp, self->r[op->rs2], op->shift);
+        b = wide_add(res, self->r[op->rs1], tmp, 0);
+        if (wide_mod(res, res, (uint32_t)b, self->mod) < 0)
+            return -1;
+        flags_set_zml(self, 0, res);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_DC_SUBM:
+        /* A negative difference -d reduces to (-(d % mod)) % mod */
+        wide_shift(tmp, self->r[op->rs2], op->shift);
+        if (wide_sub(res, self->r[op->rs1], tmp, 0)) {
+            wide_sub(res, tmp, self->r[op->rs1], 0);
+            if (wide_mod(res, res, 0, self->mod) < 0)
+                return -1;
+            if (!limbs_is_zero(res, LIMBS))
+                wide_sub(res, self->mod, res, 0);
+        } else if (wide_mod(res, res, 0, self->mod) < 0) {
+            return -1;
+        }
+        flags_set_zml(self, 0, res);
+        wdr_write(self, op->rd, res);
+        break;
+    case OP_DC_CMP:
+    case OP_DC_CMPBX: {
+        int cmp = wide_cmp(self->r[op->rs1], self->r[op->rs2]);
+        int x = op->opcode == OP_DC_CMPBX;
+        if (stats_kernel_flag_access(self, x, op->opcode) < 0)
+            return -1;
+        if (!x) {
+            flags_put(self, 0, 1 << FLAG_C | 1 << FLAG_Z,
+                      (unsigned)(cmp < 0) << FLAG_C | (unsigned)(cmp == 0) << FLAG_Z);
+        } else if (cmp) {
+            /* XC is left unchanged when rs1 == rs2 */
+            flag_put(self, FLAG_XC, cmp < 0);
+        }
+        break;
+    }
+    case OP_DC_LDRFP:
+    case OP_DC_LDLC:
+    case OP_DC_LDDMP:
+    case OP_DC_LDMOD:
+    case OP_DC_LDRND:
+        memcpy(dc_special_reg(self, op->opcode), self->r[op->rs1], sizeof(self->r[0]));
+        break;
+    case OP_DC_STDMP:
+    case OP_DC_STMOD:
+    case OP_DC_STRND:
+        wdr_write(self, op->rd, dc_special_reg(self, op->opcode));
+        break;
+    case OP_DC_LDI:
+        if (!(src = dmem_read_cell(self, op->imm)))
+            return -1;
+        wdr_write(self, op->rd, src);
+        self->perf.dmem_op_bytes += XLEN_BYTES;
+        break;
+    case OP_DC_STI:
+        if (!(dst = dmem_write_cell(self, op->imm)))
+            return -1;
+        memcpy(dst, self->r[op->rd], sizeof(self->dmem[0]));
+        self->perf.dmem_op_bytes += XLEN_BYTES;
+        break;
+    case OP_DC_LDR:
+        a = dc_ptr(self->rfp, op->rs1, NUM_REGS - 1);
+        b = dc_ptr(self->rfp, op->rd, NUM_REGS - 1);
+        wdr_write(self, (int)b, self->r[a]);
+        dc_ptr_inc(self->rfp, op->rs1, a);
+        dc_ptr_inc(self->rfp, op->rd, b);
+        if (stats_kernel_wide_mem_op(self, op->opcode, (op->rs1 >> 3) & 1,
+                                     (op->rd >> 3) & 1) < 0)
+            return -1;
+        break;
+    case OP_DC_LD:
+        a = dc_ptr(self->dmp, op->rs1, DMEM_DEPTH - 1);
+        b = dc_ptr(self->rfp, op->rd, NUM_REGS - 1);
+        if (!(src = dmem_read_cell(self, a)))
+            return -1;
+        wdr_write(self, (int)b, src);
+        self->perf.dmem_op_bytes += XLEN_BYTES;
+        dc_ptr_inc(self->dmp, op->rs1, a);
+        dc_ptr_inc(self->rfp, op->rd, b);
+        if (stats_kernel_wide_mem_op(self, op->opcode, (op->rs1 >> 3) & 1,
+                                     (op->rd >> 3) & 1) < 0)
+            return -1;
+        break;
+    case OP_DC_ST:
+        a = dc_ptr(self->rfp, op->rs1, NUM_REGS - 1);
+        b = dc_ptr(self->dmp, op->rd, DMEM_DEPTH - 1);
+        if (!(dst = dmem_write_cell(self, b)))
+            return -1;
+        memcpy(dst, self->r[a], sizeof(self->dmem[0]));
+        self->perf.dmem_op_bytes += XLEN_BYTES;
+        dc_ptr_inc(self->rfp, op->rs1, a);
+        dc_ptr_inc(self->dmp, op->rd, b);
+        if (stats_kernel_wide_mem_op(self, op->opcode, (op->rs1 >> 3) & 1,
+                                     (op->rd >> 3) & 1) < 0)
+            return -1;
+        break;
+    case OP_DC_MOVI: {
+        if (stats_movi(self, bit_length(op->imm)) < 0)
+            return -1;
+        uint32_t *limb = &self->r[op->rd][op->aux & 7];
+        if ((op->aux >> 3) & 1)
+            *limb = (*limb & 0x0000FFFFU) | ((uint32_t)op->imm << HALF_LIMB_BITS);
+        else
+            *limb = (*limb & 0xFFFF0000U) | ((uint32_t)op->imm & 0xFFFFU);
+        mark_valid_all(self, op->rd);
+        break;
+    }
+    case OP_DC_B:
+        if (op->aux < 0 || flag_bit(self, op->aux & 3) != ((op->aux >> 3) & 1)) {
+            *jump = 1;
+            *jump_addr = op->imm;
+        }
+        break;
+    case OP_DC_CALL:
+        if (stats_func_call(self, self->pc, op->imm) < 0)
+            return -1;
+        /* x1 writes push the call stack */
+        if (gpr_write(self, 1, self->pc + 1) < 0)
+            return -1;
+        *jump = 1;
+        *jump_addr = op->imm;
+        break;
+    case OP_DC_LOOP:
+        v = op->rs2 ? (long)self->lc[op->rs1 & 7] : op->imm;
+        if (loop_push(self, v - 1, op->aux + self->pc, self->pc + 1) < 0)
+            return -1;
+        if (stats_loop(self, self->pc, op->aux, self->loop_sp, v) < 0)
+            return -1;
+        break;
+    default:
+        raise_error(PyExc_RuntimeError, "no native kernel for opcode %d", op->opcode);
+        return -1;
+    }
+    return 0;
+}
+
+/* get_decoded_op(addr): mnemonic of the native kernel the instruction
+ * at addr runs through, or None when it falls back to execute(). */
+static PyObject *
+CMachine_get_decoded_op(CMachine *self, PyObject *args) {
+    long addr;
+    if (!PyArg_ParseTuple(args, "l", &addr))
+        return NULL;
+    MicroOp *op = op_at(self, addr);
+    if (!op) return NULL;
+    if (op->opcode == OP_PYTHON)
+        Py_RETURN_NONE;
+    return PyUnicode_FromString(opcode_names[op->opcode]);
+}
+
+/* ------------------------------------------------------------------ */
+/* step() / run() - core simulation loop                               */
+/* ------------------------------------------------------------------ */
+
+/* Check force-break and breakpoints for the instruction at pc.  Returns
+ * 1 when execution should break (with *passes set), 0 otherwise. */
+static int
+check_break(CMachine *self, long *passes) {
+    *passes = 0;
+    self->perf.bp_checks++;
+
+    /* Force break check */
+    if (self->fb_active) {
+        if (self->fb_consider_loopstack && self->loop_sp == self->fb_loopstack) {
+            self->fb_active = 0;
+            return 1;
+        } else if (self->fb_consider_callstack && self->call_sp == self->fb_callstack) {
+            self->fb_active = 0;
+            return 1;
+        } else if (!self->fb_consider_callstack && !self->fb_consider_loopstack) {
+            self->fb_active = 0;
+            return 1;
+        }
+    }
+
+    /* Regular breakpoint check; plain C, so safe without the GIL */
+    if (!bp_is_set(self, self->pc))
+        return 0;
+    long pc = self->pc;
+    if (self->bp_count[pc] == self->bp_passes[pc]) {
+        *passes = self->bp_passes[pc];
+        self->bp_count[pc] = 1;
+        return 1;
+    }
+    self->bp_count[pc]++;
+    return 0;
+}
+
+/* Halting is decided before the instruction executes, like the Python
+ * Machine: the instruction at stop_addr (or the one after a finish) still
+ * runs. */
+static const char *pending_halt(CMachine *self) {
+    if (self->finishFlag)
+        return "finish";
+    if (self->pc == self->stop_addr)
+        return "stop_addr";
+    return NULL;
+}
+
+/* Loop-stack handling and pc update after an instruction executed, for
+ * an imem of imem_len entries.  Returns 1 to continue, 0 once halted
+ * (*reason says why) and -1 on error. */
+static int
+advance_pc(CMachine *self, int jump, long jump_addr, Py_ssize_t imem_len,
+           const char *halt, const char **reason) {
+    if (self->loop_sp > 0 && self->pc == self->loop_stack[self->loop_sp - 1].end_addr) {
+        if (self->loop_stack[self->loop_sp - 1].cnt > 0) {
+            self->loop_stack[self->loop_sp - 1].cnt--;
+            /* jump to loop start */
+            jump_addr = self->loop_stack[self->loop_sp - 1].start_addr;
+            jump = 1;
+        } else {
+            /* continue without jump */
+            self->loop_sp--;
+        }
+    }
+
+    int cont = 1;
+    if (jump) {
+        if (jump_addr < 0 || jump_addr >= imem_len) {
+            raise_error(PyExc_RuntimeError, "Invalid jump address");
+            return -1;
+        }
+        self->pc = jump_addr;
+    } else {
+        if (self->pc + 1 >= imem_len) {
+            cont = 0;
+            halt = halt ? halt : "end_of_imem";
+        } else {
+            self->pc++;
+        }
+    }
+
+    if (halt) {
+        cont = 0;
+        *reason = halt;
+    }
+    return cont;
+}
+
+/* Execute the instruction at pc and advance the pc.  Returns 1 to
+ * continue, 0 once the machine halted (*reason says why) and -1 on
+ * error.  When trace_out is non-NULL it receives a new reference to the
+ * instruction's trace string. */
+static int
+exec_current(CMachine *self, PyObject **trace_out, long *cycles_out, const char **reason) {
+    const char *halt = pending_halt(self);
+
+    MicroOp *op = op_at(self, self->pc);
+    if (!op) return -1;
+    PyObject *instr = op->instr;
+    Py_INCREF(instr);
+    long pc = self->pc;
+    int opcode = op->opcode;
+
+    long jump_addr = -1;
+    int jump = 0;
+    PyObject *exec_result = NULL;
+
+    if (op->opcode != OP_PYTHON) {
+        *cycles_out = op_cycles(self, op, op->cycles);
+        if (stats_count_exec(self, op, self->pc, *cycles_out) < 0 ||
+            exec_native(self, op, &jump, &jump_addr) < 0) {
+            Py_DECREF(instr);
+            return -1;
+        }
+    } else {
+        /* Get cycles */
+        PyObject *cycles = PyObject_CallMethod(instr, "get_cycles", NULL);
+        if (!cycles) {
+            Py_DECREF(instr);
+            return -1;
+        }
+        *cycles_out = PyLong_AsLong(cycles);
+        Py_DECREF(cycles);
+        if (*cycles_out == -1 && PyErr_Occurred()) {
+            Py_DECREF(instr);
+            return -1;
+        }
+        *cycles_out = op_cycles(self, op, *cycles_out);
+        if (stats_count_exec(self, op, self->pc, *cycles_out) < 0) {
+            Py_DECREF(instr);
+            return -1;
+        }
+
+        /* Execute: trace_str, jump_addr = instr.execute(self) */
+        exec_result = PyObject_CallMethod(instr, "execute", "O", (PyObject *)self);
+        if (!exec_result) {
+            Py_DECREF(instr);
+            return -1;
+        }
+
+        PyObject *jump_addr_obj = PyTuple_GetItem(exec_result, 1);
+        if (jump_addr_obj != Py_None && jump_addr_obj != NULL) {
+            jump_addr = PyLong_AsLong(jump_addr_obj);
+            jump = 1;
+        }
+    }
+
+    if (self->trace_active && trace_record(self, pc, opcode) < 0) {
+        Py_XDECREF(exec_result);
+        Py_DECREF(instr);
+        return -1;
+    }
+
+    int cont = advance_pc(self, jump, jump_addr, imem_len(self), halt, reason);
+    if (cont < 0) {
+        Py_XDECREF(exec_result);
+        Py_DECREF(instr);
+        return -1;
+    }
+
+    if (trace_out) {
+        if (exec_result) {
+            *trace_out = PyTuple_GetItem(exec_result, 0);
+            Py_XINCREF(*trace_out);
+        } else {
+            /* Native ops: the trace string is execute()'s get_asm_str()[1] */
+            PyObject *asm_str = PyObject_CallMethod(instr, "get_asm_str", NULL);
+            *trace_out = asm_str ? PySequence_GetItem(asm_str, 1) : NULL;
+            Py_XDECREF(asm_str);
+            if (!*trace_out) {
+                Py_DECREF(instr);
+                return -1;
+            }
+        }
+    }
+    Py_XDECREF(exec_result);
+    Py_DECREF(instr);
+    return cont;
+}
+
+/* P-256 field prime 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const uint32_t p256_p[LIMBS] = {
+    0xffffffffU, 0xffffffffU, 0xffffffffU, 0, 0, 0, 1, 0xffffffffU,
+};
+
+/* out[0..n) = sum of t[k] * 2^(32 k) for signed column sums t that add
+ * up to a non-negative value below 2^(32 n) */
+static void limbs_from_columns(uint32_t *out, const int64_t *t, int n) {
+    int64_t carry = 0;
+    for (int k = 0; k < n; k++) {
+        int64_t v = t[k] + carry;
+        out[k] = (uint32_t)v;
+        carry = (v - (int64_t)(uint32_t)v) / ((int64_t)1 << 32);
+    }
+}
+
+/* The three products of a dcrypto 256x256 multiply, four mul128s summed
+ * by add/addc: lo:hi = x * y, part = x.l * y.u (the last mul128's
+ * temporary).  With x the P-256 prime they are Solinas shifts and adds
+ * of y instead of multiplications. */
+static void routine_mul256(uint32_t *lo, uint32_t *hi, uint32_t *part,
+                           const uint32_t *x, const uint32_t *y) {
+    uint32_t prod[2 * LIMBS], xl_yu[LIMBS];
+    if (memcmp(x, p256_p, sizeof(p256_p)) == 0) {
+        int64_t t[2 * LIMBS] = {0};
+        for (int i = 0; i < LIMBS; i++) {
+            t[i] -= y[i];
+            t[i + 3] += y[i];
+            t[i + 6] += y[i];
+            t[i + 7] -= y[i];
+            t[i + 8] += y[i];
+        }
+        limbs_from_columns(prod, t, 2 * LIMBS);
+        /* p.l = 2^96 - 1 */
+        int64_t u[LIMBS] = {0};
+        for (int i = 0; i < LIMBS / 2; i++) {
+            u[i] -= y[LIMBS / 2 + i];
+            u[i + 3] += y[LIMBS / 2 + i];
+        }
+        limbs_from_columns(xl_yu, u, LIMBS);
+    } else {
+        limbs_mul(prod, x, LIMBS, y, LIMBS);
+        limbs_mul(xl_yu, x, LIMBS / 2, y + LIMBS / 2, LIMBS / 2);
+    }
+    memcpy(lo, prod, LIMBS * sizeof(uint32_t));
+    memcpy(hi, prod + LIMBS, LIMBS * sizeof(uint32_t));
+    memcpy(part, xl_yu, sizeof(xl_yu));
+}
+
+/* dcrypto sub/subb of a - b into out: C is b > a, not the borrow */
+static void routine_dc_sub(CMachine *self, uint32_t *out, const uint32_t *a,
+                           const uint32_t *b, uint32_t borrow) {
+    int c = wide_cmp(b, a) > 0;
+    wide_sub(out, a, b, borrow);
+    flags_put(self, 0, 1 << FLAG_C, (unsigned)c << FLAG_C);
+    flags_set_zml(self, 0, out);
+}
+
+/* Run the routine starting at op (the slot at pc, op->fuse ops long) with
+ * the effect, cycles and statistics of its ops.  The intermediate
+ * results of the routine are only computed where a later op or the final
+ * state can see them.  Routines whose preconditions do not hold run op
+ * by op. */
+static int exec_routine(CMachine *self, const MicroOp *op, long n, long long *cycles) {
+    uint32_t (*r)[LIMBS] = self->r;
+    long i;
+
+    if (op->routine != ROUTINE_DC_MULMOD || limbs_is_zero(self->mod, LIMBS)) {
+        int jump = 0;
+        long jump_addr = -1;
+        for (i = 0; i < n; i++, op++) {
+            long c = op_cycles(self, op, op->cycles);
+            if (stats_count_exec(self, (MicroOp *)op, self->pc, c) < 0 ||
+                exec_native(self, op, &jump, &jump_addr) < 0)
+                return -1;
+            *cycles += c;
+            self->pc++;
+        }
+        return 0;
+    }
+
+    self->perf.routines++;
+    for (i = 0; i < n; i++) {
+        long c = op_cycles(self, &op[i], op[i].cycles);
+        if (stats_count_exec(self, (MicroOp *)&op[i], self->pc + i, c) < 0)
+            return -1;
+        switch (op[i].opcode) {
+        case OP_DC_ADD: case OP_DC_ADDC: case OP_DC_SUB: case OP_DC_SUBB:
+            if (stats_kernel_flag_access(self, 0, op[i].opcode) < 0)
+                return -1;
+            break;
+        default:
+            break;
+        }
+        *cycles += c;
+    }
+
+    /* r19:r20 = a * b */
+    routine_mul256(r[19], r[20], r[21], r[24], r[25]);
+    flags_set_czml(self, 0, r[20], 0);
+    memmove(r[22], flag_get(self, FLAG_M) ? r[28] : r[31], sizeof(r[22]));
+    /* q1 = (a * b) >> 255, q2 = q1 * mu */
+    wide_rshi(r[21], r[19], r[20], 255);
+    routine_mul256(r[23], r[24], r[25], r[21], r[28]);
+    wide_rshi(r[25], r[20], r[31], 255);
+    uint32_t carry = wide_add(r[24], r[24], r[21], 0);
+    wide_add(r[25], r[25], r[31], carry);
+    carry = wide_add(r[24], r[24], r[22], 0);
+    carry = wide_add(r[25], r[25], r[31], carry);
+    flags_set_czml(self, 0, r[25], carry);
+    /* q = q2 >> 257 (plus the low 256 bits of q1), r = a * b - q * m */
+    wide_rshi(r[21], r[24], r[25], 1);
+    routine_mul256(r[22], r[23], r[24], r[29], r[21]);
+    routine_dc_sub(self, r[22], r[19], r[22], 0);
+    routine_dc_sub(self, r[20], r[20], r[23], (uint32_t)flag_get(self, FLAG_C));
+    memmove(r[21], flag_get(self, FLAG_L) ? r[29] : r[31], sizeof(r[21]));
+    routine_dc_sub(self, r[21], r[22], r[21], 0);
+    carry = wide_add(r[19], r[21], r[31], 0);
+    if (wide_mod(r[19], r[19], carry, self->mod) < 0)
+        return -1;
+    flags_set_zml(self, 0, r[19]);
+    for (i = 19; i <= 25; i++)
+        mark_valid_all(self, i);
+    self->pc += n;
+    return 0;
+}
+
+/* Run the superinstruction of n ops starting at op (the slot at pc),
+ * with the same effect and statistics as running them one by one. */
+static int exec_fused(CMachine *self, const MicroOp *op, long n, long long *cycles) {
+    uint32_t res[LIMBS], tmp[LIMBS];
+    long i;
+
+    self->perf.superinstructions++;
+    self->perf.fused_ops += (uint64_t)n;
+    if (op->routine)
+        return exec_routine(self, op, n, cycles);
+    switch (op->opcode) {
+    case OP_BN_ADD:
+    case OP_BN_ADDC:
+    case OP_BN_SUB:
+    case OP_BN_SUBB: {
+        int add = op->opcode == OP_BN_ADD || op->opcode == OP_BN_ADDC;
+        int fg = op->fg;
+        uint32_t carry = (op->opcode == OP_BN_ADDC || op->opcode == OP_BN_SUBB)
+                         ? (uint32_t)flag_bit(self, op->fg ? 4 : 0) : 0;
+        for (i = 0; i < n; i++, op++) {
+            long c = op_cycles(self, op, op->cycles);
+            if (stats_count_exec(self, (MicroOp *)op, self->pc, c) < 0)
+                break;
+            wide_shift(tmp, self->r[op->rs2], op->shift);
+            carry = add ? wide_add(res, self->r[op->rs1], tmp, carry)
+                        : wide_sub(res, self->r[op->rs1], tmp, carry);
+            wdr_write(self, op->rd, res);
+            *cycles += c;
+            self->pc++;
+        }
+        if (i)
+            flags_set_czml(self, fg, res, carry);
+        return i == n ? 0 : -1;
+    }
+    case OP_BN_MULQACC:
+    case OP_BN_MULQACC_Z:
+        for (i = 0; i < n; i++, op++) {
+            long c = op_cycles(self, op, op->cycles);
+            if (stats_count_exec(self, (MicroOp *)op, self->pc, c) < 0)
+                return -1;
+            if (op->opcode == OP_BN_MULQACC_Z)
+                memset(self->acc, 0, sizeof(self->acc));
+            if (acc_add_product(self, limbs_get_qw(self->r[op->rs1], (int)(op->aux & 3)),
+                                limbs_get_qw(self->r[op->rs2], (int)((op->aux >> 2) & 3)),
+                                op->shift) < 0)
+                return -1;
+            *cycles += c;
+            self->pc++;
+        }
+        return 0;
+    default:
+        raise_error(PyExc_SystemError, "op at %ld does not start a superinstruction", self->pc);
+        return -1;
+    }
+}
+
+/* End of the straight-line stretch run_block() may run from pc in one
+ * go, at most budget ops; pc or less when there is none.  *loop is the
+ * innermost loop entry when the stretch ends with its end op, NULL
+ * otherwise.  An armed breakpoint at pc itself only counts when
+ * check_bp_at_pc is set. */
+static inline long
+block_limit(CMachine *self, long long budget, int check_bp_at_pc, int check_imem,
+            LoopEntry **loop) {
+    long pc = self->pc;
+    *loop = NULL;
+    if (pc < 0 || pc >= self->n_ops || self->finishFlag || !self->ops[pc].block_len)
+        return pc;
+    long limit = pc + (long)self->ops[pc].block_len;
+    if (limit > self->n_ops - 1)
+        limit = (long)self->n_ops - 1;
+    if (self->loop_sp > 0) {
+        long end = self->loop_stack[self->loop_sp - 1].end_addr;
+        if (end >= pc && end < limit) {
+            limit = end + 1;
+            *loop = &self->loop_stack[self->loop_sp - 1];
+        }
+    }
+    if (self->stop_addr >= pc && self->stop_addr < limit) {
+        limit = self->stop_addr;
+        *loop = NULL;
+    }
+    if (limit - pc > budget) {
+        limit = pc + (long)budget;
+        *loop = NULL;
+    }
+    long bp = bp_next(self, check_bp_at_pc ? pc : pc + 1, limit);
+    if (bp < limit) {
+        limit = bp;
+        *loop = NULL;
+    }
+    if (check_imem && !self->program) {
+        if (limit > PyList_GET_SIZE(self->imem)) {
+            limit = (long)PyList_GET_SIZE(self->imem);
+            *loop = NULL;
+        }
+        for (long a = pc; a < limit; a++) {
+            if (PyList_GET_ITEM(self->imem, a) != self->ops[a].instr) {
+                limit = a;
+                *loop = NULL;
+                break;
+            }
+        }
+    }
+    return limit;
+}
+
+/* Take the back-edge of loop (the innermost entry) once the stretch
+ * ending with its end op ran; -1 on an invalid start address. */
+static inline int
+block_loop_back(CMachine *self, LoopEntry *loop) {
+    if (loop->cnt > 0) {
+        loop->cnt--;
+        if (loop->start_addr < 0 || loop->start_addr >= self->n_ops) {
+            self->pc--;
+            raise_error(PyExc_RuntimeError, "Invalid jump address");
+            return -1;
+        }
+        self->pc = loop->start_addr;
+    } else {
+        self->loop_sp--;
+    }
+    return 0;
+}
+
+/* Run straight-line stretches from pc: native ops that fall through,
+ * taking the innermost loop's back-edge when its end op is one of them.
+ * Stops before anything else advance_pc() would decide on (control and
+ * Python-backed ops, stop_addr, the last imem address), before armed
+ * breakpoints other than the one at the starting pc (already checked),
+ * after a watchpoint hit and after at most budget instructions.  With check_imem (GIL held) a list imem is
+ * compared against the decoded table first, like op_at() would.
+ * Returns the number of instructions run, or -1 on error. */
+static long long
+run_block(CMachine *self, long long budget, int check_imem, long long *cycles) {
+    long long ran = 0;
+    int jump = 0;
+    long jump_addr = -1;
+
+    while (ran < budget) {
+        long pc = self->pc;
+        LoopEntry *loop;
+        long limit = block_limit(self, budget - ran, ran != 0, check_imem, &loop);
+        if (limit <= pc)
+            break;
+
+        while (self->pc < limit) {
+            const MicroOp *op = &self->ops[self->pc];
+            if (op->fuse > 1 && self->pc + (long)op->fuse <= limit && !self->trace_active &&
+                !self->n_watch) {
+                if (exec_fused(self, op, (long)op->fuse, cycles) < 0)
+                    return -1;
+                continue;
+            }
+            long c = op_cycles(self, op, op->cycles);
+            if (stats_count_exec(self, (MicroOp *)op, self->pc, c) < 0 ||
+                exec_native(self, op, &jump, &jump_addr) < 0)
+                return -1;
+            if (self->trace_active && trace_record(self, self->pc, op->opcode) < 0)
+                return -1;
+            *cycles += c;
+            self->pc++;
+            if (self->watch_kind != WATCH_NONE)
+                break;
+        }
+        ran += self->pc - pc;
+        self->perf.blocks++;
+        self->perf.block_ops += (uint64_t)(self->pc - pc);
+
+        if (loop && self->pc == limit && block_loop_back(self, loop) < 0)
+            return -1;
+        if (self->watch_kind != WATCH_NONE)
+            break;
+    }
+    return ran;
+}
+
+/* exec_current() for the run loop with the GIL released.  Only used for
+ * ops with a native kernel, and it trusts the decoded table: imem edits
+ * from other threads are picked up at the next Python-backed op. */
+static int
+exec_released(CMachine *self, MicroOp *op, long *cycles_out, const char **reason) {
+    const char *halt = pending_halt(self);
+    long pc = self->pc;
+    long jump_addr = -1;
+    int jump = 0;
+
+    *cycles_out = op_cycles(self, op, op->cycles);
+    if (stats_count_exec(self, op, pc, *cycles_out) < 0 ||
+        exec_native(self, op, &jump, &jump_addr) < 0)
+        return -1;
+    if (self->trace_active && trace_record(self, pc, op->opcode) < 0)
+        return -1;
+    return advance_pc(self, jump, jump_addr, self->n_ops, halt, reason);
+}
+
+/* Decoded native op at pc for exec_released(), or NULL when the
+ * instruction needs the GIL. */
+static MicroOp *released_op(CMachine *self) {
+    if (self->pc < 0 || self->pc >= self->n_ops)
+        return NULL;
+    MicroOp *op = &self->ops[self->pc];
+    return op->opcode == OP_PYTHON ? NULL : op;
+}
+
+static PyObject *
+CMachine_step(CMachine *self, PyObject *Py_UNUSED(args)) {
+    long passes = 0;
+    if (machine_idle_check(self) < 0)
+        return NULL;
+
+    /* A run() that stopped at a breakpoint already reported it. */
+    if (self->break_resume) {
+        self->break_resume = 0;
+    } else if (check_break(self, &passes)) {
+        /* Handle breakpoint: the interactive debugger lives in Python, the
+         * C step only reports the hit and continues. */
+        if (passes) {
+            PySys_WriteStdout("Breakpoint hit at address %ld at pass %ld.\n", self->pc, passes);
+        } else {
+            PySys_WriteStdout("Breakpoint hit at address %ld.\n", self->pc);
+        }
+    }
+
+    if (self->trace_active)
+        trace_sync(self);
+
+    PyObject *trace_str = NULL;
+    long cycles = 0;
+    const char *reason = NULL;
+    uint64_t start = perf_now();
+    int cont = exec_current(self, &trace_str, &cycles, &reason);
+    self->perf.run_ns += perf_now() - start;
+    if (cont < 0) return NULL;
+
+    return Py_BuildValue("(NNN)",
+                         PyBool_FromLong(cont),
+                         trace_str ? trace_str : (Py_INCREF(Py_None), Py_None),
+                         PyLong_FromLong(cycles));
+}
+
+/* run(max_steps=None, collect_trace=False, release_gil=False)
+ *   -> (inst_cnt, cycle_cnt, stop_reason[, traces])
+ *
+ * Execute until the machine finishes, passes stop_addr, runs off the end
+ * of imem, hits a breakpoint, writes to a watchpoint (stopping after
+ * that instruction, see watch_hit) or max_steps instructions ran.  Trace strings
+ * are only kept when collect_trace is set.
+ *
+ * With release_gil, native ops run without the GIL so other threads (e.g.
+ * other machines in run_batch()) make progress meanwhile; it is taken back
+ * for Python-backed ops and signal checks.  Collecting trace strings
+ * keeps the GIL throughout. */
+static PyObject *
+CMachine_run(CMachine *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_steps", "collect_trace", "release_gil", NULL};
+    PyObject *max_steps_obj = Py_None;
+    int collect_trace = 0;
+    int release_gil = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Opp", kwlist, &max_steps_obj,
+                                      &collect_trace, &release_gil))
+        return NULL;
+    if (machine_idle_check(self) < 0)
+        return NULL;
+
+    long long max_steps = -1;
+    if (max_steps_obj != Py_None) {
+        max_steps = PyLong_AsLongLong(max_steps_obj);
+        if (max_steps == -1 && PyErr_Occurred())
+            return NULL;
+        if (max_steps < 0) {
+            PyErr_SetString(PyExc_ValueError, "max_steps must be non-negative");
+            return NULL;
+        }
+    }
+
+    PyObject *traces = NULL;
+    if (collect_trace) {
+        traces = PyList_New(0);
+        if (!traces) return NULL;
+    }
+
+    if (self->trace_active)
+        trace_sync(self);
+
+    /* Counted for patch() (see Program_patch()) while the run lasts */
+    ProgramObject *program = release_gil && !traces ? (ProgramObject *)self->program : NULL;
+    if (program) {
+        Py_INCREF(program);
+        program->running++;
+    }
+    self->running = 1;
+
+    long long inst_cnt = 0;
+    long long cycle_cnt = 0;
+    long long next_check = 0x1000;
+    const char *reason = "max_steps";
+    PyThreadState *released = NULL;
+    uint64_t start = perf_now();
+    self->watch_kind = WATCH_NONE;
+    while (max_steps < 0 || inst_cnt < max_steps) {
+        long passes;
+        if (release_gil && !traces && !released)
+            released = PyEval_SaveThread();
+
+        if (self->break_resume) {
+            self->break_resume = 0;
+        } else if (check_break(self, &passes)) {
+            /* Stop before the instruction; the next run()/step() resumes
+             * here without re-triggering the breakpoint. */
+            self->break_resume = 1;
+            reason = "breakpoint";
+            break;
+        }
+
+        /* Straight-line stretches run as a block when nothing needs to
+         * look at each instruction */
+        if (!traces && !self->fb_active) {
+            long long budget = next_check - inst_cnt;
+            if (max_steps >= 0 && max_steps - inst_cnt < budget)
+                budget = max_steps - inst_cnt;
+            long long ran = run_block(self, budget, !released, &cycle_cnt);
+            if (ran < 0) goto error;
+            inst_cnt += ran;
+            if (ran)
+                goto next;
+        }
+
+        PyObject *trace_str = NULL;
+        long cycles = 0;
+        const char *halt = NULL;
+        MicroOp *op = released ? released_op(self) : NULL;
+        int cont;
+        if (op) {
+            cont = exec_released(self, op, &cycles, &halt);
+        } else {
+            if (released) {
+                PyEval_RestoreThread(released);
+                released = NULL;
+            }
+            cont = exec_current(self, traces ? &trace_str : NULL, &cycles, &halt);
+        }
+        if (cont < 0) goto error;
+        inst_cnt++;
+        cycle_cnt += cycles;
+        if (trace_str) {
+            int rc = PyList_Append(traces, trace_str);
+            Py_DECREF(trace_str);
+            if (rc < 0) goto error;
+        }
+        if (!cont) {
+            reason = halt;
+            break;
+        }
+    next:
+        if (self->watch_kind != WATCH_NONE) {
+            reason = "watchpoint";
+            break;
+        }
+        if (inst_cnt >= next_check) {
+            next_check = inst_cnt + 0x1000;
+            if (released) {
+                PyEval_RestoreThread(released);
+                released = NULL;
+            }
+            if (PyErr_CheckSignals() < 0)
+                goto error;
+        }
+    }
+    if (released)
+        PyEval_RestoreThread(released);
+    self->perf.run_ns += perf_now() - start;
+    self->running = 0;
+    if (program) {
+        program->running--;
+        Py_DECREF(program);
+    }
+
+    if (traces)
+        return Py_BuildValue("(LLsN)", inst_cnt, cycle_cnt, reason, traces);
+    return Py_BuildValue("(LLs)", inst_cnt, cycle_cnt, reason);
+
+error:
+    if (released)
+        PyEval_RestoreThread(released);
+    self->perf.run_ns += perf_now() - start;
+    self->running = 0;
+    if (program) {
+        program->running--;
+        Py_DECREF(program);
+    }
+    Py_XDECREF(traces);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Lockstep lanes                                                      */
+/* ------------------------------------------------------------------ */
+
+/* CMachine.run_lanes(machines, max_steps=None, release_gil=False)
+ *   -> [(inst_cnt, cycle_cnt, stop_reason), ...]
+ *
+ * Runs every machine as run(max_steps, release_gil=...) would, stepping
+ * the ones in the same control state together.  Constant-time code takes
+ * the same path whatever the data, so lanes sharing a Program run each
+ * straight-line stretch as one group: the group's WDRs, flags and ACC
+ * move into a structure-of-arrays register file (LaneFile, one row of
+ * lane words per register limb) and the add/sub, logic, shift, select
+ * and multiply-accumulate kernels below run each op as loops across the
+ * lanes.  Other native ops of a stretch run lane by lane on the machines,
+ * once the registers they may touch were written back; control and
+ * Python-backed ops always do.  A lane whose branch, loop count or halt
+ * sets it apart becomes a group of its own and runs on run()'s scalar
+ * block loop until its control state meets another group's again.  The
+ * group holding the lane with the fewest executed instructions always
+ * goes next, so lanes that fell behind catch up and merge.
+ *
+ * Results, statistics and final states are those of separate runs.  The
+ * lanes must be distinct and have no breakpoints, watchpoints or binary
+ * trace. */
+
+/* Register file of a group of lanes.  Rows are cap words apart, word l
+ * of a row belongs to lane l; a register's limbs are consecutive rows.
+ * Registers are loaded from the machines when a lane kernel first needs
+ * them and written back when a scalar op may touch them or the group
+ * breaks up. */
+typedef struct {
+    int cap;                    /* lanes of the run, the row length */
+    int n;                      /* lanes of the group held, 0 for none */
+    int *group;                 /* their run_lanes() indices */
+    CMachine **m;
+    uint32_t *r;                /* NUM_REGS * LIMBS rows */
+    uint32_t *acc;              /* ACC_LIMBS rows */
+    uint32_t *tmp;              /* LIMBS rows: shifted or immediate operand */
+    uint32_t *res;              /* LIMBS rows: results not written to a WDR */
+    uint32_t *carry;            /* carry/borrow row */
+    uint32_t *borrow;           /* dcrypto sub borrow row */
+    uint32_t *aux;              /* scratch row */
+    uint32_t *zero;             /* all-zero row */
+    uint8_t *flags;
+    uint32_t wdr_valid, wdr_dirty;  /* rows hold the WDR / newer than the lanes' */
+    int flags_valid, flags_dirty;
+    int acc_valid, acc_dirty;
+
+    /* Executions counted for the whole group and not yet added to its
+     * lanes: per slot, in the order slots were first counted, and in
+     * total.  With a timing model or profile (per_lane) every lane
+     * counts its own. */
+    int per_lane;
+    uint64_t *execs;
+    uint64_t *slot_cycles;
+    Py_ssize_t *order;
+    Py_ssize_t n_order;
+    uint64_t opcode_counts[NUM_OPCODES];
+    long long cycles;
+} LaneFile;
+
+#define LANE_WDR(lf, reg, limb) ((lf)->r + ((size_t)(reg) * LIMBS + (limb)) * (size_t)(lf)->cap)
+#define LANE_ROW(lf, base, limb) ((base) + (size_t)(limb) * (size_t)(lf)->cap)
+
+static int lanes_file_init(LaneFile *lf, int cap, Py_ssize_t n_ops) {
+    memset(lf, 0, sizeof(*lf));
+    size_t c = cap ? (size_t)cap : 1;
+    lf->cap = (int)c;
+    lf->group = PyMem_Calloc(c, sizeof(*lf->group));
+    lf->m = PyMem_Calloc(c, sizeof(*lf->m));
+    lf->r = PyMem_Calloc((size_t)NUM_REGS * LIMBS * c, sizeof(uint32_t));
+    lf->acc = PyMem_Calloc((size_t)ACC_LIMBS * c, sizeof(uint32_t));
+    lf->tmp = PyMem_Calloc((size_t)LIMBS * c, sizeof(uint32_t));
+    lf->res = PyMem_Calloc((size_t)LIMBS * c, sizeof(uint32_t));
+    lf->carry = PyMem_Calloc(c, sizeof(uint32_t));
+    lf->borrow = PyMem_Calloc(c, sizeof(uint32_t));
+    lf->aux = PyMem_Calloc(c, sizeof(uint32_t));
+    lf->zero = PyMem_Calloc(c, sizeof(uint32_t));
+    lf->flags = PyMem_Calloc(c, 1);
+    size_t slots = n_ops > 0 ? (size_t)n_ops : 1;
+    lf->execs = PyMem_Calloc(slots, sizeof(uint64_t));
+    lf->slot_cycles = PyMem_Calloc(slots, sizeof(uint64_t));
+    lf->order = PyMem_Calloc(slots, sizeof(Py_ssize_t));
+    if (!lf->group || !lf->m || !lf->r || !lf->acc || !lf->tmp || !lf->res || !lf->carry ||
+        !lf->borrow || !lf->aux || !lf->zero || !lf->flags || !lf->execs || !lf->slot_cycles || !lf->order) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void lanes_file_free(LaneFile *lf) {
+    PyMem_Free(lf->group);
+    PyMem_Free(lf->m);
+    PyMem_Free(lf->r);
+    PyMem_Free(lf->acc);
+    PyMem_Free(lf->tmp);
+    PyMem_Free(lf->res);
+    PyMem_Free(lf->carry);
+    PyMem_Free(lf->borrow);
+    PyMem_Free(lf->aux);
+    PyMem_Free(lf->zero);
+    PyMem_Free(lf->flags);
+    PyMem_Free(lf->execs);
+    PyMem_Free(lf->slot_cycles);
+    PyMem_Free(lf->order);
+}
+
+/* Whether lf holds exactly the n lanes listed in group. */
+static int lanes_file_holds(const LaneFile *lf, const int *group, int n) {
+    return lf->n == n && !memcmp(lf->group, group, (size_t)n * sizeof(*group));
+}
+
+static void lanes_file_bind(LaneFile *lf, CMachine **lanes, const int *group, int n) {
+    lf->n = n;
+    lf->per_lane = 0;
+    for (int i = 0; i < n; i++) {
+        lf->group[i] = group[i];
+        lf->m[i] = lanes[group[i]];
+        if (lf->m[i]->timing.active || lf->m[i]->prof_active)
+            lf->per_lane = 1;
+    }
+    lf->wdr_valid = lf->wdr_dirty = 0;
+    lf->flags_valid = lf->flags_dirty = 0;
+    lf->acc_valid = lf->acc_dirty = 0;
+}
+
+/* Load the registers in wdr, and the flags and ACC when asked, from the
+ * lanes where the rows do not hold them yet. */
+static void lanes_load(LaneFile *lf, uint32_t wdr, int flags, int acc) {
+    int n = lf->n;
+    for (uint32_t todo = wdr & ~lf->wdr_valid; todo; todo &= todo - 1) {
+        int reg = ctz64(todo);
+        for (int j = 0; j < LIMBS; j++) {
+            uint32_t *row = LANE_WDR(lf, reg, j);
+            for (int l = 0; l < n; l++)
+                row[l] = lf->m[l]->r[reg][j];
+        }
+    }
+    lf->wdr_valid |= wdr;
+    if (flags && !lf->flags_valid) {
+        for (int l = 0; l < n; l++)
+            lf->flags[l] = lf->m[l]->flags;
+        lf->flags_valid = 1;
+    }
+    if (acc && !lf->acc_valid) {
+        for (int j = 0; j < ACC_LIMBS; j++) {
+            uint32_t *row = LANE_ROW(lf, lf->acc, j);
+            for (int l = 0; l < n; l++)
+                row[l] = lf->m[l]->acc[j];
+        }
+        lf->acc_valid = 1;
+    }
+}
+
+/* Write the registers in wdr (and the flags and ACC when asked) that the
+ * rows changed back to the lanes, and stop relying on the rows for them:
+ * a scalar op is about to run on the lanes. */
+static void lanes_store(LaneFile *lf, uint32_t wdr, int flags, int acc) {
+    int n = lf->n;
+    for (uint32_t todo = wdr & lf->wdr_dirty; todo; todo &= todo - 1) {
+        int reg = ctz64(todo);
+        for (int j = 0; j < LIMBS; j++) {
+            const uint32_t *row = LANE_WDR(lf, reg, j);
+            for (int l = 0; l < n; l++)
+                lf->m[l]->r[reg][j] = row[l];
+        }
+        for (int l = 0; l < n; l++)
+            lf->m[l]->r_valid_half_limbs[reg] = VALID_HALF_LIMBS_ALL;
+    }
+    lf->wdr_dirty &= ~wdr;
+    lf->wdr_valid &= ~wdr;
+    if (flags) {
+        if (lf->flags_dirty) {
+            for (int l = 0; l < n; l++)
+                lf->m[l]->flags = lf->flags[l];
+        }
+        lf->flags_valid = lf->flags_dirty = 0;
+    }
+    if (acc) {
+        if (lf->acc_dirty) {
+            for (int j = 0; j < ACC_LIMBS; j++) {
+                const uint32_t *row = LANE_ROW(lf, lf->acc, j);
+                for (int l = 0; l < n; l++)
+                    lf->m[l]->acc[j] = row[l];
+            }
+        }
+        lf->acc_valid = lf->acc_dirty = 0;
+    }
+}
+
+/* Count one execution of op (the slot at addr) on every lane. */
+static int lanes_count(LaneFile *lf, MicroOp *op, Py_ssize_t addr, long long *cycles) {
+    if (lf->per_lane) {
+        for (int l = 0; l < lf->n; l++) {
+            CMachine *m = lf->m[l];
+            long c = op_cycles(m, op, op->cycles);
+            if (stats_count_exec(m, op, addr, c) < 0)
+                return -1;
+            cycles[lf->group[l]] += c;
+        }
+        return 0;
+    }
+    if (!lf->execs[addr]++)
+        lf->order[lf->n_order++] = addr;
+    lf->slot_cycles[addr] += (uint64_t)op->cycles;
+    lf->opcode_counts[op->opcode]++;
+    lf->cycles += op->cycles;
+    return 0;
+}
+
+/* Add the executions counted for the group to its lanes, as
+ * stats_count_exec() would have one by one. */
+static int lanes_flush_counts(LaneFile *lf, long long *cycles) {
+    for (int l = 0; l < lf->n; l++) {
+        CMachine *m = lf->m[l];
+        for (Py_ssize_t k = 0; k < lf->n_order; k++) {
+            Py_ssize_t addr = lf->order[k];
+            SlotCounts *cnt = &m->counts[addr];
+            if (cnt->exec_count == cnt->flushed) {
+                Py_ssize_t *slot = event_push(&m->exec_order, sizeof(Py_ssize_t));
+                if (!slot) return -1;
+                *slot = addr;
+            }
+            cnt->exec_count += lf->execs[addr];
+            cnt->cycle_count += lf->slot_cycles[addr];
+        }
+        for (int i = 0; i < NUM_OPCODES; i++)
+            m->opcode_counts[i] += lf->opcode_counts[i];
+        cycles[lf->group[l]] += lf->cycles;
+    }
+    for (Py_ssize_t k = 0; k < lf->n_order; k++) {
+        lf->execs[lf->order[k]] = 0;
+        lf->slot_cycles[lf->order[k]] = 0;
+    }
+    lf->n_order = 0;
+    memset(lf->opcode_counts, 0, sizeof(lf->opcode_counts));
+    lf->cycles = 0;
+    return 0;
+}
+
+/* Hand everything back to the lanes and hold no group. */
+static int lanes_file_release(LaneFile *lf, long long *cycles) {
+    if (!lf->n)
+        return 0;
+    lanes_store(lf, 0xFFFFFFFFu, 1, 1);
+    int rc = lanes_flush_counts(lf, cycles);
+    lf->n = 0;
+    return rc;
+}
+
+/* Value of GPR idx on m without the side effects of reading x1; 0 when
+ * it is not that simple. */
+static int lanes_gpr_peek(const CMachine *m, int idx, long *v) {
+    if (idx == 1 || idx < 0 || idx >= NUM_GPRS)
+        return 0;
+    *v = idx == 0 ? 0 : idx < 8 ? m->gpr[idx] : idx < 16 ? (long)m->rfp[idx - 8]
+       : idx < 24 ? (long)m->dmp[idx - 16] : (long)m->lc[idx - 24];
+    return 1;
+}
+
+/* WDR index that GPR idx selects on every lane alike, or -1. */
+static int lanes_indirect_wdr(const LaneFile *lf, int idx) {
+    long first = 0, v;
+    for (int l = 0; l < lf->n; l++) {
+        if (!lanes_gpr_peek(lf->m[l], idx, &v) || (l && v != first))
+            return -1;
+        first = v;
+    }
+    return first >= 0 && first < NUM_REGS ? (int)first : -1;
+}
+
+/* WDRs, flags and ACC the scalar kernel of op may touch on the lanes. */
+static void lanes_footprint(const LaneFile *lf, const MicroOp *op, uint32_t *wdr,
+                            int *flags, int *acc) {
+    uint32_t rs1 = (uint32_t)1 << op->rs1, rs2 = (uint32_t)1 << op->rs2;
+    uint32_t rd = (uint32_t)1 << op->rd;
+    int a, b;
+    *wdr = 0;
+    *flags = *acc = 0;
+    switch (op->opcode) {
+    case OP_LOOP: case OP_LOOPI:
+    case OP_ADD: case OP_ADDI: case OP_SUB: case OP_AND: case OP_ANDI: case OP_OR: case OP_ORI:
+    case OP_XOR: case OP_XORI: case OP_SLLI: case OP_LUI: case OP_LI: case OP_LW: case OP_SW:
+    case OP_BEQ: case OP_BNE: case OP_JAL: case OP_JALR: case OP_RET: case OP_ECALL: case OP_NOP:
+    case OP_DC_CALL: case OP_DC_LOOP:
+        return;
+    case OP_BN_ADDM: case OP_BN_SUBM: case OP_BN_MULH:
+        *wdr = rs1 | rs2 | rd;
+        return;
+    case OP_DC_ADDM: case OP_DC_SUBM:
+        *wdr = rs1 | rs2 | rd;
+        *flags = 1;
+        return;
+    case OP_BN_WSRRS: case OP_BN_WSRRW:
+        *wdr = rs1 | rd;
+        return;
+    case OP_DC_LDRFP: case OP_DC_LDLC: case OP_DC_LDDMP: case OP_DC_LDMOD: case OP_DC_LDRND:
+        *wdr = rs1;
+        return;
+    case OP_DC_STDMP: case OP_DC_STMOD: case OP_DC_STRND:
+    case OP_DC_LDI: case OP_DC_STI: case OP_DC_MOVI:
+        *wdr = rd;
+        return;
+    case OP_DC_B:
+        *flags = 1;
+        return;
+    case OP_BN_LID: case OP_BN_SID:
+        if ((a = lanes_indirect_wdr(lf, op->rd)) >= 0) {
+            *wdr = (uint32_t)1 << a;
+            return;
+        }
+        break;
+    case OP_BN_MOVR:
+        if ((a = lanes_indirect_wdr(lf, op->rd)) >= 0 && (b = lanes_indirect_wdr(lf, op->rs1)) >= 0) {
+            *wdr = (uint32_t)1 << a | (uint32_t)1 << b;
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    *wdr = 0xFFFFFFFFu;
+    *flags = *acc = 1;
+}
+
+/* Rows of WDR reg shifted like wide_shift() (into tmp unless bits is 0). */
+static const uint32_t *lanes_shifted(LaneFile *lf, int reg, long bits) {
+    if (!bits)
+        return LANE_WDR(lf, reg, 0);
+    int n = lf->n;
+    long nb = bits < 0 ? -bits : bits;
+    int ls = (int)(nb / 32), bs = (int)(nb % 32);
+    for (int i = 0; i < LIMBS; i++) {
+        uint32_t *out = LANE_ROW(lf, lf->tmp, i);
+        int hi_idx = bits < 0 ? i + ls + 1 : i - ls;
+        int lo_idx = bits < 0 ? i + ls : i - ls - 1;
+        const uint32_t *hi = nb < XLEN && hi_idx >= 0 && hi_idx < LIMBS ? LANE_WDR(lf, reg, hi_idx) : lf->zero;
+        const uint32_t *lo = nb < XLEN && lo_idx >= 0 && lo_idx < LIMBS ? LANE_WDR(lf, reg, lo_idx) : lf->zero;
+        if (!bs) {
+            memcpy(out, bits < 0 ? lo : hi, (size_t)n * sizeof(uint32_t));
+        } else if (bits < 0) {
+            for (int l = 0; l < n; l++)
+                out[l] = (lo[l] >> bs) | (hi[l] << (32 - bs));
+        } else {
+            for (int l = 0; l < n; l++)
+                out[l] = (hi[l] << bs) | (lo[l] >> (32 - bs));
+        }
+    }
+    return lf->tmp;
+}
+
+/* Rows of a constant operand (into tmp), limbs 0 and 1 from imm. */
+static const uint32_t *lanes_imm(LaneFile *lf, uint64_t imm) {
+    for (int i = 0; i < LIMBS; i++) {
+        uint32_t v = i == 0 ? (uint32_t)imm : i == 1 ? (uint32_t)(imm >> 32) : 0;
+        uint32_t *out = LANE_ROW(lf, lf->tmp, i);
+        for (int l = 0; l < lf->n; l++)
+            out[l] = v;
+    }
+    return lf->tmp;
+}
+
+/* carry = flag bit of each lane, or 0 for bit < 0. */
+static void lanes_carry_in(LaneFile *lf, uint32_t *carry, int bit) {
+    for (int l = 0; l < lf->n; l++)
+        carry[l] = bit < 0 ? 0 : (uint32_t)(lf->flags[l] >> bit) & 1;
+}
+
+/* out = a + b + carry (a - b - carry with sub), carry out in carry.
+ * Limb i only depends on limb i of a and b, so out may be either. */
+static void lanes_add(LaneFile *lf, uint32_t *out, const uint32_t *a, const uint32_t *b,
+                      uint32_t *carry, int sub) {
+    int n = lf->n;
+    for (int i = 0; i < LIMBS; i++) {
+        const uint32_t *x = LANE_ROW(lf, a, i), *y = LANE_ROW(lf, b, i);
+        uint32_t *o = LANE_ROW(lf, out, i);
+        if (sub) {
+            for (int l = 0; l < n; l++) {
+                uint64_t t = (uint64_t)x[l] - y[l] - carry[l];
+                o[l] = (uint32_t)t;
+                carry[l] = (uint32_t)(t >> 63);
+            }
+        } else {
+            for (int l = 0; l < n; l++) {
+                uint64_t t = (uint64_t)x[l] + y[l] + carry[l];
+                o[l] = (uint32_t)t;
+                carry[l] = (uint32_t)(t >> 32);
+            }
+        }
+    }
+}
+
+/* Row (aux) of the OR of all limbs of the rows at res. */
+static const uint32_t *lanes_nonzero(LaneFile *lf, const uint32_t *res) {
+    int n = lf->n;
+    memcpy(lf->aux, res, (size_t)n * sizeof(uint32_t));
+    for (int i = 1; i < LIMBS; i++) {
+        const uint32_t *row = LANE_ROW(lf, res, i);
+        for (int l = 0; l < n; l++)
+            lf->aux[l] |= row[l];
+    }
+    return lf->aux;
+}
+
+/* Replace the flags in mask of group fg by those of the result rows res
+ * (C from carry), like flags_put(fg, mask, flags_of_result()). */
+static void lanes_flags_of(LaneFile *lf, int fg, unsigned mask, const uint32_t *res,
+                           const uint32_t *carry) {
+    int n = lf->n, shift = FLAG_GROUP_SHIFT(fg);
+    const uint32_t *low = LANE_ROW(lf, res, 0), *top = LANE_ROW(lf, res, LIMBS - 1);
+    const uint32_t *any = lanes_nonzero(lf, res);
+    for (int l = 0; l < n; l++) {
+        unsigned bits = (carry ? carry[l] : 0) << FLAG_C | (top[l] >> 31) << FLAG_M |
+                        (low[l] & 1) << FLAG_L | (unsigned)(any[l] == 0) << FLAG_Z;
+        lf->flags[l] = (uint8_t)((lf->flags[l] & ~(mask << shift)) | (bits & mask) << shift);
+    }
+}
+
+#define LANE_CZML (1u << FLAG_C | 1u << FLAG_M | 1u << FLAG_L | 1u << FLAG_Z)
+#define LANE_ZML (1u << FLAG_M | 1u << FLAG_L | 1u << FLAG_Z)
+
+/* acc += (a * b) << shift on every lane, as acc_add_product(); 1 when a
+ * lane could overflow (the scalar kernel raises for it). */
+static int lanes_mulqacc(LaneFile *lf, const MicroOp *op) {
+    int n = lf->n;
+    long ls = op->shift / 32;
+    int bs = (int)(op->shift % 32);
+    const uint32_t *top = LANE_ROW(lf, lf->acc, ACC_LIMBS - 1);
+    /* The shifted product is below 2^(32 * (ls + 5)): with ls + 5 below
+     * ACC_LIMBS and the top limb not all ones, the sum stays in range */
+    if (ls + 5 >= ACC_LIMBS)
+        return 1;
+    if (op->opcode != OP_BN_MULQACC_Z) {
+        for (int l = 0; l < n; l++) {
+            if (top[l] == 0xFFFFFFFFu)
+                return 1;
+        }
+    }
+    int qa = (int)(op->aux & 3), qb = (int)((op->aux >> 2) & 3);
+    const uint32_t *a0 = LANE_WDR(lf, op->rs1, 2 * qa), *a1 = LANE_WDR(lf, op->rs1, 2 * qa + 1);
+    const uint32_t *b0 = LANE_WDR(lf, op->rs2, 2 * qb), *b1 = LANE_WDR(lf, op->rs2, 2 * qb + 1);
+    if (op->opcode == OP_BN_MULQACC_Z) {
+        for (int j = 0; j < ACC_LIMBS; j++)
+            memset(LANE_ROW(lf, lf->acc, j), 0, (size_t)n * sizeof(uint32_t));
+    }
+    for (int l = 0; l < n; l++) {
+        uint64_t p00 = (uint64_t)a0[l] * b0[l], p01 = (uint64_t)a0[l] * b1[l];
+        uint64_t p10 = (uint64_t)a1[l] * b0[l], p11 = (uint64_t)a1[l] * b1[l];
+        uint64_t t1 = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+        uint64_t t2 = (p01 >> 32) + (p10 >> 32) + (uint32_t)p11 + (t1 >> 32);
+        uint32_t prod[4] = {(uint32_t)p00, (uint32_t)t1, (uint32_t)t2,
+                            (uint32_t)((p11 >> 32) + (t2 >> 32))};
+        uint32_t sh[5];
+        sh[0] = prod[0] << bs;
+        for (int i = 1; i < 4; i++)
+            sh[i] = bs ? (prod[i] << bs) | (prod[i - 1] >> (32 - bs)) : prod[i];
+        sh[4] = bs ? prod[3] >> (32 - bs) : 0;
+        uint64_t carry = 0;
+        for (long i = 0; ls + i < ACC_LIMBS && (i < 5 || carry); i++) {
+            uint32_t *acc = LANE_ROW(lf, lf->acc, ls + i);
+            uint64_t t = carry + (i < 5 ? sh[i] : 0) + acc[l];
+            acc[l] = (uint32_t)t;
+            carry = t >> 32;
+        }
+    }
+    if (op->opcode != OP_BN_MULQACC_SO)
+        return 0;
+
+    /* Shift out the lower half word of the accumulator into rd */
+    int upper = (int)((op->aux >> 4) & 1);
+    for (int j = 0; j < LIMBS / 2; j++)
+        memcpy(LANE_WDR(lf, op->rd, upper * (LIMBS / 2) + j), LANE_ROW(lf, lf->acc, j),
+               (size_t)n * sizeof(uint32_t));
+    for (int j = 0; j < ACC_LIMBS; j++) {
+        uint32_t *row = LANE_ROW(lf, lf->acc, j);
+        if (j + LIMBS / 2 < ACC_LIMBS)
+            memcpy(row, LANE_ROW(lf, lf->acc, j + LIMBS / 2), (size_t)n * sizeof(uint32_t));
+        else
+            memset(row, 0, (size_t)n * sizeof(uint32_t));
+    }
+    int shift = FLAG_GROUP_SHIFT(op->fg);
+    unsigned mask = upper ? (1u << FLAG_C | 1u << FLAG_M) : 1u << FLAG_L;
+    const uint32_t *so = LANE_WDR(lf, op->rd, upper ? LIMBS - 1 : 0);
+    for (int l = 0; l < n; l++) {
+        /* set_c_m(shift_out << 128): no carry, M from the MSB */
+        unsigned bits = upper ? (so[l] >> 31) << FLAG_M : (so[l] & 1) << FLAG_L;
+        lf->flags[l] = (uint8_t)((lf->flags[l] & ~(mask << shift)) | bits << shift);
+    }
+    return 0;
+}
+
+/* Run op on the register file for every lane.  Returns 0 when it ran,
+ * 1 when it has no lane kernel (or a lane needs the scalar one) and -1
+ * on error. */
+static int lanes_kernel(LaneFile *lf, const MicroOp *op) {
+    uint32_t rs1 = (uint32_t)1 << op->rs1, rs2 = (uint32_t)1 << op->rs2;
+    uint32_t rd = (uint32_t)1 << op->rd;
+    uint32_t *out = LANE_WDR(lf, op->rd, 0);
+    const uint32_t *a = LANE_WDR(lf, op->rs1, 0), *b;
+    int n = lf->n, x, writes = 1, sets_flags = 1;
+
+    switch (op->opcode) {
+    case OP_BN_ADD: case OP_BN_ADDC: case OP_BN_SUB: case OP_BN_SUBB:
+    case OP_BN_CMP: case OP_BN_CMPB:
+        lanes_load(lf, rs1 | rs2, 1, 0);
+        lanes_carry_in(lf, lf->carry, op->opcode == OP_BN_ADDC || op->opcode == OP_BN_SUBB ||
+                                      op->opcode == OP_BN_CMPB ? (op->fg ? FLAG_XC : FLAG_C) : -1);
+        if (op->opcode == OP_BN_CMP || op->opcode == OP_BN_CMPB) {
+            out = lf->res;
+            writes = 0;
+        }
+        b = lanes_shifted(lf, op->rs2, op->shift);
+        lanes_add(lf, out, a, b, lf->carry, op->opcode != OP_BN_ADD && op->opcode != OP_BN_ADDC);
+        lanes_flags_of(lf, op->fg, LANE_CZML, out, lf->carry);
+        break;
+    case OP_BN_ADDI: case OP_BN_SUBI:
+        lanes_load(lf, rs1, 1, 0);
+        memset(lf->carry, 0, (size_t)n * sizeof(uint32_t));
+        lanes_add(lf, out, a, lanes_imm(lf, (uint64_t)op->imm), lf->carry, op->opcode == OP_BN_SUBI);
+        lanes_flags_of(lf, op->fg, LANE_CZML, out, lf->carry);
+        break;
+    case OP_BN_AND: case OP_BN_OR: case OP_BN_XOR: case OP_BN_NOT:
+        lanes_load(lf, op->opcode == OP_BN_NOT ? rs1 : rs1 | rs2, 1, 0);
+        b = lanes_shifted(lf, op->opcode == OP_BN_NOT ? op->rs1 : op->rs2, op->shift);
+        for (int i = 0; i < LIMBS; i++) {
+            const uint32_t *p = LANE_ROW(lf, a, i), *q = LANE_ROW(lf, b, i);
+            uint32_t *o = LANE_ROW(lf, out, i);
+            switch (op->opcode) {
+            case OP_BN_AND: for (int l = 0; l < n; l++) o[l] = p[l] & q[l]; break;
+            case OP_BN_OR:  for (int l = 0; l < n; l++) o[l] = p[l] | q[l]; break;
+            case OP_BN_XOR: for (int l = 0; l < n; l++) o[l] = p[l] ^ q[l]; break;
+            default:        for (int l = 0; l < n; l++) o[l] = ~q[l]; break;
+            }
+        }
+        lanes_flags_of(lf, op->fg, LANE_ZML, out, NULL);
+        break;
+    case OP_BN_RSHI: {
+        /* Limb i of (rs2 * 2^XLEN + rs1) >> shift */
+        lanes_load(lf, rs1 | rs2, 0, 0);
+        long ws = op->shift / 32;
+        int bs = (int)(op->shift % 32);
+        for (int i = 0; i < LIMBS; i++) {
+            long j = i + ws;
+            const uint32_t *lo = j < LIMBS ? LANE_WDR(lf, op->rs1, j)
+                               : j < 2 * LIMBS ? LANE_WDR(lf, op->rs2, j - LIMBS) : lf->zero;
+            const uint32_t *hi = j + 1 < LIMBS ? LANE_WDR(lf, op->rs1, j + 1)
+                               : j + 1 < 2 * LIMBS ? LANE_WDR(lf, op->rs2, j + 1 - LIMBS) : lf->zero;
+            uint32_t *o = LANE_ROW(lf, lf->res, i);
+            if (bs) {
+                for (int l = 0; l < n; l++)
+                    o[l] = (lo[l] >> bs) | (hi[l] << (32 - bs));
+            } else {
+                memcpy(o, lo, (size_t)n * sizeof(uint32_t));
+            }
+        }
+        for (int i = 0; i < LIMBS; i++)
+            memcpy(LANE_ROW(lf, out, i), LANE_ROW(lf, lf->res, i), (size_t)n * sizeof(uint32_t));
+        sets_flags = 0;
+        break;
+    }
+    case OP_BN_SEL: {
+        lanes_load(lf, rs1 | rs2, 1, 0);
+        b = LANE_WDR(lf, op->rs2, 0);
+        uint32_t *pick = lf->carry;
+        for (int l = 0; l < n; l++)
+            pick[l] = 0u - ((uint32_t)(lf->flags[l] >> (op->aux & 7)) & 1);
+        for (int i = 0; i < LIMBS; i++) {
+            const uint32_t *p = LANE_ROW(lf, a, i), *q = LANE_ROW(lf, b, i);
+            uint32_t *o = LANE_ROW(lf, out, i);
+            for (int l = 0; l < n; l++)
+                o[l] = (p[l] & pick[l]) | (q[l] & ~pick[l]);
+        }
+        sets_flags = 0;
+        break;
+    }
+    case OP_BN_MOV:
+        lanes_load(lf, rs1, 0, 0);
+        if (op->rd != op->rs1) {
+            for (int i = 0; i < LIMBS; i++)
+                memcpy(LANE_ROW(lf, out, i), LANE_ROW(lf, a, i), (size_t)n * sizeof(uint32_t));
+        }
+        sets_flags = 0;
+        break;
+    case OP_BN_MULQACC: case OP_BN_MULQACC_Z: case OP_BN_MULQACC_SO:
+        x = op->opcode == OP_BN_MULQACC_SO;
+        lanes_load(lf, rs1 | rs2 | (x ? rd : 0), x, 1);
+        if (lanes_mulqacc(lf, op))
+            return 1;
+        lf->acc_dirty = 1;
+        writes = sets_flags = x;
+        break;
+    case OP_DC_ADD: case OP_DC_ADDC: case OP_DC_ADDI: case OP_DC_ADDX: case OP_DC_ADDCX:
+        /* addx takes its carry from the standard C flag (as execute() does) */
+        x = op->opcode == OP_DC_ADDX || op->opcode == OP_DC_ADDCX;
+        lanes_load(lf, op->opcode == OP_DC_ADDI ? rs1 : rs1 | rs2, 1, 0);
+        lanes_carry_in(lf, lf->carry, op->opcode == OP_DC_ADDC || op->opcode == OP_DC_ADDX ? FLAG_C
+                                      : op->opcode == OP_DC_ADDCX ? FLAG_XC : -1);
+        b = op->opcode == OP_DC_ADDI ? lanes_imm(lf, (uint32_t)op->imm)
+                                     : lanes_shifted(lf, op->rs2, op->shift);
+        lanes_add(lf, out, a, b, lf->carry, 0);
+        for (int l = 0; l < n; l++) {
+            if (stats_kernel_flag_access(lf->m[l], x, op->opcode) < 0)
+                return -1;
+        }
+        lanes_flags_of(lf, x, LANE_CZML, out, lf->carry);
+        break;
+    case OP_DC_SUB: case OP_DC_SUBB: case OP_DC_SUBI: case OP_DC_SUBX: case OP_DC_SUBBX:
+        /* The carry flag is rs2 > rs1 on the unshifted operands */
+        x = op->opcode == OP_DC_SUBX || op->opcode == OP_DC_SUBBX;
+        lanes_load(lf, rs1 | rs2, 1, 0);
+        memset(lf->borrow, 0, (size_t)n * sizeof(uint32_t));
+        lanes_add(lf, lf->res, a, LANE_WDR(lf, op->rs2, 0), lf->borrow, 1);
+        lanes_carry_in(lf, lf->carry, op->opcode == OP_DC_SUBB ? FLAG_C
+                                      : op->opcode == OP_DC_SUBBX ? FLAG_XC : -1);
+        b = op->opcode == OP_DC_SUBI ? lanes_imm(lf, (uint32_t)op->imm)
+                                     : lanes_shifted(lf, op->rs2, op->shift);
+        lanes_add(lf, out, a, b, lf->carry, 1);
+        for (int l = 0; l < n; l++) {
+            if (stats_kernel_flag_access(lf->m[l], x, op->opcode) < 0)
+                return -1;
+        }
+        lanes_flags_of(lf, x, LANE_CZML, out, lf->borrow);
+        break;
+    case OP_DC_CMP: case OP_DC_CMPBX: {
+        x = op->opcode == OP_DC_CMPBX;
+        lanes_load(lf, rs1 | rs2, 1, 0);
+        memset(lf->carry, 0, (size_t)n * sizeof(uint32_t));
+        lanes_add(lf, lf->res, a, LANE_WDR(lf, op->rs2, 0), lf->carry, 1);
+        for (int l = 0; l < n; l++) {
+            if (stats_kernel_flag_access(lf->m[l], x, op->opcode) < 0)
+                return -1;
+        }
+        if (!x) {
+            lanes_flags_of(lf, 0, 1u << FLAG_C | 1u << FLAG_Z, lf->res, lf->carry);
         } else {
-            addr = strtol(s, &endp, 10);
-            if (*endp != '\0') {
-                /* Label lookup via ctx */
-                if (self->ctx == Py_None) {
-                    PyErr_SetString(PyExc_ValueError, "Label breakpoints only possible with assembly context");
-                    return NULL;
-                }
-                /* ctx.functions / ctx.labels */
-                PyObject *functions = PyObject_GetAttrString(self->ctx, "functions");
-                PyObject *labels = PyObject_GetAttrString(self->ctx, "labels");
-                /* Reverse lookup */
-                PyObject *items;
-                int found = 0;
-                if (functions) {
-                    items = PyDict_Values(functions);
-                    /* Actually need reverse: name -> addr */
-                    PyObject *fkeys = PyDict_Keys(functions);
-                    PyObject *fvals = PyDict_Values(functions);
-                    Py_ssize_t flen = PyList_Size(fkeys);
-                    for (Py_ssize_t i = 0; i < flen; i++) {
-                        PyObject *name = PyList_GetItem(fvals, i);
-                        if (PyUnicode_Compare(name, bp) == 0) {
-                            addr = PyLong_AsLong(PyList_GetItem(fkeys, i));
-                            found = 1;
-                            break;
-                        }
-                    }
-                    Py_XDECREF(fkeys);
-                    Py_XDECREF(fvals);
-                    Py_XDECREF(items);
-                }
-                if (!found && labels) {
-                    PyObject *lkeys = PyDict_Keys(labels);
-                    PyObject *lvals = PyDict_Values(labels);
-                    Py_ssize_t llen = PyList_Size(lkeys);
-                    for (Py_ssize_t i = 0; i < llen; i++) {
-                        PyObject *name = PyList_GetItem(lvals, i);
-                        if (PyUnicode_Compare(name, bp) == 0) {
-                            addr = PyLong_AsLong(PyList_GetItem(lkeys, i));
-                            found = 1;
-                            break;
-                        }
-                    }
-                    Py_XDECREF(lkeys);
-                    Py_XDECREF(lvals);
-                }
-                Py_XDECREF(functions);
-                Py_XDECREF(labels);
-                if (!found) {
-                    PyErr_Format(PyExc_ValueError, "function or label '%s' not found", s);
-                    return NULL;
-                }
+            /* XC is left unchanged when rs1 == rs2 */
+            const uint32_t *differ = lanes_nonzero(lf, lf->res);
+            for (int l = 0; l < n; l++) {
+                if (differ[l])
+                    lf->flags[l] = (uint8_t)((lf->flags[l] & ~(1u << FLAG_XC)) | lf->carry[l] << FLAG_XC);
             }
         }
-    } else {
-        PyErr_SetString(PyExc_TypeError, "breakpoint must be int or str");
-        return NULL;
+        writes = 0;
+        break;
+    }
+    default:
+        return 1;
     }
+    if (sets_flags)
+        lf->flags_valid = lf->flags_dirty = 1;
+    if (writes) {
+        lf->wdr_valid |= rd;
+        lf->wdr_dirty |= rd;
+    }
+    return 0;
+}
 
-    PyObject *addr_key = PyLong_FromLong(addr);
-    if (PyDict_Contains(self->breakpoints, addr_key)) {
-        PyDict_DelItem(self->breakpoints, addr_key);
-    } else {
-        if (addr >= 0 && addr < IMEM_DEPTH) {
-            PyObject *val = Py_BuildValue("(ii)", passes, 1);
-            PyDict_SetItem(self->breakpoints, addr_key, val);
-            Py_DECREF(val);
+/* Run the stretch from pc to limit (see block_limit()) of the lanes in lf,
+ * each op across all of them before the next; with loop set each lane
+ * then takes its innermost loop's back-edge. */
+static int lanes_block(LaneFile *lf, long limit, int loop, long long *cycles) {
+    const MicroOp *ops = lf->m[0]->ops;
+    long pc = lf->m[0]->pc;
+    uint64_t lane_ops = 0;
+    int jump = 0;
+    long jump_addr = -1;
+
+    for (long a = pc; a < limit; a++) {
+        MicroOp *op = (MicroOp *)&ops[a];
+        if (lanes_count(lf, op, a, cycles) < 0)
+            return -1;
+        int rc = lanes_kernel(lf, op);
+        if (rc < 0)
+            return -1;
+        if (!rc) {
+            lane_ops++;
+            continue;
+        }
+        uint32_t wdr;
+        int flags, acc;
+        lanes_footprint(lf, op, &wdr, &flags, &acc);
+        lanes_store(lf, wdr, flags, acc);
+        for (int l = 0; l < lf->n; l++) {
+            lf->m[l]->pc = a;
+            if (exec_native(lf->m[l], op, &jump, &jump_addr) < 0)
+                return -1;
         }
     }
-    Py_DECREF(addr_key);
-    Py_RETURN_NONE;
+    for (int l = 0; l < lf->n; l++) {
+        CMachine *m = lf->m[l];
+        m->pc = limit;
+        m->perf.blocks++;
+        m->perf.block_ops += (uint64_t)(limit - pc);
+        m->perf.lane_ops += lane_ops;
+        if (loop && block_loop_back(m, &m->loop_stack[m->loop_sp - 1]) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Whether a and b agree on everything that decides where they go next. */
+static int lanes_converged(const CMachine *a, const CMachine *b) {
+    if (a->pc != b->pc || a->ops != b->ops || a->stop_addr != b->stop_addr ||
+        a->finishFlag != b->finishFlag || a->loop_sp != b->loop_sp || a->call_sp != b->call_sp)
+        return 0;
+    for (int i = 0; i < a->loop_sp; i++) {
+        const LoopEntry *x = &a->loop_stack[i], *y = &b->loop_stack[i];
+        if (x->cnt != y->cnt || x->end_addr != y->end_addr || x->start_addr != y->start_addr)
+            return 0;
+    }
+    return !memcmp(a->call_stack, b->call_stack, (size_t)a->call_sp * sizeof(a->call_stack[0]));
 }
 
 static PyObject *
-CMachine_set_breakpoint(CMachine *self, PyObject *args) {
-    PyObject *bp;
-    int passes = 1;
-    int msg = 0;
-    if (!PyArg_ParseTuple(args, "O|ip", &bp, &passes, &msg))
+CMachine_run_lanes(PyObject *Py_UNUSED(cls), PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"machines", "max_steps", "release_gil", NULL};
+    PyObject *machines_obj;
+    PyObject *max_steps_obj = Py_None;
+    int release_gil = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Op", kwlist, &machines_obj,
+                                      &max_steps_obj, &release_gil))
         return NULL;
 
-    /* Simplified: just resolve to addr and set */
-    long addr;
-    if (PyLong_Check(bp)) {
-        addr = PyLong_AsLong(bp);
-    } else {
-        const char *s = PyUnicode_AsUTF8(bp);
-        char *endp;
-        addr = strtol(s, &endp, 0);
-        if (*endp != '\0') {
-            /* Label resolution - delegate to toggle logic concepts */
-            /* For simplicity, just set numeric for now */
-            PyErr_SetString(PyExc_ValueError, "Label breakpoints: use toggle_breakpoint");
+    long long max_steps = -1;
+    if (max_steps_obj != Py_None) {
+        max_steps = PyLong_AsLongLong(max_steps_obj);
+        if (max_steps == -1 && PyErr_Occurred())
+            return NULL;
+        if (max_steps < 0) {
+            PyErr_SetString(PyExc_ValueError, "max_steps must be non-negative");
             return NULL;
         }
     }
 
-    if (addr >= 0 && addr < IMEM_DEPTH) {
-        PyObject *addr_key = PyLong_FromLong(addr);
-        PyObject *val = Py_BuildValue("(ii)", passes, 1);
-        PyDict_SetItem(self->breakpoints, addr_key, val);
-        Py_DECREF(val);
-        Py_DECREF(addr_key);
+    PyObject *fast = PySequence_Fast(machines_obj, "machines must be a sequence");
+    if (!fast) return NULL;
+    Py_ssize_t n_lanes = PySequence_Fast_GET_SIZE(fast);
+    if (n_lanes > INT_MAX) {
+        Py_DECREF(fast);
+        PyErr_SetString(PyExc_OverflowError, "too many machines");
+        return NULL;
     }
-    Py_RETURN_NONE;
-}
-
-/* ------------------------------------------------------------------ */
-/* step() - core simulation step                                       */
-/* ------------------------------------------------------------------ */
-static PyObject *
-CMachine_step(CMachine *self, PyObject *Py_UNUSED(args)) {
-    int halt = 0;
-
-    if (self->pc == self->stop_addr)
-        halt = 1;
-    if (self->finishFlag)
-        halt = 1;
-
-    /* Check breakpoints */
-    int is_break = 0;
-    long passes = 0;
-
-    /* Force break check */
-    if (self->fb_active) {
-        if (self->fb_consider_loopstack && self->loop_sp == self->fb_loopstack) {
-            is_break = 1;
-            self->fb_active = 0;
-        } else if (self->fb_consider_callstack && self->call_sp == self->fb_callstack) {
-            is_break = 1;
-            self->fb_active = 0;
-        } else if (!self->fb_consider_callstack && !self->fb_consider_loopstack) {
-            is_break = 1;
-            self->fb_active = 0;
-        }
+    size_t alloc = n_lanes ? (size_t)n_lanes : 1;
+    CMachine **lanes = PyMem_Calloc(alloc, sizeof(*lanes));
+    int *group = PyMem_Calloc(alloc, sizeof(*group));
+    long long *insts = PyMem_Calloc(alloc, sizeof(*insts));
+    long long *cycles = PyMem_Calloc(alloc, sizeof(*cycles));
+    const char **reasons = PyMem_Calloc(alloc, sizeof(*reasons));
+    LaneFile lf;
+    int lf_ready = 0, running = 0;
+    PyObject *result = NULL;
+    PyThreadState *released = NULL;
+    memset(&lf, 0, sizeof(lf));
+    if (!lanes || !group || !insts || !cycles || !reasons) {
+        PyErr_NoMemory();
+        goto done;
     }
 
-    /* Regular breakpoint check */
-    if (!is_break && PyDict_Size(self->breakpoints) > 0) {
-        PyObject *pc_key = PyLong_FromLong(self->pc);
-        PyObject *bp_val = PyDict_GetItem(self->breakpoints, pc_key);
-        if (bp_val) {
-            long bp_passes = PyLong_AsLong(PyTuple_GetItem(bp_val, 0));
-            long bp_cnt = PyLong_AsLong(PyTuple_GetItem(bp_val, 1));
-            if (bp_cnt == bp_passes) {
-                is_break = 1;
-                passes = bp_passes;
-                PyObject *new_val = Py_BuildValue("(ll)", bp_passes, (long)1);
-                PyDict_SetItem(self->breakpoints, pc_key, new_val);
-                Py_DECREF(new_val);
-            } else {
-                PyObject *new_val = Py_BuildValue("(ll)", bp_passes, bp_cnt + 1);
-                PyDict_SetItem(self->breakpoints, pc_key, new_val);
-                Py_DECREF(new_val);
+    Py_ssize_t max_ops = 0;
+    for (Py_ssize_t l = 0; l < n_lanes; l++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(fast, l);
+        if (!PyObject_TypeCheck(item, &CMachineType)) {
+            PyErr_Format(PyExc_TypeError, "machines[%zd] is not a CMachine of this build", l);
+            goto done;
+        }
+        CMachine *m = (CMachine *)item;
+        if (machine_idle_check(m) < 0)
+            goto done;
+        if (m->n_breakpoints || m->fb_active || m->n_watch || m->trace_active) {
+            PyErr_Format(PyExc_ValueError,
+                         "run_lanes() needs machines without breakpoints, watchpoints "
+                         "or trace (machines[%zd])", l);
+            goto done;
+        }
+        for (Py_ssize_t k = 0; k < l; k++) {
+            if (lanes[k] == m) {
+                PyErr_Format(PyExc_ValueError, "machines[%zd] is machines[%zd]", l, k);
+                goto done;
             }
         }
-        Py_DECREF(pc_key);
+        lanes[l] = m;
+        if (m->n_ops > max_ops)
+            max_ops = m->n_ops;
     }
-
-    /* Handle breakpoint (call back into Python debugger) */
-    if (is_break) {
-        /* Use Python-level break handling - call print_asm and input loop */
-        /* We'll emit a simple message and let the Python wrapper handle interactive debug */
-        if (passes) {
-            PySys_WriteStdout("Breakpoint hit at address %ld at pass %ld.\n", self->pc, passes);
-        } else {
-            PySys_WriteStdout("Breakpoint hit at address %ld.\n", self->pc);
+    if (lanes_file_init(&lf, (int)n_lanes, max_ops) < 0)
+        goto done;
+    lf_ready = 1;
+
+    /* Counted for patch() like run() does */
+    for (Py_ssize_t l = 0; l < n_lanes; l++) {
+        CMachine *m = lanes[l];
+        if (release_gil && m->program) {
+            Py_INCREF(m->program);
+            ((ProgramObject *)m->program)->running++;
         }
-        /* For non-interactive: just continue */
+        m->running = 1;
+        m->break_resume = 0;
+        m->watch_kind = WATCH_NONE;
+        if (max_steps == 0)
+            reasons[l] = "max_steps";
     }
+    running = 1;
+
+    /* Each lane's run_ns gets the whole lockstep run */
+    uint64_t start = perf_now();
+    long long since_check = 0;
+    for (;;) {
+        /* The lane behind all others leads the next group */
+        int lead = -1;
+        for (int l = 0; l < (int)n_lanes; l++) {
+            if (!reasons[l] && (lead < 0 || insts[l] < insts[lead]))
+                lead = l;
+        }
+        if (lead < 0)
+            break;
+        CMachine *lm = lanes[lead];
+        int n = 0;
+        long long budget = 0x1000;
+        group[n++] = lead;
+        for (int l = 0; l < (int)n_lanes; l++) {
+            if (l != lead && !reasons[l] && lanes_converged(lm, lanes[l]))
+                group[n++] = l;
+        }
+        if (max_steps >= 0) {
+            for (int i = 0; i < n; i++) {
+                if (max_steps - insts[group[i]] < budget)
+                    budget = max_steps - insts[group[i]];
+            }
+        }
 
-    /* Execute instruction */
-    PyObject *instr = PyList_GetItem(self->imem, self->pc);
-    if (!instr) return NULL;
-
-    /* stat_record_instr */
-    PyObject *sr_args = Py_BuildValue("(O)", instr);
-    PyObject *sr_result = CMachine_stat_record_instr(self, sr_args);
-    Py_DECREF(sr_args);
-    if (!sr_result) {
-        PyErr_Clear();  /* Non-fatal */
-    } else {
-        Py_DECREF(sr_result);
-    }
+        if (release_gil && !released)
+            released = PyEval_SaveThread();
 
-    /* Get cycles */
-    PyObject *cycles = PyObject_CallMethod(instr, "get_cycles", NULL);
-    if (!cycles) return NULL;
+        if (!lanes_file_holds(&lf, group, n > 1 ? n : 0)) {
+            if (lanes_file_release(&lf, cycles) < 0)
+                goto done;
+            if (n > 1)
+                lanes_file_bind(&lf, lanes, group, n);
+        }
 
-    /* Execute: trace_str, jump_addr = instr.execute(self) */
-    PyObject *self_obj = (PyObject *)self;
-    PyObject *exec_result = PyObject_CallMethod(instr, "execute", "O", self_obj);
-    if (!exec_result) return NULL;
+        long long ran;
+        if (n == 1) {
+            ran = run_block(lm, budget, !released, &cycles[lead]);
+            if (ran < 0) goto done;
+        } else {
+            LoopEntry *loop;
+            long pc = lm->pc;
+            long limit = block_limit(lm, budget, 1, !released, &loop);
+            ran = limit > pc ? limit - pc : 0;
+            if (ran && lanes_block(&lf, limit, loop != NULL, cycles) < 0)
+                goto done;
+        }
 
-    PyObject *trace_str = PyTuple_GetItem(exec_result, 0);
-    PyObject *jump_addr_obj = PyTuple_GetItem(exec_result, 1);
+        if (!ran) {
+            /* Control and Python-backed ops, and everything else advance_pc()
+             * decides on, one lane at a time on the machines */
+            if (n > 1) {
+                uint32_t wdr = 0xFFFFFFFFu;
+                int flags = 1, acc = 1;
+                if (lm->pc >= 0 && lm->pc < lm->n_ops)
+                    lanes_footprint(&lf, &lm->ops[lm->pc], &wdr, &flags, &acc);
+                lanes_store(&lf, wdr, flags, acc);
+                if (lanes_flush_counts(&lf, cycles) < 0)
+                    goto done;
+            }
+            ran = 1;
+            for (int i = 0; i < n; i++) {
+                CMachine *m = lanes[group[i]];
+                long c = 0;
+                const char *halt = NULL;
+                MicroOp *op = released ? released_op(m) : NULL;
+                int cont;
+                if (op) {
+                    cont = exec_released(m, op, &c, &halt);
+                } else {
+                    if (released) {
+                        PyEval_RestoreThread(released);
+                        released = NULL;
+                    }
+                    cont = exec_current(m, NULL, &c, &halt);
+                }
+                if (cont < 0) goto done;
+                cycles[group[i]] += c;
+                if (!cont)
+                    reasons[group[i]] = halt;
+            }
+        }
 
-    /* Loop stack handling */
-    if (self->loop_sp > 0 && self->pc == self->loop_stack[self->loop_sp - 1].end_addr) {
-        if (self->loop_stack[self->loop_sp - 1].cnt > 0) {
-            self->loop_stack[self->loop_sp - 1].cnt--;
-            /* jump to loop start */
-            jump_addr_obj = PyLong_FromLong(self->loop_stack[self->loop_sp - 1].start_addr);
-        } else {
-            self->loop_sp--;
-            /* continue without jump - jump_addr_obj stays None */
+        for (int i = 0; i < n; i++) {
+            int l = group[i];
+            insts[l] += ran;
+            if (!reasons[l] && max_steps >= 0 && insts[l] >= max_steps)
+                reasons[l] = "max_steps";
+        }
+        since_check += ran * n;
+        if (since_check >= 0x1000) {
+            since_check = 0;
+            if (released) {
+                PyEval_RestoreThread(released);
+                released = NULL;
+            }
+            if (PyErr_CheckSignals() < 0)
+                goto done;
+        }
+    }
+    if (lanes_file_release(&lf, cycles) < 0)
+        goto done;
+    if (released) {
+        PyEval_RestoreThread(released);
+        released = NULL;
+    }
+    uint64_t elapsed = perf_now() - start;
+    for (Py_ssize_t l = 0; l < n_lanes; l++)
+        lanes[l]->perf.run_ns += elapsed;
+
+    result = PyList_New(n_lanes);
+    if (!result) goto done;
+    for (Py_ssize_t l = 0; l < n_lanes; l++) {
+        PyObject *item = Py_BuildValue("(LLs)", insts[l], cycles[l], reasons[l]);
+        if (!item) {
+            Py_CLEAR(result);
+            goto done;
         }
+        PyList_SET_ITEM(result, l, item);
     }
 
-    int cont = 1;
-    if (jump_addr_obj != Py_None && jump_addr_obj != NULL) {
-        long jump_addr = PyLong_AsLong(jump_addr_obj);
-        if (jump_addr < 0 || jump_addr >= PyList_Size(self->imem)) {
-            Py_DECREF(exec_result);
-            Py_DECREF(cycles);
-            PyErr_SetString(PyExc_RuntimeError, "Invalid jump address");
-            return NULL;
+done:
+    /* On errors too, the lanes get their registers and counts back */
+    if (lf_ready && lf.n) {
+        PyObject *type, *value, *tb;
+        if (released) {
+            PyEval_RestoreThread(released);
+            released = NULL;
         }
-        self->pc = jump_addr;
-    } else {
-        if (self->pc + 1 >= PyList_Size(self->imem)) {
-            cont = 0;
-        } else {
-            self->pc++;
+        PyErr_Fetch(&type, &value, &tb);
+        if (lanes_file_release(&lf, cycles) < 0)
+            PyErr_Clear();
+        PyErr_Restore(type, value, tb);
+    }
+    if (released)
+        PyEval_RestoreThread(released);
+    if (running) {
+        for (Py_ssize_t l = 0; l < n_lanes; l++) {
+            CMachine *m = lanes[l];
+            m->running = 0;
+            if (release_gil && m->program) {
+                ((ProgramObject *)m->program)->running--;
+                Py_DECREF(m->program);
+            }
         }
     }
-
-    if (halt)
-        cont = 0;
-
-    Py_INCREF(trace_str);
-    Py_INCREF(cycles);
-    Py_DECREF(exec_result);
-
-    PyObject *result = Py_BuildValue("(NNN)",
-                                      PyBool_FromLong(cont),
-                                      trace_str,
-                                      cycles);
+    if (lf_ready)
+        lanes_file_free(&lf);
+    PyMem_Free(lanes);
+    PyMem_Free(group);
+    PyMem_Free(insts);
+    PyMem_Free(cycles);
+    PyMem_Free(reasons);
+    Py_DECREF(fast);
     return result;
 }
 
@@ -1854,6 +6984,8 @@ CMachine_set_ctx(CMachine *self, PyObject *value, void *closure) {
 static PyObject *
 CMachine_get_stats_py(CMachine *self, void *closure) {
     (void)closure;
+    if (stats_flush(self) < 0)
+        return NULL;
     Py_INCREF(self->stats);
     return self->stats;
 }
@@ -1861,6 +6993,13 @@ CMachine_get_stats_py(CMachine *self, void *closure) {
 static int
 CMachine_set_stats_py(CMachine *self, PyObject *value, void *closure) {
     (void)closure;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError, "cannot delete stats");
+        return -1;
+    }
+    /* What was recorded so far belongs to the old dict */
+    if (stats_flush(self) < 0)
+        return -1;
     Py_INCREF(value);
     Py_XDECREF(self->stats);
     self->stats = value;
@@ -1894,27 +7033,40 @@ CMachine_set_stop_addr_prop(CMachine *self, PyObject *value, void *closure) {
 }
 
 /* Properties for mod/dmp/rfp/lc/rnd/acc as direct Python attribute access */
-static PyObject *CMachine_get_mod(CMachine *self, void *c) { (void)c; Py_INCREF(self->mod); return self->mod; }
-static int CMachine_set_mod(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->mod); self->mod = v; return 0; }
-static PyObject *CMachine_get_dmp_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->dmp); return self->dmp; }
-static int CMachine_set_dmp_prop(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->dmp); self->dmp = v; return 0; }
-static PyObject *CMachine_get_rfp_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->rfp); return self->rfp; }
-static int CMachine_set_rfp_prop(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->rfp); self->rfp = v; return 0; }
-static PyObject *CMachine_get_lc_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->lc); return self->lc; }
-static int CMachine_set_lc_prop(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->lc); self->lc = v; return 0; }
-static PyObject *CMachine_get_rnd_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->rnd); return self->rnd; }
-static int CMachine_set_rnd_prop(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->rnd); self->rnd = v; return 0; }
-static PyObject *CMachine_get_acc_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->acc); return self->acc; }
-static int CMachine_set_acc_prop(CMachine *self, PyObject *v, void *c) { (void)c; Py_INCREF(v); Py_DECREF(self->acc); self->acc = v; return 0; }
+static int set_wide_prop(uint32_t *limbs, int n, PyObject *v, const char *msg) {
+    if (!v) {
+        PyErr_SetString(PyExc_AttributeError, "cannot delete register attribute");
+        return -1;
+    }
+    return pylong_to_limbs(v, limbs, n, msg);
+}
+
+static PyObject *CMachine_get_mod(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->mod, LIMBS); }
+static int CMachine_set_mod(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->mod, LIMBS, v, "register value out of range"); }
+static PyObject *CMachine_get_dmp_prop(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->dmp, LIMBS); }
+static int CMachine_set_dmp_prop(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->dmp, LIMBS, v, "register value out of range"); }
+static PyObject *CMachine_get_rfp_prop(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->rfp, LIMBS); }
+static int CMachine_set_rfp_prop(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->rfp, LIMBS, v, "register value out of range"); }
+static PyObject *CMachine_get_lc_prop(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->lc, LIMBS); }
+static int CMachine_set_lc_prop(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->lc, LIMBS, v, "register value out of range"); }
+static PyObject *CMachine_get_rnd_prop(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->rnd, LIMBS); }
+static int CMachine_set_rnd_prop(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->rnd, LIMBS, v, "register value out of range"); }
+static PyObject *CMachine_get_acc_prop(CMachine *self, void *c) { (void)c; return machine_pylong(self, self->acc, ACC_LIMBS); }
+static int CMachine_set_acc_prop(CMachine *self, PyObject *v, void *c) { (void)c; return set_wide_prop(self->acc, ACC_LIMBS, v, "accumulator value out of range"); }
 
 /* r[] access */
 static PyObject *CMachine_get_r(CMachine *self, void *c) {
     (void)c;
-    /* Return list of all wide registers */
+    /* Return list of all wide registers (a snapshot, not a live view) */
     PyObject *lst = PyList_New(NUM_REGS);
+    if (!lst) return NULL;
     for (int i = 0; i < NUM_REGS; i++) {
-        Py_INCREF(self->r[i]);
-        PyList_SET_ITEM(lst, i, self->r[i]);
+        PyObject *v = machine_pylong(self, self->r[i], LIMBS);
+        if (!v) {
+            Py_DECREF(lst);
+            return NULL;
+        }
+        PyList_SET_ITEM(lst, i, v);
     }
     return lst;
 }
@@ -1929,32 +7081,46 @@ static PyObject *CMachine_get_gpr_arr(CMachine *self, void *c) {
     return lst;
 }
 
-/* dmem access */
-static PyObject *CMachine_get_dmem_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->dmem); return self->dmem; }
+/* dmem access: reads build a fresh list, writes copy the values in */
+static PyObject *CMachine_get_dmem_prop(CMachine *self, void *c) { (void)c; return dmem_to_list(self); }
 static int CMachine_set_dmem_prop(CMachine *self, PyObject *value, void *c) {
     (void)c;
-    if (!PyList_Check(value)) {
-        PyErr_SetString(PyExc_TypeError, "dmem must be a list");
+    if (!value || !(PyList_Check(value) || PyObject_CheckBuffer(value))) {
+        PyErr_SetString(PyExc_TypeError, "dmem must be a list or a bytes-like image");
         return -1;
     }
-    Py_INCREF(value);
-    Py_DECREF(self->dmem);
-    self->dmem = value;
-    /* Also rebuild init_dmem to match the new size, marking all as True
-     * since the caller is providing pre-initialized data. */
-    Py_ssize_t sz = PyList_Size(value);
-    PyObject *new_init = PyList_New(sz);
-    Py_ssize_t i;
-    for (i = 0; i < sz; ++i) {
-        Py_INCREF(Py_True);
-        PyList_SET_ITEM(new_init, i, Py_True);
-    }
-    Py_DECREF(self->init_dmem);
-    self->init_dmem = new_init;
-    return 0;
+    if (machine_idle_check(self) < 0)
+        return -1;
+    /* The caller is providing pre-initialized data, so every cell it
+     * covers is marked initialized. */
+    return load_dmem(self, value);
+}
+static PyObject *CMachine_get_imem_prop(CMachine *self, void *c) {
+    (void)c;
+    if (self->program)
+        return program_instructions((ProgramObject *)self->program);
+    Py_INCREF(self->imem);
+    return self->imem;
+}
+static PyObject *CMachine_get_program(CMachine *self, void *c) {
+    (void)c;
+    PyObject *prog = self->program ? self->program : Py_None;
+    Py_INCREF(prog);
+    return prog;
+}
+static PyObject *CMachine_get_dmem_view(CMachine *self, void *c) {
+    (void)c;
+    return PyMemoryView_FromObject((PyObject *)self);
+}
+
+static PyObject *CMachine_get_init_dmem_prop(CMachine *self, void *c) {
+    (void)c;
+    PyObject *lst = PyList_New(DMEM_DEPTH);
+    if (!lst) return NULL;
+    for (Py_ssize_t i = 0; i < DMEM_DEPTH; i++)
+        PyList_SET_ITEM(lst, i, PyBool_FromLong(self->init_dmem[i]));
+    return lst;
 }
-static PyObject *CMachine_get_imem_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->imem); return self->imem; }
-static PyObject *CMachine_get_init_dmem_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->init_dmem); return self->init_dmem; }
 
 /* Constant class attrs */
 static PyObject *CMachine_get_XLEN(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(XLEN); }
@@ -1973,39 +7139,37 @@ static PyObject *CMachine_get_CSR_RNG(CMachine *self, void *c) { (void)self; (vo
 static PyObject *CMachine_get_WSR_MOD(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(WSR_MOD); }
 static PyObject *CMachine_get_WSR_RND(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(WSR_RND); }
 static PyObject *CMachine_get_DEFAULT_DUMP_FILENAME(CMachine *self, void *c) { (void)self; (void)c; return PyUnicode_FromString("dmem_dump.hex"); }
-static PyObject *CMachine_get_xlen_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->xlen_mask); return self->xlen_mask; }
-static PyObject *CMachine_get_limb_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->limb_mask); return self->limb_mask; }
-static PyObject *CMachine_get_half_limb_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->half_limb_mask); return self->half_limb_mask; }
-static PyObject *CMachine_get_hw_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->hw_mask); return self->hw_mask; }
-static PyObject *CMachine_get_qw_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->qw_mask); return self->qw_mask; }
-static PyObject *CMachine_get_gpr_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(self->gpr_mask); return self->gpr_mask; }
+static PyObject *CMachine_get_xlen_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(xlen_mask); return xlen_mask; }
+static PyObject *CMachine_get_limb_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(limb_mask); return limb_mask; }
+static PyObject *CMachine_get_half_limb_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(half_limb_mask); return half_limb_mask; }
+static PyObject *CMachine_get_hw_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(hw_mask); return hw_mask; }
+static PyObject *CMachine_get_qw_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(qw_mask); return qw_mask; }
+static PyObject *CMachine_get_gpr_mask_prop(CMachine *self, void *c) { (void)c; Py_INCREF(gpr_mask); return gpr_mask; }
 static PyObject *CMachine_get_limb_width_prop(CMachine *self, void *c) { (void)c; return PyLong_FromLong(self->limb_width); }
 static PyObject *CMachine_get_half_limb_width_prop(CMachine *self, void *c) { (void)c; return PyLong_FromLong(self->half_limb_width); }
 static PyObject *CMachine_get_qw_width_prop(CMachine *self, void *c) { (void)c; return PyLong_FromLong(self->qw_width); }
 static PyObject *CMachine_get_hw_width_prop(CMachine *self, void *c) { (void)c; return PyLong_FromLong(self->hw_width); }
-static PyObject *CMachine_get_half_xlen_mask(CMachine *self, void *c) { (void)c; Py_INCREF(self->hw_mask); return self->hw_mask; }
+static PyObject *CMachine_get_half_xlen_mask(CMachine *self, void *c) { (void)c; Py_INCREF(hw_mask); return hw_mask; }
 static PyObject *CMachine_get_reg_idx_width(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(5); }
 static PyObject *CMachine_get_reg_idx_mask(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(31); }
-static PyObject *CMachine_get_dmem_idx_width(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(7); }
-static PyObject *CMachine_get_dmem_idx_mask(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(127); }
+static PyObject *CMachine_get_dmem_idx_width(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(ctz64(DMEM_DEPTH)); }
+static PyObject *CMachine_get_dmem_idx_mask(CMachine *self, void *c) { (void)self; (void)c; return PyLong_FromLong(DMEM_DEPTH - 1); }
 
 /* Flag direct properties (for direct .M, .L, .Z, .C, .XM, .XL, .XZ, .XC access) */
-static PyObject *CMachine_get_M(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->M); }
-static int CMachine_set_M(CMachine *s, PyObject *v, void *c) { (void)c; s->M = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_L(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->L); }
-static int CMachine_set_L(CMachine *s, PyObject *v, void *c) { (void)c; s->L = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_Z(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->Z); }
-static int CMachine_set_Z(CMachine *s, PyObject *v, void *c) { (void)c; s->Z = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_C_flag(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->C); }
-static int CMachine_set_C_flag(CMachine *s, PyObject *v, void *c) { (void)c; s->C = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_XM(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->XM); }
-static int CMachine_set_XM(CMachine *s, PyObject *v, void *c) { (void)c; s->XM = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_XL(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->XL); }
-static int CMachine_set_XL(CMachine *s, PyObject *v, void *c) { (void)c; s->XL = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_XZ(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->XZ); }
-static int CMachine_set_XZ(CMachine *s, PyObject *v, void *c) { (void)c; s->XZ = PyObject_IsTrue(v); return 0; }
-static PyObject *CMachine_get_XC(CMachine *s, void *c) { (void)c; return PyBool_FromLong(s->XC); }
-static int CMachine_set_XC(CMachine *s, PyObject *v, void *c) { (void)c; s->XC = PyObject_IsTrue(v); return 0; }
+/* Flag properties; the closure is the flag's bit */
+static PyObject *CMachine_get_flag_prop(CMachine *s, void *c) {
+    return PyBool_FromLong(flag_get(s, (int)(intptr_t)c));
+}
+static int CMachine_set_flag_prop(CMachine *s, PyObject *v, void *c) {
+    int val = v ? PyObject_IsTrue(v) : -1;
+    if (val < 0) {
+        if (!v)
+            PyErr_SetString(PyExc_AttributeError, "cannot delete a flag");
+        return -1;
+    }
+    flag_put(s, (int)(intptr_t)c, val);
+    return 0;
+}
 
 /* force_break as tuple property */
 static PyObject *CMachine_get_force_break(CMachine *s, void *c) {
@@ -2041,6 +7205,7 @@ static PyMethodDef CMachine_methods[] = {
     {"get_reg_qw", (PyCFunction)CMachine_get_reg_qw, METH_VARARGS, NULL},
     {"set_reg_half_word", (PyCFunction)CMachine_set_reg_half_word, METH_VARARGS, NULL},
     {"get_reg_valid_half_limbs", (PyCFunction)CMachine_get_reg_valid_half_limbs, METH_VARARGS, NULL},
+    {"get_reg_valid_half_limb_mask", (PyCFunction)CMachine_get_reg_valid_half_limb_mask, METH_VARARGS, NULL},
     {"set_gpr", (PyCFunction)CMachine_set_gpr, METH_VARARGS, NULL},
     {"get_gpr", (PyCFunction)CMachine_get_gpr, METH_VARARGS, NULL},
     {"inc_gpr", (PyCFunction)CMachine_inc_gpr, METH_VARARGS, NULL},
@@ -2069,6 +7234,8 @@ static PyMethodDef CMachine_methods[] = {
     {"get_dmem", (PyCFunction)CMachine_get_dmem, METH_VARARGS, NULL},
     {"set_dmem", (PyCFunction)CMachine_set_dmem, METH_VARARGS, NULL},
     {"get_dmem_otbn", (PyCFunction)CMachine_get_dmem_otbn, METH_VARARGS, NULL},
+    {"get_dmem_bytes", (PyCFunction)CMachine_get_dmem_bytes, METH_VARARGS, NULL},
+    {"set_dmem_bytes", (PyCFunction)CMachine_set_dmem_bytes, METH_VARARGS, NULL},
     {"set_dmem_otbn", (PyCFunction)CMachine_set_dmem_otbn, METH_VARARGS, NULL},
     {"push_loop_stack", (PyCFunction)CMachine_push_loop_stack, METH_VARARGS, NULL},
     {"dec_top_loop_cnt", (PyCFunction)CMachine_dec_top_loop_cnt, METH_NOARGS, NULL},
@@ -2081,14 +7248,40 @@ static PyMethodDef CMachine_methods[] = {
     {"finish", (PyCFunction)CMachine_finish, METH_VARARGS | METH_KEYWORDS, NULL},
     {"clear_regs", (PyCFunction)CMachine_clear_regs, METH_NOARGS, NULL},
     {"reset", (PyCFunction)CMachine_reset, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"snapshot", (PyCFunction)CMachine_snapshot, METH_NOARGS, NULL},
+    {"restore", (PyCFunction)CMachine_restore, METH_VARARGS, NULL},
+    {"fork", (PyCFunction)CMachine_fork, METH_NOARGS, NULL},
+    {"state_bytes", (PyCFunction)CMachine_state_bytes, METH_NOARGS, NULL},
+    {"get_decoded_op", (PyCFunction)CMachine_get_decoded_op, METH_VARARGS, NULL},
     {"step", (PyCFunction)CMachine_step, METH_NOARGS, NULL},
+    {"run", (PyCFunction)CMachine_run, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"run_lanes", (PyCFunction)CMachine_run_lanes, METH_VARARGS | METH_KEYWORDS | METH_STATIC, NULL},
     {"get_limb_hex_str", (PyCFunction)CMachine_get_limb_hex_str, METH_VARARGS, NULL},
     {"get_xlen_hex_str", (PyCFunction)CMachine_get_xlen_hex_str, METH_VARARGS, NULL},
     {"get_full_dmem", (PyCFunction)CMachine_get_full_dmem, METH_NOARGS, NULL},
-    {"stat_record_instr", (PyCFunction)CMachine_stat_record_instr, METH_VARARGS, NULL},
+    {"stat_record_func_call", (PyCFunction)CMachine_stat_record_func_call, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stat_record_loop", (PyCFunction)CMachine_stat_record_loop, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stat_record_movi", (PyCFunction)CMachine_stat_record_movi, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stat_record_wide_mem_op", (PyCFunction)CMachine_stat_record_wide_mem_op, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stat_record_flag_access", (PyCFunction)CMachine_stat_record_flag_access, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"get_func_addr_for_pc", (PyCFunction)CMachine_get_func_addr_for_pc, METH_VARARGS, NULL},
+    {"get_opcode_counts", (PyCFunction)CMachine_get_opcode_counts, METH_NOARGS, NULL},
+    {"get_exec_counts", (PyCFunction)CMachine_get_exec_counts, METH_NOARGS, NULL},
+    {"get_cycle_counts", (PyCFunction)CMachine_get_cycle_counts, METH_NOARGS, NULL},
+    {"perf_counters", (PyCFunction)CMachine_perf_counters, METH_NOARGS, NULL},
+    {"reset_perf_counters", (PyCFunction)CMachine_reset_perf_counters, METH_NOARGS, NULL},
+    {"enable_profile", (PyCFunction)CMachine_enable_profile, METH_NOARGS, NULL},
+    {"disable_profile", (PyCFunction)CMachine_disable_profile, METH_NOARGS, NULL},
+    {"get_profile", (PyCFunction)CMachine_get_profile, METH_NOARGS, NULL},
+    {"enable_trace", (PyCFunction)CMachine_enable_trace, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"disable_trace", (PyCFunction)CMachine_disable_trace, METH_NOARGS, NULL},
+    {"get_trace", (PyCFunction)CMachine_get_trace, METH_NOARGS, NULL},
     {"get_breakpoints", (PyCFunction)CMachine_get_breakpoints, METH_NOARGS, NULL},
     {"toggle_breakpoint", (PyCFunction)CMachine_toggle_breakpoint, METH_VARARGS, NULL},
     {"set_breakpoint", (PyCFunction)CMachine_set_breakpoint, METH_VARARGS, NULL},
+    {"set_watchpoint", (PyCFunction)CMachine_set_watchpoint, METH_VARARGS, NULL},
+    {"clear_watchpoint", (PyCFunction)CMachine_clear_watchpoint, METH_VARARGS, NULL},
+    {"clear_watchpoints", (PyCFunction)CMachine_clear_watchpoints, METH_NOARGS, NULL},
     {NULL, NULL, 0, NULL},
 };
 
@@ -2113,8 +7306,13 @@ static PyGetSetDef CMachine_getset[] = {
     {"gpr", (getter)CMachine_get_gpr_arr, NULL, NULL, NULL},
     {"dmem", (getter)CMachine_get_dmem_prop, (setter)CMachine_set_dmem_prop, NULL, NULL},
     {"imem", (getter)CMachine_get_imem_prop, NULL, NULL, NULL},
+    {"program", (getter)CMachine_get_program, NULL, NULL, NULL},
+    {"timing_model", (getter)CMachine_get_timing_model, (setter)CMachine_set_timing_model, NULL, NULL},
+    {"dmem_view", (getter)CMachine_get_dmem_view, NULL, NULL, NULL},
     {"init_dmem", (getter)CMachine_get_init_dmem_prop, NULL, NULL, NULL},
-    {"breakpoints", (getter)CMachine_get_breakpoints, NULL, NULL, NULL},
+    {"breakpoints", (getter)CMachine_get_breakpoints, (setter)CMachine_set_breakpoints, NULL, NULL},
+    {"watchpoints", (getter)CMachine_get_watchpoints, NULL, NULL, NULL},
+    {"watch_hit", (getter)CMachine_get_watch_hit, NULL, NULL, NULL},
     /* Constants */
     {"XLEN", (getter)CMachine_get_XLEN, NULL, NULL, NULL},
     {"LIMBS", (getter)CMachine_get_LIMBS, NULL, NULL, NULL},
@@ -2148,14 +7346,14 @@ static PyGetSetDef CMachine_getset[] = {
     {"dmem_idx_width", (getter)CMachine_get_dmem_idx_width, NULL, NULL, NULL},
     {"dmem_idx_mask", (getter)CMachine_get_dmem_idx_mask, NULL, NULL, NULL},
     /* Flags as direct properties */
-    {"M", (getter)CMachine_get_M, (setter)CMachine_set_M, NULL, NULL},
-    {"L", (getter)CMachine_get_L, (setter)CMachine_set_L, NULL, NULL},
-    {"Z", (getter)CMachine_get_Z, (setter)CMachine_set_Z, NULL, NULL},
-    {"C", (getter)CMachine_get_C_flag, (setter)CMachine_set_C_flag, NULL, NULL},
-    {"XM", (getter)CMachine_get_XM, (setter)CMachine_set_XM, NULL, NULL},
-    {"XL", (getter)CMachine_get_XL, (setter)CMachine_set_XL, NULL, NULL},
-    {"XZ", (getter)CMachine_get_XZ, (setter)CMachine_set_XZ, NULL, NULL},
-    {"XC", (getter)CMachine_get_XC, (setter)CMachine_set_XC, NULL, NULL},
+    {"M", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_M},
+    {"L", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_L},
+    {"Z", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_Z},
+    {"C", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_C},
+    {"XM", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_XM},
+    {"XL", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_XL},
+    {"XZ", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_XZ},
+    {"XC", (getter)CMachine_get_flag_prop, (setter)CMachine_set_flag_prop, NULL, (void *)FLAG_XC},
     {"force_break", (getter)CMachine_get_force_break, (setter)CMachine_set_force_break, NULL, NULL},
     {NULL, NULL, NULL, NULL, NULL},
 };
@@ -2165,7 +7363,7 @@ static PyGetSetDef CMachine_getset[] = {
 /* ------------------------------------------------------------------ */
 static PyTypeObject CMachineType = {
     .ob_base = PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_machine.CMachine",
+    .tp_name = MODULE_NAME ".CMachine",
     .tp_doc = "C implementation of the Machine class for ot_dsim.",
     .tp_basicsize = sizeof(CMachine),
     .tp_itemsize = 0,
@@ -2175,6 +7373,302 @@ static PyTypeObject CMachineType = {
     .tp_dealloc = (destructor)CMachine_dealloc,
     .tp_methods = CMachine_methods,
     .tp_getset = CMachine_getset,
+    .tp_as_buffer = &CMachine_as_buffer,
+};
+
+/* ------------------------------------------------------------------ */
+/* Machine pools                                                       */
+/* ------------------------------------------------------------------ */
+
+/* MachinePool(program, size, machine_type=CMachine): size machines
+ * running a Program, built once and then handed out by acquire() in the
+ * state machine_type(dmem, program, s_addr, stop_addr) would start in,
+ * so a driver running many short jobs pays for construction only once.
+ * The per-slot statistics counters of all of them share one arena that
+ * each machine keeps a reference to.  A pooled machine that reset() to
+ * another imem decodes into tables of its own as usual and is moved back
+ * onto the program and the arena by its next acquire().
+ *
+ * acquire() and release() hold the GIL; a machine must have stopped
+ * running before it is released. */
+typedef struct {
+    PyObject_HEAD
+    PyObject *program;
+    PyObject *arena;            /* bytearray of size * slot_len SlotCounts */
+    Py_ssize_t slot_len;        /* counters per machine */
+    Py_ssize_t size;
+    CMachine **machines;        /* size entries, then idle and in_use */
+    Py_ssize_t *idle;           /* stack of released machine indexes */
+    Py_ssize_t n_idle;
+    uint8_t *in_use;
+} MachinePoolObject;
+
+static PyTypeObject MachinePoolType;
+
+/* Point machine i's counters at its slice of the arena, reloading the
+ * program first if the machine was reset() to something else. */
+static int pool_attach(MachinePoolObject *pool, Py_ssize_t i) {
+    CMachine *m = pool->machines[i];
+    if (m->counts_arena)
+        return 0;
+    if (m->program != pool->program && load_imem(m, pool->program) < 0)
+        return -1;
+    PyMem_Free(m->counts);
+    m->counts = (SlotCounts *)PyByteArray_AS_STRING(pool->arena) + i * pool->slot_len;
+    Py_INCREF(pool->arena);
+    m->counts_arena = pool->arena;
+    return 0;
+}
+
+/* Bring machine i back to the state of a new machine on the program */
+static int pool_reset(MachinePoolObject *pool, Py_ssize_t i, PyObject *dmem, long s_addr,
+                      PyObject *stop_addr_obj) {
+    CMachine *m = pool->machines[i];
+    ProgramObject *prog = (ProgramObject *)pool->program;
+    if (pool_attach(pool, i) < 0)
+        return -1;
+    long stop_addr = m->n_ops - 1;
+    if (stop_addr_obj != Py_None) {
+        stop_addr = PyLong_AsLong(stop_addr_obj);
+        if (stop_addr == -1 && PyErr_Occurred())
+            return -1;
+    }
+
+    /* Statistics and counters start over */
+    stats_clear(m);
+    memset(m->counts, 0, (size_t)m->n_ops * sizeof(SlotCounts));
+    memset(m->opcode_counts, 0, sizeof(m->opcode_counts));
+    memset(&m->perf, 0, sizeof(m->perf));
+    if (PyDict_CheckExact(m->stats) && Py_REFCNT(m->stats) == 1) {
+        PyDict_Clear(m->stats);
+    } else {
+        PyObject *stats = PyDict_New();
+        if (!stats) return -1;
+        Py_SETREF(m->stats, stats);
+    }
+
+    if (dmem == Py_None) {
+        memset(m->dmem, 0, sizeof(m->dmem));
+        memset(m->init_dmem, 0, sizeof(m->init_dmem));
+    } else if (load_dmem(m, dmem) < 0) {
+        return -1;
+    }
+    clear_wide_regs(m);
+    memset(m->gpr, 0, sizeof(m->gpr));
+    m->flags = 0;
+    memset(m->r_valid_half_limbs, 0, sizeof(m->r_valid_half_limbs));
+    m->pc = s_addr;
+    m->stop_addr = stop_addr;
+    m->finishFlag = 0;
+    m->loop_sp = 0;
+    m->call_sp = 0;
+    m->fb_active = 0;
+    m->fb_consider_callstack = 0;
+    m->fb_callstack = 0;
+    m->fb_consider_loopstack = 0;
+    m->fb_loopstack = 0;
+    m->break_resume = 0;
+
+    Py_INCREF(prog->ctx);
+    Py_XSETREF(m->ctx, prog->ctx);
+    timing_copy(&m->timing, &prog->timing);
+    m->hz_wdr = m->hz_gpr = 0;
+    m->hz_acc = 0;
+    bp_clear_all(m);
+    memset(m->watch_dmem, 0, sizeof(m->watch_dmem));
+    m->watch_wdr = 0;
+    m->n_watch = 0;
+    m->watch_kind = WATCH_NONE;
+    trace_close(m);
+    PyMem_Free(m->trace_buf);
+    m->trace_buf = NULL;
+    m->trace_cap = 0;
+    m->trace_count = 0;
+    prof_free(m);
+    return 0;
+}
+
+static int
+MachinePool_init(MachinePoolObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"program", "size", "machine_type", NULL};
+    PyObject *program;
+    Py_ssize_t size;
+    PyObject *type = (PyObject *)&CMachineType;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "On|O", kwlist, &program, &size, &type))
+        return -1;
+    if (self->machines) {
+        PyErr_SetString(PyExc_TypeError, "MachinePool is already initialised");
+        return -1;
+    }
+    if (!Program_Check(program)) {
+        PyErr_SetString(PyExc_TypeError, "MachinePool needs a Program");
+        return -1;
+    }
+    if (!PyType_Check(type) || !PyType_IsSubtype((PyTypeObject *)type, &CMachineType)) {
+        PyErr_SetString(PyExc_TypeError, "machine_type must be a CMachine subclass");
+        return -1;
+    }
+    if (size < 1) {
+        PyErr_SetString(PyExc_ValueError, "pool size must be at least 1");
+        return -1;
+    }
+    Py_ssize_t n_ops = ((ProgramObject *)program)->n_ops;
+    Py_ssize_t slot_len = n_ops ? n_ops : 1;
+    if (slot_len > PY_SSIZE_T_MAX / size / (Py_ssize_t)sizeof(SlotCounts)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->arena = PyByteArray_FromStringAndSize(NULL, size * slot_len * (Py_ssize_t)sizeof(SlotCounts));
+    if (!self->arena)
+        return -1;
+    size_t per = sizeof(CMachine *) + sizeof(Py_ssize_t) + 1;
+    char *mem = PyMem_Calloc((size_t)size, per);
+    if (!mem) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->machines = (CMachine **)mem;
+    self->idle = (Py_ssize_t *)(mem + (size_t)size * sizeof(CMachine *));
+    self->in_use = (uint8_t *)(self->idle + size);
+    Py_INCREF(program);
+    self->program = program;
+    self->slot_len = slot_len;
+
+    PyObject *dmem = PyTuple_New(0);
+    if (!dmem) return -1;
+    for (Py_ssize_t i = 0; i < size; i++) {
+        PyObject *m = PyObject_CallFunctionObjArgs(type, dmem, program, NULL);
+        if (!m) {
+            Py_DECREF(dmem);
+            return -1;
+        }
+        if (!PyObject_TypeCheck(m, &CMachineType)) {
+            Py_DECREF(m);
+            Py_DECREF(dmem);
+            PyErr_SetString(PyExc_TypeError, "machine_type did not build a CMachine");
+            return -1;
+        }
+        self->machines[i] = (CMachine *)m;
+        self->size = i + 1;
+        if (pool_attach(self, i) < 0) {
+            Py_DECREF(dmem);
+            return -1;
+        }
+        self->idle[size - 1 - i] = i;
+    }
+    Py_DECREF(dmem);
+    self->n_idle = size;
+    return 0;
+}
+
+static void
+MachinePool_dealloc(MachinePoolObject *self) {
+    for (Py_ssize_t i = 0; i < self->size; i++)
+        Py_DECREF(self->machines[i]);
+    PyMem_Free(self->machines);
+    Py_XDECREF(self->arena);
+    Py_XDECREF(self->program);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/* acquire(dmem=None, s_addr=0, stop_addr=None) -> an idle machine, reset
+ * to run the program from s_addr with DMEM loaded from dmem (a sequence
+ * of ints or a bytes-like image; None leaves it zeroed and
+ * uninitialised).  Raises RuntimeError when every machine is in use. */
+static PyObject *
+MachinePool_acquire(MachinePoolObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"dmem", "s_addr", "stop_addr", NULL};
+    PyObject *dmem = Py_None;
+    long s_addr = 0;
+    PyObject *stop_addr_obj = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OlO", kwlist, &dmem, &s_addr, &stop_addr_obj))
+        return NULL;
+    if (!self->machines) {
+        PyErr_SetString(PyExc_ValueError, "MachinePool is not initialised");
+        return NULL;
+    }
+    if (!self->n_idle) {
+        PyErr_SetString(PyExc_RuntimeError, "all machines of the pool are in use");
+        return NULL;
+    }
+    /* The machine stays idle if it cannot be reset */
+    Py_ssize_t i = self->idle[self->n_idle - 1];
+    if (machine_idle_check(self->machines[i]) < 0 ||
+        pool_reset(self, i, dmem, s_addr, stop_addr_obj) < 0)
+        return NULL;
+    self->n_idle--;
+    self->in_use[i] = 1;
+    Py_INCREF(self->machines[i]);
+    return (PyObject *)self->machines[i];
+}
+
+/* release(machine): hand an acquired machine back; its statistics are
+ * flushed into its stats dict first, as when a machine is freed. */
+static PyObject *
+MachinePool_release(MachinePoolObject *self, PyObject *machine) {
+    Py_ssize_t i = 0;
+    while (i < self->size && (PyObject *)self->machines[i] != machine)
+        i++;
+    if (i == self->size) {
+        PyErr_SetString(PyExc_ValueError, "machine does not belong to this pool");
+        return NULL;
+    }
+    if (!self->in_use[i]) {
+        PyErr_SetString(PyExc_ValueError, "machine is not acquired");
+        return NULL;
+    }
+    if (machine_idle_check(self->machines[i]) < 0)
+        return NULL;
+    self->in_use[i] = 0;
+    self->idle[self->n_idle++] = i;
+    if (stats_flush(self->machines[i]) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static Py_ssize_t MachinePool_len(MachinePoolObject *self) { return self->size; }
+
+static PyObject *MachinePool_get_program(MachinePoolObject *self, void *c) {
+    (void)c;
+    PyObject *program = self->program ? self->program : Py_None;
+    Py_INCREF(program);
+    return program;
+}
+
+static PyObject *MachinePool_get_available(MachinePoolObject *self, void *c) {
+    (void)c;
+    return PyLong_FromSsize_t(self->n_idle);
+}
+
+static PyMethodDef MachinePool_methods[] = {
+    {"acquire", (PyCFunction)MachinePool_acquire, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"release", (PyCFunction)MachinePool_release, METH_O, NULL},
+    {NULL}
+};
+
+static PySequenceMethods MachinePool_as_sequence = {
+    .sq_length = (lenfunc)MachinePool_len,
+};
+
+static PyGetSetDef MachinePool_getset[] = {
+    {"program", (getter)MachinePool_get_program, NULL, NULL, NULL},
+    {"available", (getter)MachinePool_get_available, NULL, NULL, NULL},
+    {NULL}
+};
+
+static PyTypeObject MachinePoolType = {
+    .ob_base = PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = MODULE_NAME ".MachinePool",
+    .tp_doc = "Preconstructed machines running one Program.",
+    .tp_basicsize = sizeof(MachinePoolObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)MachinePool_init,
+    .tp_dealloc = (destructor)MachinePool_dealloc,
+    .tp_as_sequence = &MachinePool_as_sequence,
+    .tp_methods = MachinePool_methods,
+    .tp_getset = MachinePool_getset,
 };
 
 /* ------------------------------------------------------------------ */
@@ -2185,23 +7679,61 @@ static PyTypeObject CMachineType = {
 
 static struct PyModuleDef machinemodule = {
     PyModuleDef_HEAD_INIT,
-    "_machine",
+    MODULE_NAME,
     "C Machine core for ot_dsim.",
     -1,
     NULL,
 };
 
-PyMODINIT_FUNC PyInit__machine(void) {
+PyMODINIT_FUNC OT_CAT(PyInit_, OT_DSIM_MACHINE_NAME)(void) {
     PyObject *m = PyModule_Create(&machinemodule);
     if (!m) return NULL;
 
-    if (PyModule_AddIntConstant(m, "ABI_VERSION", OT_DSIM_MACHINE_ABI_VERSION) < 0) {
+    if (PyModule_AddIntConstant(m, "ABI_VERSION", OT_DSIM_MACHINE_ABI_VERSION) < 0 ||
+        PyModule_AddIntConstant(m, "XLEN", XLEN) < 0 ||
+        PyModule_AddIntConstant(m, "DMEM_DEPTH", DMEM_DEPTH) < 0 ||
+        PyModule_AddIntConstant(m, "IMEM_DEPTH", IMEM_DEPTH) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    if (PyType_Ready(&CMachineType) < 0 || PyType_Ready(&ProgramType) < 0 ||
+        PyType_Ready(&MachinePoolType) < 0 || stats_init_module() < 0 || masks_init_module() < 0) {
         Py_DECREF(m);
         return NULL;
     }
 
-    if (PyType_Ready(&CMachineType) < 0)
+#ifdef OT_DSIM_MACHINE_VARIANT
+    /* Programs and the underrun exception are shared with _machine, so
+     * one Program runs on every variant and one except clause catches
+     * all underruns. */
+    PyObject *base = PyImport_ImportModule("ot_dsim._machine");
+    PyObject *prog = base ? PyObject_GetAttrString(base, "Program") : NULL;
+    PyObject *perf = base ? PyObject_GetAttrString(base, "PerfCounters") : NULL;
+    CallStackUnderrun = base ? PyObject_GetAttrString(base, "CallStackUnderrun") : NULL;
+    Py_XDECREF(base);
+    if (!prog || !perf || !CallStackUnderrun || !PyType_Check(prog) || !PyType_Check(perf) ||
+        PyModule_AddObject(m, "Program", prog) < 0) {
+        Py_XDECREF(prog);
+        Py_XDECREF(perf);
+        Py_DECREF(m);
+        return NULL;
+    }
+    program_type = (PyTypeObject *)prog;
+    perf_counters_type = (PyTypeObject *)perf;
+    Py_INCREF(perf);
+    if (PyModule_AddObject(m, "PerfCounters", perf) < 0) {
+        Py_DECREF(perf);
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(CallStackUnderrun);
+    if (PyModule_AddObject(m, "CallStackUnderrun", CallStackUnderrun) < 0) {
+        Py_DECREF(CallStackUnderrun);
+        Py_DECREF(m);
         return NULL;
+    }
+#endif
 
     Py_INCREF(&CMachineType);
     if (PyModule_AddObject(m, "CMachine", (PyObject *)&CMachineType) < 0) {
@@ -2209,6 +7741,32 @@ PyMODINIT_FUNC PyInit__machine(void) {
         Py_DECREF(m);
         return NULL;
     }
+    Py_INCREF(&MachinePoolType);
+    if (PyModule_AddObject(m, "MachinePool", (PyObject *)&MachinePoolType) < 0) {
+        Py_DECREF(&MachinePoolType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
+#ifndef OT_DSIM_MACHINE_VARIANT
+    perf_counters_type = PyStructSequence_NewType(&perf_counters_desc);
+    if (!perf_counters_type) {
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(perf_counters_type);
+    if (PyModule_AddObject(m, "PerfCounters", (PyObject *)perf_counters_type) < 0) {
+        Py_DECREF(perf_counters_type);
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    Py_INCREF(&ProgramType);
+    if (PyModule_AddObject(m, "Program", (PyObject *)&ProgramType) < 0) {
+        Py_DECREF(&ProgramType);
+        Py_DECREF(m);
+        return NULL;
+    }
 
     /* Create CallStackUnderrun as subclass of OverflowError */
     CallStackUnderrun = PyErr_NewException("_machine.CallStackUnderrun", PyExc_OverflowError, NULL);
@@ -2218,6 +7776,7 @@ PyMODINIT_FUNC PyInit__machine(void) {
         Py_DECREF(m);
         return NULL;
     }
+#endif
 
     return m;
 }
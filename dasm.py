@@ -3,7 +3,7 @@
 # SPDX-License-Identifier: Apache-2.0
 
 import argparse
-from ot_dsim.bignum_lib.disassembler import Disassembler
+from ot_dsim.bignum_lib.disassembler import Disassembler, render_binary_trace
 
 
 def main():
@@ -26,6 +26,8 @@ def main():
     argparser.add_argument('-f', '--function-length',
                            help='include function length in function statements',
                            action='store_true')
+    argparser.add_argument('-t', '--trace',
+                           help='render a binary trace (Machine.enable_trace()) of the program instead')
     mutexgroup_addr = argparser.add_mutually_exclusive_group()
     mutexgroup_addr.add_argument('-ad', '--addresses-dec',
                                  help="Include leading decimal addresses",
@@ -67,7 +69,16 @@ def main():
                 exit()
 
     dasm = Disassembler.from_hex_file_lines(ins_lines, label_lines, args.bitmaps)
-    outlines = dasm.create_assembly(address, address_format, args.function_length, args.code, args.defines)
+    if args.trace:
+        try:
+            with open(args.trace, 'rb') as tracefile:
+                trace = tracefile.read()
+        except IOError:
+            print('Could not open file ' + args.trace)
+            exit()
+        outlines = render_binary_trace(trace, dasm.get_instruction_objects())
+    else:
+        outlines = dasm.create_assembly(address, address_format, args.function_length, args.code, args.defines)
 
     if args.output_file:
         outfile = open(args.output_file, 'w')
@@ -31,11 +31,30 @@ _machine_ext = Extension(
     extra_compile_args=extra_compile_args,
 )
 
+# 3. _machine_d<N>_i<M>: the same core specialised at compile time for
+#    larger memories (DMEM_DEPTH cells, IMEM_DEPTH instructions). Must match
+#    _C_MACHINE_VARIANTS in bignum_lib/machine.py.
+_machine_variants = [(1024, 4096)]
+_machine_variant_exts = [
+    Extension(
+        "ot_dsim._machine_d%d_i%d" % (dmem_depth, imem_depth),
+        sources=["csrc/ot_dsim_machine.c"],
+        define_macros=[
+            ("OT_DSIM_MACHINE_NAME", "_machine_d%d_i%d" % (dmem_depth, imem_depth)),
+            ("OT_DSIM_MACHINE_VARIANT", "1"),
+            ("DMEM_DEPTH", str(dmem_depth)),
+            ("IMEM_DEPTH", str(imem_depth)),
+        ],
+        extra_compile_args=extra_compile_args,
+    )
+    for dmem_depth, imem_depth in _machine_variants
+]
+
 # Allow building without the C extensions (pure-Python fallback) by setting
 # the environment variable OT_DSIM_PURE_PYTHON=1
 _extensions = []
 if not os.environ.get("OT_DSIM_PURE_PYTHON"):
-    _extensions = [_cops_ext, _machine_ext]
+    _extensions = [_cops_ext, _machine_ext] + _machine_variant_exts
 
 setup(
     name="ot_dsim",
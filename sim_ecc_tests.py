@@ -8,7 +8,8 @@ Runs ECC operations based on the primitives contained in the binary blob of
 the p256 lib.
 """
 
-from ot_dsim.bignum_lib.machine import Machine
+from ot_dsim.bignum_lib.machine import Machine, Program
+from ot_dsim.bignum_lib.program_cache import load_asm_program
 from ot_dsim.bignum_lib.sim_helpers import *
 from ot_dsim.sim import ins_objects_from_hex_file
 from ot_dsim.sim import ins_objects_from_asm_file
@@ -69,6 +70,8 @@ P256VERIFY_START_ADDR = 538
 P256VERIFY_STOP_ADDR = 617
 
 P256_CURVE_ORDER = 0xFFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551
+P256_GX = 0x6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296
+P256_GY = 0x4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5
 
 # Example key
 # public
@@ -161,8 +164,8 @@ def _set_dmem_addressing(byte_addressing):
     dmem_mult = 32 if DMEM_BYTE_ADDRESSING else 1
 
 
-def load_pointer():
-    """Load pointers into 1st dmem word according to calling conventions"""
+def pointer_val():
+    """Pointer word according to calling conventions"""
     pval = pK * dmem_mult
     pval += pRnd * dmem_mult << BN_LIMB_LEN * 1
     pval += pMsg * dmem_mult << BN_LIMB_LEN * 2
@@ -171,7 +174,12 @@ def load_pointer():
     pval += pX * dmem_mult << BN_LIMB_LEN * 5
     pval += pY * dmem_mult << BN_LIMB_LEN * 6
     pval += pD * dmem_mult << BN_LIMB_LEN * 7
-    dmem[pLoc] = pval
+    return pval
+
+
+def load_pointer():
+    """Load pointers into 1st dmem word according to calling conventions"""
+    dmem[pLoc] = pointer_val()
 
 
 def load_k(k):
@@ -234,6 +242,8 @@ def load_program_hex():
     insfile = open(PROGRAM_HEX_FILE)
     ins_objects, ctx = ins_objects_from_hex_file(insfile)
     insfile.close()
+    # decoded once, shared by every Machine below
+    ins_objects = Program(ins_objects, ctx)
 
     start_addr_dict = {
         "p256init": P256INIT_START_ADDR,
@@ -261,9 +271,7 @@ def load_program_asm():
 
     _set_dmem_addressing(False)
 
-    insfile = open(PROGRAM_ASM_FILE)
-    ins_objects, ctx, breakpoints = ins_objects_from_asm_file(insfile)
-    insfile.close()
+    ins_objects, ctx, breakpoints = load_asm_program(PROGRAM_ASM_FILE)
 
     # reverse function address dictionary
     function_addr = {v: k for k, v in ctx.functions.items()}
@@ -293,11 +301,9 @@ def load_program_otbn_asm():
 
     _set_dmem_addressing(True)
 
-    insfile = open(PROGRAM_OTBN_ASM_FILE)
-    ins_objects, ctx, breakpoints = ins_objects_from_asm_file(
-        insfile, dmem_byte_addressing=DMEM_BYTE_ADDRESSING
+    ins_objects, ctx, breakpoints = load_asm_program(
+        PROGRAM_OTBN_ASM_FILE, dmem_byte_addressing=DMEM_BYTE_ADDRESSING
     )
-    insfile.close()
 
     # reverse label address dictionary for function addresses (OTBN asm does not differantiate between generic
     # und function labels)
@@ -339,25 +345,19 @@ def run_isoncurve(x, y):
         ctx=ctx,
         breakpoints=breakpoints,
     )
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     load_x(x)
     load_y(y)
     machine.dmem = dmem.copy()
     machine.pc = start_addr_dict["p256isoncurve"]
     machine.stop_addr = stop_addr_dict["p256isoncurve"]
-    cont = True
     machine.stats = stats
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     # point is on curve if r and s are equal
     on_curve = dmem[pS] == dmem[pR]
@@ -382,12 +382,9 @@ def run_scalarmult(x, y, k):
         breakpoints=breakpoints,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     load_x(x)
     load_y(y)
@@ -396,12 +393,9 @@ def run_scalarmult(x, y, k):
     machine.pc = start_addr_dict["p256scalarmult"]
     machine.stop_addr = stop_addr_dict["p256scalarmult"]
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     return dmem[pX], dmem[pY]
 
@@ -423,12 +417,9 @@ def run_sign(d, k, msg):
         ctx=ctx,
         breakpoints=breakpoints,
     )
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     load_msg(msg)
     load_d(d)
@@ -437,12 +428,9 @@ def run_sign(d, k, msg):
     machine.pc = start_addr_dict["p256sign"]
     machine.stop_addr = stop_addr_dict["p256sign"]
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     return dmem[pR], dmem[pS]
 
@@ -465,12 +453,9 @@ def run_verify(x, y, r, s, msg):
         breakpoints=breakpoints,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     load_x(x)
     load_y(y)
@@ -481,12 +466,9 @@ def run_verify(x, y, r, s, msg):
     machine.pc = start_addr_dict["p256verify"]
     machine.stop_addr = stop_addr_dict["p256verify"]
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     # Verification successful if r == rnd
     return dmem[pR] == dmem[pRnd]
@@ -594,6 +576,110 @@ def run_test_ecdsa_verify_random():
         raise Exception("ECDSA verifiy (rand) failed")
 
 
+# Streaming test vectors
+# primitive and the vector fields loaded into dmem, per vector op
+VECTOR_OPS = {
+    "isoncurve": ("p256isoncurve", (("x", pX), ("y", pY))),
+    "scalarmult": ("p256scalarmult", (("x", pX), ("y", pY), ("k", pK))),
+    "sign": ("p256sign", (("msg", pMsg), ("d", pD), ("k", pK))),
+    "verify": ("p256verify", (("x", pX), ("y", pY), ("r", pR), ("s", pS), ("msg", pMsg))),
+}
+
+
+def prepare_vector(vector):
+    """Reference values and DMEM contents of an ECC test vector
+
+    A vector names its op (a key of VECTOR_OPS) and holds that op's fields
+    as ints or "0x..." strings, msg being the message digest. isoncurve and
+    verify take an optional boolean expect (default true); the reference
+    point of scalarmult and the public key checking a signature are
+    computed here.
+    """
+    op = vector["op"]
+    func, fields = VECTOR_OPS[op]
+    job = {
+        "op": op,
+        "func": func,
+        "cells": [(addr, vector_int(vector[name])) for name, addr in fields],
+    }
+    if op == "scalarmult":
+        point = ECC.EccPoint(vector_int(vector["x"]), vector_int(vector["y"]), curve="p256")
+        point = point * vector_int(vector["k"])
+        job["expect"] = (int(point.x), int(point.y))
+    elif op == "sign":
+        job["pub"] = ECC.EccPoint(P256_GX, P256_GY, curve="p256") * vector_int(vector["d"])
+        job["msg"] = vector_int(vector["msg"])
+    else:
+        job["expect"] = bool(vector.get("expect", True))
+    return job
+
+
+def execute_vector(job):
+    """Run p256init and the vector's primitive, returns (dmem, inst_cnt, cycle_cnt)
+
+    Builds its own machine and leaves the module state alone, so jobs can
+    run on several threads at once.
+    """
+    dmem_init = [0] * DMEM_DEPTH
+    dmem_init[pLoc] = pointer_val()
+    machine = Machine(
+        dmem_init,
+        ins_objects,
+        start_addr_dict["p256init"],
+        stop_addr_dict["p256init"],
+        ctx=ctx,
+    )
+    inst, cycles, _ = machine.run(release_gil=True)
+    dmem_op = machine.dmem.copy()
+    for addr, val in job["cells"]:
+        dmem_op[addr] = val
+    machine.dmem = dmem_op
+    machine.pc = start_addr_dict[job["func"]]
+    machine.stop_addr = stop_addr_dict[job["func"]]
+    inst_op, cycles_op, _ = machine.run(release_gil=True)
+    return machine.dmem, inst + inst_op, cycles + cycles_op
+
+
+def ecdsa_valid(pub, msg, r, s):
+    """Check an ECDSA signature (r, s) of digest msg against public key point pub"""
+    n = P256_CURVE_ORDER
+    if not (0 < r < n and 0 < s < n):
+        return False
+    w = pow(s, -1, n)
+    point = ECC.EccPoint(P256_GX, P256_GY, curve="p256") * (msg * w % n) + pub * (r * w % n)
+    return not point.is_point_at_infinity() and int(point.x) % n == r
+
+
+def check_vector(vector, job, result):
+    """Result record of an executed vector"""
+    dmem_res, inst, cycles = result
+    record = {"inst_cnt": inst, "cycle_cnt": cycles}
+    op = job["op"]
+    if op == "isoncurve":
+        # point is on curve if r and s are equal
+        res = dmem_res[pS] == dmem_res[pR]
+        record.update(ok=res == job["expect"], result=res)
+    elif op == "verify":
+        # verification successful if r == rnd
+        res = dmem_res[pR] == dmem_res[pRnd]
+        record.update(ok=res == job["expect"], result=res)
+    elif op == "scalarmult":
+        res = (dmem_res[pX], dmem_res[pY])
+        record.update(ok=res == job["expect"], x=hex(res[0]), y=hex(res[1]))
+    else:
+        r, s = dmem_res[pR], dmem_res[pS]
+        record.update(ok=ecdsa_valid(job["pub"], job["msg"], r, s), r=hex(r), s=hex(s))
+    return record
+
+
+def run_vectors(vector_file, results=None, workers=None, window=None):
+    """Check the ECC vectors of a JSON lines stream, see stream_vectors()"""
+    return stream_vectors(
+        iter_vectors(vector_file), prepare_vector, execute_vector, check_vector,
+        results=results, workers=workers, window=window,
+    )
+
+
 def run_test(name):
     global inst_cnt
     global cycle_cnt
@@ -678,8 +764,15 @@ def main():
     # run_test("ecdsa_verify_random")
 
 
+def main_vectors(argv):
+    """Stream the vector file given on the command line"""
+    return vectors_main(argv, "Check P-256 test vectors", load_program_hex, run_vectors)
+
+
 if __name__ == "__main__":
     try:
+        if len(sys.argv) > 1:
+            sys.exit(main_vectors(sys.argv[1:]))
         main()
     except KeyboardInterrupt:
         print("Cancelled by user request.")
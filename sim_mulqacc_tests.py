@@ -8,6 +8,7 @@ Uses two random 256 bit wide operands and checks the result for corectness
 """
 
 from ot_dsim.bignum_lib.machine import Machine
+from ot_dsim.bignum_lib.program_cache import load_asm_program
 from ot_dsim.bignum_lib.sim_helpers import *
 import random
 
@@ -34,9 +35,7 @@ def load_program_asm():
     global ctx
     global breakpoints
 
-    insfile = open(PROGRAM_ASM_FILE)
-    ins_objects, ctx, breakpoints = ins_objects_from_asm_file(insfile)
-    insfile.close()
+    ins_objects, ctx, breakpoints = load_asm_program(PROGRAM_ASM_FILE)
 
 def dump_trace_str(trace_string):
     if ENABLE_TRACE_DUMP:
@@ -48,10 +47,7 @@ def run_mult(op1, op2):
     dmem[0] = op1
     dmem[1] = op2
     machine = Machine(dmem.copy(), ins_objects, 0, 23, ctx=ctx, breakpoints=breakpoints)
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
+    run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
     dmem = machine.dmem.copy()
     res_low = dmem[2]
     res_high = dmem[3]
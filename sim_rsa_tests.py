@@ -9,10 +9,14 @@ the generic bignum library. Hence these are wrappers around mainly modexp and
 montmul operations.
 """
 
-from ot_dsim.bignum_lib.machine import Machine
+from ot_dsim.bignum_lib.machine import Machine, MachinePool, Program
+from ot_dsim.bignum_lib.program_cache import load_asm_program
 from ot_dsim.bignum_lib.sim_helpers import *
 
 from Crypto.PublicKey import RSA
+import os
+import sys
+from functools import partial
 
 # Switch to True to get a full instruction trace
 ENABLE_TRACE_DUMP = False
@@ -153,8 +157,8 @@ def init_dmem():
     dmem = [0] * DMEM_DEPTH
 
 
-def load_pointer(bn_words, p_loc, p_a, p_b, p_c):
-    """Load pointers into 1st dmem word according to calling conventions"""
+def pointer_val(bn_words, p_a, p_b, p_c):
+    """Pointer word according to calling conventions"""
     pval = DMEMP_MOD
     pval += DMEMP_DINV << BN_LIMB_LEN * 1
     pval += DMEMP_RR << BN_LIMB_LEN * 2
@@ -163,7 +167,12 @@ def load_pointer(bn_words, p_loc, p_a, p_b, p_c):
     pval += p_c << BN_LIMB_LEN * 5
     pval += bn_words << BN_LIMB_LEN * 6
     pval += (bn_words - 1) << BN_LIMB_LEN * 7
-    dmem[p_loc] = pval
+    return pval
+
+
+def load_pointer(bn_words, p_loc, p_a, p_b, p_c):
+    """Load pointers into 1st dmem word according to calling conventions"""
+    dmem[p_loc] = pointer_val(bn_words, p_a, p_b, p_c)
 
 
 def load_blinding(pubexp, rnd, pad1, pad2):
@@ -179,18 +188,23 @@ def load_blinding(pubexp, rnd, pad1, pad2):
     dmem[DMEMP_BLINDING] = bval
 
 
+def full_bn_cells(dmem_p, bn_val):
+    """(address, value) of the dmem cells holding a full multi-word bignum value"""
+    return [
+        (dmem_p // dmem_mult + i, (bn_val >> (BN_WORD_LEN * i)) & BN_MASK)
+        for i in range(0, BN_MAX_WORDS)
+    ]
+
+
 def load_full_bn_val(dmem_p, bn_val):
     """Load a full multi-word bignum value into dmem"""
-    for i in range(0, BN_MAX_WORDS):
-        dmem[dmem_p // dmem_mult + i] = (bn_val >> (BN_WORD_LEN * i)) & BN_MASK
+    for addr, val in full_bn_cells(dmem_p, bn_val):
+        dmem[addr] = val
 
 
 def get_full_bn_val(dmem_p, machine, bn_words=BN_MAX_WORDS):
     """Get a full multi-word bignum value form dmem"""
-    bn_val = 0
-    for i in range(0, bn_words):
-        bn_val += machine.get_dmem(i + dmem_p // dmem_mult) << (BN_WORD_LEN * i)
-    return bn_val
+    return int.from_bytes(machine.get_dmem_bytes(dmem_p // dmem_mult, bn_words), "little")
 
 
 def load_mod(mod):
@@ -212,6 +226,8 @@ def load_program_hex():
     insfile = open(PROGRAM_HEX_FILE)
     ins_objects, ctx = ins_objects_from_hex_file(insfile)
     insfile.close()
+    # decoded once, shared by every Machine below
+    ins_objects = Program(ins_objects, ctx)
 
     start_addr_dict = {
         "modload": 414,
@@ -237,9 +253,7 @@ def load_program_asm():
     global stop_addr_dict
     global breakpoints
 
-    insfile = open(PROGRAM_ASM_FILE)
-    ins_objects, ctx, breakpoints = ins_objects_from_asm_file(insfile)
-    insfile.close()
+    ins_objects, ctx, breakpoints = load_asm_program(PROGRAM_ASM_FILE)
 
     # reverse function address dictionary
     function_addr = {v: k for k, v in ctx.functions.items()}
@@ -267,11 +281,9 @@ def load_program_otbn_asm():
     global stop_addr_dict
     global breakpoints
 
-    insfile = open(PROGRAM_OTBN_ASM_FILE)
-    ins_objects, ctx, breakpoints = ins_objects_from_asm_file(
-        insfile, dmem_byte_addressing=DMEM_BYTE_ADDRESSING, otbn_only=True
+    ins_objects, ctx, breakpoints = load_asm_program(
+        PROGRAM_OTBN_ASM_FILE, dmem_byte_addressing=DMEM_BYTE_ADDRESSING, otbn_only=True
     )
-    insfile.close()
 
     # reverse label address dictionary for function addresses (OTBN asm does not differentiate between generic
     # und function labels)
@@ -322,12 +334,9 @@ def run_modload(bn_words):
         breakpoints=breakpoints,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     dmem = machine.dmem.copy()
     dinv_res = dmem[DMEMP_DINV // dmem_mult]
     rr_res = get_full_bn_val(DMEMP_RR, machine, bn_words)
@@ -352,14 +361,9 @@ def run_montmul(bn_words, p_a, p_b, p_out):
         breakpoints=breakpoints,
     )
     machine.stats = stats
-    cont = True
-    i = 0
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        i += 1
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     res = get_full_bn_val(DMEMP_OUT, machine, bn_words)
     dmem = machine.dmem.copy()
     return res
@@ -382,12 +386,9 @@ def run_montout(bn_words, p_a, p_out):
         breakpoints=breakpoints,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     res = get_full_bn_val(DMEMP_OUT, machine, bn_words)
     dmem = machine.dmem.copy()
     return res
@@ -413,12 +414,9 @@ def run_modexp(bn_words, exp):
         ctx=ctx,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     res = get_full_bn_val(DMEMP_OUT, machine, bn_words)
     dmem = machine.dmem.copy()
     return res
@@ -456,12 +454,9 @@ def run_modexp_blinded(bn_words, exp):
         ctx=ctx,
     )
     machine.stats = stats
-    cont = True
-    while cont:
-        cont, trace_str, cycles = machine.step()
-        dump_trace_str(trace_str)
-        inst_cnt += 1
-        cycle_cnt += cycles
+    inst, cycles = run_machine(machine, dump_trace_str if ENABLE_TRACE_DUMP else None)
+    inst_cnt += inst
+    cycle_cnt += cycles
     res = get_full_bn_val(DMEMP_OUT, machine, bn_words)
     dmem = machine.dmem.copy()
     return res
@@ -546,6 +541,100 @@ def rsa_decrypt(mod, bn_words, priv_key, enc):
     return decrypt
 
 
+# Streaming test vectors
+def prepare_vector(vector):
+    """Reference result and DMEM contents of a modexp test vector
+
+    A vector holds the modulus n, the input msg and optionally the exponent
+    exp (default EXP_PUB) and the expected result expect, all as ints or
+    "0x..." strings; without expect the result is computed here.
+    """
+    mod = vector_int(vector["n"])
+    inval = vector_int(vector["msg"])
+    exp = vector_int(vector.get("exp", EXP_PUB))
+    bn_words = -(-bit_len(mod) // BN_WORD_LEN)
+    if not 0 < bn_words <= BN_MAX_WORDS:
+        raise ValueError("Modulus width not supported")
+    if "expect" in vector:
+        expect = vector_int(vector["expect"])
+    else:
+        expect = pow(inval, exp, mod)
+    modload_dmem = [0] * DMEM_DEPTH
+    for addr, val in full_bn_cells(DMEMP_MOD, mod):
+        modload_dmem[addr] = val
+    modload_dmem[DMEM_LOC_IN_PTRS] = pointer_val(bn_words, DMEMP_IN, DMEMP_EXP, DMEMP_OUT)
+    modexp_cells = full_bn_cells(DMEMP_IN, inval) + full_bn_cells(DMEMP_EXP, exp)
+    modexp_cells += [
+        (DMEM_LOC_IN_PTRS, pointer_val(bn_words, DMEMP_IN, DMEMP_RR, DMEMP_IN)),
+        (DMEM_LOC_SQR_PTRS, pointer_val(bn_words, DMEMP_OUT, DMEMP_OUT, DMEMP_OUT)),
+        (DMEM_LOC_MUL_PTRS, pointer_val(bn_words, DMEMP_IN, DMEMP_OUT, DMEMP_OUT)),
+        (DMEM_LOC_OUT_PTRS, pointer_val(bn_words, DMEMP_OUT, DMEMP_EXP, DMEMP_OUT)),
+    ]
+    return {
+        "bn_words": bn_words,
+        "expect": expect,
+        "modload_dmem": modload_dmem,
+        "modexp_cells": modexp_cells,
+    }
+
+
+def execute_vector(job, pool=None):
+    """Run modload and modexp of a prepared vector, returns (result, inst_cnt, cycle_cnt)
+
+    Takes its machines from pool (a MachinePool of the program) when
+    given, else builds its own; either way it leaves the module state
+    alone, so jobs can run on several threads at once.
+    """
+    def acquire(dmem, name):
+        if pool is not None:
+            return pool.acquire(dmem, start_addr_dict[name], stop_addr_dict[name])
+        return Machine(dmem, ins_objects, start_addr_dict[name], stop_addr_dict[name], ctx=ctx)
+
+    def release(machine):
+        if pool is not None:
+            pool.release(machine)
+
+    machine = acquire(job["modload_dmem"], "modload")
+    try:
+        inst, cycles, _ = machine.run(release_gil=True)
+        dmem_modexp = machine.dmem.copy()
+    finally:
+        release(machine)
+    for addr, val in job["modexp_cells"]:
+        dmem_modexp[addr] = val
+    machine = acquire(dmem_modexp, "modexp")
+    try:
+        inst_exp, cycles_exp, _ = machine.run(release_gil=True)
+        res = get_full_bn_val(DMEMP_OUT, machine, job["bn_words"])
+    finally:
+        release(machine)
+    return res, inst + inst_exp, cycles + cycles_exp
+
+
+def check_vector(vector, job, result):
+    """Result record of an executed vector"""
+    res, inst, cycles = result
+    return {
+        "ok": res == job["expect"],
+        "result": hex(res),
+        "inst_cnt": inst,
+        "cycle_cnt": cycles,
+    }
+
+
+def run_vectors(vector_file, results=None, workers=None, window=None):
+    """Check the modexp vectors of a JSON lines stream, see stream_vectors()
+
+    Each worker thread runs one vector at a time, so a pool with a machine
+    per worker serves them all.
+    """
+    pool = MachinePool(ins_objects, workers if workers is not None else os.cpu_count() or 1)
+    return stream_vectors(
+        iter_vectors(vector_file), prepare_vector, partial(execute_vector, pool=pool),
+        check_vector, results=results, workers=workers, window=window,
+    )
+
+
 def main():
     """main"""
     global inst_cnt
@@ -650,8 +739,15 @@ def main():
         print("\n\n")
 
 
+def main_vectors(argv):
+    """Stream the vector file given on the command line"""
+    return vectors_main(argv, "Check RSA modexp test vectors", load_program_otbn_asm, run_vectors)
+
+
 if __name__ == "__main__":
     try:
+        if len(sys.argv) > 1:
+            sys.exit(main_vectors(sys.argv[1:]))
         main()
     except KeyboardInterrupt:
         print("Cancelled by user request.")
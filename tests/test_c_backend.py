@@ -1,6 +1,6 @@
 import random
 import unittest
-from contextlib import contextmanager
+from contextlib import contextmanager, nullcontext
 
 from ot_dsim.bignum_lib import c_backend
 from ot_dsim.bignum_lib.machine import Machine
@@ -105,6 +105,127 @@ class CBackendTest(unittest.TestCase):
             )
             self.assertEqual(updated_half_word, expected_half_word)
 
+    def test_multiply_accumulate_matches_python_math(self):
+        qw_mask = c_backend.QUARTER_WORD_MASK
+        for _ in range(200):
+            lhs = self.rand_u256()
+            rhs = self.rand_u256()
+            lhs_qw = self.rng.randrange(4)
+            rhs_qw = self.rng.randrange(4)
+            shift = self.rng.choice([0, 64, 128, 192, self.rng.randrange(384)])
+            acc = self.rng.getrandbits(self.rng.choice([0, 128, 256, 320, 511]))
+            op1 = (lhs >> (64 * lhs_qw)) & qw_mask
+            op2 = (rhs >> (64 * rhs_qw)) & qw_mask
+            expected = acc + ((op1 * op2) << shift)
+
+            self.assertEqual(c_backend.mulqacc(acc, lhs, rhs, lhs_qw, rhs_qw, shift), expected)
+            self.assertEqual(
+                c_backend.mulqacc_so(acc, lhs, rhs, lhs_qw, rhs_qw, shift),
+                (expected >> 128, expected & c_backend.HALF_WORD_MASK),
+            )
+            with self.force_python_backend():
+                self.assertEqual(c_backend.mulqacc(acc, lhs, rhs, lhs_qw, rhs_qw, shift), expected)
+
+            lhs_upper = bool(self.rng.getrandbits(1))
+            rhs_upper = bool(self.rng.getrandbits(1))
+            expected_mulh = ((lhs >> (128 * lhs_upper)) & c_backend.HALF_WORD_MASK) * (
+                (rhs >> (128 * rhs_upper)) & c_backend.HALF_WORD_MASK
+            )
+            self.assertEqual(c_backend.mulh(lhs, rhs, lhs_upper, rhs_upper), expected_mulh)
+
+        # Accumulators past the native width take the Python path
+        big = 1 << 600
+        self.assertEqual(c_backend.mulqacc(big, 3, 5, 0, 0, 0), big + 15)
+        with self.assertRaises(IndexError):
+            c_backend.mulqacc(0, 1, 1, 4, 0, 0)
+
+    def test_many_ops_match_scalar_ops(self):
+        lhs_vals = [self.rand_u256() for _ in range(64)] + [0, c_backend.XLEN_MASK]
+        rhs_vals = [self.rand_u256() for _ in range(64)] + [c_backend.XLEN_MASK, 0]
+        lhs_vals[3] = rhs_vals[3]
+        lhs = c_backend.pack_u256_many(lhs_vals)
+        rhs = c_backend.pack_u256_many(rhs_vals)
+        pairs = list(zip(lhs_vals, rhs_vals))
+
+        for backend in (nullcontext(), self.force_python_backend()):
+            with backend:
+                sums, carries = c_backend.add_u256_many(lhs, rhs, True)
+                expected = [c_backend.add_u256(a, b, True) for a, b in pairs]
+                self.assertEqual(c_backend.unpack_u256_many(sums), [v for v, _ in expected])
+                self.assertEqual(list(carries), [c for _, c in expected])
+
+                diffs, borrows = c_backend.sub_u256_many(memoryview(lhs), rhs)
+                expected = [c_backend.sub_u256(a, b) for a, b in pairs]
+                self.assertEqual(c_backend.unpack_u256_many(diffs), [v for v, _ in expected])
+                self.assertEqual(list(borrows), [b for _, b in expected])
+
+                self.assertEqual(
+                    c_backend.cmp_u256_many(lhs, rhs),
+                    [c_backend.cmp_u256(a, b) for a, b in pairs],
+                )
+                self.assertEqual(
+                    c_backend.unpack_u256_many(c_backend.xor_u256_many(lhs, rhs)),
+                    [a ^ b for a, b in pairs],
+                )
+                self.assertEqual(
+                    c_backend.unpack_u256_many(
+                        c_backend.mul_u256_many(lhs, rhs), c_backend.ACC_BYTES
+                    ),
+                    [a * b for a, b in pairs],
+                )
+
+                # A single rhs value broadcasts over every lhs value
+                mask = rhs_vals[0]
+                self.assertEqual(
+                    c_backend.unpack_u256_many(
+                        c_backend.and_u256_many(lhs, c_backend.pack_u256_many([mask]))
+                    ),
+                    [a & mask for a in lhs_vals],
+                )
+                self.assertEqual(
+                    c_backend.unpack_u256_many(
+                        c_backend.or_u256_many(lhs, c_backend.pack_u256_many([mask]))
+                    ),
+                    [a | mask for a in lhs_vals],
+                )
+                # Buffers that are not word-aligned take the byte loop
+                odd = memoryview(bytearray(b"\0" + lhs))[1:]
+                self.assertEqual(
+                    c_backend.unpack_u256_many(c_backend.xor_u256_many(odd, rhs)),
+                    [a ^ b for a, b in pairs],
+                )
+                with self.assertRaises(ValueError):
+                    c_backend.add_u256_many(lhs, rhs[:64])
+
+    def test_hex_parsers_match_python_fallback(self):
+        values = [self.rand_u256() for _ in range(5)]
+        lines = [
+            f"{i:04d}: " + " ".join(f"{(v >> (32 * k)) & c_backend.LIMB_MASK:08x}" for k in range(7, -1, -1))
+            for i, v in enumerate(values)
+        ]
+        dmem = ("\r\n".join(lines[:2]) + "\n" + "\n".join(line.split(": ")[1] for line in lines[2:])).encode()
+        hex_prog = b"0xf8000001\n\n0003: 0x4C000000\nfunction:\n 0x80000001"
+
+        for backend in (nullcontext(), self.force_python_backend()):
+            with backend:
+                image, n, used = c_backend.parse_dmem_hex(dmem)
+                self.assertEqual(c_backend.unpack_u256_many(image), values)
+                self.assertEqual((n, used), (5, len(dmem)))
+                # Without final the unterminated last line is left over
+                image, n, used = c_backend.parse_dmem_hex(dmem, 0, False)
+                self.assertEqual((n, dmem[used:]), (4, dmem[dmem.rindex(b"\n") + 1:]))
+                with self.assertRaises(ValueError):
+                    c_backend.parse_dmem_hex(dmem, 1)
+                with self.assertRaises(ValueError):
+                    c_backend.parse_dmem_hex(b"0 0 0 0 0 0 0 0\n")
+                with self.assertRaises(ValueError):
+                    c_backend.parse_dmem_hex(lines[0].replace("0", "g", 1).encode())
+
+                words = memoryview(c_backend.parse_hex_words(hex_prog)).cast("I").tolist()
+                self.assertEqual(words, [0xF8000001, 0x4C000000, 0x80000001])
+                with self.assertRaises(ValueError):
+                    c_backend.parse_hex_words(b"0x123\n")
+
     def test_machine_set_reg_limb_overwrites_full_limb(self):
         machine = Machine([], [None])
         machine.set_reg(
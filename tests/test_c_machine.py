@@ -5,13 +5,202 @@ original pure-Python Machine for all core operations: register access,
 limb manipulation, flags, DMEM, GPRs, CSRs/WSRs, loop/call stacks.
 """
 
+import asyncio
+import contextlib
+import io
+import json
 import random
 import os
 import subprocess
 import sys
+import tempfile
+import threading
 import unittest
+from concurrent.futures import CancelledError
+from unittest import mock
 
-from ot_dsim.bignum_lib.machine import Machine, CallStackUnderrun, _USE_C_MACHINE
+from ot_dsim.bignum_lib.machine import (
+    Machine, CallStackUnderrun, MachinePool, PERF_COUNTER_FIELDS, Program, _USE_C_MACHINE,
+    decode_state, lockstep, machine_class, perf_counters_dict, run_batch, run_lanes, state_digest,
+)
+from ot_dsim.bignum_lib.assembler import Assembler
+from ot_dsim.bignum_lib.disassembler import read_binary_trace, render_binary_trace
+from ot_dsim.bignum_lib import instructions, program_cache
+from ot_dsim.bignum_lib.sim_helpers import (
+    ins_objects_from_asm_file, ins_objects_from_hex_file, program_from_hex_file,
+    read_dmem_from_file, dmem_image_from_file, iter_dmem_images, iter_vectors, stream_vectors,
+)
+
+ASM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "asm")
+HEX_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "hex")
+
+
+def _mulqacc_program():
+    """Assemble the 256x256 mulqacc example without its breakpoint."""
+    with open(os.path.join(ASM_DIR, "otbn_mulqacc_256x256.asm")) as f:
+        lines = [line for line in f.readlines() if line.strip() != "break"]
+    asm = Assembler(lines)
+    asm.assemble()
+    return asm.get_instruction_objects()
+
+
+def _random_bn_program(rng, n_ops=300):
+    """Straight-line program over the natively decoded OTBN instructions."""
+    w = lambda: rng.randrange(32)
+    x = lambda: rng.randrange(5, 20)
+    qw = lambda: rng.randrange(4)
+
+    def shift():
+        return rng.choice(["", " << 8", " >> 16", " << 128", " >> 248"])
+
+    def fg():
+        return rng.choice(["", ", FG1"])
+
+    templates = [
+        lambda: f"BN.{rng.choice(['ADD', 'ADDC', 'SUB', 'SUBB'])} w{w()}, w{w()}, w{w()}{shift()}{fg()}",
+        lambda: f"BN.{rng.choice(['AND', 'OR', 'XOR'])} w{w()}, w{w()}, w{w()}{shift()}",
+        lambda: f"BN.{rng.choice(['CMP', 'CMPB'])} w{w()}, w{w()}{shift()}{fg()}",
+        lambda: f"BN.{rng.choice(['ADDI', 'SUBI'])} w{w()}, w{w()}, {rng.randrange(1024)}{fg()}",
+        lambda: f"BN.{rng.choice(['ADDM', 'SUBM'])} w{w()}, w{w()}, w{w()}",
+        lambda: f"BN.NOT w{w()}, w{w()}{shift()}",
+        lambda: f"BN.RSHI w{w()}, w{w()}, w{w()} >> {rng.randrange(512)}",
+        lambda: f"BN.SEL w{w()}, w{w()}, w{w()}, {rng.choice(['', 'FG1.'])}{rng.choice('CLMZ')}",
+        lambda: f"BN.MOV w{w()}, w{w()}",
+        lambda: f"BN.MULQACC w{w()}.{qw()}, w{w()}.{qw()}, {rng.choice([0, 64, 128, 192])}",
+        lambda: f"BN.MULQACC.Z w{w()}.{qw()}, w{w()}.{qw()}, {rng.randrange(4)}",
+        lambda: f"BN.MULQACC.SO w{w()}.{rng.choice('lu')}, w{w()}.{qw()}, w{w()}.{qw()}, 64",
+        lambda: f"BN.MULH w{w()}, w{w()}.{rng.choice('LU')}, w{w()}.{rng.choice('LU')}",
+        lambda: f"BN.WSRRW w{w()}, 0, w{w()}",
+        lambda: f"BN.WSRRS w{w()}, 0, w{w()}",
+        lambda: f"{rng.choice(['ADD', 'SUB', 'AND', 'OR', 'XOR'])} x{x()}, x{x()}, x{x()}",
+        lambda: f"{rng.choice(['ADDI', 'ANDI', 'ORI', 'XORI'])} x{x()}, x{x()}, {rng.randrange(2048)}",
+        lambda: f"SLLI x{x()}, x{x()}, {rng.randrange(32)}",
+        lambda: f"LI x{x()}, {rng.randrange(1 << 20)}",
+        lambda: f"LUI x{x()}, {rng.randrange(1 << 20)}",
+        lambda: f"CSRRS x{x()}, 1984, x0",
+        lambda: f"LI x20, {w()}\nLI x21, {w()}\nBN.MOVR x20{rng.choice(['++', ''])}, x21",
+        lambda: f"LI x22, {rng.randrange(8)}\nLI x23, {w()}\nBN.SID x23, {rng.randrange(8)}(x22++)",
+        lambda: f"LI x22, {rng.randrange(8)}\nLI x23, {w()}\nBN.LID x23++, {rng.randrange(8)}(x22)",
+        lambda: f"LI x22, {4 * rng.randrange(64)}\nSW x{x()}, 0(x22)",
+        lambda: f"LI x22, {4 * rng.randrange(64)}\nLW x{x()}, 0(x22)",
+        lambda: "LOOPI 3, 2\nBN.ADDC w4, w4, w5\nADDI x6, x6, 1",
+    ]
+    lines = [f"BN.MULQACC.Z w0.0, w0.0, 0"]
+    for _ in range(n_ops):
+        lines.extend(rng.choice(templates)().split("\n"))
+    lines.append("ECALL")
+    asm = Assembler([line + "\n" for line in lines])
+    asm.assemble()
+    return asm.get_instruction_objects()
+
+
+def _random_dcrypto_program(rng, n_ops=300):
+    """Program over the natively decoded dcrypto instructions: a straight-line
+    main function with forward branches, loops and calls into a helper."""
+    r = lambda: rng.randrange(32)
+    limb = lambda: rng.randrange(8)
+    inc = lambda: rng.choice(["", "++"])
+    labels = iter(range(n_ops))
+
+    def shift():
+        return rng.choice(["", " << 8", " >> 16", " << 128", " >> 248"])
+
+    def branch():
+        label = f"skip{next(labels)}"
+        cc = rng.choice(["b", "bl", "bm", "bnc", "bnz", "bz"])
+        return f"{cc} {label}\nadd r1, r1, r2\n{label}:"
+
+    templates = [
+        lambda: f"{rng.choice(['add', 'addc', 'addx', 'addcx'])} r{r()}, r{r()}, r{r()}{shift()}",
+        lambda: f"{rng.choice(['sub', 'subb', 'subx', 'subbx'])} r{r()}, r{r()}, r{r()}{shift()}",
+        lambda: f"{rng.choice(['addi', 'subi'])} r{r()}, r{r()}, #{rng.randrange(256)}",
+        lambda: f"addm r{r()}, r{r()}, r{r()}{shift()}",
+        lambda: f"subm r{r()}, r{r()}, r{r()}",
+        lambda: f"{rng.choice(['and', 'or', 'xor'])} r{r()}, r{r()}, r{r()}{shift()}",
+        lambda: f"{rng.choice(['not', 'notx'])} r{r()}, r{r()}{shift()}",
+        lambda: f"{rng.choice(['cmp', 'cmpbx'])} r{r()}, r{r()}",
+        lambda: f"sel{rng.choice('clmz')}{rng.choice(['', 'x'])} r{r()}, r{r()}, r{r()}",
+        lambda: f"rshi r{r()}, r{r()}, r{r()} >> {rng.randrange(256)}",
+        lambda: f"mul128 r{r()}, r{r()}{rng.choice('lu')}, r{r()}{rng.choice('lu')}",
+        lambda: f"mov r{r()}, r{r()}",
+        lambda: f"movi r{r()}.{limb()}{rng.choice('lh')}, #{rng.randrange(1 << 16)}",
+        lambda: f"{rng.choice(['ldrfp', 'lddmp', 'ldmod', 'ldrnd'])} r{r()}",
+        lambda: f"{rng.choice(['stdmp', 'stmod', 'strnd'])} r{r()}",
+        lambda: f"{rng.choice(['ldi', 'sti'])} r{r()}, [#{rng.randrange(128)}]",
+        lambda: f"ldr *{limb()}{inc()}, *{limb()}{inc()}",
+        lambda: f"ld *{limb()}{inc()}, *{limb()}{inc()}",
+        lambda: f"st *{limb()}{inc()}, *{limb()}{inc()}",
+        lambda: "loop #3 (\naddc r4, r4, r5\naddi r6, r6, #1\n)",
+        lambda: "loop *1 (\nsubb r7, r7, r8\n)",
+        lambda: "call &helper",
+        lambda: "nop",
+        branch,
+    ]
+    body = []
+    for _ in range(n_ops):
+        body.extend(rng.choice(templates)().split("\n"))
+    body.append("nop")
+
+    def size(lines):
+        return sum(1 for line in lines if not line.endswith(":") and line not in "()")
+
+    helper = ["addi r9, r9, #1", "ret"]
+    lines = [f"function main[{size(body)}] {{"] + body + ["}"]
+    lines += [f"function helper[{size(helper)}] {{"] + helper + ["}"]
+    ins, ctx, _ = ins_objects_from_asm_file(io.StringIO("\n".join(lines) + "\n"))
+    return ins, ctx, size(body) - 1
+
+
+def _seeded_dcrypto_machine(rng, lc=0x0000000200000003):
+    """Random dcrypto program with a random start state: DMEM, registers
+    and an odd MOD, and lc for LC (one loop count per 32-bit limb).
+
+    Returns (machine, ins, ctx, stop_addr). machine(imem=None, cls=Machine,
+    into=None) loads the state into into, or a new cls over imem (the
+    program by default), and returns it; every call gives the same state.
+    """
+    ins, ctx, stop_addr = _random_dcrypto_program(rng)
+    dmem = [rng.getrandbits(256) for _ in range(128)]
+    regs = [rng.getrandbits(256) | 1 for _ in range(32)]
+    mod = rng.getrandbits(256) | 1
+
+    def machine(imem=None, cls=Machine, into=None):
+        m = into or cls(list(dmem), ins if imem is None else imem, 0, stop_addr, ctx=ctx)
+        for i, v in enumerate(regs):
+            m.set_reg(i, v)
+        m.set_reg("mod", mod)
+        m.set_reg("lc", lc)
+        return m
+
+    return machine, ins, ctx, stop_addr
+
+
+class _ExecuteOnly:
+    """Wraps an instruction object but hides its native op description, so
+    the machine runs it through execute()."""
+
+    def __init__(self, ins):
+        self._ins = ins
+
+    def __getattr__(self, name):
+        return getattr(self._ins, name)
+
+    def get_native_op(self):
+        return None
+
+
+def _machine_state(m):
+    return (
+        [m.get_reg(i) for i in range(32)],
+        m.get_reg("mod"),
+        m.get_acc(),
+        [m.get_gpr(i) for i in range(2, 32)],
+        m.get_flags_as_bin(),
+        list(m.dmem),
+        m.get_pc(),
+        [m.get_reg(r) for r in ("rfp", "dmp", "lc", "rnd")],
+        m.stats,
+    )
 
 
 class CMachineTest(unittest.TestCase):
@@ -67,6 +256,34 @@ class CMachineTest(unittest.TestCase):
         self.assertEqual(Machine.DMEM_DEPTH, 128)
         self.assertEqual(Machine.IMEM_DEPTH, 1024)
 
+    def test_specialized_memory_geometry(self):
+        """Larger DMEM/IMEM builds are picked by construction arguments."""
+        big = machine_class(dmem_depth=200)
+        self.assertEqual((big.DMEM_DEPTH, big.IMEM_DEPTH), (1024, 4096))
+        self.assertIs(machine_class(dmem_depth=64), Machine)
+        with self.assertRaises(ValueError):
+            machine_class(imem_depth=1 << 20)
+
+        asm = Assembler([line + "\n" for line in
+                         ["LI x22, 1000", "LI x23, 5", "BN.SID x23, 3(x22)",
+                          "LI x24, 7", "BN.LID x24, 3(x22)", "NOP"]])
+        asm.assemble()
+        prog = Program(asm.get_instruction_objects())
+        m = Machine([], prog, dmem_depth=1024)
+        self.assertIsInstance(m, big)
+        self.assertEqual(len(m.dmem), 1024)
+        m.set_reg(5, 0xABCDEF)
+        m.run()
+        self.assertEqual(m.get_dmem(1003), 0xABCDEF)
+        self.assertEqual(m.get_reg(7), 0xABCDEF)
+        self.assertEqual(m.fork().get_dmem(1003), 0xABCDEF)
+        self.assertIsInstance(m.fork(), big)
+        with self.assertRaises(IndexError):
+            m.get_dmem(1024)
+        # the default build keeps its 128 cells
+        with self.assertRaises(IndexError):
+            Machine([], prog).get_dmem(1003)
+
     def test_register_get_set(self):
         m = Machine([], [None])
         val = 0xDEADBEEFCAFEBABE12345678AABBCCDD
@@ -103,6 +320,30 @@ class CMachineTest(unittest.TestCase):
         limb0 = m.get_reg_limb(4, 0)
         self.assertEqual(limb0, 0xABCD0000)
 
+    def test_valid_half_limbs(self):
+        asm = Assembler(["BN.ADD w7, w1, w2\n", "ECALL\n"])
+        asm.assemble()
+        m = Machine([], asm.get_instruction_objects())
+
+        def check(ridx, mask):
+            self.assertEqual(m.get_reg_valid_half_limb_mask(ridx), mask)
+            self.assertEqual(m.get_reg_valid_half_limbs(ridx), [bool(mask >> j & 1) for j in range(16)])
+
+        check(5, 0)
+        m.set_reg(5, 1, 2)
+        check(5, 0b110000)
+        m.set_reg(5, 1, None, 9)
+        check(5, 0b1000110000)
+        m.set_reg_limb(6, 7, 1)
+        check(6, 0xC000)
+        m.set_reg(8, 1)
+        check(8, 0xFFFF)
+        m.run()
+        check(7, 0xFFFF)
+        m.reset([], asm.get_instruction_objects())
+        for ridx in (5, 6, 7, 8):
+            check(ridx, 0)
+
     def test_flags(self):
         m = Machine([], [None])
         for flag in ["M", "L", "Z", "C", "XM", "XL", "XZ", "XC"]:
@@ -191,6 +432,22 @@ class CMachineTest(unittest.TestCase):
         self.assertEqual(flags_bin & 0x1, 1)  # C
         self.assertEqual((flags_bin >> 3) & 1, 1)  # Z
 
+    def test_flag_groups_update_only_their_bits(self):
+        m = Machine([], [None])
+        names = ["C", "L", "M", "Z", "XC", "XL", "XM", "XZ"]
+        for bit, flag in enumerate(names):
+            m.set_flags_as_bin(1 << bit)
+            self.assertEqual([getattr(m, f) for f in names], [f == flag for f in names])
+        m.set_flags_as_bin(0xF0)
+        m.set_c_z_m_l((1 << 256) | (1 << 255) | 1)
+        self.assertEqual(m.get_flags_as_bin(), 0xF7)
+        m.setx_z_m_l(0)
+        self.assertEqual(m.get_flags_as_bin(), 0x97)
+        m.set_l(2)
+        m.XC = False
+        self.assertEqual(m.get_flags_as_bin(), 0x85)
+        self.assertEqual(m.fork().get_flags_as_bin(), 0x85)
+
     def test_xlen_hex_str(self):
         m = Machine([], [None])
         s = m.get_xlen_hex_str(0xDEADBEEF)
@@ -219,6 +476,1255 @@ class CMachineTest(unittest.TestCase):
         m.set_wsr(0, 0x42)  # WSR_MOD
         self.assertEqual(m.get_wsr(0), 0x42)
 
+    def test_acc_wider_than_xlen(self):
+        # mulqacc chains may accumulate past 256 bits before a shift-out
+        m = Machine([], [None])
+        wide = (1 << 300) + 0x1234
+        m.set_acc(wide)
+        self.assertEqual(m.get_acc(), wide)
+        m.set_acc(m.get_acc() >> 128)
+        self.assertEqual(m.acc, wide >> 128)
+
+    def test_register_value_out_of_range(self):
+        m = Machine([], [None])
+        with self.assertRaises(OverflowError):
+            m.set_reg(1, 1 << 256)
+        with self.assertRaises(OverflowError):
+            m.set_reg(1, -1)
+        with self.assertRaises(OverflowError):
+            m.set_reg_limb(1, 0, 1 << 32)
+        with self.assertRaises(OverflowError):
+            m.set_dmem(0, 1 << 256)
+
+    def test_qw_and_half_word(self):
+        m = Machine([], [None])
+        val = sum((0x1111111111111111 * (i + 1)) << (64 * i) for i in range(4))
+        m.set_reg(7, val)
+        for i in range(4):
+            self.assertEqual(m.get_reg_qw(7, i), 0x1111111111111111 * (i + 1))
+        m.set_reg_half_word(7, 1, (1 << 128) - 1)
+        self.assertEqual(m.get_reg(7) >> 128, (1 << 128) - 1)
+        self.assertEqual(m.get_reg(7) & ((1 << 128) - 1), val & ((1 << 128) - 1))
+
+    def test_gpr_mirrors_special_regs(self):
+        m = Machine([], [None])
+        m.set_gpr(9, 0xCAFEF00D)
+        self.assertEqual(m.get_reg_limb("rfp", 1), 0xCAFEF00D)
+        m.set_reg("dmp", 0xABCD << 64)
+        self.assertEqual(m.get_gpr(18), 0xABCD)
+
+    def test_dmem_property_is_snapshot(self):
+        if not _USE_C_MACHINE:
+            self.skipTest("native DMEM only")
+        m = Machine([1, 2, 3], [None])
+        snap = m.dmem
+        self.assertEqual(len(snap), 128)
+        self.assertEqual(snap[:3], [1, 2, 3])
+        snap[0] = 42
+        self.assertEqual(m.get_dmem(0), 1)
+        m.dmem = [7, 8]
+        self.assertEqual(m.dmem[:3], [7, 8, 0])
+        self.assertEqual(m.init_dmem[:3], [True, True, False])
+
+    def test_dmem_byte_image(self):
+        big = (1 << 255) | 0x1234
+        m = Machine([big, 7], [None])
+        image = m.get_dmem_bytes()
+        self.assertEqual(len(image), 128 * 32)
+        self.assertEqual(image[:64], big.to_bytes(32, "little") + (7).to_bytes(32, "little"))
+        self.assertEqual(m.get_dmem_bytes(1, 1), (7).to_bytes(32, "little"))
+
+        m.set_dmem_bytes(10, (5).to_bytes(32, "little") + (6).to_bytes(32, "little"))
+        self.assertEqual((m.get_dmem(10), m.get_dmem(11)), (5, 6))
+        self.assertTrue(m.init_dmem[11])
+        self.assertFalse(m.init_dmem[12])
+        with self.assertRaises(IndexError):
+            m.set_dmem_bytes(127, bytes(64))
+        with self.assertRaises(ValueError):
+            m.set_dmem_bytes(0, bytes(31))
+
+        # An image loads like the equivalent list of ints
+        m2 = Machine(image[: 3 * 32], [None])
+        self.assertEqual(m2.dmem[:3], [big, 7, 0])
+        self.assertEqual(m2.init_dmem[:4], [True, True, True, False])
+
+    def test_dmem_view_is_writable(self):
+        if not _USE_C_MACHINE:
+            self.skipTest("native DMEM only")
+        m = Machine([], [None])
+        view = m.dmem_view
+        self.assertEqual(view.nbytes, 128 * 32)
+        self.assertFalse(view.readonly)
+        view[64:96] = (0xABCDEF).to_bytes(32, "little")
+        self.assertEqual(m.dmem[2], 0xABCDEF)
+        m.set_dmem(3, 99)
+        self.assertEqual(int.from_bytes(view[96:128], "little"), 99)
+        self.assertEqual(bytes(memoryview(m)), m.get_dmem_bytes())
+
+    def test_flag_setters_accept_wide_and_negative(self):
+        m = Machine([], [None])
+        m.set_c_z_m_l((1 << 256) | (1 << 255) | 1)
+        self.assertTrue(m.get_flag("C"))
+        self.assertTrue(m.get_flag("M"))
+        self.assertTrue(m.get_flag("L"))
+        self.assertFalse(m.get_flag("Z"))
+        m.set_z_m_l(1 << 300)
+        self.assertTrue(m.get_flag("Z"))
+        m.set_z_m_l(-1)
+        self.assertTrue(m.get_flag("M"))
+        self.assertFalse(m.get_flag("Z"))
+
+    def _mulqacc_machine(self, ops=(0x1234 << 200, 0xFEDC << 190)):
+        ins = _mulqacc_program()
+        return Machine(list(ops), ins, 0, len(ins) - 1)
+
+    def test_run_matches_step_loop(self):
+        m = self._mulqacc_machine()
+        inst_cnt = cycle_cnt = 0
+        cont = True
+        while cont:
+            cont, _, cycles = m.step()
+            inst_cnt += 1
+            cycle_cnt += cycles
+        ref_dmem = m.dmem[:4]
+
+        m = self._mulqacc_machine()
+        self.assertEqual(m.run(), (inst_cnt, cycle_cnt, "stop_addr"))
+        self.assertEqual(m.dmem[:4], ref_dmem)
+        self.assertEqual((ref_dmem[3] << 256) + ref_dmem[2], (0x1234 << 200) * (0xFEDC << 190))
+
+    def test_run_max_steps_and_trace(self):
+        m = self._mulqacc_machine()
+        self.assertEqual(m.run(max_steps=0), (0, 0, "max_steps"))
+        inst_cnt, cycle_cnt, reason, traces = m.run(max_steps=3, collect_trace=True)
+        self.assertEqual((inst_cnt, reason), (3, "max_steps"))
+        self.assertEqual(len(traces), 3)
+        self.assertTrue(all(isinstance(t, str) for t in traces))
+        self.assertEqual(m.get_pc(), 3)
+        total = inst_cnt + m.run()[0]
+        self.assertEqual(total, len(_mulqacc_program()))
+        with self.assertRaises(ValueError):
+            m.run(max_steps=-1)
+
+    def test_run_stops_at_breakpoint(self):
+        m = self._mulqacc_machine()
+        ref = m.run()
+        m = self._mulqacc_machine()
+        m.set_breakpoint(6)
+        first = m.run()
+        self.assertEqual(first[0], 6)
+        self.assertEqual(first[2], "breakpoint")
+        self.assertEqual(m.get_pc(), 6)
+        # resuming executes the instruction at the breakpoint
+        second = m.run()
+        self.assertEqual(second[2], "stop_addr")
+        self.assertEqual(first[0] + second[0], ref[0])
+        self.assertEqual(first[1] + second[1], ref[1])
+
+    def test_breakpoint_passes_inside_loops(self):
+        lines = ["LOOPI 5, 3", "BN.ADD w1, w1, w2", "BN.ADDC w3, w3, w4", "ADDI x5, x5, 1", "NOP"]
+        asm = Assembler([line + "\n" for line in lines])
+        asm.assemble()
+        ins = asm.get_instruction_objects()
+        m = Machine([0] * 4, ins, 0, len(ins) - 1)
+        m.set_breakpoint(2, 2)
+        self.assertEqual(m.breakpoints, {2: (2, 1)})
+        reasons = []
+        total = 0
+        while True:
+            ran, _, reason = m.run()
+            total += ran
+            if reason != "breakpoint":
+                break
+            reasons.append(m.get_pc())
+            self.assertEqual(m.get_gpr(5), 2 * len(reasons) - 1)
+        # passes 2 and 4 break, 1, 3 and 5 only count
+        self.assertEqual(reasons, [2, 2])
+        self.assertEqual(m.breakpoints, {2: (2, 2)})
+        self.assertEqual(total, 1 + 5 * 3 + 1)
+        self.assertEqual(m.get_gpr(5), 5)
+
+        fork_src = Machine([0] * 4, ins, 0, len(ins) - 1)
+        fork_src.toggle_breakpoint("0x3")
+        fork = fork_src.fork()
+        fork_src.toggle_breakpoint(3)
+        self.assertEqual(fork_src.breakpoints, {})
+        self.assertEqual(fork.breakpoints, {3: (1, 1)})
+        self.assertEqual(fork.run(release_gil=True)[2], "breakpoint")
+        self.assertEqual(fork.get_pc(), 3)
+        fork.breakpoints = {}
+        self.assertEqual(fork.run()[2], "stop_addr")
+
+    def test_set_breakpoint_resolves_labels(self):
+        ins, ctx, _ = _random_dcrypto_program(random.Random(0x1AB), n_ops=20)
+        helper = {v: k for k, v in ctx.functions.items()}["helper"]
+        m = Machine([0] * 128, ins, 0, None, ctx=ctx, breakpoints=["helper"])
+        self.assertEqual(m.breakpoints, {helper: (1, 1)})
+        m.set_breakpoint("main", 3)
+        self.assertEqual(m.breakpoints, {helper: (1, 1), 0: (3, 1)})
+        self.assertNotIn(helper, Machine([0] * 128, ins, 0, None, ctx=ctx).breakpoints)
+
+    def test_run_end_of_imem(self):
+        ins = _mulqacc_program()
+        m = Machine([1, 2], ins, 0, len(ins) + 10)
+        self.assertEqual(m.run()[2], "end_of_imem")
+
+    def test_blocks_and_fused_chains_match_step_loop(self):
+        lines = [
+            "LOOPI 3, 11",
+            "BN.ADD w1, w2, w3",
+            "BN.ADDC w4, w5, w6",
+            "BN.ADDC w7, w4, w9, FG1",
+            "BN.MULQACC.Z w1.0, w2.1, 0",
+            "BN.MULQACC w1.1, w2.2, 64",
+            "BN.MULQACC w3.3, w4.0, 128",
+            "BN.MULQACC.SO w10.U, w5.1, w6.2, 64",
+            "LOOPI 2, 2",
+            "BN.SUB w11, w12, w13",
+            "BN.SUBB w14, w11, w12",
+            "ADDI x5, x5, 1",
+            "BN.ADDC w15, w15, w16",
+            "BN.ADDC w16, w16, w15",
+            "ECALL",
+        ]
+        asm = Assembler([line + "\n" for line in lines])
+        asm.assemble()
+        ins = asm.get_instruction_objects()
+        regs = [random.Random(0xB10C + i).getrandbits(256) for i in range(32)]
+
+        def machine():
+            m = Machine([0] * 4, list(ins), 0, len(ins) + 1)
+            for i, v in enumerate(regs):
+                m.set_reg(i, v)
+            return m
+
+        ref = machine()
+        inst_cnt = cycle_cnt = 0
+        cont = True
+        while cont:
+            cont, _, cycles = ref.step()
+            inst_cnt += 1
+            cycle_cnt += cycles
+
+        m = machine()
+        self.assertEqual(m.run(), (inst_cnt, cycle_cnt, "end_of_imem"))
+        self.assertEqual(_machine_state(m), _machine_state(ref))
+
+        # Block runs split by max_steps resume in the middle of chains
+        m = machine()
+        total = 0
+        while True:
+            ran, _, reason = m.run(max_steps=5)
+            total += ran
+            if reason != "max_steps":
+                break
+        self.assertEqual(total, inst_cnt)
+        self.assertEqual(_machine_state(m), _machine_state(ref))
+        if _USE_C_MACHINE:
+            self.assertEqual(m.get_exec_counts(), ref.get_exec_counts())
+
+    def test_run_picks_up_imem_edits_inside_blocks(self):
+        ins = _random_bn_program(random.Random(0xED17), n_ops=40)
+        patch = _random_bn_program(random.Random(0xED18), n_ops=40)
+        ref_imem = list(ins)
+        ref_imem[20:30] = patch[20:30]
+        ref = Machine([0] * 128, ref_imem, 0, len(ins) + 1)
+        ref.run()
+
+        imem = list(ins)
+        m = Machine([0] * 128, imem, 0, len(ins) + 1)
+        m.run(max_steps=10)
+        imem[20:30] = patch[20:30]
+        m.run()
+        self.assertEqual(_machine_state(m)[:-1], _machine_state(ref)[:-1])
+
+    def test_reassemble_patches_shared_program(self):
+        lines = [
+            "LOOPI 3, 7",
+            "BN.ADD w1, w2, w3",
+            "BN.ADDC w4, w5, w6",
+            "BN.ADDC w7, w4, w9",
+            "BN.MULQACC.Z w1.0, w2.1, 0",
+            "BN.MULQACC w1.1, w2.2, 64",
+            "BN.MULQACC.SO w10.U, w5.1, w6.2, 64",
+            "ADDI x5, x5, 1",
+            "ECALL",
+        ]
+        edits = {2: "BN.XOR w4, w5, w6", 6: "BN.MULQACC w5.1, w6.2, 128", 7: "ADDI x5, x5, 2"}
+        edited = [edits.get(i, line) for i, line in enumerate(lines)]
+        regs = [random.Random(0xA55E + i).getrandbits(256) for i in range(32)]
+
+        def assemble(src):
+            asm = Assembler([line + "\n" for line in src])
+            asm.assemble()
+            return asm
+
+        def machine(imem):
+            m = Machine([0] * 4, imem, 0, len(imem) + 1)
+            for i, v in enumerate(regs):
+                m.set_reg(i, v)
+            return m
+
+        ref = machine(Program(assemble(edited).get_instruction_objects()))
+        ref_run = ref.run()
+
+        asm = assemble(lines)
+        ins = asm.get_instruction_objects()
+        program = Program(ins)
+        m = machine(program)
+        listed = machine(ins)
+        captured = program.instructions
+        captured_hash = hash(captured)
+        self.assertEqual(asm.reassemble([line + "\n" for line in edited], program), [(2, 3), (6, 8)])
+        self.assertIs(asm.get_instruction_objects(), ins)
+        # Tuples handed out before are not patched under their holders
+        self.assertEqual(hash(captured), captured_hash)
+        self.assertIsNot(captured[2], program.instructions[2])
+        self.assertEqual([i.get_asm_str() for i in program.instructions],
+                         [i.get_asm_str() for i in ref.program.instructions])
+        for patched in (m, listed):
+            self.assertEqual(patched.run(), ref_run)
+            self.assertEqual(_machine_state(patched), _machine_state(ref))
+        self.assertEqual(list(program.cycles), list(ref.program.cycles))
+        with self.assertRaises(IndexError):
+            program.patch(len(program) - 1, ins[:2])
+
+        if _USE_C_MACHINE:
+            # Not while a machine runs the program with the GIL released
+            refused = []
+
+            class Patching(_ExecuteOnly):
+                def execute(self, m):
+                    try:
+                        guarded.patch(0, guarded.instructions[:1])
+                    except RuntimeError:
+                        refused.append(m.get_pc())
+                    return self._ins.execute(m)
+
+            guarded = Program(ins[:7] + [Patching(ins[7])] + ins[8:])
+            machine(guarded).run(release_gil=True)
+            self.assertEqual(refused, [7] * 3)
+            machine(guarded).run()
+            self.assertEqual(len(refused), 3)
+
+        # Moving an address re-assembles everything and leaves program alone
+        moved = edited[:1] + ["ADDI x6, x6, 1"] + edited[1:]
+        self.assertIsNone(asm.reassemble([line + "\n" for line in moved], program))
+        self.assertEqual([i.get_asm_str() for i in ins],
+                         [i.get_asm_str() for i in assemble(moved).get_instruction_objects()])
+        self.assertEqual(len(program), len(lines))
+        # A full re-assembly that fails changes neither the list nor asm
+        before = list(ins)
+        broken = moved[:2] + ["ADDI x5, x5, 99999"] + moved[2:]
+        for src in (broken, moved[:2] + ["ADDI x5, x5, 99999"] + moved[3:]):
+            with contextlib.redirect_stdout(io.StringIO()), self.assertRaises(SyntaxError):
+                asm.reassemble([line + "\n" for line in src])
+            self.assertEqual(ins, before)
+            self.assertIs(asm.get_instruction_objects(), ins)
+            self.assertEqual(asm.reassemble([line + "\n" for line in moved]), [])
+
+    def test_decoded_ops_cover_mulqacc_program(self):
+        if not _USE_C_MACHINE:
+            return
+        m = self._mulqacc_machine()
+        for addr, ins in enumerate(_mulqacc_program()):
+            self.assertEqual(m.get_decoded_op(addr), ins.MNEM)
+
+    def test_decoded_op_falls_back_to_execute(self):
+        if not _USE_C_MACHINE:
+            return
+        ins = _mulqacc_program()
+        addr = [i.MNEM for i in ins].index("BN.MULQACC.Z")
+        ins[addr] = _ExecuteOnly(ins[addr])
+        m = Machine([0x1234, 0x5678], ins, 0, len(ins) - 1)
+        self.assertIsNone(m.get_decoded_op(addr))
+        m.run()
+        self.assertEqual((m.dmem[3] << 256) + m.dmem[2], 0x1234 * 0x5678)
+        # replacing an imem entry re-decodes that slot
+        ins[addr] = ins[addr]._ins
+        self.assertEqual(m.get_decoded_op(addr), "BN.MULQACC.Z")
+        # entries without a native description still construct
+        self.assertIsNone(Machine([], [None]).get_decoded_op(0))
+
+    def test_native_ops_match_execute(self):
+        rng = random.Random(0x0DD5)
+        for _ in range(3):
+            ins = _random_bn_program(rng)
+            dmem = [rng.getrandbits(256) for _ in range(16)]
+            regs = [rng.getrandbits(256) for _ in range(32)]
+            results = []
+            for prog in (ins, [_ExecuteOnly(i) for i in ins]):
+                m = Machine(list(dmem), prog, 0, len(prog) - 1)
+                for i, v in enumerate(regs):
+                    m.set_reg(i, v)
+                m.set_reg("mod", regs[7])
+                run = m.run(collect_trace=True)
+                results.append((run, _machine_state(m)))
+            self.assertEqual(results[0], results[1])
+
+    def test_decoded_ops_cover_dcrypto_p256(self):
+        if not _USE_C_MACHINE:
+            return
+        with open(os.path.join(HEX_DIR, "dcrypto_p256.hex")) as f:
+            ins, ctx = ins_objects_from_hex_file(f)
+        m = Machine([], ins, 0, len(ins) - 1, ctx=ctx)
+        fallback = {
+            ins[addr].get_asm_str()[1].split()[0]
+            for addr in range(len(ins))
+            if m.get_decoded_op(addr) is None
+        }
+        self.assertEqual(fallback, {"sigini"})
+        # dcrypto ops that match an OTBN kernel share it
+        addr = [i.get_asm_str()[1].split()[0] for i in ins].index("mul128")
+        self.assertEqual(m.get_decoded_op(addr), "BN.MULH")
+
+    def test_p256_mulmod_routine_matches_step_loop(self):
+        with open(os.path.join(ASM_DIR, "dcrypto_p256.asm")) as f:
+            ins, ctx, _ = ins_objects_from_asm_file(f)
+        addr = {v: k for k, v in ctx.functions.items()}
+        p = 2**256 - 2**224 + 2**192 + 2**96 - 1
+        n = 0xFFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551
+        rng = random.Random(0x9256)
+
+        def mulmod(setup, a, b, step):
+            m = Machine([0] * 4, ins, addr[setup], None, ctx=ctx)
+            m.run()
+            m.finishFlag = False
+            m.set_pc(addr["MulMod"])
+            m.set_reg(24, a)
+            m.set_reg(25, b)
+            m.reset_perf_counters()
+            if step:
+                inst_cnt = cycle_cnt = 0
+                cont = True
+                while cont:
+                    cont, _, cycles = m.step()
+                    inst_cnt += 1
+                    cycle_cnt += cycles
+                run = (inst_cnt, cycle_cnt, "finish")
+            else:
+                run = m.run()
+            return m, run
+
+        for setup, mod in (("SetupP256PandMuLow", p), ("SetupP256NandMuLow", n)):
+            for a, b in [(mod - 1, mod - 1), (0, 1)] + [
+                    (rng.randrange(mod), rng.randrange(mod)) for _ in range(20)]:
+                m, run = mulmod(setup, a, b, step=False)
+                ref, ref_run = mulmod(setup, a, b, step=True)
+                self.assertEqual(m.get_reg(19), a * b % mod)
+                self.assertEqual(run, ref_run)
+                self.assertEqual(_machine_state(m), _machine_state(ref))
+                if _USE_C_MACHINE:
+                    self.assertEqual(m.perf_counters().routines, 1)
+                    self.assertEqual(m.get_exec_counts(), ref.get_exec_counts())
+
+    def test_native_hex_loaders(self):
+        with open(os.path.join(HEX_DIR, "dcrypto_bn.hex")) as f:
+            ref, ref_ctx = ins_objects_from_hex_file(f)
+        with open(os.path.join(HEX_DIR, "dcrypto_bn.hex"), "rb") as f:
+            program, ctx = program_from_hex_file(f)
+        self.assertEqual([i.get_asm_str() for i in program.instructions],
+                         [i.get_asm_str() for i in ref])
+        self.assertEqual(dict(ctx.functions), dict(ref_ctx.functions))
+        with self.assertRaises(ValueError):
+            program_from_hex_file(io.StringIO("0x12\n"))
+
+        rng = random.Random(0xD4E)
+        m = Machine([rng.getrandbits(256) for _ in range(40)], [None])
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "dmem.hex")
+            m.dump_dmem(40, path)
+            with open(path) as f:
+                self.assertEqual(read_dmem_from_file(f), m.dmem[:40])
+            with open(path, "rb") as f:
+                self.assertEqual(dmem_image_from_file(f), m.get_dmem_bytes(0, 40))
+            # Streaming: chunk boundaries split lines, images split cells
+            with open(path, "rb") as f:
+                images = list(iter_dmem_images(f, cells=16, chunk_size=100))
+            self.assertEqual([len(i) // 32 for i in images], [16, 16, 8])
+            self.assertEqual(b"".join(images), m.get_dmem_bytes(0, 40))
+            with open(path, "a") as f:
+                f.write("0041: 00000000\n")
+            with open(path) as f, self.assertRaises(ValueError):
+                read_dmem_from_file(f)
+        with self.assertRaises(OverflowError):
+            dmem_image_from_file(io.StringIO("0 0 0 0 0 0 0 0\n".replace("0", "00000000") * 129))
+
+    def test_dcrypto_native_ops_match_execute(self):
+        rng = random.Random(0xDC)
+        for _ in range(3):
+            lc = sum(rng.randrange(1, 4) << (32 * i) for i in range(8))
+            machine, ins, ctx, stop_addr = _seeded_dcrypto_machine(rng, lc)
+            rfp, dmp = rng.getrandbits(256), rng.getrandbits(256)
+            results = []
+            for prog in (ins, [_ExecuteOnly(i) for i in ins]):
+                m = machine(prog)
+                m.set_reg("rfp", rfp)
+                m.set_reg("dmp", dmp)
+                run = m.run(collect_trace=True)
+                results.append((run, _machine_state(m)))
+            self.assertEqual(results[0], results[1])
+
+    def test_snapshot_restore_and_fork(self):
+        rng = random.Random(0x5A)
+        m = _seeded_dcrypto_machine(rng, 0x0000000200000002)[0]()
+        m.run(max_steps=150)
+        snap = m.snapshot()
+        mid_state = _machine_state(m)[:-1]
+
+        clone = m.fork()
+        self.assertIs(type(clone), type(m))
+        self.assertEqual(_machine_state(clone)[:-1], mid_state)
+
+        m.run()
+        final_state = _machine_state(m)[:-1]
+        self.assertNotEqual(final_state, mid_state)
+        # The fork kept its own copy of the mid-run state
+        self.assertEqual(_machine_state(clone)[:-1], mid_state)
+        clone.run()
+        self.assertEqual(_machine_state(clone)[:-1], final_state)
+
+        m.restore(snap)
+        self.assertEqual(_machine_state(m)[:-1], mid_state)
+        m.run()
+        self.assertEqual(_machine_state(m)[:-1], final_state)
+
+    def test_run_with_gil_released_matches_run(self):
+        machine = _seeded_dcrypto_machine(random.Random(0x611), 0x0000000300000002)[0]
+        results = []
+        for release_gil in (False, True):
+            m = machine()
+            run = m.run(release_gil=release_gil)
+            results.append((run, _machine_state(m)))
+        self.assertEqual(results[0], results[1])
+
+    def test_released_run_raises_kernel_errors(self):
+        asm = Assembler(["LI x20, 40\n", "LI x21, 1\n", "BN.MOVR x20, x21\n", "ECALL\n"])
+        asm.assemble()
+        m = Machine([], asm.get_instruction_objects())
+        with self.assertRaises(IndexError):
+            m.run(release_gil=True)
+
+    def test_run_batch_matches_sequential_runs(self):
+        rng = random.Random(0xBA7)
+        template = _seeded_dcrypto_machine(rng)[0]()
+        images = [
+            b"".join(rng.getrandbits(256).to_bytes(32, "little") for _ in range(128))
+            for _ in range(6)
+        ]
+
+        results = run_batch(template, images, threads=3)
+        self.assertEqual(len(results), len(images))
+        for image, res in zip(images, results):
+            m = template.fork()
+            m.set_dmem_bytes(0, image)
+            run = m.run()
+            self.assertEqual((res.inst_cnt, res.cycle_cnt, res.stop_reason), run)
+            self.assertEqual(res.dmem, m.get_dmem_bytes())
+            self.assertEqual(_machine_state(res.machine), _machine_state(m))
+        # The template itself did not run
+        self.assertEqual(template.get_pc(), 0)
+
+        # Groups of lockstep lanes on each thread give the same results
+        lane_results = run_batch(template, images, threads=2, lanes=4)
+        self.assertEqual([r[:4] for r in lane_results], [r[:4] for r in results])
+
+    def test_run_lanes_matches_separate_runs(self):
+        rng = random.Random(0x1A9E)
+
+        def result(m, run):
+            if not _USE_C_MACHINE:
+                return run, _machine_state(m), state_digest(m)
+            return run, _machine_state(m), state_digest(m), m.get_exec_counts(), m.get_cycle_counts()
+
+        for _ in range(3):
+            machine, ins, ctx = _seeded_dcrypto_machine(rng)[:3]
+            program = Program(ins, ctx)
+
+            def lane(seed):
+                lrng = random.Random(seed)
+                m = machine(program)
+                m.dmem = [lrng.getrandbits(256) for _ in range(128)]
+                for i in range(32):
+                    m.set_reg(i, lrng.getrandbits(256) | 1)
+                # Lanes 0-3 share the loop count, the others diverge from the start
+                m.set_reg("lc", 0x0000000200000003 + (seed > 3))
+                return m
+
+            full = None
+            for max_steps in (None, 0, 57):
+                expected = []
+                for seed in range(6):
+                    m = lane(seed)
+                    expected.append(result(m, m.run(max_steps)))
+                lanes = [lane(seed) for seed in range(6)]
+                runs = run_lanes(lanes, max_steps)
+                self.assertEqual(list(map(result, lanes, runs)), expected, max_steps)
+                full = full or runs
+                if _USE_C_MACHINE and max_steps is None:
+                    # Most of the work ran in the lane kernels
+                    lane_ops = [m.perf_counters().lane_ops for m in lanes]
+                    self.assertGreater(min(lane_ops[:4]), full[0][0] // 4)
+            # Data-dependent branches really diverged some lanes
+            self.assertGreater(len({r[0] for r in full[:4]}), 1)
+
+        lanes = [lane(seed) for seed in range(3)]
+        self.assertEqual(run_lanes(lanes, release_gil=True),
+                         [lane(seed).run() for seed in range(3)])
+        self.assertEqual(run_lanes([]), [])
+        if not _USE_C_MACHINE:
+            return
+        m = lane(0)
+        with self.assertRaises(ValueError):
+            run_lanes([m, lane(1), m])
+        m.set_breakpoint(3)
+        with self.assertRaises(ValueError):
+            run_lanes([m, lane(1)])
+
+    def test_run_lanes_bn_kernels(self):
+        if not _USE_C_MACHINE:
+            return
+        rng = random.Random(0x50A)
+        stalls = {"load_use": 3, "acc_use": 5, "dmem_wait": 1}
+        for timing_model in (None, None, None, stalls):
+            ins = _random_bn_program(rng, n_ops=400)
+            program = Program(ins)
+            regs = [rng.getrandbits(256) for _ in range(32)]
+
+            def lane(seed):
+                lrng = random.Random(seed)
+                m = Machine([lrng.getrandbits(256) for _ in range(16)], program, 0, len(ins) - 1,
+                            timing_model=timing_model)
+                # Some registers agree across the lanes and some are never
+                # set, so equal operands and half-valid registers both
+                # reach the kernels
+                for i, v in enumerate(regs):
+                    if i % 5:
+                        m.set_reg(i, v if i % 3 else lrng.getrandbits(256))
+                m.set_reg("mod", regs[7])
+                m.set_acc(lrng.getrandbits(256))
+                return m
+
+            def result(m, run):
+                return run, _machine_state(m), state_digest(m), m.get_exec_counts(), m.get_cycle_counts()
+
+            expected = []
+            for seed in range(5):
+                m = lane(seed)
+                expected.append(result(m, m.run()))
+            lanes = [lane(seed) for seed in range(5)]
+            self.assertEqual(list(map(result, lanes, run_lanes(lanes))), expected, timing_model)
+
+    def test_stream_vectors_pipeline(self):
+        template = _seeded_dcrypto_machine(random.Random(0x57E))[0]()
+        lines = ['{"seed": %d}' % seed for seed in range(10)]
+        lines[3] = '{"seed": "bad"}'
+        lines.insert(5, "# comment")
+        lines.insert(6, "")
+
+        def image(seed):
+            srng = random.Random(seed)
+            return b"".join(srng.getrandbits(256).to_bytes(32, "little") for _ in range(128))
+
+        lock = threading.Lock()
+        in_flight = [0, 0]
+
+        def prepare(vector):
+            job = template.fork()
+            job.set_dmem_bytes(0, image(vector["seed"]))
+            with lock:
+                in_flight[0] += 1
+                in_flight[1] = max(in_flight)
+            return job
+
+        def execute(job):
+            return job.run(release_gil=True)
+
+        def check(vector, job, result):
+            with lock:
+                in_flight[0] -= 1
+            ref = template.fork()
+            ref.set_dmem_bytes(0, image(vector["seed"]))
+            return {"ok": result == ref.run() and vector["seed"] % 4 != 1,
+                    "inst_cnt": result[0]}
+
+        out = io.StringIO()
+        summary = stream_vectors(iter_vectors(io.StringIO("\n".join(lines))), prepare, execute,
+                                 check, results=out, workers=2, window=3)
+        self.assertEqual(summary, {"vectors": 10, "passed": 6, "failed": 4})
+        self.assertLessEqual(in_flight[1], 3)
+        records = [json.loads(line) for line in out.getvalue().splitlines()]
+        self.assertEqual([r["index"] for r in records], list(range(10)))
+        self.assertEqual([r["ok"] for r in records],
+                         [seed % 4 != 1 and seed != 3 for seed in range(10)])
+        self.assertIn("error", records[3])
+        self.assertNotIn("error", records[1])
+
+    def test_lockstep_matches_reference_and_finds_divergence(self):
+        machine, ins = _seeded_dcrypto_machine(random.Random(0x10C))[:2]
+        m = machine()
+        state = decode_state(m.state_bytes())
+        self.assertEqual(state["r"], [m.get_reg(i) for i in range(32)])
+        self.assertEqual(state["dmem"], m.dmem)
+        expected = m.fork().run()
+        for kwargs in ({}, {"every": 16}, {"blocks": True}):
+            m = machine()
+            res = lockstep(m, **kwargs)
+            self.assertIsNone(res.divergence, kwargs)
+            self.assertEqual(res[:3], expected)
+            self.assertEqual(state_digest(m), state_digest(res.reference))
+        res = lockstep(machine(), max_steps=40)
+        self.assertEqual((res.inst_cnt, res.stop_reason), (40, "max_steps"))
+
+        if not _USE_C_MACHINE:
+            return
+        # Only the reference runs the Python execute() of natively decoded ops
+        orig = instructions.IXor.execute
+
+        def broken(op, m):
+            ret = orig(op, m)
+            m.set_reg(op.rd, m.get_reg(op.rd) ^ 1)
+            return ret
+
+        found = []
+        with mock.patch.object(instructions.IXor, "execute", broken):
+            for kwargs in ({}, {"every": 64}, {"blocks": True}):
+                m = machine()
+                found.append(lockstep(m, **kwargs).divergence)
+                # Pinning the instruction counts nothing twice: the stats
+                # cover the checked stretch the divergence fell in
+                executed = sum(m.get_exec_counts())
+                self.assertGreaterEqual(executed, found[-1].inst_cnt, kwargs)
+                if not kwargs.get("blocks"):
+                    self.assertLess(executed, found[-1].inst_cnt + kwargs.get("every", 1), kwargs)
+                self.assertEqual(m.get_pc(), found[-1].pc + 1, kwargs)
+        # Sparser checks miss divergences overwritten before the next one,
+        # but always pin the instruction of the one they catch
+        self.assertEqual(found[0].inst_cnt, min(at.inst_cnt for at in found))
+        for at in found:
+            self.assertIsInstance(ins[at.pc], instructions.IXor)
+            self.assertEqual([d[0] for d in at.diff], ["r[%d]" % ins[at.pc].rd])
+            native, reference = at.diff[0][1:]
+            self.assertEqual(native ^ reference, 1)
+
+        # A reference that raises stops the native side at the same
+        # instruction, also when it checks whole blocks
+        def raising(op, m):
+            raise ArithmeticError("reference failed")
+
+        with mock.patch.object(instructions.IXor, "execute", raising):
+            for kwargs in ({}, {"every": 64}, {"blocks": True}):
+                m = machine()
+                res = lockstep(m, **kwargs)
+                self.assertEqual(res.divergence.pc, found[0].pc, kwargs)
+                self.assertEqual(res.divergence.inst_cnt, found[0].inst_cnt, kwargs)
+                self.assertEqual(res.divergence.diff[0][0], "exception", kwargs)
+                self.assertLessEqual(sum(m.get_exec_counts()), found[0].inst_cnt + 64, kwargs)
+
+    def test_submit_and_run_async(self):
+        def counter(levels, n=100):
+            src = []
+            for i in range(levels):
+                src.append(f"LOOPI {n}, {2 * (levels - i) - 1}\n")
+            src += [f"ADDI x{5 + i}, x{5 + i}, 1\n" for i in range(levels)] + ["ECALL\n"]
+            asm = Assembler(src)
+            asm.assemble()
+            return Machine([], asm.get_instruction_objects())
+
+        m = counter(2)
+        expected = m.fork().run()
+        seen = []
+        future = m.submit(progress=lambda i, c: seen.append(i), progress_every=1000)
+        self.assertEqual(future.result(timeout=60), expected)
+        self.assertEqual(seen, list(range(1000, expected[0], 1000)))
+        self.assertEqual(m.get_gpr(5), 100 * 100)
+        self.assertEqual(counter(2).submit(max_steps=1234).result(timeout=60)[::2], (1234, "max_steps"))
+
+        # A billion instructions: only cancellation ends this one
+        m = counter(3, 1000)
+        started = threading.Event()
+        future = m.submit(progress=lambda i, c: started.set(), progress_every=1000)
+        self.assertTrue(started.wait(60))
+        with self.assertRaises(RuntimeError):
+            m.submit()
+        self.assertTrue(future.cancel())
+        with self.assertRaises(CancelledError):
+            future.result(timeout=60)
+        self.assertFalse(future.cancel())
+        self.assertGreater(m.get_gpr(5), 0)
+
+        async def overlapped():
+            loop_thread = threading.get_ident()
+            threads = set()
+            runs = [counter(2) for _ in range(3)]
+            results = await asyncio.gather(*(
+                r.run_async(progress=lambda i, c: threads.add(threading.get_ident()), progress_every=500)
+                for r in runs
+            ))
+            self.assertEqual(results, [expected] * 3)
+            self.assertEqual(threads, {loop_thread})
+
+            slow = counter(3, 1000)
+            task = asyncio.ensure_future(slow.run_async())
+            await asyncio.sleep(0.05)
+            task.cancel()
+            with self.assertRaises(asyncio.CancelledError):
+                await task
+            return slow
+
+        slow = asyncio.run(overlapped())
+        with self.assertRaises(CancelledError):
+            slow._background_run.result(timeout=60)
+
+        if not _USE_C_MACHINE:
+            return
+        # Nothing replaces what a background run works on while it lasts
+        entered, resume = threading.Event(), threading.Event()
+
+        class Blocking(_ExecuteOnly):
+            def execute(self, m):
+                entered.set()
+                resume.wait(60)
+                return self._ins.execute(m)
+
+        ins = list(counter(2).imem)
+        imem = ins[:3] + [Blocking(ins[3])] + ins[4:]
+        pool = MachinePool(Program(imem), 1)
+        for m, pooled in ((Machine([], imem), False), (pool.acquire(), True)):
+            entered.clear()
+            resume.clear()
+            snap = m.snapshot()
+            future = m.submit()
+            try:
+                self.assertTrue(entered.wait(60))
+                for call in (lambda: m.reset([], imem), lambda: m.restore(snap), m.step, m.run,
+                             lambda: m.set_dmem_bytes(0, bytes(32)), lambda: setattr(m, "dmem", [0]),
+                             lambda: setattr(m, "timing_model", None)):
+                    with self.assertRaises(RuntimeError):
+                        call()
+                if pooled:
+                    with self.assertRaises(RuntimeError):
+                        pool.release(m)
+            finally:
+                resume.set()
+            self.assertEqual(future.result(timeout=60), expected)
+            m.restore(snap)
+        pool.release(m)
+        self.assertIs(pool.acquire(), m)
+
+    def test_shared_program_matches_list_imem(self):
+        machine, ins, ctx = _seeded_dcrypto_machine(random.Random(0x9906))[:3]
+        program = Program(ins, ctx)
+        self.assertEqual(len(program), len(ins))
+        self.assertEqual(list(program.instructions), ins)
+        self.assertIs(program.ctx, ctx)
+        self.assertEqual(dict(program.functions), dict(ctx.functions))
+        self.assertEqual(dict(program.labels), dict(ctx.labels))
+        self.assertEqual(list(program.cycles), [i.get_cycles() for i in ins])
+
+        def run(imem):
+            m = machine(imem)
+            return m, m.run()
+
+        ref, ref_run = run(ins)
+        shared = [run(program) for _ in range(2)]
+        for m, res in shared:
+            self.assertEqual(res, ref_run)
+            self.assertIs(m.ctx, ctx)
+            self.assertIs(m.program, program)
+            self.assertEqual(_machine_state(m), _machine_state(ref))
+        self.assertIsNone(ref.program)
+        if _USE_C_MACHINE:
+            # Statistics stay per machine
+            shared[0][0].run()
+            self.assertEqual(shared[1][0].get_exec_counts(), ref.get_exec_counts())
+            self.assertEqual(sum(shared[1][0].get_exec_counts()), ref_run[0])
+            fork = shared[1][0].fork()
+            self.assertIs(fork.program, program)
+
+    def test_machine_pool_hands_out_fresh_machines(self):
+        machine, ins, ctx, stop_addr = _seeded_dcrypto_machine(random.Random(0x9030))
+        program = Program(ins, ctx)
+
+        def run(m):
+            return machine(into=m).run()
+
+        ref = machine(program)
+        dmem = ref.dmem
+        ref_run = ref.run()
+        pool = MachinePool(program, 2)
+        self.assertEqual((len(pool), pool.available), (2, 2))
+        self.assertIs(pool.program, program)
+        first = pool.acquire(list(dmem), 0, stop_addr)
+        other = pool.acquire()
+        self.assertIsNot(first, other)
+        self.assertIsInstance(first, Machine)
+        self.assertEqual(other.dmem, [0] * len(dmem))
+        with self.assertRaises(RuntimeError):
+            pool.acquire()
+        self.assertEqual(run(first), ref_run)
+        self.assertEqual(_machine_state(first), _machine_state(ref))
+
+        # Whatever the last user left behind is gone on the next acquire
+        stats = first.stats
+        first.set_breakpoint(stop_addr // 2)
+        first.set_reg(3, 1)
+        pool.release(first)
+        with self.assertRaises(ValueError):
+            pool.release(first)
+        with self.assertRaises(ValueError):
+            pool.release(ref)
+        again = pool.acquire(list(dmem), 0, stop_addr)
+        self.assertIs(again, first)
+        self.assertIsNot(again.stats, stats)
+        self.assertFalse(again.get_breakpoints())
+        self.assertIs(again.ctx, ctx)
+        self.assertEqual(run(again), ref_run)
+        self.assertEqual(_machine_state(again), _machine_state(ref))
+        self.assertEqual(again.xlen_mask, (1 << 256) - 1)
+        if _USE_C_MACHINE:
+            self.assertIs(again.xlen_mask, ref.xlen_mask)
+            self.assertEqual(again.get_exec_counts(), ref.get_exec_counts())
+            self.assertEqual(again.perf_counters().native_ops, ref.perf_counters().native_ops)
+        # A machine reset() to a list goes back to the program
+        other.reset(list(dmem), ins, 0, stop_addr)
+        pool.release(other)
+        pool.release(again)
+        self.assertIs(pool.acquire(list(dmem), 0, stop_addr), first)
+        moved = pool.acquire(list(dmem), 0, stop_addr)
+        self.assertIs(moved.program, program)
+        self.assertEqual(run(moved), ref_run)
+        self.assertEqual(_machine_state(moved), _machine_state(ref))
+        with self.assertRaises(TypeError):
+            MachinePool(ins, 1)
+
+    def test_program_cache_round_trip(self):
+        asm_path = os.path.join(ASM_DIR, "otbn_mulqacc_256x256.asm")
+        rng = random.Random(0x0C4E)
+        dmem = [rng.getrandbits(256) for _ in range(2)]
+
+        def run(program):
+            m = Machine(list(dmem), program, 0, 23)
+            m.run()
+            return _machine_state(m)
+
+        with tempfile.TemporaryDirectory() as cache:
+            ref, ctx, bps = program_cache.load_asm_program(asm_path, directory=cache)
+            entries = os.listdir(cache)
+            self.assertEqual(len(entries), 1)
+            # A hit neither assembles nor decodes
+            with mock.patch.object(program_cache, "_assemble", side_effect=AssertionError):
+                hit, hit_ctx, hit_bps = program_cache.load_asm_program(asm_path, directory=cache)
+            self.assertEqual(hit_bps, bps)
+            self.assertEqual(dict(hit.labels), dict(ref.labels))
+            self.assertEqual([i.get_asm_str() for i in hit.instructions],
+                             [i.get_asm_str() for i in ref.instructions])
+            self.assertEqual(run(hit), run(ref))
+            # ISA flags key their own entry
+            program_cache.load_asm_program(asm_path, dmem_byte_addressing=True, directory=cache)
+            self.assertEqual(len(os.listdir(cache)), 2)
+            # A damaged entry is rebuilt
+            with open(os.path.join(cache, entries[0]), "r+b") as f:
+                f.truncate(100)
+            again, _, _ = program_cache.load_asm_program(asm_path, directory=cache)
+            self.assertEqual(run(again), run(ref))
+            with mock.patch.object(program_cache, "_assemble", side_effect=AssertionError):
+                program_cache.load_asm_program(asm_path, directory=cache)
+            # So is one with a flipped bit anywhere in its payload
+            with open(os.path.join(cache, entries[0]), "r+b") as f:
+                f.seek(-1, os.SEEK_END)
+                last = f.read(1)
+                f.seek(-1, os.SEEK_END)
+                f.write(bytes([last[0] ^ 0x10]))
+            with mock.patch.object(program_cache, "_assemble", wraps=program_cache._assemble) as asm:
+                again, _, _ = program_cache.load_asm_program(asm_path, directory=cache)
+            asm.assert_called_once()
+            self.assertEqual(run(again), run(ref))
+
+        if _USE_C_MACHINE:
+            image = ref.ops_image()
+            with self.assertRaises(ValueError):
+                Program(ref.instructions[:-1], ops=image)
+            with self.assertRaises(ValueError):
+                Program(ref.instructions, ops=image[:-1])
+            with self.assertRaises(ValueError):
+                Program(ref.instructions, timing_model={"BN.ADD": 2}).ops_image()
+            timed = Program(ref.instructions, timing_model={"BN.MULQACC": 3}, ops=image)
+            self.assertEqual(timed.cycles, Program(ref.instructions, timing_model={"BN.MULQACC": 3}).cycles)
+
+            # Operand fields and links are checked, not trusted
+            def program(*lines):
+                asm = Assembler([line + "\n" for line in lines])
+                asm.assemble()
+                return Program(asm.get_instruction_objects())
+
+            mov1, mov3 = program("BN.MOV w1, w2", "ECALL"), program("BN.MOV w3, w2", "ECALL")
+            image = bytearray(mov1.ops_image())
+            op_size = len(image) - len(program("ECALL").ops_image())
+            header = len(image) - 2 * op_size
+            rd = [i for i, (a, b) in enumerate(zip(image, mov3.ops_image())) if a != b]
+            self.assertEqual(len(rd), 1)
+            Program(mov1.instructions, ops=bytes(image))
+            image[rd[0]] = 40
+            with self.assertRaises(ValueError):
+                Program(mov1.instructions, ops=bytes(image))
+            movs = program("BN.MOV w1, w2", "BN.MOV w3, w2", "ECALL")
+            image = bytearray(movs.ops_image())
+            image[header:] = image[header + op_size:] + image[header:header + op_size]
+            with self.assertRaises(ValueError):
+                Program(movs.instructions, ops=bytes(image))
+
+    def test_restore_rejects_foreign_blob(self):
+        if not _USE_C_MACHINE:
+            return
+        m = Machine([], [None])
+        snap = m.snapshot()
+        with self.assertRaises(ValueError):
+            m.restore(snap[:-1])
+        with self.assertRaises(ValueError):
+            m.restore(b"X" + snap[1:])
+
+    def test_stats_match_python_machine(self):
+        from ot_dsim.bignum_lib.machine import _PyMachine
+
+        rng = random.Random(0x57A7)
+        machine = _seeded_dcrypto_machine(rng, 0x0000000300000002)[0]
+        rfp, dmp = rng.getrandbits(256), rng.getrandbits(256)
+        stats = []
+        for cls in (Machine, _PyMachine):
+            m = machine(cls=cls)
+            m.set_reg("rfp", rfp)
+            m.set_reg("dmp", dmp)
+            while m.step()[0]:
+                pass
+            stats.append(m.stats)
+        self.assertEqual(stats[0], stats[1])
+        self.assertGreater(len(stats[0]["flag_access"]), 0)
+
+    def test_stats_flushed_into_assigned_dict(self):
+        stats = {}
+        m = self._mulqacc_machine()
+        m.stats = stats
+        inst_cnt, cycle_cnt, _ = m.run()
+        if _USE_C_MACHINE:
+            self.assertEqual(sum(m.get_exec_counts()), inst_cnt)
+            self.assertEqual(sum(m.get_cycle_counts()), cycle_cnt)
+            self.assertEqual(sum(m.get_opcode_counts().values()), inst_cnt)
+            self.assertEqual(m.get_opcode_counts()["BN.MULQACC.Z"], 1)
+        # the dict is complete once the machine is released
+        del m
+        self.assertEqual(sum(stats["instruction_histo"].values()), inst_cnt)
+        self.assertEqual(stats["instruction_histo"]["BN.MULQACC.Z,"], 1)
+
+    def test_binary_trace_records_each_instruction(self):
+        if not _USE_C_MACHINE:
+            return
+        ref = self._mulqacc_machine()
+        pcs = []
+        cont = True
+        while cont:
+            pcs.append(ref.get_pc())
+            cont = ref.step()[0]
+
+        m = self._mulqacc_machine()
+        m.enable_trace()
+        inst_cnt = m.run()[0]
+        self.assertEqual(m.disable_trace(), inst_cnt)
+        names, records = read_binary_trace(m.get_trace())
+        self.assertEqual([r.pc for r in records], pcs)
+        self.assertEqual(names[records[0].opcode], m.get_decoded_op(records[0].pc))
+        final = {r.wdr: r.wdr_value for r in records if r.wdr is not None}
+        self.assertTrue(final)
+        for reg, value in final.items():
+            self.assertEqual(m.get_reg(reg), value)
+        self.assertEqual(records[-1].flags, m.get_flags_as_bin())
+        lines = render_binary_trace(m.get_trace(), _mulqacc_program())
+        self.assertEqual(len(lines), inst_cnt)
+
+    def test_binary_trace_ring_and_file(self):
+        if not _USE_C_MACHINE:
+            return
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "trace.bin")
+            m = self._mulqacc_machine()
+            m.enable_trace(path=path)
+            m.run()
+            m.disable_trace()
+            with open(path, "rb") as f:
+                _, full = read_binary_trace(f.read())
+        m = self._mulqacc_machine()
+        m.enable_trace(capacity=4)
+        self.assertEqual(m.run()[0], len(full))
+        _, ring = read_binary_trace(m.get_trace())
+        self.assertEqual(ring, full[-4:])
+        with self.assertRaises(ValueError):
+            m.enable_trace(capacity=0)
+        with self.assertRaises(ValueError):
+            read_binary_trace(b"not a trace")
+
+    def test_perf_counters(self):
+        m = self._mulqacc_machine()
+        inst_cnt = m.run()[0]
+        perf = m.perf_counters()
+        self.assertEqual(len(perf), len(PERF_COUNTER_FIELDS))
+        self.assertEqual(perf.native_ops + perf.python_ops, inst_cnt)
+        self.assertGreater(perf.run_ns, 0)
+        d = perf_counters_dict(perf)
+        self.assertEqual([d[name] for name in PERF_COUNTER_FIELDS], list(perf))
+        self.assertEqual(json.loads(json.dumps(d)), d)
+        m.reset_perf_counters()
+        self.assertEqual(list(m.perf_counters()), [0] * len(PERF_COUNTER_FIELDS))
+        if not _USE_C_MACHINE:
+            return
+        self.assertEqual(perf.native_ops, inst_cnt)
+        self.assertGreater(perf.superinstructions, 0)
+        self.assertLessEqual(perf.fused_ops, perf.block_ops)
+        self.assertLessEqual(perf.block_ops, perf.native_ops)
+        self.assertGreater(perf.breakpoint_checks, 0)
+        self.assertEqual(perf.trace_bytes, 0)
+        self.assertGreater(d["superinstruction_rate"], 0)
+
+        m.get_reg(3)
+        m.get_dmem_bytes()
+        perf = m.perf_counters()
+        self.assertEqual(perf.pylongs, 1)
+        self.assertEqual(perf.dmem_host_bytes, m.DMEM_DEPTH * 32)
+        self.assertEqual(perf.native_ops, 0)
+
+        m = self._mulqacc_machine()
+        m.enable_trace()
+        inst_cnt = m.run()[0]
+        perf = m.perf_counters()
+        self.assertGreater(perf.trace_bytes, 0)
+        self.assertEqual(perf.trace_bytes % inst_cnt, 0)
+        self.assertEqual(perf.superinstructions, 0)
+        # a list imem is decoded by the machine, a Program by itself
+        self.assertGreater(Machine([], list(_mulqacc_program())).perf_counters().decode_ns, 0)
+        self.assertGreater(Program(_mulqacc_program()).decode_ns, 0)
+
+    def test_profile_attributes_cycles_to_calls_and_loops(self):
+        if not _USE_C_MACHINE:
+            return
+        body = ["call &helper", "loop #3 (", "call &helper", "addc r4, r4, r5", ")", "nop"]
+        helper = ["addi r9, r9, #1", "ret"]
+        lines = ["function main[5] {"] + body + ["}", "function helper[2] {"] + helper + ["}"]
+        ins, ctx, _ = ins_objects_from_asm_file(io.StringIO("\n".join(lines) + "\n"))
+        m = Machine([0] * 128, ins, 0, 4, ctx=ctx)
+        m.enable_profile()
+        _, cycle_cnt, _ = m.run()
+        prof = m.get_profile()
+        helper_cycles = 4 * (ins[5].get_cycles() + ins[6].get_cycles())
+
+        self.assertEqual(prof["cycles"], cycle_cnt)
+        self.assertEqual(sum(prof["paths"].values()), cycle_cnt)
+        self.assertEqual(prof["paths"]["main;helper"], helper_cycles)
+        self.assertEqual(prof["functions"]["helper"],
+                         {"calls": 4, "inclusive": helper_cycles, "exclusive": helper_cycles})
+        self.assertEqual(prof["functions"]["main"]["inclusive"], cycle_cnt)
+        self.assertEqual(prof["functions"]["main"]["exclusive"], cycle_cnt - helper_cycles)
+        self.assertEqual(prof["loops"][1]["entries"], 1)
+        self.assertEqual(prof["loops"][1]["iterations"], 3)
+
+        out = io.StringIO()
+        m.write_folded_profile(out)
+        self.assertIn(f"main;helper {helper_cycles}\n", out.getvalue())
+        m.disable_profile()
+        m.set_pc(0)
+        m.run()
+        self.assertEqual(m.get_profile(), prof)
+
+    def test_watchpoints_stop_run_after_the_write(self):
+        if not _USE_C_MACHINE:
+            return
+        lines = ["LOOPI 3, 2", "BN.ADD w3, w3, w2", "ADDI x5, x5, 1",
+                 "LI x22, 64", "SW x5, 0(x22)", "NOP"]
+        asm = Assembler([line + "\n" for line in lines])
+        asm.assemble()
+        ins = asm.get_instruction_objects()
+        m = Machine([0] * 4, ins, 0, len(ins) - 1)
+        m.set_reg(2, 1)
+        m.set_watchpoint("wdr", 3)
+        m.set_watchpoint("dmem", 2)
+        self.assertEqual(m.watchpoints, [("dmem", 2), ("wdr", 3)])
+        for i in range(3):
+            self.assertEqual(m.run()[2], "watchpoint")
+            self.assertEqual(m.watch_hit, ("wdr", 3, 1))
+            self.assertEqual((m.get_pc(), m.get_reg(3), m.get_gpr(5)), (2, i + 1, i))
+        self.assertEqual(m.run()[2], "watchpoint")
+        self.assertEqual(m.watch_hit, ("dmem", 2, 4))
+        self.assertEqual(m.get_dmem(2), 3)
+        m.clear_watchpoint("dmem", 2)
+        self.assertEqual(m.watchpoints, [("wdr", 3)])
+        self.assertEqual(m.run()[2], "stop_addr")
+        self.assertIsNone(m.watch_hit)
+
+        m.clear_watchpoints()
+        self.assertEqual(m.watchpoints, [])
+        with self.assertRaises(IndexError):
+            m.set_watchpoint("wdr", 32)
+        with self.assertRaises(ValueError):
+            m.set_watchpoint("csr", 0)
+
+    def test_timing_model_tables_and_stalls(self):
+        if not _USE_C_MACHINE:
+            return
+        lines = ["LI x5, 0", "LW x6, 0(x5)", "ADDI x7, x6, 1", "ADDI x8, x5, 1",
+                 "BN.MULQACC.Z w1.0, w2.0, 0", "BN.MULQACC w1.1, w2.1, 64",
+                 "BN.ADD w3, w1, w2", "NOP"]
+        asm = Assembler([line + "\n" for line in lines])
+        asm.assemble()
+        ins = asm.get_instruction_objects()
+        base = [i.get_cycles() for i in ins]
+
+        def run(imem, **kw):
+            m = Machine([0] * 4, imem, 0, len(ins) - 1, **kw)
+            m.set_reg(2, 0x1234)
+            inst_cnt, cycle_cnt, _ = m.run()
+            return cycle_cnt, _machine_state(m)[:7]
+
+        ref_cycles, ref_state = run(ins)
+        self.assertEqual(ref_cycles, sum(base))
+
+        model = {"BN.MULQACC": 4, "BN.MULQACC.Z": 2}
+        prog = Program(ins, timing_model=model)
+        self.assertEqual(prog.timing_model, model)
+        self.assertEqual(prog.cycles[4:6], (2, 4))
+        cycles, state = run(prog)
+        self.assertEqual(cycles, ref_cycles - sum(base[4:6]) + 6)
+        self.assertEqual(state, ref_state)
+
+        # stall rules: LW waits once, ADDI x7 uses the loaded x6, the
+        # MULQACC accumulates onto the MULQACC.Z result
+        stalls = {"load_use": 3, "acc_use": 5, "dmem_wait": 1}
+        cycles, state = run(ins, timing_model=stalls)
+        self.assertEqual(cycles, ref_cycles + 1 + 3 + 5)
+        self.assertEqual(state, ref_state)
+        # a machine's own model applies on top of the program's cycles,
+        # and is forked
+        prog_cycles = ref_cycles - sum(base[4:6]) + 6
+        m = Machine([0] * 4, prog, 0, len(ins) - 1, timing_model=stalls)
+        self.assertEqual(m.timing_model, stalls)
+        self.assertEqual(m.fork().run()[1], prog_cycles + 9)
+        m.timing_model = None
+        self.assertIsNone(m.timing_model)
+        self.assertEqual(m.run()[1], prog_cycles)
+        self.assertEqual(Machine([0] * 4, prog).timing_model, model)
+        # the load-use hazard of LW x6 survives snapshot()/restore() but
+        # not reset()
+        m = Machine([0] * 4, ins, 0, 1, timing_model=stalls)
+        m.run()
+        blob = m.snapshot()
+        m.reset([0] * 4, ins, 2, 2)
+        self.assertEqual(m.run()[1], base[2])
+        m.restore(blob)
+        m.stop_addr = 2
+        self.assertEqual(m.run()[1], base[2] + 3)
+
+        with self.assertRaises(ValueError):
+            Program(ins, timing_model={"BN.FOO": 1})
+        with self.assertRaises(ValueError):
+            Machine([0] * 4, ins, timing_model={"load_use": -1})
+
     def test_random_limb_operations(self):
         """Stress test: random set_reg_limb / get_reg_limb consistency."""
         rng = random.Random(0xBEEF)